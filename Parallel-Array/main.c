@@ -4,37 +4,63 @@
  * @brief 자료구조에 대한 테스트가 수행되는 파일이다.
  * @details 이 프로그램을 사용하는 방법은 해당 소스 코드가 있는 폴더에
  테스트 케이스 파일을 가져와서(e.g. uniform.inp) 이름을 `test.inp`로 변경하고 넣도록 한다.
- 입력 파일은 상수로 설정되어 있으므로 반드시 입력 파일의 이름은 `test.inp`로 해주도록 한다.
+ 입력과 출력 파일의 이름은 각각 `-i`, `-o`로 바꿀 수 있다.
 
- 그리고 만약 내가 trivial한 동작을 돌리고 싶은 경우에는 parallel.h 파일의 `#define TRIVIAL`
- 매크로의 주석을 해제해주고, 그렇지 않은 개선된 버전을 동작시키는 경우에는 해당 주석을 제거해주도록 한다.
- 단, DEBUG 주석은 해제하지 말도록 한다.
+ 사용할 자료구조는 `-b <backend>`로 고르며(기본 값은 PA_DEFAULT_BACKEND), `-l`은
+ 고를 수 있는 backend의 목록을 보여준다. `-c`를 주면 같은 입력을 모든 backend로
+ 수행해서 각각 `test.<backend>.out`에 쓰고, `-b`로 고른 backend의 출력과 비교한
+ 결과와 처리량, 명령별 지연 시간을 표로 출력한다. 단, DEBUG 주석은 해제하지 말도록 한다.
 
- 여기까지 했으면 code block의 **Build and run**을 클릭하여 실행해주도록 한다.
+ `-s <snapshot>`을 주면 시작할 때 snapshot에서 PA를 읽고 끝날 때 같은 경로에
+ 저장한다. snapshot이 없거나 읽을 수 없으면 빈 PA에서 입력을 수행한다.
+
+ 빌드는 `make`로 하고 `./parallel`로 실행한다. `make check`는 `check.inp`로
+ 모든 backend와 AVX2 빌드의 출력, snapshot으로 이어서 수행한 출력을 비교한다.
  * @date 2020-04-03
  *
  */
 #include "parallel.h"
 
-static FILE *inp_fp; /**< 입력 파일의 포인터이다. */
-static FILE *outp_fp; /**< 출력 파일의 포인터이다. */
+#include <limits.h>
+
+static struct pa_input input; /**< mmap된 입력 파일이다. */
+static struct pa_output output; /**< 결과를 모아서 쓰는 출력이다. */
 static int N; /**< 입력 파일에 있는 명령의 갯수를 지칭한다. */
-static struct op operation; /**< trivial, improve를 선택할 수 있도록 해준다. */
+static struct op operation; /**< 고른 backend의 함수들이다. */
+static void *stores[PA_MAX_SHARDS]; /**< shard마다 가지는 PA이다. */
+static int nr_shards; /**< 명령을 나누어 수행하는 shard의 수이다. */
+static struct pa_snapshot snapshot; /**< 시작할 때 읽어온 snapshot이다. */
+static const char *snapshot_path; /**< snapshot 파일의 경로로 NULL이면 사용하지 않는다. */
 
 /**
  * @brief 입력 파일 및 출력 파일, N 값을 설정한다. 그리고 PA를 동적 할당하고, 빈 공간 정보를 설정한다.
  *
+ * @param backend 사용할 backend
  * @param inp_file 입력 파일의 이름을 가진다.
  * @param outp_file 출력 파일의 이름을 가진다.
+ * @param restore 1이면 snapshot_path가 있을 때 PA를 snapshot에서 읽는다.
  */
-static void setup(const char *inp_file, const char *outp_file)
+static void setup(const struct pa_backend *backend, const char *inp_file,
+                  const char *outp_file, int restore)
 {
-        int ret;
+        struct pa_line line;
+        int ret, i;
 
-        inp_fp = fopen(inp_file, "r");
-        outp_fp = fopen(outp_file, "w");
+        ret = pa_input_open(&input, inp_file);
+        if (ret != 0) {
+                fprintf(stderr, "[%s:%s(%d)] Cannot open the input file\n",
+                        __FILE__, __FUNCTION__, __LINE__);
+                exit(ret);
+        }
+        ret = pa_output_open(&output, outp_file, PA_OUTPUT_ASYNC);
+        if (ret != 0) {
+                fprintf(stderr, "[%s:%s(%d)] Cannot open the output file\n",
+                        __FILE__, __FUNCTION__, __LINE__);
+                exit(ret);
+        }
 
-        fscanf(inp_fp, "%d\n", &N);
+        N = (pa_input_next(&input, &line) ? pa_field_atoi(&line.field[0]) :
+                                             0);
 
         if (N < 0) {
                 fprintf(stderr, "[%s:%s,(%d)] invalid N value(%d)", __FILE__,
@@ -42,110 +68,295 @@ static void setup(const char *inp_file, const char *outp_file)
                 exit(-EINVAL);
         }
 
-#ifdef TRIVIAL
-        printf("[%s:%s(%d)] trivial setting initialize\n", __FILE__,
-               __FUNCTION__, __LINE__);
-        operation.init = trivial_init;
-        operation.insert = trivial_insert;
-        operation.search = trivial_search;
-        operation.remove = trivial_remove;
-#ifdef DEBUG
-        operation.get_current_usage = trivial_get_current_usage;
-#endif
-        operation.free = trivial_free;
-#else
-        printf("[%s:%s(%d)] improve setting initialize\n", __FILE__,
-               __FUNCTION__, __LINE__);
-        operation.init = improve_init;
-        operation.insert = improve_insert;
-        operation.search = improve_search;
-        operation.remove = improve_remove;
-#ifdef DEBUG
-        operation.get_current_usage = improve_get_current_usage;
-#endif
-        operation.free = improve_free;
-#endif
-        ret = operation.init();
+        printf("[%s:%s(%d)] %s setting initialize\n", __FILE__,
+               __FUNCTION__, __LINE__, backend->name);
+        operation = backend->operation;
+        if (backend->sharded) {
+                nr_shards = (PA_NR_SHARDS > 0 ? PA_NR_SHARDS :
+                                                pa_pipeline_nr_cpus());
+        } else {
+                nr_shards = 1; /**< trivial은 전역 변수를 사용하므로 나눌 수 없다. */
+        }
+        if (nr_shards > PA_MAX_SHARDS) {
+                nr_shards = PA_MAX_SHARDS;
+        }
+        ret = (restore && snapshot_path != NULL ?
+                       pa_snapshot_load(&snapshot, snapshot_path, &operation,
+                                        stores, &nr_shards) :
+                       -ENOENT);
+        if (ret == 0) {
+                printf("[%s:%s(%d)] %d shard(s) from %s\n", __FILE__,
+                       __FUNCTION__, __LINE__, nr_shards, snapshot_path);
+                return;
+        }
+        if (ret != -ENOENT) {
+                /* 실패한 load는 store를 남기지 않으므로 처음부터 수행하면 된다. */
+                fprintf(stderr,
+                        "[%s:%s(%d)] Cannot load the snapshot %s (%s), "
+                        "replaying from empty\n",
+                        __FILE__, __FUNCTION__, __LINE__, snapshot_path,
+                        (ret == -EOPNOTSUPP ? "not supported by backend" :
+                         ret == -EINVAL     ? "header does not match" :
+                                              strerror(-ret)));
+        }
+        printf("[%s:%s(%d)] %d shard(s)\n", __FILE__, __FUNCTION__, __LINE__,
+               nr_shards);
+        for (i = 0; i < nr_shards; i++) {
+                ret = operation.init(&stores[i]);
+                if (ret != 0) {
+                        fprintf(stderr, "[%s:%s(%d)] Initialize failed\n",
+                                __FILE__, __FUNCTION__, __LINE__);
+                        exit(ret);
+                }
+        }
+}
+
+/**
+ * @brief 실제 자료구조를 테스트하는 부분이다.
+ * @details 입력 해석과 결과 출력은 별도의 thread에서 수행되고, 명령은 id에
+ 따라 shard별 thread에서 수행된다. 이 thread는 0번 shard를 맡는다.
+ *
+ * @param start 진행 상황을 출력할 때 사용하는 시작 시각
+ * @param stats 지연 시간을 모을 곳으로 NULL이면 재지 않는다.
+ */
+static void run(clock_t start, struct pa_stats *stats)
+{
+        int ret = pa_pipeline_run(&input, N, &operation, stores, nr_shards,
+                                  &output, start, stats);
         if (ret != 0) {
-                fprintf(stderr, "[%s:%s(%d)] Initialize failed\n", __FILE__,
-                        __FUNCTION__, __LINE__);
+                fprintf(stderr, "[%s:%s(%d)] Cannot run the pipeline\n",
+                        __FILE__, __FUNCTION__, __LINE__);
                 exit(ret);
         }
 }
 
 /**
- * @brief 실제 자료구조를 테스트하는 부분이다.
+ * @brief 파일을 닫고, 동적 할당된 PA를 해제해주도록 한다.
  *
+ * @param save 1이면 snapshot_path가 있을 때 PA를 snapshot으로 저장한다.
  */
-static void run(clock_t start)
+static void close(int save)
 {
-        int i = 0;
-        char *command, *temp;
-        const int _10_percent = N / 10;
-        char *line = (char *)malloc(sizeof(char) * MAX_LINE_LEN);
-
-        for (i = 0; i < N; i++) {
-                temp = line;
-                if (i % _10_percent == 0) {
-                        printf("[%s:%s(%d)] %.2lf%% done (%.2lfs)\n", __FILE__,
-                               __FUNCTION__, __LINE__, (double)i / N * 100,
-                               (double)(clock() - start) / CLOCKS_PER_SEC);
+        int ret, i;
+
+        if (save && snapshot_path != NULL) {
+                ret = pa_snapshot_save(snapshot_path, &operation, stores,
+                                       nr_shards);
+                if (ret != 0) {
+                        fprintf(stderr,
+                                "[%s:%s(%d)] Cannot save the snapshot %s (%s)\n",
+                                __FILE__, __FUNCTION__, __LINE__,
+                                snapshot_path,
+                                (ret == -EOPNOTSUPP ?
+                                         "not supported by backend" :
+                                         strerror(-ret)));
                 }
-                fgets(temp, MAX_LINE_LEN, inp_fp);
-                command = get_csv_field(&temp, ",");
-                if (!strcmp(command, "INSERT")) {
-                        if (operation.insert(temp, outp_fp)) {
-                                fprintf(outp_fp, "INSERT <FAIL>\n");
-                        }
-                } else if (!strcmp(command, "SEARCH")) {
-                        if (operation.search(temp, outp_fp)) {
-                                fprintf(outp_fp, "SEARCH <FAIL>\n");
-                        }
-                } else if (!strcmp(command, "REMOVE")) {
-                        if (operation.remove(temp, outp_fp)) {
-                                fprintf(outp_fp, "REMOVE <FAIL>\n");
-                        }
-                } else {
+        }
+        for (i = 0; i < nr_shards; i++) {
 #ifdef DEBUG
-                        fprintf(stderr, "[%s:%s(%d)] invalid command detected",
-                                __FILE__, __FUNCTION__, __LINE__);
+                if (operation.get_fragmentation != NULL) {
+                        printf("fragmentation(shard %d): %d%%\n", i,
+                               operation.get_fragmentation(stores[i]));
+                }
 #endif
-                        fprintf(outp_fp, "OTHERS <FAIL>\n");
-                } // end of if
+                operation.free(stores[i]);
+        }
+        pa_snapshot_close(&snapshot);
+        pa_input_close(&input);
+        if (pa_output_close(&output)) {
+                fprintf(stderr, "[%s:%s(%d)] Cannot write the output file\n",
+                        __FILE__, __FUNCTION__, __LINE__);
+        }
+}
 
-#ifdef DEBUG
-                static int max = -1;
-                if (max < operation.get_current_usage()) {
-                        printf("max usage: %d/%d\n", max, MAX_ENTRY_SIZE);
-                        max = operation.get_current_usage();
+/**
+ * @brief backend의 출력 파일 이름을 만든다.
+ * @details outp_file이 `.out`으로 끝나면 그 앞에 backend의 이름을 넣고, 그렇지
+ 않으면 뒤에 붙인다. (e.g. test.out -> test.hashed.out)
+ *
+ * @param buf 이름을 쓸 공간
+ * @param size buf의 크기
+ * @param outp_file 기본 출력 파일의 이름
+ * @param backend 출력을 만든 backend
+ * @return int 정상적인 경우에는 0을, 이름이 너무 길면 음수 값을 반환한다.
+ */
+static int output_path(char *buf, size_t size, const char *outp_file,
+                       const struct pa_backend *backend)
+{
+        size_t len = strlen(outp_file);
+        int ret;
+
+        if (len >= 4 && strcmp(outp_file + len - 4, ".out") == 0) {
+                ret = snprintf(buf, size, "%.*s.%s.out", (int)(len - 4),
+                               outp_file, backend->name);
+        } else {
+                ret = snprintf(buf, size, "%s.%s", outp_file, backend->name);
+        }
+        return (ret < 0 || (size_t)ret >= size ? -ENAMETOOLONG : 0);
+}
+
+/**
+ * @brief 같은 입력을 모든 backend로 수행하고 결과를 비교한다.
+ * @details 기준 backend를 먼저 수행하고, 나머지 backend의 출력은 기준 출력과
+ 비교한다. snapshot은 backend마다 모양이 다르므로 읽거나 쓰지 않는다.
+ *
+ * @param reference 기준이 되는 backend
+ * @param inp_file 입력 파일의 이름
+ * @param outp_file 기본 출력 파일의 이름
+ * @return int 모든 출력이 같으면 0을, 그렇지 않으면 1을 반환한다.
+ */
+static int compare(const struct pa_backend *reference, const char *inp_file,
+                   const char *outp_file)
+{
+        const struct pa_backend *backend;
+        char reference_path[PATH_MAX], path[PATH_MAX], verdict[64];
+        struct pa_stats *stats;
+        int *shards;
+        int ret, i, k, differs = 0;
+
+        if (output_path(reference_path, sizeof(reference_path), outp_file,
+                        reference)) {
+                fprintf(stderr, "[%s:%s(%d)] Output file name too long\n",
+                        __FILE__, __FUNCTION__, __LINE__);
+                exit(-ENAMETOOLONG);
+        }
+        stats = (struct pa_stats *)calloc(pa_nr_backends, sizeof(*stats));
+        shards = (int *)calloc(pa_nr_backends, sizeof(*shards));
+        if (stats == NULL || shards == NULL) {
+                fprintf(stderr, "[%s:%s(%d)] Cannot allocate stats\n",
+                        __FILE__, __FUNCTION__, __LINE__);
+                exit(-ENOMEM);
+        }
+        for (k = 0; k < pa_nr_backends; k++) {
+                /* 기준 backend를 0번째로 수행한다. */
+                i = (k == 0 ? (int)(reference - pa_backends) :
+                              (k <= reference - pa_backends ? k - 1 : k));
+                backend = &pa_backends[i];
+                if (output_path(path, sizeof(path), outp_file, backend)) {
+                        exit(-ENAMETOOLONG);
                 }
-#endif
+                setup(backend, inp_file, path, 0);
+                ret = pa_stats_init(&stats[i], N);
+                if (ret != 0) {
+                        fprintf(stderr, "[%s:%s(%d)] Cannot allocate stats\n",
+                                __FILE__, __FUNCTION__, __LINE__);
+                        exit(ret);
+                }
+                shards[i] = nr_shards;
+                run(clock(), &stats[i]);
+                close(0);
+                printf("\n");
         }
 
-        free(line);
+        printf("%-14s %6s %9s %12s %9s %9s %9s  %s\n", "backend", "shards",
+               "time(s)", "commands/s", "p50(us)", "p99(us)", "max(us)",
+               "output");
+        for (i = 0; i < pa_nr_backends; i++) {
+                backend = &pa_backends[i];
+                if (backend == reference) {
+                        snprintf(verdict, sizeof(verdict), "reference");
+                } else {
+                        output_path(path, sizeof(path), outp_file, backend);
+                        ret = pa_bench_diff(reference_path, path);
+                        if (ret == 0) {
+                                snprintf(verdict, sizeof(verdict),
+                                         "identical");
+                        } else if (ret > 0) {
+                                snprintf(verdict, sizeof(verdict),
+                                         "differs at line %d", ret);
+                        } else {
+                                snprintf(verdict, sizeof(verdict),
+                                         "cannot compare (%d)", ret);
+                        }
+                        differs |= (ret != 0);
+                }
+                printf("%-14s %6d %9.3lf %12.0lf %9.1lf %9.1lf %9.1lf  %s\n",
+                       backend->name, shards[i], stats[i].elapsed,
+                       (stats[i].elapsed > 0 ?
+                                stats[i].nr_commands / stats[i].elapsed :
+                                0),
+                       pa_stats_percentile(&stats[i], 50) / 1000.0,
+                       pa_stats_percentile(&stats[i], 99) / 1000.0,
+                       pa_stats_percentile(&stats[i], 100) / 1000.0, verdict);
+                pa_stats_free(&stats[i]);
+        }
+        free(stats);
+        free(shards);
+        return differs;
 }
 
 /**
- * @brief 파일을 닫고, 동적 할당된 PA를 해제해주도록 한다.
+ * @brief 사용법을 출력한다.
  *
+ * @param program 실행 파일의 이름
  */
-static void close()
+static void usage(const char *program)
 {
-        operation.free();
-        fclose(inp_fp);
-        fclose(outp_fp);
+        int i;
+
+        fprintf(stderr,
+                "usage: %s [-b backend] [-c] [-l] [-i input] [-o output] "
+                "[-s snapshot]\n"
+                "  -b backend  run with backend (default: %s)\n"
+                "  -c          run every backend and compare with -b\n"
+                "  -l          list backends\n"
+                "  -s snapshot load the store from snapshot if it exists "
+                "and save it there on exit\n",
+                program, PA_DEFAULT_BACKEND);
+        fprintf(stderr, "backends:");
+        for (i = 0; i < pa_nr_backends; i++) {
+                fprintf(stderr, " %s", pa_backends[i].name);
+        }
+        fprintf(stderr, "\n");
 }
 
-int main(void)
+int main(int argc, char *argv[])
 {
+        const struct pa_backend *backend;
+        const char *name = PA_DEFAULT_BACKEND;
+        const char *inp_file = "test.inp", *outp_file = "test.out";
         clock_t start;
+        int i, comparing = 0;
+
+        for (i = 1; i < argc; i++) {
+                if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+                        name = argv[++i];
+                } else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+                        inp_file = argv[++i];
+                } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+                        outp_file = argv[++i];
+                } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+                        snapshot_path = argv[++i];
+                } else if (strcmp(argv[i], "-c") == 0) {
+                        comparing = 1;
+                } else if (strcmp(argv[i], "-l") == 0) {
+                        for (i = 0; i < pa_nr_backends; i++) {
+                                printf("%-14s %s\n", pa_backends[i].name,
+                                       pa_backends[i].description);
+                        }
+                        return 0;
+                } else {
+                        usage(argv[0]);
+                        return -EINVAL;
+                }
+        }
+        backend = pa_backend_find(name);
+        if (backend == NULL) {
+                fprintf(stderr, "[%s:%s(%d)] Unknown backend %s\n", __FILE__,
+                        __FUNCTION__, __LINE__, name);
+                usage(argv[0]);
+                return -EINVAL;
+        }
+        if (comparing) {
+                return compare(backend, inp_file, outp_file);
+        }
 
-        setup("test.inp", "test.out");
+        setup(backend, inp_file, outp_file, 1);
         start = clock();
-        run(start);
+        run(start, NULL);
         printf("[%s:%s(%d)] total execution time %.2lfs", __FILE__,
                __FUNCTION__, __LINE__,
                (double)(clock() - start) / CLOCKS_PER_SEC);
-        close();
+        close(1);
         return 0;
 }
@@ -0,0 +1,92 @@
+/**
+ * @file parallel-backend.c
+ * @author 오기준 (kijunking@pusan.ac.kr)
+ * @brief 명령행에서 이름으로 고를 수 있는 backend의 표를 가진다.
+ * @details trivial은 고정 크기의 배열을 처음부터 순회하는 구현이다. 나머지는
+ 모두 segment와 계층형 비트맵을 사용하는 improve store이며 유지하는 인덱스만
+ 다르다. bitmap은 인덱스 없이 column을 64행씩 SIMD로 순회하고, hashed는 id
+ 해시 인덱스를, sorted-array는 여기에 email 해시 인덱스와 배열에 node를 두는
+ name 정렬 인덱스를 더한다.
+ * @date 2020-04-20
+ *
+ */
+#include "parallel.h"
+
+/**
+ * @brief improve store를 사용하는 backend의 함수들을 채운다.
+ *
+ * @param init_fn store를 만드는 함수
+ * @param load_fn snapshot으로 store를 만드는 함수
+ */
+#define PA_BACKEND_IMPROVE(init_fn, load_fn)                                   \
+        {                                                                      \
+                .init = init_fn, .insert = improve_insert,                     \
+                .search = improve_search, .remove = improve_remove,            \
+                .search_email = improve_search_email,                          \
+                .search_name_prefix = improve_search_name_prefix,              \
+                .scan_count = improve_scan_count,                              \
+                .scan_select = improve_scan_select, .free = improve_free,      \
+                .get_current_usage = improve_get_current_usage,                \
+                .get_fragmentation = improve_get_fragmentation,                \
+                .save = improve_save, .load = load_fn,                         \
+        }
+
+const struct pa_backend pa_backends[] = {
+        {
+                .name = "trivial",
+                .description = "fixed array, linear scans",
+                .sharded = 0,
+                .operation = {
+                        .init = trivial_init,
+                        .insert = trivial_insert,
+                        .search = trivial_search,
+                        .remove = trivial_remove,
+                        .search_email = trivial_search_email,
+                        .search_name_prefix = trivial_search_name_prefix,
+                        .scan_count = trivial_scan_count,
+                        .scan_select = trivial_scan_select,
+                        .free = trivial_free,
+                        .get_current_usage = trivial_get_current_usage,
+                },
+        },
+        {
+                .name = "bitmap",
+                .description = "segments + bitmap, SIMD column scans",
+                .sharded = 1,
+                .operation = PA_BACKEND_IMPROVE(improve_bitmap_init,
+                                                improve_bitmap_load),
+        },
+        {
+                .name = "hashed",
+                .description = "bitmap + id hash index",
+                .sharded = 1,
+                .operation = PA_BACKEND_IMPROVE(improve_hashed_init,
+                                                improve_hashed_load),
+        },
+        {
+                .name = "sorted-array",
+                .description = "hashed + email hash, name sorted index",
+                .sharded = 1,
+                .operation = PA_BACKEND_IMPROVE(improve_init, improve_load),
+        },
+};
+
+const int pa_nr_backends = sizeof(pa_backends) / sizeof(pa_backends[0]);
+
+/**
+ * @brief 이름으로 backend를 찾는다.
+ *
+ * @param name backend의 이름
+ * @return const struct pa_backend* 찾은 backend로 없으면 NULL을 반환한다.
+ */
+const struct pa_backend *pa_backend_find(const char *name)
+{
+        int i;
+
+        for (i = 0; i < pa_nr_backends; i++) {
+                if (strcmp(pa_backends[i].name, name) == 0) {
+                        return &pa_backends[i];
+                }
+        }
+        return NULL;
+}
@@ -0,0 +1,140 @@
+/**
+ * @file parallel-bench.c
+ * @author 오기준 (kijunking@pusan.ac.kr)
+ * @brief backend들을 비교하기 위한 지연 시간 통계와 출력 비교를 가진다.
+ * @details 지연 시간은 수행 thread가 명령 하나를 수행하는 데 걸린 시간으로,
+ 모든 shard가 수행하는 명령은 가장 늦게 끝난 shard의 시간을 사용한다. 백분위는
+ 처음 요청될 때 한 번 정렬해서 구한다.
+ * @date 2020-04-20
+ *
+ */
+#include "parallel.h"
+
+#define PA_BENCH_CHUNK (1 << 16) /** PA_BENCH_CHUNK < 출력을 비교할 때 한 번에 읽는 크기 */
+
+/**
+ * @brief 명령 nr_commands개의 지연 시간을 담을 수 있도록 초기화한다.
+ *
+ * @param stats 초기화할 통계
+ * @param nr_commands 수행할 명령의 수
+ * @return int 정상적인 경우에는 0을, 그렇지 않으면 음수 값을 반환한다.
+ */
+int pa_stats_init(struct pa_stats *stats, int nr_commands)
+{
+        stats->nr_commands = 0;
+        stats->elapsed = 0;
+        stats->capacity = (nr_commands > 0 ? nr_commands : 0);
+        stats->sorted = 0;
+        stats->latency = (unsigned int *)malloc(
+                sizeof(unsigned int) *
+                (stats->capacity > 0 ? stats->capacity : 1));
+        if (stats->latency == NULL) {
+                stats->capacity = 0;
+                return -ENOMEM;
+        }
+        return 0;
+}
+
+/**
+ * @brief qsort에서 지연 시간을 오름차순으로 비교한다.
+ *
+ */
+static int pa_stats_compare(const void *a, const void *b)
+{
+        unsigned int x = *(const unsigned int *)a;
+        unsigned int y = *(const unsigned int *)b;
+
+        return (x > y) - (x < y);
+}
+
+/**
+ * @brief 지연 시간의 백분위 값을 가져온다.
+ *
+ * @param stats pipeline을 수행한 통계
+ * @param percent 0 이상 100 이하의 백분위
+ * @return unsigned int 해당 백분위의 지연 시간(ns)으로 명령이 없으면 0이다.
+ */
+unsigned int pa_stats_percentile(struct pa_stats *stats, double percent)
+{
+        int nr = stats->nr_commands, index;
+
+        if (nr > stats->capacity) {
+                nr = stats->capacity;
+        }
+        if (nr <= 0) {
+                return 0;
+        }
+        if (!stats->sorted) {
+                qsort(stats->latency, nr, sizeof(unsigned int),
+                      pa_stats_compare);
+                stats->sorted = 1;
+        }
+        index = (int)(percent / 100.0 * (nr - 1) + 0.5);
+        if (index < 0) {
+                index = 0;
+        } else if (index >= nr) {
+                index = nr - 1;
+        }
+        return stats->latency[index];
+}
+
+/**
+ * @brief 통계에 할당된 공간을 해제한다.
+ *
+ * @param stats 해제할 통계
+ */
+void pa_stats_free(struct pa_stats *stats)
+{
+        free(stats->latency);
+        stats->latency = NULL;
+        stats->capacity = 0;
+}
+
+/**
+ * @brief 두 출력 파일이 같은지 비교한다.
+ *
+ * @param path_a 비교할 파일
+ * @param path_b 비교할 파일
+ * @return int 같으면 0을, 다르면 처음 달라지는 행의 번호(1부터)를, 파일을
+ * 읽을 수 없으면 음수 값을 반환한다.
+ */
+int pa_bench_diff(const char *path_a, const char *path_b)
+{
+        char buf_a[PA_BENCH_CHUNK], buf_b[PA_BENCH_CHUNK];
+        FILE *fa = NULL, *fb = NULL;
+        size_t len_a, len_b, i;
+        int ret = 0, line = 1;
+
+        fa = fopen(path_a, "rb");
+        fb = fopen(path_b, "rb");
+        if (fa == NULL || fb == NULL) {
+                ret = -errno;
+                goto exception;
+        }
+        do {
+                len_a = fread(buf_a, 1, sizeof(buf_a), fa);
+                len_b = fread(buf_b, 1, sizeof(buf_b), fb);
+                for (i = 0; i < len_a && i < len_b; i++) {
+                        if (buf_a[i] != buf_b[i]) {
+                                ret = line;
+                                goto exception;
+                        }
+                        line += (buf_a[i] == '\n');
+                }
+                if (len_a != len_b) {
+                        ret = line;
+                        goto exception;
+                }
+        } while (len_a > 0);
+        if (ferror(fa) || ferror(fb)) {
+                ret = -EIO;
+        }
+exception:
+        if (fa != NULL) {
+                fclose(fa);
+        }
+        if (fb != NULL) {
+                fclose(fb);
+        }
+        return ret;
+}
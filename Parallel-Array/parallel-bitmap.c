@@ -0,0 +1,167 @@
+/**
+ * @file parallel-bitmap.c
+ * @author 오기준 (kijunking@pusan.ac.kr)
+ * @brief 빈 공간을 O(1)에 찾기 위한 계층형 비트맵을 가진다.
+ * @details level 0은 행마다 한 비트(1: 사용 중)를 가지고, level k의 비트는
+ level k-1의 word 하나가 가득 찼는지를 나타낸다. 따라서 맨 위 word부터 보수를
+ 취한 word에 `__builtin_ctzll`을 적용해서 내려가면 가장 앞의 빈 비트를 찾을 수
+ 있고, 그 비용은 전체 크기나 채워진 정도와 관계없이 level의 수에 비례한다.
+ * @date 2020-04-12
+ *
+ */
+#include "parallel.h"
+
+/**
+ * @brief level의 word 수를 구한다.
+ *
+ * @param nr_bits level이 가지는 비트 수
+ * @return int word의 수
+ */
+static inline int pa_bitmap_nr_words(int nr_bits)
+{
+        return (nr_bits + PA_BITMAP_WORD_BITS - 1) / PA_BITMAP_WORD_BITS;
+}
+
+/**
+ * @brief 비트맵을 초기화한다.
+ * @details 각 level의 마지막 word에서 실제 비트가 없는 뒷부분은 사용 중으로
+ 표시해 두어서 찾기에서 선택되지 않도록 한다.
+ *
+ * @param bitmap 초기화할 비트맵
+ * @param nr_bits 관리하고자 하는 비트 수
+ * @return int 정상적인 경우에는 0을, 메모리가 부족한 경우 -ENOMEM을 반환한다.
+ */
+int pa_bitmap_init(struct pa_bitmap *bitmap, int nr_bits)
+{
+        int level, n = nr_bits, nr_words, i;
+
+        bitmap->nr_bits = nr_bits;
+        bitmap->nr_levels = 0;
+        for (level = 0; level < PA_BITMAP_MAX_LEVEL; level++) {
+                bitmap->level[level] = NULL;
+        }
+
+        for (level = 0; level < PA_BITMAP_MAX_LEVEL; level++) {
+                nr_words = pa_bitmap_nr_words(n);
+                bitmap->level[level] = (unsigned long long *)calloc(
+                        nr_words, sizeof(unsigned long long));
+                if (bitmap->level[level] == NULL) {
+                        pa_bitmap_free(bitmap);
+                        return -ENOMEM;
+                }
+                bitmap->nr_levels++;
+                for (i = n; i < nr_words * PA_BITMAP_WORD_BITS; i++) {
+                        bitmap->level[level][i / PA_BITMAP_WORD_BITS] |=
+                                1ULL << (i % PA_BITMAP_WORD_BITS);
+                }
+                if (nr_words == 1) {
+                        return 0;
+                }
+                n = nr_words;
+        }
+
+        pa_bitmap_free(bitmap);
+        return -EINVAL;
+}
+
+/**
+ * @brief 비트를 사용 중으로 설정한다.
+ * @details word가 가득 차게 되면 상위 level에 그 사실을 전파한다.
+ *
+ * @param bitmap 비트맵
+ * @param bit 설정할 비트
+ */
+void pa_bitmap_set(struct pa_bitmap *bitmap, int bit)
+{
+        int level;
+        unsigned long long *word;
+
+        for (level = 0; level < bitmap->nr_levels; level++) {
+                word = &bitmap->level[level][bit / PA_BITMAP_WORD_BITS];
+                *word |= 1ULL << (bit % PA_BITMAP_WORD_BITS);
+                if (*word != PA_BITMAP_WORD_FULL) {
+                        break;
+                }
+                bit /= PA_BITMAP_WORD_BITS;
+        }
+}
+
+/**
+ * @brief 비트를 빈 공간으로 설정한다.
+ * @details 가득 차 있던 word에 빈 공간이 생기면 상위 level에 그 사실을 전파한다.
+ *
+ * @param bitmap 비트맵
+ * @param bit 해제할 비트
+ */
+void pa_bitmap_clear(struct pa_bitmap *bitmap, int bit)
+{
+        int level, was_full;
+        unsigned long long *word;
+
+        for (level = 0; level < bitmap->nr_levels; level++) {
+                word = &bitmap->level[level][bit / PA_BITMAP_WORD_BITS];
+                was_full = (*word == PA_BITMAP_WORD_FULL);
+                *word &= ~(1ULL << (bit % PA_BITMAP_WORD_BITS));
+                if (!was_full) {
+                        break;
+                }
+                bit /= PA_BITMAP_WORD_BITS;
+        }
+}
+
+/**
+ * @brief 가장 앞의 빈 비트를 찾는다.
+ *
+ * @param bitmap 비트맵
+ * @return int 빈 비트의 위치로 빈 비트가 없으면 -ENOENT를 반환한다.
+ */
+int pa_bitmap_find_zero(const struct pa_bitmap *bitmap)
+{
+        int level = bitmap->nr_levels - 1, bit = 0;
+        unsigned long long word = bitmap->level[level][0];
+
+        if (word == PA_BITMAP_WORD_FULL) {
+                return -ENOENT;
+        }
+        for (;;) {
+                bit = bit * PA_BITMAP_WORD_BITS + __builtin_ctzll(~word);
+                if (level-- == 0) {
+                        break;
+                }
+                word = bitmap->level[level][bit];
+        }
+        return bit;
+}
+
+/**
+ * @brief 사용 중인 비트의 수를 센다.
+ *
+ * @param bitmap 비트맵
+ * @return int 사용 중인 비트의 수
+ */
+int pa_bitmap_count(const struct pa_bitmap *bitmap)
+{
+        int i, count = 0, nr_words = pa_bitmap_nr_words(bitmap->nr_bits);
+
+        for (i = 0; i < nr_words; i++) {
+                count += __builtin_popcountll(bitmap->level[0][i]);
+        }
+        /* 마지막 word의 뒷부분은 사용 중으로 표시되어 있다. */
+        return count - (nr_words * PA_BITMAP_WORD_BITS - bitmap->nr_bits);
+}
+
+/**
+ * @brief 비트맵에서 사용한 메모리를 해제한다.
+ *
+ * @param bitmap 비트맵
+ */
+void pa_bitmap_free(struct pa_bitmap *bitmap)
+{
+        int level;
+
+        for (level = 0; level < PA_BITMAP_MAX_LEVEL; level++) {
+                free(bitmap->level[level]);
+                bitmap->level[level] = NULL;
+        }
+        bitmap->nr_levels = 0;
+}
@@ -0,0 +1,430 @@
+/**
+ * @file parallel-hash.c
+ * @author 오기준 (kijunking@pusan.ac.kr)
+ * @brief id를 WP로 바꾸어 주는 open addressing 해시 인덱스를 가진다.
+ * @details Robin Hood hashing을 사용한다. 삽입할 때 자신의 home에서 더 멀리
+ 떨어진 항목이 자리를 차지하도록 하므로 probe 거리의 분산이 작고, 탐색은 현재
+ 항목의 probe 거리가 찾는 id의 probe 거리보다 작아지는 순간 멈출 수 있다.
+ 삭제는 tombstone 없이 뒤의 항목을 한 칸씩 당기는(backward shift) 방식이다.
+ 테이블을 늘릴 때에는 이전 테이블을 남겨두고 이후의 연산마다 조금씩 옮긴다.
+ * @date 2020-04-10
+ *
+ */
+#include "parallel.h"
+
+#define PA_HASH_MIN_CAPACITY 16
+#define PA_HASH_MIGRATE_STEP 16 /**< 한 번의 연산에서 옮기는 이전 테이블의 bucket 수 */
+
+/**
+ * @brief 해시 인덱스를 초기화한다.
+ *
+ * @param hash 초기화할 해시 인덱스
+ * @param capacity 담고자 하는 항목의 수
+ * @return int 정상적인 경우에는 0을, 메모리가 부족한 경우 -ENOMEM을 반환한다.
+ */
+int pa_hash_init(struct pa_hash *hash, int capacity)
+{
+        unsigned int nr_buckets = PA_HASH_MIN_CAPACITY;
+
+        /* 적재율을 7/8 이하로 유지하도록 한다. */
+        while (nr_buckets / 8 * 7 < (unsigned int)capacity) {
+                nr_buckets <<= 1;
+        }
+
+        hash->entries = (struct pa_hash_entry *)calloc(
+                nr_buckets, sizeof(struct pa_hash_entry));
+        if (hash->entries == NULL) {
+                return -ENOMEM;
+        }
+        hash->mask = nr_buckets - 1;
+        hash->nr_entries = 0;
+        hash->old = NULL;
+        hash->old_mask = 0;
+        hash->cursor = 0;
+        hash->nr_old = 0;
+        hash->borrowed = NULL;
+        return 0;
+}
+
+/**
+ * @brief 테이블의 메모리를 해제한다.
+ * @details snapshot에서 빌려온 테이블은 해시 인덱스가 할당한 것이 아니므로
+ 해제하지 않는다.
+ *
+ * @param hash 해시 인덱스
+ * @param entries 해제하고자 하는 테이블
+ */
+static void pa_hash_release(struct pa_hash *hash,
+                            struct pa_hash_entry *entries)
+{
+        if (entries != hash->borrowed) {
+                free(entries);
+        }
+}
+
+/**
+ * @brief 크기를 확인하지 않고 항목을 테이블에 집어넣는다.
+ *
+ * @param entries 넣고자 하는 테이블
+ * @param mask 테이블의 bucket 수 - 1
+ * @param id 넣고자 하는 id
+ * @param wp id가 위치한 WP
+ */
+static void __pa_hash_insert(struct pa_hash_entry *entries, unsigned int mask,
+                             int id, int wp)
+{
+        struct pa_hash_entry entry = { .id = id, .wp = wp, .dist = 1 };
+        struct pa_hash_entry temp;
+        unsigned int pos = pa_hash_mix(id) & mask;
+
+        for (;;) {
+                if (entries[pos].dist == 0) {
+                        entries[pos] = entry;
+                        break;
+                }
+                /* home에 더 가까운 항목의 자리를 빼앗는다. */
+                if (entries[pos].dist < entry.dist) {
+                        temp = entries[pos];
+                        entries[pos] = entry;
+                        entry = temp;
+                }
+                pos = (pos + 1) & mask;
+                entry.dist++;
+        }
+}
+
+/**
+ * @brief 테이블에서 id가 위치한 모든 WP를 방문한다.
+ *
+ * @param entries 찾고자 하는 테이블
+ * @param mask 테이블의 bucket 수 - 1
+ * @param id 찾고자 하는 id
+ * @param visit WP마다 호출되는 함수
+ * @param arg visit에 넘겨줄 값
+ */
+static void __pa_hash_find_each(const struct pa_hash_entry *entries,
+                                unsigned int mask, int id,
+                                void (*visit)(void *arg, int wp), void *arg)
+{
+        unsigned int pos = pa_hash_mix(id) & mask;
+        unsigned int dist = 1;
+
+        while (entries[pos].dist >= dist) {
+                if (entries[pos].id == id) {
+                        visit(arg, entries[pos].wp);
+                }
+                pos = (pos + 1) & mask;
+                dist++;
+        }
+}
+
+/**
+ * @brief 테이블에서 id가 위치한 가장 작은 WP를 찾는다.
+ *
+ * @param entries 찾고자 하는 테이블
+ * @param mask 테이블의 bucket 수 - 1
+ * @param id 찾고자 하는 id
+ * @param wp 지금까지 찾은 WP (없으면 음수)
+ * @return int wp와 테이블에서 찾은 WP 중 작은 값
+ */
+static int __pa_hash_find(const struct pa_hash_entry *entries,
+                          unsigned int mask, int id, int wp)
+{
+        unsigned int pos = pa_hash_mix(id) & mask;
+        unsigned int dist = 1;
+
+        while (entries[pos].dist >= dist) {
+                if (entries[pos].id == id &&
+                    (wp < 0 || entries[pos].wp < wp)) {
+                        wp = entries[pos].wp;
+                }
+                pos = (pos + 1) & mask;
+                dist++;
+        }
+        return wp;
+}
+
+/**
+ * @brief pos의 항목을 지우고 뒤의 항목들을 home 쪽으로 한 칸씩 당긴다.
+ *
+ * @param entries 지우고자 하는 테이블
+ * @param mask 테이블의 bucket 수 - 1
+ * @param pos 지우고자 하는 bucket
+ */
+static void pa_hash_shift(struct pa_hash_entry *entries, unsigned int mask,
+                          unsigned int pos)
+{
+        unsigned int next = (pos + 1) & mask;
+
+        while (entries[next].dist > 1) {
+                entries[pos] = entries[next];
+                entries[pos].dist--;
+                pos = next;
+                next = (next + 1) & mask;
+        }
+        entries[pos].dist = 0;
+}
+
+/**
+ * @brief 테이블에서 id와 WP의 쌍을 제거한다.
+ *
+ * @param entries 지우고자 하는 테이블
+ * @param mask 테이블의 bucket 수 - 1
+ * @param id 제거하고자 하는 id
+ * @param wp id가 위치한 WP
+ * @return int 정상적인 경우에는 0을, 찾지 못한 경우 -ENOENT를 반환한다.
+ */
+static int __pa_hash_remove(struct pa_hash_entry *entries, unsigned int mask,
+                            int id, int wp)
+{
+        unsigned int pos = pa_hash_mix(id) & mask;
+        unsigned int dist = 1;
+
+        while (entries[pos].dist >= dist) {
+                if (entries[pos].id == id && entries[pos].wp == wp) {
+                        pa_hash_shift(entries, mask, pos);
+                        return 0;
+                }
+                pos = (pos + 1) & mask;
+                dist++;
+        }
+        return -ENOENT;
+}
+
+/**
+ * @brief 테이블에서 id와 WP의 쌍을 찾아서 WP를 바꾼다.
+ *
+ * @param entries 바꾸고자 하는 테이블
+ * @param mask 테이블의 bucket 수 - 1
+ * @param id 바꾸고자 하는 id
+ * @param wp id가 위치한 WP
+ * @param new_wp id가 옮겨진 WP
+ * @return int 정상적인 경우에는 0을, 찾지 못한 경우 -ENOENT를 반환한다.
+ */
+static int __pa_hash_move(struct pa_hash_entry *entries, unsigned int mask,
+                          int id, int wp, int new_wp)
+{
+        unsigned int pos = pa_hash_mix(id) & mask;
+        unsigned int dist = 1;
+
+        while (entries[pos].dist >= dist) {
+                if (entries[pos].id == id && entries[pos].wp == wp) {
+                        entries[pos].wp = new_wp;
+                        return 0;
+                }
+                pos = (pos + 1) & mask;
+                dist++;
+        }
+        return -ENOENT;
+}
+
+/**
+ * @brief 이전 테이블의 항목을 새 테이블로 조금씩 옮긴다.
+ * @details 이전 테이블을 앞에서부터 순회하면서 항목을 backward shift로 지우기
+ 때문에 cursor 앞의 bucket은 항상 비어 있고, 옮기지 않은 항목의 probe
+ 순서도 그대로 유지된다. 따라서 옮기는 도중에도 두 테이블을 모두 찾으면 된다.
+ *
+ * @param hash 해시 인덱스
+ * @param nr_steps 이번에 처리할 bucket 또는 항목의 수
+ */
+static void pa_hash_migrate(struct pa_hash *hash, unsigned int nr_steps)
+{
+        struct pa_hash_entry entry;
+
+        while (hash->old && nr_steps--) {
+                entry = hash->old[hash->cursor];
+                if (entry.dist != 0) {
+                        pa_hash_shift(hash->old, hash->old_mask, hash->cursor);
+                        __pa_hash_insert(hash->entries, hash->mask, entry.id,
+                                         entry.wp);
+                        hash->nr_old--;
+                } else if (hash->cursor++ == hash->old_mask) {
+                        pa_hash_release(hash, hash->old);
+                        hash->old = NULL;
+                }
+        }
+}
+
+/**
+ * @brief bucket의 수를 2배로 늘린다.
+ * @details 항목들은 한 번에 옮기지 않고 이후의 삽입, 삭제마다
+ PA_HASH_MIGRATE_STEP개씩 옮긴다. 새 테이블이 다시 가득 차기 전에 옮기기가
+ 끝나므로 어떤 연산도 전체 항목을 다시 배치하는 비용을 기다리지 않는다.
+ *
+ * @param hash 해시 인덱스
+ * @return int 정상적인 경우에는 0을, 메모리가 부족한 경우 -ENOMEM을 반환한다.
+ */
+static int pa_hash_grow(struct pa_hash *hash)
+{
+        unsigned int nr_buckets = (hash->mask + 1) * 2;
+        struct pa_hash_entry *entries = NULL;
+
+        pa_hash_migrate(hash, (unsigned int)-1); /* 이전 확장을 마무리한다. */
+        entries = (struct pa_hash_entry *)calloc(nr_buckets,
+                                                 sizeof(struct pa_hash_entry));
+        if (entries == NULL) {
+                return -ENOMEM;
+        }
+        hash->old = hash->entries;
+        hash->old_mask = hash->mask;
+        hash->cursor = 0;
+        hash->nr_old = hash->nr_entries;
+        hash->entries = entries;
+        hash->mask = nr_buckets - 1;
+        return 0;
+}
+
+/**
+ * @brief id와 WP의 쌍을 해시 인덱스에 넣는다.
+ * @note 같은 id가 여러 번 들어올 수 있으며, 이 경우 각각을 따로 저장한다.
+ *
+ * @param hash 해시 인덱스
+ * @param id 넣고자 하는 id
+ * @param wp id가 위치한 WP
+ * @return int 정상적인 경우에는 0을, 메모리가 부족한 경우 -ENOMEM을 반환한다.
+ */
+int pa_hash_insert(struct pa_hash *hash, int id, int wp)
+{
+        pa_hash_migrate(hash, PA_HASH_MIGRATE_STEP);
+        if ((unsigned int)(hash->nr_entries + 1) > (hash->mask + 1) / 8 * 7) {
+                if (pa_hash_grow(hash)) {
+                        return -ENOMEM;
+                }
+        }
+        __pa_hash_insert(hash->entries, hash->mask, id, wp);
+        hash->nr_entries++;
+        return 0;
+}
+
+/**
+ * @brief id가 위치한 WP를 찾는다.
+ * @details 같은 id가 여러 개인 경우 PA를 앞에서부터 찾았을 때와 같은 결과가
+ 나오도록 가장 작은 WP를 반환한다.
+ *
+ * @param hash 해시 인덱스
+ * @param id 찾고자 하는 id
+ * @return int id가 위치한 WP로 찾지 못한 경우 -ENOENT를 반환한다.
+ */
+int pa_hash_find(const struct pa_hash *hash, int id)
+{
+        int wp = __pa_hash_find(hash->entries, hash->mask, id, -ENOENT);
+
+        if (hash->old) {
+                wp = __pa_hash_find(hash->old, hash->old_mask, id, wp);
+        }
+        return wp;
+}
+
+/**
+ * @brief id가 위치한 모든 WP를 방문한다.
+ * @details 문자열의 해시 값을 id로 사용하는 인덱스처럼 같은 id에 여러 WP가
+ 있을 때 사용한다. 방문 순서는 정해져 있지 않다.
+ *
+ * @param hash 해시 인덱스
+ * @param id 찾고자 하는 id
+ * @param visit WP마다 호출되는 함수
+ * @param arg visit에 넘겨줄 값
+ */
+void pa_hash_find_each(const struct pa_hash *hash, int id,
+                       void (*visit)(void *arg, int wp), void *arg)
+{
+        __pa_hash_find_each(hash->entries, hash->mask, id, visit, arg);
+        if (hash->old) {
+                __pa_hash_find_each(hash->old, hash->old_mask, id, visit, arg);
+        }
+}
+
+/**
+ * @brief id와 WP의 쌍을 해시 인덱스에서 제거한다.
+ *
+ * @param hash 해시 인덱스
+ * @param id 제거하고자 하는 id
+ * @param wp id가 위치한 WP
+ * @return int 정상적인 경우에는 0을, 찾지 못한 경우 -ENOENT를 반환한다.
+ */
+int pa_hash_remove(struct pa_hash *hash, int id, int wp)
+{
+        pa_hash_migrate(hash, PA_HASH_MIGRATE_STEP);
+        if (__pa_hash_remove(hash->entries, hash->mask, id, wp) == 0) {
+                hash->nr_entries--;
+                return 0;
+        }
+        if (hash->old &&
+            __pa_hash_remove(hash->old, hash->old_mask, id, wp) == 0) {
+                hash->nr_old--;
+                hash->nr_entries--;
+                return 0;
+        }
+        return -ENOENT;
+}
+
+/**
+ * @brief 행이 옮겨졌을 때 id와 WP의 쌍이 새 WP를 가리키도록 한다.
+ * @details 항목의 bucket은 id로만 정해지므로 제자리에서 WP만 바꾼다.
+ *
+ * @param hash 해시 인덱스
+ * @param id 옮겨진 행의 id
+ * @param wp 행이 있던 WP
+ * @param new_wp 행이 옮겨진 WP
+ * @return int 정상적인 경우에는 0을, 찾지 못한 경우 -ENOENT를 반환한다.
+ */
+int pa_hash_move(struct pa_hash *hash, int id, int wp, int new_wp)
+{
+        if (__pa_hash_move(hash->entries, hash->mask, id, wp, new_wp) == 0) {
+                return 0;
+        }
+        if (hash->old &&
+            __pa_hash_move(hash->old, hash->old_mask, id, wp, new_wp) == 0) {
+                return 0;
+        }
+        return -ENOENT;
+}
+
+/**
+ * @brief 진행 중인 확장을 마무리해서 모든 항목이 한 테이블에 있도록 한다.
+ *
+ * @param hash 해시 인덱스
+ */
+void pa_hash_settle(struct pa_hash *hash)
+{
+        pa_hash_migrate(hash, (unsigned int)-1);
+}
+
+/**
+ * @brief 이미 만들어진 테이블을 복사하지 않고 해시 인덱스로 사용한다.
+ * @details snapshot을 mmap한 영역의 테이블을 그대로 사용하기 위한 것으로,
+ 이 테이블은 이후에 확장되더라도 해제되지 않는다.
+ *
+ * @param hash 초기화할 해시 인덱스
+ * @param entries 사용할 테이블
+ * @param mask 테이블의 bucket 수 - 1
+ * @param nr_entries 테이블에 있는 항목 수
+ */
+void pa_hash_attach(struct pa_hash *hash, struct pa_hash_entry *entries,
+                    unsigned int mask, int nr_entries)
+{
+        hash->entries = entries;
+        hash->mask = mask;
+        hash->nr_entries = nr_entries;
+        hash->old = NULL;
+        hash->old_mask = 0;
+        hash->cursor = 0;
+        hash->nr_old = 0;
+        hash->borrowed = entries;
+}
+
+/**
+ * @brief 해시 인덱스에서 사용한 메모리를 해제한다.
+ *
+ * @param hash 해시 인덱스
+ */
+void pa_hash_free(struct pa_hash *hash)
+{
+        pa_hash_release(hash, hash->entries);
+        pa_hash_release(hash, hash->old);
+        hash->entries = NULL;
+        hash->old = NULL;
+        hash->borrowed = NULL;
+        hash->mask = 0;
+        hash->nr_entries = 0;
+}
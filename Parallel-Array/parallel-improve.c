@@ -7,169 +7,844 @@
  */
 #include "parallel.h"
 
-#define BITS_PER_BYTE                                                          \
-        8 /** BITS_PER_BYTE < 1 바이트에 들어가는 비트 수를 지칭한다. */
-#define BITMAP_LEN                                                             \
-        (sizeof(unsigned long) *                                               \
-         BITS_PER_BYTE) /** BITMAP_LEN < 비트맵의 길이를 가진다. */
-#define BITMAP_FULL                                                            \
-        0xffffffff /** BITMAP_FULL < unsigned long이 4 바이트 이므로 이를 마스킹을 할 수 있도록 만든다. */
+#include <limits.h>
 
-static int *_id;
-static char **_name;
-static char **_bban;
-static char **_email;
+/**
+ * @brief store가 유지하는 인덱스에 해당한다.
+ * @details 인덱스가 없으면 같은 일을 column을 순회해서 한다. backend 표의
+ bitmap, hashed, sorted-array는 이 값만 다른 improve store이다.
+ *
+ */
+enum improve_flag {
+        IMPROVE_ID_INDEX = 1 << 0, /**< IMPROVE_ID_INDEX < id 해시 인덱스 */
+        IMPROVE_SECONDARY_INDEX = 1 << 1, /**< IMPROVE_SECONDARY_INDEX < email 해시 인덱스와 name 정렬 인덱스 */
+};
 
-static unsigned long *_bitmap;
+/**
+ * @brief PA의 일부 행들을 담는 segment에 해당한다.
+ * @details s번째 segment는 (PA_SEGMENT_BASE << s)개의 행을 가지므로 용량이
+ 기하급수적으로 늘어난다. 용량을 늘릴 때 이전 segment는 그대로 두고 새
+ segment만 할당하므로 기존 행을 복사하지 않는다. 문자열 column은 행마다 따로
+ 할당하지 않고 `char[행 수][MAX_CHAR_LEN]` 하나로 할당하므로 column을 순회할 때
+ 포인터를 따라가지 않고 메모리를 순서대로 읽는다.
+ *
+ */
+struct improve_segment {
+        int *id;
+        char (*name)[MAX_CHAR_LEN]; /**< name < 행마다 고정 길이를 가지는 연속된 문자열 column */
+        char (*bban)[MAX_CHAR_LEN];
+        char (*email)[MAX_CHAR_LEN];
+        struct pa_bitmap bitmap; /**< bitmap < segment 안에서 사용 중인 행 */
+        int mapped; /**< mapped < 1이면 column과 비트맵이 mmap된 snapshot을 가리킨다. */
+};
 
-static int _wp = 0;
+/**
+ * @brief improve 방식의 PA 하나에 해당한다.
+ * @details 모든 상태를 이 구조체가 가지므로 여러 개의 store를 만들어서 각각
+ 다른 thread가 lock 없이 다룰 수 있다.
+ *
+ */
+struct improve_store {
+        struct improve_segment segment[PA_MAX_SEGMENTS];
+        int nr_segments; /**< nr_segments < 할당된 segment의 수 */
+        int capacity; /**< capacity < 할당된 segment들이 가지는 전체 행 수 */
+        int nr_rows; /**< nr_rows < 초기화된 행 수로 이후의 행은 모두 비어 있다. */
+        unsigned int full_segments; /**< full_segments < s번째 비트는 s번째 segment가 가득 찼는지 */
+        int nr_live; /**< nr_live < 사용 중인 행 수 */
+        int compact_src; /**< compact_src < compaction이 다음에 확인할 WP (진행 중이 아니면 -1) */
+        int compact_dst; /**< compact_dst < compaction이 다음 행을 옮겨 넣을 빈 WP */
+
+        unsigned int flags; /**< flags < 유지하는 인덱스 (enum improve_flag) */
+        struct pa_hash index; /**< index < id를 WP로 바꾸어 주는 인덱스 */
+        struct pa_hash email_index; /**< email_index < email의 해시 값을 WP로 바꾸어 주는 인덱스 */
+        struct pa_sorted name_index; /**< name_index < name의 순서를 유지하는 인덱스 */
+        unsigned char *id_filter; /**< id_filter < id 인덱스가 없을 때 id의 hash별 사용 중인 행 수 */
+        unsigned int id_filter_mask;
+        unsigned char *old_id_filter; /**< old_id_filter < id_filter를 키우는 동안 모든 행을 세는 이전 filter (NULL이면 모든 id가 있을 수 있다.) */
+        unsigned int old_id_filter_mask;
+        int id_filter_src; /**< id_filter_src < 새 id_filter로 옮길 다음 WP (옮기는 중이 아니면 -1) */
+
+        int wp;
+};
 
 /**
- * @brief 빈 공간을 가진 Write Pointer(WP) 위치를 찾는다.
+ * @brief snapshot에 저장되는 segment의 모습이다.
+ * @details 포인터 대신 각 section의 offset을 가진다.
+ *
+ */
+struct improve_image_segment {
+        unsigned long long id;
+        unsigned long long name;
+        unsigned long long bban;
+        unsigned long long email;
+        unsigned long long level[PA_BITMAP_MAX_LEVEL];
+        int nr_levels;
+        int nr_bits;
+};
+
+/**
+ * @brief snapshot에 저장되는 store의 모습이다.
+ *
+ */
+struct improve_image {
+        int nr_segments;
+        int nr_rows;
+        int wp;
+        unsigned int full_segments;
+        int nr_live;
+        int compact_src;
+        int compact_dst;
+        unsigned int index_mask; /**< index_mask < 해시 테이블의 bucket 수 - 1 */
+        int index_entries; /**< index_entries < 해시 테이블에 있는 항목 수 */
+        unsigned long long index; /**< index < 해시 테이블 section의 offset */
+        unsigned int flags; /**< flags < 저장할 때 유지하던 인덱스 */
+        unsigned int email_mask;
+        int email_entries;
+        int name_nodes; /**< name_nodes < name 인덱스에서 사용된 node의 수 */
+        int name_root;
+        int name_free;
+        int name_entries;
+        unsigned long long email_index;
+        unsigned long long name_index;
+        struct improve_image_segment segment[PA_MAX_SEGMENTS];
+};
+
+/**
+ * @brief WP가 속한 segment와 segment 안에서의 위치를 찾는다.
  *
- * @return int wp의 index 값으로 만약 빈 공간을 찾지 못하면 -ENOENT를 반환한다.
+ * @param wp 찾고자 하는 WP
+ * @param offset segment 안에서의 위치가 저장된다.
+ * @return struct improve_segment* WP가 속한 segment
  */
-static int improve_get_free_wp(int id)
+static inline struct improve_segment *
+improve_locate(struct improve_store *store, int wp, int *offset)
 {
-        int wp = _wp, i = 0, offset = 0;
-        int is_valid_wp = (wp < MAX_ENTRY_SIZE && wp >= 0);
-        if (is_valid_wp && _id[wp] == -1) {
-                i = wp / BITMAP_LEN;
-                offset = wp % BITMAP_LEN;
-                _bitmap[i] |=
-                        (0x1
-                         << offset); /**_bitmap[i] |= (0x1 << offset); < 비트맵에 값을 설정한다. */
-                return wp;
+        unsigned int q = (unsigned int)wp / PA_SEGMENT_BASE + 1;
+        int s = 31 - __builtin_clz(q);
+
+        *offset = wp - PA_SEGMENT_BASE * ((1 << s) - 1);
+        return &store->segment[s];
+}
+
+/**
+ * @brief WP의 id 값을 가리키는 포인터를 가져온다.
+ *
+ * @param wp 가져오고자 하는 WP
+ * @return int* id 값을 가리키는 포인터
+ */
+static inline int *improve_id(struct improve_store *store, int wp)
+{
+        int offset;
+        struct improve_segment *seg = improve_locate(store, wp, &offset);
+        return &seg->id[offset];
+}
+
+/**
+ * @brief email을 email 인덱스의 key로 바꾼다. (FNV-1a)
+ *
+ * @param email NUL로 끝나는 email
+ * @return int email 인덱스의 key
+ */
+static inline int improve_email_key(const char *email)
+{
+        unsigned int h = 2166136261U;
+
+        while (*email != 0x00) {
+                h = (h ^ (unsigned char)*email++) * 16777619U;
         }
+        return (int)h;
+}
 
-        /**
-         * @brief 4 byte 단위로 비트맵을 읽어서 꽉 차지 않은 구역을 찾도록 한다.
-         *
-         */
-        for (i = 0; i * BITMAP_LEN < MAX_ENTRY_SIZE; i++) {
-                if (_bitmap[i] < BITMAP_FULL) {
-                        wp = i * BITMAP_LEN;
-                        for (offset = 0; offset < BITMAP_LEN; offset++) {
-                                if (wp + offset >= MAX_ENTRY_SIZE) {
-                                        goto ret;
-                                }
-                                if (_id[wp + offset] == -1) {
-                                        _bitmap[i] |= (0x1 << offset);
-                                        return wp + offset;
-                                }
-                        } // end of for
-                } // end of if
-        } // end of for
-ret:
-        return -ENOENT;
+/**
+ * @brief WP 행의 name을 가져온다. name 인덱스의 key 함수이다.
+ *
+ * @param arg name을 가져오고자 하는 store
+ * @param wp 가져오고자 하는 WP
+ * @return const char* WP 행의 name
+ */
+static const char *improve_name_key(void *arg, int wp)
+{
+        int offset;
+        struct improve_segment *seg =
+                improve_locate((struct improve_store *)arg, wp, &offset);
+        return seg->name[offset];
+}
+
+/**
+ * @brief 새로 쓴 행을 email, name 인덱스에 넣는다.
+ *
+ * @param store 행이 있는 store
+ * @param wp 넣고자 하는 WP
+ * @return int 정상적인 경우에는 0을, 메모리가 부족한 경우 -ENOMEM을 반환한다.
+ */
+static int improve_index_insert(struct improve_store *store, int wp)
+{
+        int offset;
+        struct improve_segment *seg = improve_locate(store, wp, &offset);
+        int key = improve_email_key(seg->email[offset]);
+
+        if (pa_hash_insert(&store->email_index, key, wp)) {
+                return -ENOMEM;
+        }
+        if (pa_sorted_insert(&store->name_index, seg->name[offset],
+                             seg->id[offset], wp)) {
+                pa_hash_remove(&store->email_index, key, wp);
+                return -ENOMEM;
+        }
+        return 0;
+}
+
+/**
+ * @brief 지우는 행을 email, name 인덱스에서 제거한다.
+ * @warning 행의 id와 문자열을 바꾸기 전에 호출해야 한다.
+ *
+ * @param store 행이 있는 store
+ * @param wp 제거하고자 하는 WP
+ */
+static void improve_index_remove(struct improve_store *store, int wp)
+{
+        int offset;
+        struct improve_segment *seg = improve_locate(store, wp, &offset);
+
+        pa_hash_remove(&store->email_index,
+                       improve_email_key(seg->email[offset]), wp);
+        pa_sorted_remove(&store->name_index, seg->name[offset],
+                         seg->id[offset], wp);
+}
+
+/**
+ * @brief WP를 사용 중으로 표시한다.
+ *
+ * @param wp 표시하고자 하는 WP
+ */
+static void improve_mark_used(struct improve_store *store, int wp)
+{
+        int offset;
+        struct improve_segment *seg = improve_locate(store, wp, &offset);
+
+        pa_bitmap_set(&seg->bitmap, offset);
+        if (pa_bitmap_full(&seg->bitmap)) {
+                store->full_segments |= 1U << (seg - store->segment);
+        }
+}
+
+/**
+ * @brief WP를 빈 공간으로 표시한다.
+ *
+ * @param wp 표시하고자 하는 WP
+ */
+static void improve_mark_free(struct improve_store *store, int wp)
+{
+        int offset;
+        struct improve_segment *seg = improve_locate(store, wp, &offset);
+
+        pa_bitmap_clear(&seg->bitmap, offset);
+        store->full_segments &= ~(1U << (seg - store->segment));
+}
+
+/**
+ * @brief segment의 column과 비트맵을 해제한다.
+ *
+ * @param seg 해제하고자 하는 segment
+ */
+static void improve_release_segment(struct improve_segment *seg)
+{
+        if (!seg->mapped) { /**< mapped이면 snapshot과 함께 munmap된다. */
+                free(seg->id);
+                free(seg->name);
+                free(seg->bban);
+                free(seg->email);
+                pa_bitmap_free(&seg->bitmap);
+        }
+        memset(seg, 0, sizeof(*seg));
+}
+
+/**
+ * @brief id counter 하나를 늘리거나 줄인다.
+ * @details 가득 찬 counter는 더 이상 바꾸지 않으므로 그 hash의 id는 계속 있을
+ 수 있는 것으로 남는다.
+ *
+ * @param counter 바꾸고자 하는 counter
+ * @param delta 1 또는 -1
+ */
+static inline void improve_filter_add(unsigned char *counter, int delta)
+{
+        if (*counter != UCHAR_MAX) {
+                *counter += delta;
+        }
+}
+
+/**
+ * @brief id 인덱스가 없는 store의 id filter에 행 하나를 더하거나 뺀다.
+ * @details 키우는 동안 이전 filter는 모든 행을, 새 filter는 id_filter_src 앞의
+ 행만 센다.
+ *
+ * @param store 행이 있는 store
+ * @param id 행의 id
+ * @param wp 행의 WP
+ * @param delta 1이면 행을 더하고 -1이면 뺀다.
+ */
+static void improve_filter_count(struct improve_store *store, int id, int wp,
+                                 int delta)
+{
+        unsigned int h = pa_hash_mix(id);
+
+        if (store->flags & IMPROVE_ID_INDEX) {
+                return;
+        }
+        if (store->id_filter_src >= 0) {
+                if (store->old_id_filter != NULL) {
+                        improve_filter_add(&store->old_id_filter
+                                                    [h & store->old_id_filter_mask],
+                                           delta);
+                }
+                if (wp >= store->id_filter_src) {
+                        return;
+                }
+        }
+        if (store->id_filter != NULL) {
+                improve_filter_add(&store->id_filter[h & store->id_filter_mask],
+                                   delta);
+        }
+}
+
+/**
+ * @brief id가 store에 있을 수 있는지 확인한다.
+ * @details id 인덱스가 있으면 인덱스로 정확히 확인한다. 없으면 id filter의
+ counter를 보므로 O(1)이지만, 다른 id와 hash가 겹치면 없는 id도 있다고 할 수
+ 있다.
+ *
+ * @param store 확인하고자 하는 store
+ * @param id 확인하고자 하는 id
+ * @return int 있을 수 있으면 1을, 확실히 없으면 0을 반환한다.
+ */
+static int improve_may_have_id(struct improve_store *store, int id)
+{
+        unsigned int h = pa_hash_mix(id);
+
+        if (store->flags & IMPROVE_ID_INDEX) {
+                return pa_hash_find(&store->index, id) >= 0;
+        }
+        if (store->id_filter_src >= 0) {
+                return store->old_id_filter == NULL ||
+                       store->old_id_filter[h & store->old_id_filter_mask] != 0;
+        }
+        return store->id_filter == NULL ||
+               store->id_filter[h & store->id_filter_mask] != 0;
+}
+
+/**
+ * @brief 용량에 맞추어 id filter를 키우기 시작한다.
+ * @details 새 filter는 비어 있는 상태로 할당하고, 사용 중인 행은
+ improve_filter_migrate()가 명령마다 조금씩 옮긴다. 그동안에는 모든 행을 세는
+ 이전 filter로 확인한다. 할당하지 못하면 지금의 filter를 그대로 사용한다.
+ *
+ * @param store id filter를 키우고자 하는 store
+ */
+static void improve_filter_grow(struct improve_store *store)
+{
+        unsigned int mask = PA_SEGMENT_BASE * PA_ID_FILTER_RATIO - 1;
+        unsigned char *filter;
+
+        if (store->flags & IMPROVE_ID_INDEX) {
+                return;
+        }
+        while (mask < (unsigned int)store->capacity * PA_ID_FILTER_RATIO - 1) {
+                mask = (mask << 1) | 1;
+        }
+        if (store->id_filter != NULL && mask <= store->id_filter_mask) {
+                return;
+        }
+        filter = (unsigned char *)calloc((size_t)mask + 1, 1);
+        if (filter == NULL) {
+                return;
+        }
+        if (store->id_filter_src >= 0) {
+                free(store->id_filter); /**< 이전 filter가 아직 모든 행을 센다. */
+        } else {
+                free(store->old_id_filter);
+                store->old_id_filter = store->id_filter;
+                store->old_id_filter_mask = store->id_filter_mask;
+        }
+        store->id_filter = filter;
+        store->id_filter_mask = mask;
+        store->id_filter_src = 0;
+}
+
+/**
+ * @brief 사용 중인 행을 새 id filter로 조금씩 옮긴다.
+ * @details 명령마다 PA_COMPACT_STEP개의 비트맵 word만 확인하므로 filter를
+ 키우는 동안에도 한 명령이 기다리는 시간은 PA의 크기와 관계없다.
+ *
+ * @param store id filter를 옮기고 있는 store
+ */
+static void improve_filter_migrate(struct improve_store *store)
+{
+        struct improve_segment *seg;
+        unsigned long long word;
+        int budget = PA_COMPACT_STEP, offset, bit;
+
+        while (store->id_filter_src >= 0 && budget-- > 0) {
+                if (store->id_filter_src >= store->nr_rows) {
+                        free(store->old_id_filter);
+                        store->old_id_filter = NULL;
+                        store->id_filter_src = -1;
+                        return;
+                }
+                seg = improve_locate(store, store->id_filter_src, &offset);
+                word = seg->bitmap.level[0][offset / PA_BITMAP_WORD_BITS] >>
+                       (offset % PA_BITMAP_WORD_BITS);
+                while (word != 0) {
+                        bit = __builtin_ctzll(word);
+                        word &= word - 1;
+                        improve_filter_add(
+                                &store->id_filter[pa_hash_mix(
+                                                          seg->id[offset + bit]) &
+                                                  store->id_filter_mask],
+                                1);
+                }
+                store->id_filter_src +=
+                        PA_BITMAP_WORD_BITS - offset % PA_BITMAP_WORD_BITS;
+        }
+}
+
+/**
+ * @brief 새로운 segment를 할당해서 용량을 늘린다.
+ * @details 행의 초기화는 해당 행을 처음 사용할 때 하므로, 이 함수는 segment의
+ 크기와 관계없이 몇 번의 할당만 수행한다.
+ *
+ * @return int 정상적인 경우에는 0을, 메모리가 부족한 경우 -ENOMEM을 반환한다.
+ */
+static int improve_add_segment(struct improve_store *store)
+{
+        struct improve_segment *seg = &store->segment[store->nr_segments];
+        int nr_rows;
+
+        if (store->nr_segments == PA_MAX_SEGMENTS) {
+                return -ENOMEM;
+        }
+        nr_rows = PA_SEGMENT_BASE << store->nr_segments;
+
+        seg->id = (int *)malloc(sizeof(int) * nr_rows);
+        seg->name = (char(*)[MAX_CHAR_LEN])malloc(MAX_CHAR_LEN * nr_rows);
+        seg->bban = (char(*)[MAX_CHAR_LEN])malloc(MAX_CHAR_LEN * nr_rows);
+        seg->email = (char(*)[MAX_CHAR_LEN])malloc(MAX_CHAR_LEN * nr_rows);
+        if (seg->id == NULL || seg->name == NULL || seg->bban == NULL ||
+            seg->email == NULL || pa_bitmap_init(&seg->bitmap, nr_rows)) {
+                free(seg->id);
+                free(seg->name);
+                free(seg->bban);
+                free(seg->email);
+                return -ENOMEM;
+        }
+
+        store->nr_segments++;
+        store->capacity += nr_rows;
+        improve_filter_grow(store);
+        return 0;
+}
+
+/**
+ * @brief 가장 앞의 빈 WP를 찾는다.
+ * @details 가득 차지 않은 segment를 `full_segments`의 ctz로 고르고, segment
+ 안에서는 계층형 비트맵의 요약 word를 따라 내려가므로 PA의 크기나 사용률과
+ 관계없이 O(1)이다. 모든 segment가 가득 찼으면 segment를 하나 추가한다.
+ *
+ * @param store 빈 WP를 찾고자 하는 store
+ * @return int 빈 WP로 segment를 추가하지 못하면 -ENOMEM을 반환한다.
+ */
+static int improve_first_free_wp(struct improve_store *store)
+{
+        unsigned int candidates;
+        int s;
+
+        candidates = ~store->full_segments & ((1U << store->nr_segments) - 1);
+        if (candidates == 0) {
+                if (improve_add_segment(store)) {
+                        return -ENOMEM;
+                }
+                candidates = 1U << (store->nr_segments - 1);
+        }
+        s = __builtin_ctz(candidates);
+        return PA_SEGMENT_BASE * ((1 << s) - 1) +
+               pa_bitmap_find_zero(&store->segment[s].bitmap);
+}
+
+/**
+ * @brief 조건을 만족하는 사용 중인 행들을 block 단위의 마스크로 방문한다.
+ * @details segment의 행 수는 PA_SCAN_BLOCK의 배수이므로 block은 segment를
+ 넘지 않고, block의 마스크는 비트맵 level[0]의 word 하나와 위치가 같다. 비어
+ 있는 block은 column을 읽지 않고 건너뛴다.
+ *
+ * @param store 순회하고자 하는 store
+ * @param predicate 조건
+ * @param visit 마스크가 0이 아닌 block마다 호출되는 함수 (block 첫 행의 WP와 마스크)
+ * @param arg visit에 넘겨줄 값
+ * @return int 정상적인 경우에는 0을, visit이 실패하면 그 값을 반환한다.
+ */
+static int improve_scan_block(struct improve_store *store,
+                              const struct pa_predicate *predicate,
+                              int (*visit)(void *arg, int wp,
+                                           unsigned long long mask),
+                              void *arg)
+{
+        struct improve_segment *seg;
+        unsigned long long mask;
+        int s, b, start, nr_blocks, ret;
+
+        for (s = 0; s < store->nr_segments; s++) {
+                start = PA_SEGMENT_BASE * ((1 << s) - 1);
+                if (store->nr_rows <= start) {
+                        break;
+                }
+                seg = &store->segment[s];
+                nr_blocks = (store->nr_rows - start + PA_SCAN_BLOCK - 1) /
+                            PA_SCAN_BLOCK;
+                if (nr_blocks > (PA_SEGMENT_BASE << s) / PA_SCAN_BLOCK) {
+                        nr_blocks = (PA_SEGMENT_BASE << s) / PA_SCAN_BLOCK;
+                }
+                for (b = 0; b < nr_blocks; b++) {
+                        mask = seg->bitmap.level[0][b];
+                        if (mask == 0) {
+                                continue;
+                        }
+                        mask &= pa_predicate_block(
+                                predicate, seg->id + b * PA_SCAN_BLOCK,
+                                (const char(*)[MAX_CHAR_LEN])seg->name +
+                                        b * PA_SCAN_BLOCK,
+                                (const char(*)[MAX_CHAR_LEN])seg->email +
+                                        b * PA_SCAN_BLOCK);
+                        if (mask == 0) {
+                                continue;
+                        }
+                        ret = visit(arg, start + b * PA_SCAN_BLOCK, mask);
+                        if (ret != 0) {
+                                return ret;
+                        }
+                }
+        }
+        return 0;
+}
+
+/**
+ * @brief id가 같은 첫 행을 찾았으면 순회를 멈춘다.
+ *
+ * @param arg 찾은 WP가 저장된다.
+ * @param wp block 첫 행의 WP
+ * @param mask id가 같은 행의 마스크
+ * @return int 항상 1을 반환해서 순회를 멈춘다.
+ */
+static int improve_scan_id_block(void *arg, int wp, unsigned long long mask)
+{
+        *(int *)arg = wp + __builtin_ctzll(mask);
+        return 1;
+}
+
+/**
+ * @brief id 인덱스 없이 id가 위치한 가장 작은 WP를 찾는다.
+ * @details 64행씩 id column을 SIMD로 비교하므로 해시 인덱스를 유지하지 않는
+ 대신 찾을 때마다 사용 중인 block을 순회한다.
+ *
+ * @param store id를 찾고자 하는 store
+ * @param id 찾고자 하는 id
+ * @return int id가 위치한 WP로 찾지 못한 경우 -ENOENT를 반환한다.
+ */
+static int improve_scan_id(struct improve_store *store, int id)
+{
+        struct pa_predicate predicate = { .type = PA_PREDICATE_ID,
+                                          .lo = id,
+                                          .hi = id };
+        int wp = -ENOENT;
+
+        improve_scan_block(store, &predicate, improve_scan_id_block, &wp);
+        return wp;
 }
 
 /**
  * @brief 임의의 id에 해당하는 Write Pointer(WP) 위치를 찾는다.
+ * @details id 인덱스가 있으면 PA를 순회하지 않고 해시 인덱스를 통해서
+ O(1)에 찾는다. 없으면 id column을 순회한다.
  *
+ * @param store id를 찾고자 하는 store
  * @param id 찾고자하는 id에 해당한다.
  * @param is_remove remove 명령인 경우에 해당하는 지를 확인한다.
  * @return int 찾고자하는 id가 존재하는 WP의 위치를 반환한다. 만약 찾지 못한 경우 -ENOENT를 반환한다.
  */
-static int improve_find_wp(const int id, const int is_remove)
+static int improve_find_wp(struct improve_store *store, const int id,
+                           const int is_remove)
 {
-        int wp, i, offset;
+        int wp = (store->flags & IMPROVE_ID_INDEX ?
+                          pa_hash_find(&store->index, id) :
+                          improve_scan_id(store, id));
 
         /**
-        * @brief is_remove의 경우에는 bitmap unset을 하는 과정을 추가한다.
+        * @brief is_remove의 경우에는 bitmap unset과 인덱스 제거를 추가한다.
         *
         */
-        for (i = 0; i * BITMAP_LEN < MAX_ENTRY_SIZE; i++) {
-                if (_bitmap[i] > 0x0) {
-                        wp = i * BITMAP_LEN;
-                        for (offset = 0; offset < BITMAP_LEN; offset++) {
-                                if (wp + offset >= MAX_ENTRY_SIZE) {
-                                        goto ret;
-                                }
-                                if (_id[wp + offset] == id) {
-                                        if (is_remove) {
-                                                _bitmap[i] &= ~(0x1 << offset);
-                                        }
-                                        return (wp + offset);
-                                }
-                        } // end of for
-                } // end of if
-        } // end of for
-ret:
-        return -ENOENT;
+        if (wp >= 0 && is_remove) {
+                if (store->flags & IMPROVE_SECONDARY_INDEX) {
+                        improve_index_remove(store, wp);
+                }
+                improve_filter_count(store, id, wp, -1);
+                improve_mark_free(store, wp);
+                if (store->flags & IMPROVE_ID_INDEX) {
+                        pa_hash_remove(&store->index, id, wp);
+                }
+        }
+        return wp;
+}
+
+/**
+ * @brief 빈 공간을 가진 Write Pointer(WP) 위치를 찾는다.
+ * @details 이전에 쓴 다음 위치가 비어 있으면 이를 사용하고, 그렇지 않으면 가장
+ 앞의 빈 공간을 improve_first_free_wp()로 찾는다. 지워진 행이 없을 때만
+ `nr_rows`를 사용해서 PA를 한 행 늘리므로, 삽입과 삭제가 반복되어도 PA는 사용
+ 중인 행 수보다 커지지 않는다.
+ 같은 id가 이미 있을 수 있으면 빈 공간을 다시 쓰지 않고 PA를 늘린다. 같은 id
+ 사이에서는 WP가 작은 행이 앞서므로, 이렇게 해야 먼저 들어온 행이 앞서는 순서가
+ 빈 공간의 위치나 shard의 수와 관계없이 유지된다. 확인은 improve_may_have_id()로
+ 하므로 id 인덱스가 없어도 column을 순회하지 않는다.
+ *
+ * @param store 빈 공간을 찾고자 하는 store
+ * @param id 넣고자 하는 레코드의 id
+ * @return int wp의 index 값으로 만약 빈 공간을 만들지 못하면 -ENOMEM을 반환한다.
+ */
+static int improve_get_free_wp(struct improve_store *store, const int id)
+{
+        struct improve_segment *seg;
+        int wp = store->wp, offset;
+
+        /* 초기화된 행 중에 빈 공간이 없거나 같은 id가 있으면 PA를 늘린다. */
+        if (store->nr_live == store->nr_rows ||
+            improve_may_have_id(store, id)) {
+                wp = store->nr_rows;
+                if (wp == store->capacity && improve_add_segment(store)) {
+                        return -ENOMEM;
+                }
+                goto found;
+        }
+        if (wp < store->nr_rows) {
+                seg = improve_locate(store, wp, &offset);
+                if (!pa_bitmap_test(&seg->bitmap, offset)) {
+                        goto found;
+                }
+        }
+        wp = improve_first_free_wp(store);
+        if (wp < 0) {
+                return -ENOMEM;
+        }
+
+found:
+        if (wp == store->nr_rows) {
+                *improve_id(store, wp) = -1; /**< 빈 공간 정보를 설정한다. */
+                store->nr_rows++;
+        }
+        improve_mark_used(store, wp);
+        return wp;
+}
+
+/**
+ * @brief from 행을 빈 to 행으로 옮기고 인덱스들이 to를 가리키도록 한다.
+ * @details 인덱스의 항목은 다시 넣지 않고 WP만 바꾼다. compaction은 행의
+ 상대적인 순서를 바꾸지 않으므로 같은 id 사이에서 WP가 작은 행이 앞서는
+ 순서도 그대로 유지된다.
+ *
+ * @param store 행이 있는 store
+ * @param from 옮기고자 하는 사용 중인 WP
+ * @param to 옮겨 넣을 빈 WP (from보다 앞에 있다.)
+ */
+static void improve_move(struct improve_store *store, int from, int to)
+{
+        int src_offset, dst_offset, id;
+        struct improve_segment *src = improve_locate(store, from, &src_offset);
+        struct improve_segment *dst = improve_locate(store, to, &dst_offset);
+
+        id = src->id[src_offset];
+        dst->id[dst_offset] = id;
+        memcpy(dst->name[dst_offset], src->name[src_offset], MAX_CHAR_LEN);
+        memcpy(dst->bban[dst_offset], src->bban[src_offset], MAX_CHAR_LEN);
+        memcpy(dst->email[dst_offset], src->email[src_offset], MAX_CHAR_LEN);
+
+        if (store->flags & IMPROVE_ID_INDEX) {
+                pa_hash_move(&store->index, id, from, to);
+        } else if (store->id_filter_src >= 0 && to < store->id_filter_src &&
+                   from >= store->id_filter_src) {
+                /* 새 id filter가 세는 범위 안으로 들어온다. */
+                improve_filter_count(store, id, to, 1);
+                improve_filter_count(store, id, from, -1);
+        }
+        if (store->flags & IMPROVE_SECONDARY_INDEX) {
+                pa_hash_move(&store->email_index,
+                             improve_email_key(src->email[src_offset]), from,
+                             to);
+                pa_sorted_move(&store->name_index, src->name[src_offset], id,
+                               from, to);
+        }
+        improve_mark_used(store, to);
+        improve_mark_free(store, from);
+        src->id[src_offset] = -1;
+}
+
+/**
+ * @brief 빈 행의 비율이 PA_COMPACT_THRESHOLD 이상이면 compaction을 시작한다.
+ * @details 가장 앞의 빈 행부터 채우기 시작한다.
+ *
+ * @param store compaction을 시작하고자 하는 store
+ * @return int 시작했으면 1을, 그렇지 않으면 0을 반환한다.
+ */
+static int improve_compact_start(struct improve_store *store)
+{
+        long long nr_holes = store->nr_rows - store->nr_live;
+
+        if (PA_COMPACT_THRESHOLD <= 0 || store->nr_rows < PA_SEGMENT_BASE ||
+            nr_holes * 100 < (long long)store->nr_rows * PA_COMPACT_THRESHOLD) {
+                return 0;
+        }
+        store->compact_dst = improve_first_free_wp(store);
+        if (store->compact_dst < 0 || store->compact_dst >= store->nr_rows) {
+                return 0;
+        }
+        store->compact_src = store->compact_dst + 1;
+        return 1;
+}
+
+/**
+ * @brief compaction을 마치고 비게 된 뒷부분을 PA에서 잘라낸다.
+ * @details 다음 행이 들어갈 segment 뒤의 segment들은 해제한다.
+ *
+ * @param store compaction을 마치고자 하는 store
+ */
+static void improve_compact_finish(struct improve_store *store)
+{
+        int offset, keep, s;
+
+        store->nr_rows = store->compact_dst;
+        store->wp = store->nr_rows;
+        store->compact_src = -1;
+
+        keep = (store->nr_rows < store->capacity ?
+                        (int)(improve_locate(store, store->nr_rows, &offset) -
+                              store->segment) :
+                        store->nr_segments);
+        while (store->nr_segments - 1 > keep) {
+                s = --store->nr_segments;
+                store->capacity -= PA_SEGMENT_BASE << s;
+                store->full_segments &= ~(1U << s);
+                improve_release_segment(&store->segment[s]);
+        }
+}
+
+/**
+ * @brief 사용 중인 행을 앞의 빈 행으로 조금씩 옮긴다.
+ * @details compact_dst부터 compact_src 앞까지는 모두 빈 행이므로, compact_src
+ 이후의 첫 사용 중인 행을 compact_dst로 옮기면 행의 상대적인 순서를 유지하면서
+ 빈 행이 뒤로 밀려난다. 명령마다 PA_COMPACT_STEP개의 행을 옮기거나 비트맵
+ word를 건너뛰므로 한 명령이 기다리는 시간은 PA의 크기와 관계없다.
+ compact_src가 초기화된 행의 끝에 닿으면 compact_dst 이후는 모두 비어 있다.
+ *
+ * @param store compaction을 진행하고자 하는 store
+ */
+static void improve_compact(struct improve_store *store)
+{
+        struct improve_segment *seg;
+        unsigned long long word;
+        int budget = PA_COMPACT_STEP, offset;
+
+        if (store->compact_src < 0 && !improve_compact_start(store)) {
+                return;
+        }
+        while (budget-- > 0) {
+                if (store->compact_src >= store->nr_rows) {
+                        improve_compact_finish(store);
+                        return;
+                }
+                seg = improve_locate(store, store->compact_src, &offset);
+                word = seg->bitmap.level[0][offset / PA_BITMAP_WORD_BITS] >>
+                       (offset % PA_BITMAP_WORD_BITS);
+                if (word == 0) {
+                        store->compact_src += PA_BITMAP_WORD_BITS -
+                                              offset % PA_BITMAP_WORD_BITS;
+                        continue;
+                }
+                store->compact_src += __builtin_ctzll(word);
+                seg = improve_locate(store, store->compact_dst, &offset);
+                if (pa_bitmap_test(&seg->bitmap, offset)) {
+                        /* 빈 행이 다시 사용되었으면 다음에 처음부터 한다. */
+                        store->compact_src = -1;
+                        return;
+                }
+                improve_move(store, store->compact_src++,
+                             store->compact_dst++);
+        }
 }
 
 /**
  * @brief 문자열을 가지는 PA에 값을 넣도록 한다.
  *
- * @param str 현재 쓰고 있는 문자열 값
- * @param arr 쓰고자 하는 PA 포인터
- * @param wp 현재 쓰는 위치
+ * @param field 현재 쓰고 있는 문자열 field
+ * @param dest 쓰고자 하는 PA의 원소
+ * @param id 현재 쓰는 레코드의 id
  */
-static void improve_insert_string(char **str, char **arr, const int wp)
+static void improve_insert_string(const struct pa_field *field, char *dest,
+                                  const int id)
 {
-        int is_valid;
-        char *ptr;
-        ptr = get_csv_field(str, ",\n");
-        is_valid = (ptr != NULL && strlen(ptr) != 0);
+        int is_valid = (field->len != 0);
 #ifdef DEBUG
         if (!is_valid) {
                 fprintf(stderr, "[%s:%s(%d)] Cannot find field value(id: %d)\n",
-                        __FILE__, __FUNCTION__, __LINE__, _id[wp]);
+                        __FILE__, __FUNCTION__, __LINE__, id);
         }
+#else
+        (void)id;
 #endif
-        strncpy(arr[wp], (is_valid ? ptr : "<EMPTY>"), MAX_CHAR_LEN);
+        if (is_valid) {
+                pa_field_copy(dest, field);
+        } else {
+                strcpy(dest, "<EMPTY>");
+        }
 }
 
 /**
  * @brief improve 방식을 초기화 하도록 한다.
  *
+ * @param storep 할당된 store가 저장된다.
+ * @param flags 유지할 인덱스 (enum improve_flag)
  * @return int 정상적인 경우에는 0을 그렇지 않고 메모리를 할당 받지 못하는 등의 예외가 발생하면 음수 값을 반환한다.
  */
-int improve_init(void)
+static int improve_create(void **storep, unsigned int flags)
 {
-        int i, nr_bitmap;
-        int total_size = 0;
+        struct improve_store *store;
+        int total_size = 0, bitmap_size = 0;
 
-        _id = (int *)malloc(sizeof(int) * MAX_ENTRY_SIZE);
-        total_size += sizeof(int) * MAX_ENTRY_SIZE;
-        _name = (char **)malloc(sizeof(char *) * MAX_ENTRY_SIZE);
-        _bban = (char **)malloc(sizeof(char *) * MAX_ENTRY_SIZE);
-        _email = (char **)malloc(sizeof(char *) * MAX_ENTRY_SIZE);
-        total_size += sizeof(char *) * MAX_ENTRY_SIZE * 3;
-        if (_id == NULL || _name == NULL || _bban == NULL || _email == NULL) {
+        store = (struct improve_store *)calloc(1, sizeof(struct improve_store));
+        if (store == NULL) {
                 goto exception;
         }
-
-        for (i = 0; i < MAX_ENTRY_SIZE; i++) {
-                _id[i] = -1; /**_id[i] = -1; < 빈 공간 정보를 설정한다. */
-                _name[i] = (char *)malloc(sizeof(char) * MAX_CHAR_LEN);
-                _bban[i] = (char *)malloc(sizeof(char) * MAX_CHAR_LEN);
-                _email[i] = (char *)malloc(sizeof(char) * MAX_CHAR_LEN);
-                total_size += sizeof(char) * MAX_CHAR_LEN * 3;
-                if (_name[i] == NULL || _bban[i] == NULL || _email[i] == NULL) {
-                        goto exception;
-                }
+        store->flags = flags;
+        store->compact_src = -1;
+        store->id_filter_src = -1;
+        if (improve_add_segment(store)) {
+                goto exception;
         }
+        total_size += (sizeof(int) + MAX_CHAR_LEN * 3) * PA_SEGMENT_BASE;
+        bitmap_size = sizeof(unsigned long long) * PA_SEGMENT_BASE /
+                      PA_BITMAP_WORD_BITS;
 
-        nr_bitmap = MAX_ENTRY_SIZE / BITMAP_LEN;
-        _bitmap = (unsigned long *)malloc(sizeof(unsigned long) *
-                                          (nr_bitmap + 1));
-        if (_bitmap == NULL) {
+        if ((flags & IMPROVE_ID_INDEX) &&
+            pa_hash_init(&store->index, PA_SEGMENT_BASE)) {
                 goto exception;
         }
-        printf("[%s:%s(%d)] Additional Memory: %.2lfKB/%.2lfKB(%lf%%)\n",
-               __FILE__, __FUNCTION__, __LINE__,
-               (sizeof(unsigned long) * (nr_bitmap + 1)) / 1000.0,
-               total_size / 1000.0,
-               (double)(sizeof(unsigned long) * (nr_bitmap + 1)) / total_size *
-                       100);
-#ifdef DEBUG
-        for (i = 0; i * BITMAP_LEN < MAX_ENTRY_SIZE; i++) {
-                _bitmap[i] &= 0x00;
-                printf("_bitmap[%d]: 0x%08lx\n", i, _bitmap[i]);
+        if ((flags & IMPROVE_SECONDARY_INDEX) &&
+            (pa_hash_init(&store->email_index, PA_SEGMENT_BASE) ||
+             pa_sorted_init(&store->name_index, PA_SEGMENT_BASE,
+                            improve_name_key, store))) {
+                goto exception;
         }
-#endif
+        *storep = store;
+
+        printf("[%s:%s(%d)] Additional Memory: %.2lfKB/%.2lfKB(%lf%%)\n",
+               __FILE__, __FUNCTION__, __LINE__, bitmap_size / 1000.0,
+               total_size / 1000.0, (double)bitmap_size / total_size * 100);
         return 0;
 
 exception:
@@ -177,24 +852,66 @@ exception:
         fprintf(stderr, "[%s:%s(%d)] Cannot allocate the MEMORY\n", __FILE__,
                 __FUNCTION__, __LINE__);
 #endif
+        if (store != NULL) {
+                improve_free(store);
+        }
         return -ENOMEM;
 }
 
+/**
+ * @brief 비트맵만 사용하는 improve 방식(bitmap)을 초기화한다.
+ * @details 인덱스를 유지하지 않으므로 찾는 명령은 column을 순회한다.
+ *
+ * @param storep 할당된 store가 저장된다.
+ * @return int 정상적인 경우에는 0을, 그렇지 않으면 음수 값을 반환한다.
+ */
+int improve_bitmap_init(void **storep)
+{
+        return improve_create(storep, 0);
+}
+
+/**
+ * @brief id 해시 인덱스를 사용하는 improve 방식(hashed)을 초기화한다.
+ *
+ * @param storep 할당된 store가 저장된다.
+ * @return int 정상적인 경우에는 0을, 그렇지 않으면 음수 값을 반환한다.
+ */
+int improve_hashed_init(void **storep)
+{
+        return improve_create(storep, IMPROVE_ID_INDEX);
+}
+
+/**
+ * @brief 모든 인덱스를 사용하는 improve 방식(sorted-array)을 초기화한다.
+ * @details id 해시 인덱스에 더해서 email 해시 인덱스와 배열에 node를 두는
+ name 정렬 인덱스를 유지한다.
+ *
+ * @param storep 할당된 store가 저장된다.
+ * @return int 정상적인 경우에는 0을, 그렇지 않으면 음수 값을 반환한다.
+ */
+int improve_init(void **storep)
+{
+        return improve_create(storep, IMPROVE_ID_INDEX |
+                                              IMPROVE_SECONDARY_INDEX);
+}
+
 /**
  * @brief PA에 값을 집어넣도록 한다.
  *
- * @param str COMMAND를 제외한 csv 형태의 행을 의미한다.
- * @param outp_fp 출력을 하는 파일에 대한 포인터이다.
+ * @param storep 값을 넣고자 하는 store
+ * @param line COMMAND와 레코드의 field들로 나누어진 행을 의미한다.
+ * @param result 명령을 수행한 결과가 저장된다.
  *
  * @return int 정상적인 종료 때에는 0을 비정상 종료의 경우 음수 값을 반환한다.
  */
-int improve_insert(char *str, FILE *outp_fp)
+int improve_insert(void *storep, const struct pa_line *line,
+                   struct pa_result *result)
 {
-        int wp, is_valid, id;
-        char *ptr;
+        struct improve_store *store = (struct improve_store *)storep;
+        struct improve_segment *seg;
+        int wp, is_valid, id, offset;
 
-        ptr = get_csv_field(&str, ",\n");
-        is_valid = (ptr != NULL && strlen(ptr) != 0);
+        is_valid = (line->field[1].len != 0);
         if (!is_valid) {
 #ifdef DEBUG
                 fprintf(stderr, "[%s:%s(%d)] Cannot allow the empty \"id\"\n",
@@ -202,8 +919,8 @@ int improve_insert(char *str, FILE *outp_fp)
 #endif
                 return -EINVAL;
         }
-        id = atoi(ptr);
-        wp = improve_get_free_wp(id);
+        id = pa_field_atoi(&line->field[1]);
+        wp = improve_get_free_wp(store, id);
         if (wp < 0) {
 #ifdef DEBUG
                 fprintf(stderr, "[%s:%s(%d)] Cannot find free WP\n", __FILE__,
@@ -212,34 +929,58 @@ int improve_insert(char *str, FILE *outp_fp)
                 return -ENOMEM;
         }
 
-        _id[wp] = id;
-        improve_insert_string(&str, _name, wp);
-        improve_insert_string(&str, _bban, wp);
-        improve_insert_string(&str, _email, wp);
+        if ((store->flags & IMPROVE_ID_INDEX) &&
+            pa_hash_insert(&store->index, id, wp)) {
+                improve_mark_free(store, wp);
+                return -ENOMEM;
+        }
+
+        seg = improve_locate(store, wp, &offset);
+        seg->id[offset] = id;
+        improve_insert_string(&line->field[2], seg->name[offset], id);
+        improve_insert_string(&line->field[3], seg->bban[offset], id);
+        improve_insert_string(&line->field[4], seg->email[offset], id);
+        if ((store->flags & IMPROVE_SECONDARY_INDEX) &&
+            improve_index_insert(store, wp)) {
+                if (store->flags & IMPROVE_ID_INDEX) {
+                        pa_hash_remove(&store->index, id, wp);
+                }
+                improve_mark_free(store, wp);
+                seg->id[offset] = -1;
+                return -ENOMEM;
+        }
 
 #ifdef DEBUG
-        fprintf(outp_fp, "INSERT\t%d\t%s\t%s\t%s\n", _id[wp], _name[wp],
-                _bban[wp], _email[wp]);
+        pa_result_record(result, seg->id[offset], seg->name[offset],
+                         seg->bban[offset], seg->email[offset]);
 #else
-        fprintf(outp_fp, "INSERT\t%d\n", _id[wp]);
+        result->id = seg->id[offset];
 #endif
-        _wp = wp + 1;
+        store->wp = wp + 1;
+        store->nr_live++;
+        improve_filter_count(store, id, wp, 1);
+        improve_compact(store);
+        improve_filter_migrate(store);
         return 0;
 }
 
 /**
  * @brief id에 기반하여 PA에 존재하는 값을 찾는 함수에 해당한다.
  *
- * @param str COMMAND를 제외한 csv 형태의 행을 의미한다.
- * @param outp_fp 출력하는 파일에 대한 포인터이다.
+ * @param storep 값을 찾고자 하는 store
+ * @param line COMMAND와 레코드의 field들로 나누어진 행을 의미한다.
+ * @param result 명령을 수행한 결과가 저장된다.
  *
  * @return int 정상 종료 시에 0을 반환하고 비정상 종료시 -1을 반환한다.
  */
-int improve_search(char *str, FILE *outp_fp)
+int improve_search(void *storep, const struct pa_line *line,
+                   struct pa_result *result)
 {
-        int wp, id;
-        id = atoi(get_csv_field(&str, ","));
-        wp = improve_find_wp(id, 0);
+        struct improve_store *store = (struct improve_store *)storep;
+        struct improve_segment *seg;
+        int wp, id, offset;
+        id = pa_field_atoi(&line->field[1]);
+        wp = improve_find_wp(store, id, 0);
         if (wp < 0) {
 #ifdef DEBUG
                 fprintf(stderr, "[%s:%s(%d)] Cannot find WP\n", __FILE__,
@@ -247,24 +988,28 @@ int improve_search(char *str, FILE *outp_fp)
 #endif
                 return -ENOMEM;
         }
-        fprintf(outp_fp, "SEARCH\t%d\t%s\t%s\t%s\n", _id[wp], _name[wp],
-                _bban[wp], _email[wp]);
+        seg = improve_locate(store, wp, &offset);
+        pa_result_record(result, seg->id[offset], seg->name[offset],
+                         seg->bban[offset], seg->email[offset]);
         return 0;
 }
 
 /**
  * @brief id에 기반하여 PA에 해당하는 값을 제거한다.
  *
- * @param str COMMAND를 제외한 csv 형태의 행을 의미한다.
- * @param outp_fp 출력하는 파일에 대한 포인터이다.
+ * @param storep 값을 제거하고자 하는 store
+ * @param line COMMAND와 레코드의 field들로 나누어진 행을 의미한다.
+ * @param result 명령을 수행한 결과가 저장된다.
  *
  * @return int 정상 종료 시에 0을 반환하고 비정상 종료시 -1을 반환한다.
  */
-int improve_remove(char *str, FILE *outp_fp)
+int improve_remove(void *storep, const struct pa_line *line,
+                   struct pa_result *result)
 {
+        struct improve_store *store = (struct improve_store *)storep;
         int wp, id;
-        id = atoi(get_csv_field(&str, ",\n"));
-        wp = improve_find_wp(id, 1);
+        id = pa_field_atoi(&line->field[1]);
+        wp = improve_find_wp(store, id, 1);
         if (wp < 0) {
 #ifdef DEBUG
                 fprintf(stderr, "[%s:%s(%d)] Cannot find WP\n", __FILE__,
@@ -272,42 +1017,674 @@ int improve_remove(char *str, FILE *outp_fp)
 #endif
                 return -ENOMEM;
         }
-        _id[wp] = -1;
-        fprintf(outp_fp, "REMOVE\t%d\n", id);
+        *improve_id(store, wp) = -1;
+        result->id = id;
+        store->nr_live--;
+        improve_compact(store);
+        improve_filter_migrate(store);
+        return 0;
+}
+
+/**
+ * @brief email이나 name으로 찾는 동안 지금까지 찾은 레코드를 가진다.
+ *
+ */
+struct improve_match {
+        struct improve_store *store;
+        const char *str; /**< str < 찾고자 하는 email 또는 name prefix */
+        size_t len; /**< len < str의 길이 */
+        int wp; /**< wp < 지금까지 찾은 WP (없으면 -ENOENT) */
+};
+
+/**
+ * @brief WP 행이 찾은 레코드보다 앞서면 찾은 레코드로 바꾼다.
+ * @details id가 같으면 먼저 들어온(WP가 작은) 행이 앞선다.
+ *
+ * @param match 지금까지 찾은 레코드
+ * @param wp 비교하고자 하는 WP
+ * @param cmp WP 행과 찾은 행의 문자열을 비교한 값 (email이면 0)
+ */
+static void improve_match_update(struct improve_match *match, int wp,
+                                 int cmp)
+{
+        int id, best;
+
+        if (match->wp >= 0 && cmp == 0) {
+                id = *improve_id(match->store, wp);
+                best = *improve_id(match->store, match->wp);
+                cmp = (id != best ? (id < best ? -1 : 1) : wp - match->wp);
+        }
+        if (match->wp < 0 || cmp < 0) {
+                match->wp = wp;
+        }
+}
+
+/**
+ * @brief email이 같은 행인지 확인하고 찾은 레코드를 갱신한다.
+ *
+ * @param arg 지금까지 찾은 레코드
+ * @param wp 확인하고자 하는 WP
+ */
+static void improve_match_email(void *arg, int wp)
+{
+        struct improve_match *match = (struct improve_match *)arg;
+        int offset;
+        struct improve_segment *seg = improve_locate(match->store, wp, &offset);
+
+        if (strcmp(seg->email[offset], match->str) == 0) {
+                improve_match_update(match, wp, 0);
+        }
+}
+
+/**
+ * @brief name이 prefix로 시작하는 행인지 확인하고 찾은 레코드를 갱신한다.
+ *
+ * @param arg 지금까지 찾은 레코드
+ * @param wp 확인하고자 하는 WP
+ */
+static void improve_match_name(void *arg, int wp)
+{
+        struct improve_match *match = (struct improve_match *)arg;
+        int offset, best;
+        struct improve_segment *seg = improve_locate(match->store, wp, &offset);
+        char *name = seg->name[offset];
+
+        if (strncmp(name, match->str, match->len) != 0) {
+                return;
+        }
+        if (match->wp < 0) {
+                match->wp = wp;
+                return;
+        }
+        seg = improve_locate(match->store, match->wp, &best);
+        improve_match_update(match, wp, strcmp(name, seg->name[best]));
+}
+
+/**
+ * @brief 사용 중인 모든 행을 방문한다.
+ * @details 보조 인덱스가 없을 때 email, name으로 찾기 위한 것이다. 행마다
+ 비트맵을 확인하고, 초기화되지 않은 뒷부분은 보지 않는다.
+ *
+ * @param store 순회하고자 하는 store
+ * @param visit WP마다 호출되는 함수
+ * @param arg visit에 넘겨줄 값
+ */
+static void improve_scan(struct improve_store *store,
+                         void (*visit)(void *arg, int wp), void *arg)
+{
+        int s, offset, start, nr_rows;
+
+        for (s = 0; s < store->nr_segments; s++) {
+                start = PA_SEGMENT_BASE * ((1 << s) - 1);
+                nr_rows = store->nr_rows - start;
+                if (nr_rows <= 0) {
+                        break;
+                }
+                if (nr_rows > (PA_SEGMENT_BASE << s)) {
+                        nr_rows = PA_SEGMENT_BASE << s;
+                }
+                for (offset = 0; offset < nr_rows; offset++) {
+                        if (pa_bitmap_test(&store->segment[s].bitmap,
+                                           offset)) {
+                                visit(arg, start + offset);
+                        }
+                }
+        }
+}
+
+/**
+ * @brief field를 검색에 사용할 문자열로 복사한다.
+ *
+ * @param dest 문자열이 저장될 버퍼 (MAX_CHAR_LEN 바이트)
+ * @param field 복사하고자 하는 field
+ */
+static inline void improve_query(char *dest, const struct pa_field *field)
+{
+        dest[0] = 0x00;
+        if (field->len != 0) {
+                pa_field_copy(dest, field);
+        }
+}
+
+/**
+ * @brief email이 같은 레코드 중 id가 가장 작은 것을 찾는다.
+ * @details 보조 인덱스가 있으면 email의 해시 값으로 후보 행만 확인한다.
+ *
+ * @param storep 값을 찾고자 하는 store
+ * @param line COMMAND와 email로 나누어진 행을 의미한다.
+ * @param result 명령을 수행한 결과가 저장된다.
+ *
+ * @return int 정상 종료 시에 0을, 찾지 못하면 -ENOENT를 반환한다.
+ */
+int improve_search_email(void *storep, const struct pa_line *line,
+                         struct pa_result *result)
+{
+        struct improve_store *store = (struct improve_store *)storep;
+        struct improve_match match = { .store = store, .wp = -ENOENT };
+        struct improve_segment *seg;
+        char email[MAX_CHAR_LEN];
+        int offset;
+
+        improve_query(email, &line->field[1]);
+        match.str = email;
+        match.len = strlen(email);
+        if (store->flags & IMPROVE_SECONDARY_INDEX) {
+                pa_hash_find_each(&store->email_index,
+                                  improve_email_key(email),
+                                  improve_match_email, &match);
+        } else {
+                improve_scan(store, improve_match_email, &match);
+        }
+        if (match.wp < 0) {
+                return -ENOENT;
+        }
+        seg = improve_locate(store, match.wp, &offset);
+        pa_result_record(result, seg->id[offset], seg->name[offset],
+                         seg->bban[offset], seg->email[offset]);
+        return 0;
+}
+
+/**
+ * @brief name이 prefix로 시작하는 레코드 중 (name, id)가 가장 작은 것을 찾는다.
+ * @details 보조 인덱스가 있으면 prefix 이상인 첫 항목만 확인하면 된다.
+ *
+ * @param storep 값을 찾고자 하는 store
+ * @param line COMMAND와 name prefix로 나누어진 행을 의미한다.
+ * @param result 명령을 수행한 결과가 저장된다.
+ *
+ * @return int 정상 종료 시에 0을, 찾지 못하면 -ENOENT를 반환한다.
+ */
+int improve_search_name_prefix(void *storep, const struct pa_line *line,
+                               struct pa_result *result)
+{
+        struct improve_store *store = (struct improve_store *)storep;
+        struct improve_match match = { .store = store, .wp = -ENOENT };
+        struct improve_segment *seg;
+        char prefix[MAX_CHAR_LEN];
+        int offset;
+
+        improve_query(prefix, &line->field[1]);
+        match.str = prefix;
+        match.len = strlen(prefix);
+        if (store->flags & IMPROVE_SECONDARY_INDEX) {
+                match.wp = pa_sorted_lower_bound(&store->name_index, prefix);
+                if (match.wp >= 0 &&
+                    strncmp(improve_name_key(store, match.wp), prefix,
+                            match.len)) {
+                        match.wp = -ENOENT;
+                }
+        } else {
+                improve_scan(store, improve_match_name, &match);
+        }
+        if (match.wp < 0) {
+                return -ENOENT;
+        }
+        seg = improve_locate(store, match.wp, &offset);
+        pa_result_record(result, seg->id[offset], seg->name[offset],
+                         seg->bban[offset], seg->email[offset]);
+        return 0;
+}
+
+/**
+ * @brief block에서 고른 행의 수를 더한다.
+ *
+ * @param arg 행의 수를 더할 결과
+ * @param wp block 첫 행의 WP
+ * @param mask 고른 행의 마스크
+ * @return int 항상 0을 반환한다.
+ */
+static int improve_scan_count_block(void *arg, int wp, unsigned long long mask)
+{
+        struct pa_result *result = (struct pa_result *)arg;
+
+        (void)wp;
+        result->count += __builtin_popcountll(mask);
+        return 0;
+}
+
+/**
+ * @brief 조건을 만족하는 행의 수를 센다.
+ * @details 64행씩 조건을 SIMD로 확인하고 popcount로 센다.
+ *
+ * @param storep 확인하고자 하는 store
+ * @param line COMMAND와 조건으로 나누어진 행을 의미한다.
+ * @param result 고른 행의 수가 저장된다.
+ *
+ * @return int 정상 종료 시에 0을, 조건이 잘못되면 -EINVAL을 반환한다.
+ */
+int improve_scan_count(void *storep, const struct pa_line *line,
+                       struct pa_result *result)
+{
+        struct improve_store *store = (struct improve_store *)storep;
+        struct pa_predicate predicate;
+        int ret;
+
+        ret = pa_predicate_parse(&predicate, line);
+        if (ret != 0) {
+                return ret;
+        }
+        return improve_scan_block(store, &predicate, improve_scan_count_block,
+                                  result);
+}
+
+/**
+ * @brief SCAN_SELECT가 행을 고르는 동안 필요한 상태를 가진다.
+ *
+ */
+struct improve_selection {
+        struct improve_store *store;
+        struct pa_result *result; /**< result < 고른 레코드가 저장될 결과 */
+};
+
+/**
+ * @brief block에서 고른 행들을 결과의 selection에 복사한다.
+ *
+ * @param arg 레코드를 고르고 있는 상태
+ * @param wp block 첫 행의 WP
+ * @param mask 고른 행의 마스크
+ * @return int 정상적인 경우에는 0을, 메모리가 부족하면 -ENOMEM을 반환한다.
+ */
+static int improve_scan_select_block(void *arg, int wp,
+                                     unsigned long long mask)
+{
+        struct improve_selection *selection = (struct improve_selection *)arg;
+        struct pa_result *result = selection->result;
+        struct improve_segment *seg;
+        int offset, row, ret;
+
+        seg = improve_locate(selection->store, wp, &offset);
+        while (mask != 0) {
+                row = offset + __builtin_ctzll(mask);
+                mask &= mask - 1;
+                ret = pa_selection_add(&result->selection, seg->id[row],
+                                       wp + row - offset, seg->name[row],
+                                       seg->bban[row], seg->email[row]);
+                if (ret != 0) {
+                        return ret;
+                }
+                result->count++;
+        }
+        return 0;
+}
+
+/**
+ * @brief 조건을 만족하는 행을 모두 고른다.
+ * @details 고른 레코드는 (id, WP) 순서로 정렬해 두므로 출력할 때 shard들의
+ 결과를 병합하기만 하면 된다.
+ *
+ * @param storep 확인하고자 하는 store
+ * @param line COMMAND와 조건으로 나누어진 행을 의미한다.
+ * @param result 고른 행의 수와 레코드가 저장된다.
+ *
+ * @return int 정상 종료 시에 0을, 조건이 잘못되면 -EINVAL을, 메모리가
+ 부족하면 -ENOMEM을 반환한다.
+ */
+int improve_scan_select(void *storep, const struct pa_line *line,
+                        struct pa_result *result)
+{
+        struct improve_store *store = (struct improve_store *)storep;
+        struct improve_selection selection = { .store = store,
+                                               .result = result };
+        struct pa_predicate predicate;
+        int ret;
+
+        ret = pa_predicate_parse(&predicate, line);
+        if (ret == 0) {
+                ret = improve_scan_block(store, &predicate,
+                                         improve_scan_select_block,
+                                         &selection);
+        }
+        if (ret != 0) {
+                pa_selection_free(result->selection);
+                result->selection = NULL;
+                result->count = 0;
+                return ret;
+        }
+        pa_selection_sort(result->selection);
         return 0;
 }
 
 /**
  * @brief 현재 사용량을 출력하도록 한다.
  *
+ * @details 행을 순회하지 않고 각 segment 비트맵의 popcount를 더한다.
+ *
+ * @param storep 사용량을 확인하고자 하는 store
  * @return int 현재 사용량을 출력한다.
  */
-int improve_get_current_usage()
+int improve_get_current_usage(void *storep)
 {
-        int wp, count = 0;
-        for (wp = 0; wp < MAX_ENTRY_SIZE; wp++) {
-                if (_id[wp] != -1) {
-                        count++;
-                }
+        struct improve_store *store = (struct improve_store *)storep;
+        int s, count = 0;
+        for (s = 0; s < store->nr_segments; s++) {
+                count += pa_bitmap_count(&store->segment[s].bitmap);
         }
         return count;
 }
 
+/**
+ * @brief 초기화된 행 중 빈 행의 비율을 구한다.
+ * @details 이 값이 PA_COMPACT_THRESHOLD 이상이 되면 compaction이 시작된다.
+ *
+ * @param storep 확인하고자 하는 store
+ * @return int 빈 행의 비율(%)
+ */
+int improve_get_fragmentation(void *storep)
+{
+        struct improve_store *store = (struct improve_store *)storep;
+
+        if (store->nr_rows == 0) {
+                return 0;
+        }
+        return (int)((long long)(store->nr_rows - store->nr_live) * 100 /
+                     store->nr_rows);
+}
+
+/**
+ * @brief store를 snapshot에 쓴다.
+ * @details column은 segment의 크기만큼 자리를 차지하지만 초기화된 행까지만
+ 쓰고, 해시 인덱스는 진행 중인 확장을 마무리해서 한 테이블로 쓴다.
+ *
+ * @param storep 저장하고자 하는 store
+ * @param snapshot 쓰고 있는 snapshot
+ * @param offset store가 저장된 section의 offset이 저장된다.
+ * @return int 정상적인 경우에는 0을, 쓰기에 실패하면 음수 값을 반환한다.
+ */
+int improve_save(void *storep, struct pa_snapshot *snapshot,
+                 unsigned long long *offset)
+{
+        struct improve_store *store = (struct improve_store *)storep;
+        struct improve_image image;
+        struct improve_segment *seg;
+        size_t nr_rows, nr_used, nr_words;
+        int s, level, start = 0;
+
+        memset(&image, 0, sizeof(image));
+        image.nr_segments = store->nr_segments;
+        image.nr_rows = store->nr_rows;
+        image.wp = store->wp;
+        image.full_segments = store->full_segments;
+        image.nr_live = store->nr_live;
+        image.compact_src = store->compact_src;
+        image.compact_dst = store->compact_dst;
+
+        for (s = 0; s < store->nr_segments; s++) {
+                seg = &store->segment[s];
+                nr_rows = (size_t)PA_SEGMENT_BASE << s;
+                nr_used = (store->nr_rows <= start ?
+                                   0 :
+                                   (size_t)(store->nr_rows - start));
+                nr_used = (nr_used < nr_rows ? nr_used : nr_rows);
+                start += (int)nr_rows;
+
+                image.segment[s].id = pa_snapshot_write(
+                        snapshot, seg->id, sizeof(int) * nr_used,
+                        sizeof(int) * nr_rows);
+                image.segment[s].name = pa_snapshot_write(
+                        snapshot, seg->name, MAX_CHAR_LEN * nr_used,
+                        MAX_CHAR_LEN * nr_rows);
+                image.segment[s].bban = pa_snapshot_write(
+                        snapshot, seg->bban, MAX_CHAR_LEN * nr_used,
+                        MAX_CHAR_LEN * nr_rows);
+                image.segment[s].email = pa_snapshot_write(
+                        snapshot, seg->email, MAX_CHAR_LEN * nr_used,
+                        MAX_CHAR_LEN * nr_rows);
+
+                image.segment[s].nr_levels = seg->bitmap.nr_levels;
+                image.segment[s].nr_bits = seg->bitmap.nr_bits;
+                nr_words = (size_t)seg->bitmap.nr_bits;
+                for (level = 0; level < seg->bitmap.nr_levels; level++) {
+                        nr_words = (nr_words + PA_BITMAP_WORD_BITS - 1) /
+                                   PA_BITMAP_WORD_BITS;
+                        image.segment[s].level[level] = pa_snapshot_write(
+                                snapshot, seg->bitmap.level[level],
+                                sizeof(unsigned long long) * nr_words,
+                                sizeof(unsigned long long) * nr_words);
+                }
+        }
+
+        image.flags = store->flags;
+        if (store->flags & IMPROVE_ID_INDEX) {
+                pa_hash_settle(&store->index);
+                image.index_mask = store->index.mask;
+                image.index_entries = store->index.nr_entries;
+                image.index = pa_snapshot_write(
+                        snapshot, store->index.entries,
+                        sizeof(struct pa_hash_entry) * (store->index.mask + 1),
+                        sizeof(struct pa_hash_entry) *
+                                (store->index.mask + 1));
+        }
+        if (!(store->flags & IMPROVE_SECONDARY_INDEX)) {
+                goto out;
+        }
+        pa_hash_settle(&store->email_index);
+        image.email_mask = store->email_index.mask;
+        image.email_entries = store->email_index.nr_entries;
+        image.email_index = pa_snapshot_write(
+                snapshot, store->email_index.entries,
+                sizeof(struct pa_hash_entry) * (store->email_index.mask + 1),
+                sizeof(struct pa_hash_entry) * (store->email_index.mask + 1));
+        image.name_nodes = store->name_index.nr_nodes;
+        image.name_root = store->name_index.root;
+        image.name_free = store->name_index.free_node;
+        image.name_entries = store->name_index.nr_entries;
+        image.name_index = pa_snapshot_write(
+                snapshot, store->name_index.nodes,
+                sizeof(struct pa_sorted_node) * store->name_index.nr_nodes,
+                sizeof(struct pa_sorted_node) * store->name_index.nr_nodes);
+
+out:
+        *offset = pa_snapshot_write(snapshot, &image, sizeof(image),
+                                    sizeof(image));
+        return snapshot->error;
+}
+
+/**
+ * @brief mmap된 snapshot의 section들을 그대로 사용하는 store를 만든다.
+ * @details offset을 포인터로 바꾸기만 하고 행은 읽지 않는다. 이후에 새로
+ 할당되는 segment와 해시 테이블만 malloc된 메모리를 사용한다.
+ *
+ * @param storep 만들어진 store가 저장된다.
+ * @param snapshot mmap된 snapshot
+ * @param offset store가 저장된 section의 offset
+ * @param flags 선택된 backend가 유지하는 인덱스 (저장할 때와 같아야 한다.)
+ * @return int 정상적인 경우에는 0을, section이 잘못되었거나 다른 backend가
+ 저장한 경우 -EINVAL을, 메모리가 부족한 경우 -ENOMEM을 반환한다.
+ */
+static int improve_restore(void **storep, const struct pa_snapshot *snapshot,
+                           unsigned long long offset, unsigned int flags)
+{
+        const struct improve_image *image;
+        const struct improve_image_segment *iseg;
+        struct improve_store *store;
+        struct improve_segment *seg;
+        struct pa_hash_entry *entries = NULL, *email_entries = NULL;
+        struct pa_sorted_node *name_nodes = NULL;
+        size_t nr_rows, nr_words;
+        int s, level;
+
+        image = (const struct improve_image *)pa_snapshot_ptr(
+                snapshot, offset, sizeof(struct improve_image));
+        if (image == NULL || image->nr_segments <= 0 ||
+            image->nr_segments > PA_MAX_SEGMENTS ||
+            (image->index_mask & (image->index_mask + 1)) != 0 ||
+            image->flags != flags) {
+                return -EINVAL;
+        }
+        if (flags & IMPROVE_ID_INDEX) {
+                entries = (struct pa_hash_entry *)pa_snapshot_ptr(
+                        snapshot, image->index,
+                        sizeof(struct pa_hash_entry) *
+                                ((size_t)image->index_mask + 1));
+                if (entries == NULL) {
+                        return -EINVAL;
+                }
+        }
+        if ((flags & IMPROVE_SECONDARY_INDEX) &&
+            ((image->email_mask & (image->email_mask + 1)) != 0 ||
+            image->name_nodes < 0 || image->name_root < -1 ||
+            image->name_root >= image->name_nodes || image->name_free < -1 ||
+            image->name_free >= image->name_nodes)) {
+                return -EINVAL;
+        }
+        if (flags & IMPROVE_SECONDARY_INDEX) {
+                email_entries = (struct pa_hash_entry *)pa_snapshot_ptr(
+                        snapshot, image->email_index,
+                        sizeof(struct pa_hash_entry) *
+                                ((size_t)image->email_mask + 1));
+                name_nodes = (struct pa_sorted_node *)pa_snapshot_ptr(
+                        snapshot, image->name_index,
+                        sizeof(struct pa_sorted_node) *
+                                (size_t)image->name_nodes);
+                if (email_entries == NULL || name_nodes == NULL) {
+                        return -EINVAL;
+                }
+        }
+
+        store = (struct improve_store *)calloc(1, sizeof(struct improve_store));
+        if (store == NULL) {
+                return -ENOMEM;
+        }
+        for (s = 0; s < image->nr_segments; s++) {
+                iseg = &image->segment[s];
+                seg = &store->segment[s];
+                nr_rows = (size_t)PA_SEGMENT_BASE << s;
+                if (iseg->nr_bits != (int)nr_rows || iseg->nr_levels <= 0 ||
+                    iseg->nr_levels > PA_BITMAP_MAX_LEVEL) {
+                        goto exception;
+                }
+                seg->id = (int *)pa_snapshot_ptr(snapshot, iseg->id,
+                                                 sizeof(int) * nr_rows);
+                seg->name = (char(*)[MAX_CHAR_LEN])pa_snapshot_ptr(
+                        snapshot, iseg->name, MAX_CHAR_LEN * nr_rows);
+                seg->bban = (char(*)[MAX_CHAR_LEN])pa_snapshot_ptr(
+                        snapshot, iseg->bban, MAX_CHAR_LEN * nr_rows);
+                seg->email = (char(*)[MAX_CHAR_LEN])pa_snapshot_ptr(
+                        snapshot, iseg->email, MAX_CHAR_LEN * nr_rows);
+                if (seg->id == NULL || seg->name == NULL ||
+                    seg->bban == NULL || seg->email == NULL) {
+                        goto exception;
+                }
+
+                nr_words = nr_rows;
+                for (level = 0; level < iseg->nr_levels; level++) {
+                        nr_words = (nr_words + PA_BITMAP_WORD_BITS - 1) /
+                                   PA_BITMAP_WORD_BITS;
+                        seg->bitmap.level[level] =
+                                (unsigned long long *)pa_snapshot_ptr(
+                                        snapshot, iseg->level[level],
+                                        sizeof(unsigned long long) *
+                                                nr_words);
+                        if (seg->bitmap.level[level] == NULL) {
+                                goto exception;
+                        }
+                }
+                seg->bitmap.nr_levels = iseg->nr_levels;
+                seg->bitmap.nr_bits = iseg->nr_bits;
+                seg->mapped = 1;
+                store->nr_segments++;
+                store->capacity += (int)nr_rows;
+        }
+        if (image->nr_rows < 0 || image->nr_rows > store->capacity ||
+            image->wp < 0 || image->wp > image->nr_rows ||
+            image->nr_live < 0 || image->nr_live > image->nr_rows ||
+            (image->compact_src >= 0 &&
+             (image->compact_dst < 0 ||
+              image->compact_dst >= image->compact_src))) {
+                goto exception;
+        }
+        store->nr_rows = image->nr_rows;
+        store->wp = image->wp;
+        store->full_segments = image->full_segments;
+        store->nr_live = image->nr_live;
+        store->compact_src = (image->compact_src >= 0 ? image->compact_src :
+                                                        -1);
+        store->compact_dst = image->compact_dst;
+        store->flags = flags;
+        /* id filter는 저장하지 않으므로 모든 id가 있을 수 있는 상태에서 다시 센다. */
+        store->id_filter_src = -1;
+        improve_filter_grow(store);
+        if (flags & IMPROVE_ID_INDEX) {
+                pa_hash_attach(&store->index, entries, image->index_mask,
+                               image->index_entries);
+        }
+        if (flags & IMPROVE_SECONDARY_INDEX) {
+                pa_hash_attach(&store->email_index, email_entries,
+                               image->email_mask, image->email_entries);
+                pa_sorted_attach(&store->name_index, name_nodes,
+                                 image->name_nodes, image->name_root,
+                                 image->name_free, image->name_entries,
+                                 improve_name_key, store);
+        }
+
+        *storep = store;
+        return 0;
+
+exception:
+        improve_free(store);
+        return -EINVAL;
+}
+
+/**
+ * @brief bitmap backend가 저장한 snapshot으로 store를 만든다.
+ *
+ * @param storep 만들어진 store가 저장된다.
+ * @param snapshot mmap된 snapshot
+ * @param offset store가 저장된 section의 offset
+ * @return int 정상적인 경우에는 0을, 그렇지 않으면 음수 값을 반환한다.
+ */
+int improve_bitmap_load(void **storep, const struct pa_snapshot *snapshot,
+                        unsigned long long offset)
+{
+        return improve_restore(storep, snapshot, offset, 0);
+}
+
+/**
+ * @brief hashed backend가 저장한 snapshot으로 store를 만든다.
+ *
+ * @param storep 만들어진 store가 저장된다.
+ * @param snapshot mmap된 snapshot
+ * @param offset store가 저장된 section의 offset
+ * @return int 정상적인 경우에는 0을, 그렇지 않으면 음수 값을 반환한다.
+ */
+int improve_hashed_load(void **storep, const struct pa_snapshot *snapshot,
+                        unsigned long long offset)
+{
+        return improve_restore(storep, snapshot, offset, IMPROVE_ID_INDEX);
+}
+
+/**
+ * @brief sorted-array backend가 저장한 snapshot으로 store를 만든다.
+ *
+ * @param storep 만들어진 store가 저장된다.
+ * @param snapshot mmap된 snapshot
+ * @param offset store가 저장된 section의 offset
+ * @return int 정상적인 경우에는 0을, 그렇지 않으면 음수 값을 반환한다.
+ */
+int improve_load(void **storep, const struct pa_snapshot *snapshot,
+                 unsigned long long offset)
+{
+        return improve_restore(storep, snapshot, offset,
+                               IMPROVE_ID_INDEX | IMPROVE_SECONDARY_INDEX);
+}
+
 /**
  * @brief improve에서 설정된 것들을 해제한다.
  *
+ * @param storep 해제하고자 하는 store
  */
-void improve_free(void)
+void improve_free(void *storep)
 {
-        int i;
+        struct improve_store *store = (struct improve_store *)storep;
+        int s;
 
-        free(_id);
-        for (i = 0; i < MAX_ENTRY_SIZE; i++) {
-                free(_name[i]);
-                free(_bban[i]);
-                free(_email[i]);
+        for (s = 0; s < store->nr_segments; s++) {
+                improve_release_segment(&store->segment[s]);
         }
-        free(_name);
-        free(_bban);
-        free(_email);
+        pa_hash_free(&store->index);
+        pa_hash_free(&store->email_index);
+        pa_sorted_free(&store->name_index);
+        free(store->id_filter);
+        free(store->old_id_filter);
+        free(store);
 }
@@ -0,0 +1,236 @@
+/**
+ * @file parallel-input.c
+ * @author 오기준 (kijunking@pusan.ac.kr)
+ * @brief 입력 파일을 mmap해서 복사 없이 명령을 읽어오는 부분을 가진다.
+ * @details 입력 파일 전체를 한 번 mmap하고, 64 바이트 block마다 `,`와 `\n`의
+ 위치를 비트마스크로 만든다. 마스크는 SIMD 비교(AVX2 또는 SSE2, 없으면 scalar)로
+ 한 번에 만들어지고, 이후에는 `__builtin_ctzll`로 다음 구분자를 찾으므로 문자마다
+ `strchr`를 호출하지 않는다. 찾은 field는 mmap된 영역을 가리키는 (ptr, len)
+ 형태로 넘겨주므로 어떤 문자열도 복사하지 않는다.
+ * @date 2020-04-13
+ *
+ */
+#include "parallel.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#define PA_INPUT_BLOCK 64 /**< PA_INPUT_BLOCK < 마스크 하나가 담당하는 바이트 수 */
+
+/**
+ * @brief block 안에서 구분자의 위치를 비트마스크로 만든다.
+ *
+ * @param ptr block의 시작 위치 (PA_INPUT_BLOCK 바이트를 읽을 수 있어야 한다.)
+ * @return unsigned long long i번째 바이트가 `,` 또는 `\n`이면 i번째 비트가 1인 마스크
+ */
+static inline unsigned long long pa_input_mask(const char *ptr)
+{
+#if defined(__AVX2__)
+        const __m256i comma = _mm256_set1_epi8(',');
+        const __m256i newline = _mm256_set1_epi8('\n');
+        __m256i lo = _mm256_loadu_si256((const __m256i *)ptr);
+        __m256i hi = _mm256_loadu_si256((const __m256i *)(ptr + 32));
+        unsigned int mask_lo = (unsigned int)_mm256_movemask_epi8(
+                _mm256_or_si256(_mm256_cmpeq_epi8(lo, comma),
+                                _mm256_cmpeq_epi8(lo, newline)));
+        unsigned int mask_hi = (unsigned int)_mm256_movemask_epi8(
+                _mm256_or_si256(_mm256_cmpeq_epi8(hi, comma),
+                                _mm256_cmpeq_epi8(hi, newline)));
+
+        return ((unsigned long long)mask_hi << 32) | mask_lo;
+#elif defined(__SSE2__)
+        const __m128i comma = _mm_set1_epi8(',');
+        const __m128i newline = _mm_set1_epi8('\n');
+        unsigned long long mask = 0;
+        __m128i chunk;
+        int i;
+
+        for (i = 0; i < PA_INPUT_BLOCK; i += 16) {
+                chunk = _mm_loadu_si128((const __m128i *)(ptr + i));
+                mask |= (unsigned long long)(unsigned int)_mm_movemask_epi8(
+                                _mm_or_si128(_mm_cmpeq_epi8(chunk, comma),
+                                             _mm_cmpeq_epi8(chunk, newline)))
+                        << i;
+        }
+        return mask;
+#else
+        unsigned long long mask = 0;
+        int i;
+
+        for (i = 0; i < PA_INPUT_BLOCK; i++) {
+                if (ptr[i] == ',' || ptr[i] == '\n') {
+                        mask |= 1ULL << i;
+                }
+        }
+        return mask;
+#endif
+}
+
+/**
+ * @brief 파일의 끝에 걸친 block의 마스크를 만든다.
+ *
+ * @param ptr block의 시작 위치
+ * @param len block에서 읽을 수 있는 바이트 수 (PA_INPUT_BLOCK보다 작다.)
+ * @return unsigned long long 구분자의 위치를 가지는 마스크
+ */
+static unsigned long long pa_input_tail_mask(const char *ptr, size_t len)
+{
+        unsigned long long mask = 0;
+        size_t i;
+
+        for (i = 0; i < len; i++) {
+                if (ptr[i] == ',' || ptr[i] == '\n') {
+                        mask |= 1ULL << i;
+                }
+        }
+        return mask;
+}
+
+/**
+ * @brief 다음 block으로 넘어가서 마스크를 만든다.
+ *
+ * @param input 입력 파일
+ * @return int 다음 block이 있으면 1을, 파일의 끝이면 0을 반환한다.
+ */
+static int pa_input_advance(struct pa_input *input)
+{
+        size_t remain;
+
+        input->block += PA_INPUT_BLOCK;
+        if (input->block >= input->size) {
+                return 0;
+        }
+        remain = input->size - input->block;
+        input->mask = (remain >= PA_INPUT_BLOCK ?
+                               pa_input_mask(input->base + input->block) :
+                               pa_input_tail_mask(input->base + input->block,
+                                                  remain));
+        return 1;
+}
+
+/**
+ * @brief 입력 파일을 mmap해서 읽을 준비를 한다.
+ *
+ * @param input 초기화할 입력 파일
+ * @param path 입력 파일의 경로
+ * @return int 정상적인 경우에는 0을, 파일을 열거나 mmap하지 못하면 음수 값을 반환한다.
+ */
+int pa_input_open(struct pa_input *input, const char *path)
+{
+        struct stat st;
+        void *base;
+        int fd, ret = 0;
+
+        input->base = NULL;
+        input->size = 0;
+        fd = open(path, O_RDONLY);
+        if (fd < 0) {
+                return -errno;
+        }
+        if (fstat(fd, &st) < 0) {
+                ret = -errno;
+                goto out;
+        }
+
+        if (st.st_size > 0) {
+                base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE,
+                            fd, 0);
+                if (base == MAP_FAILED) {
+                        ret = -errno;
+                        goto out;
+                }
+                madvise(base, (size_t)st.st_size, MADV_SEQUENTIAL);
+                input->base = (const char *)base;
+                input->size = (size_t)st.st_size;
+        }
+
+        /* 첫 block의 마스크를 만들도록 block을 한 칸 앞에서 시작한다. */
+        input->block = (size_t)0 - PA_INPUT_BLOCK;
+        input->mask = 0;
+        input->start = 0;
+        pa_input_advance(input);
+out:
+        close(fd); /**< mmap은 fd를 닫아도 유지된다. */
+        return ret;
+}
+
+/**
+ * @brief 현재 field를 pos에서 끝내고 행에 추가한다.
+ *
+ * @param input 입력 파일
+ * @param line field가 추가될 행
+ * @param pos field를 끝내는 구분자의 위치
+ */
+static inline void pa_input_push(struct pa_input *input, struct pa_line *line,
+                                 size_t pos)
+{
+        if (line->nr_fields < PA_MAX_FIELDS) {
+                line->field[line->nr_fields].ptr = input->base + input->start;
+                line->field[line->nr_fields].len = (int)(pos - input->start);
+                line->nr_fields++;
+        }
+        input->start = pos + 1;
+}
+
+/**
+ * @brief 다음 행을 읽어서 field들로 나눈다.
+ * @details field는 `,` 또는 `\n`으로 끝나며, PA_MAX_FIELDS를 넘는 field는
+ 무시한다. 채우지 못한 field는 길이가 0인 field가 된다.
+ *
+ * @param input 입력 파일
+ * @param line field가 저장될 행
+ * @return int 행을 읽은 경우에는 1을, 파일의 끝이면 0을 반환한다.
+ */
+int pa_input_next(struct pa_input *input, struct pa_line *line)
+{
+        size_t pos;
+        int i;
+
+        if (input->start >= input->size) {
+                return 0;
+        }
+
+        line->nr_fields = 0;
+        for (;;) {
+                if (input->mask == 0) {
+                        if (!pa_input_advance(input)) {
+                                /* 마지막 행이 `\n`으로 끝나지 않은 경우 */
+                                pa_input_push(input, line, input->size);
+                                break;
+                        }
+                        continue;
+                }
+                pos = input->block + __builtin_ctzll(input->mask);
+                input->mask &= input->mask - 1;
+                pa_input_push(input, line, pos);
+                if (input->base[pos] == '\n') {
+                        break;
+                }
+        }
+
+        for (i = line->nr_fields; i < PA_MAX_FIELDS; i++) {
+                line->field[i].ptr = NULL;
+                line->field[i].len = 0;
+        }
+        return 1;
+}
+
+/**
+ * @brief mmap한 입력 파일을 해제한다.
+ *
+ * @param input 입력 파일
+ */
+void pa_input_close(struct pa_input *input)
+{
+        if (input->base != NULL) {
+                munmap((void *)input->base, input->size);
+        }
+        input->base = NULL;
+        input->size = 0;
+}
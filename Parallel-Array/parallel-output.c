@@ -0,0 +1,407 @@
+/**
+ * @file parallel-output.c
+ * @author 오기준 (kijunking@pusan.ac.kr)
+ * @brief 결과를 버퍼에 모아서 한꺼번에 파일에 쓰는 부분을 가진다.
+ * @details 결과 한 줄마다 `fprintf`를 호출하면 매번 stdio lock을 잡고 format
+ 문자열을 해석하게 된다. 여기서는 정수와 문자열을 직접 큰 버퍼에 복사하고,
+ 버퍼가 가득 차면 `write`로 한 번에 쓴다. 비동기 모드에서는 버퍼를 두 개 두고
+ 하나를 쓰기 thread에 넘긴 뒤 다른 하나를 계속 채우므로 디스크 쓰기를
+ 기다리지 않는다.
+ * @date 2020-04-14
+ *
+ */
+#include "parallel.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+/**
+ * @brief 00부터 99까지의 두 자리 숫자 문자열을 이어 붙인 표이다.
+ *
+ */
+static const char pa_output_digits[] = "00010203040506070809"
+                                       "10111213141516171819"
+                                       "20212223242526272829"
+                                       "30313233343536373839"
+                                       "40414243444546474849"
+                                       "50515253545556575859"
+                                       "60616263646566676869"
+                                       "70717273747576777879"
+                                       "80818283848586878889"
+                                       "90919293949596979899";
+
+/**
+ * @brief 버퍼의 내용을 모두 fd에 쓴다.
+ *
+ * @param fd 쓰고자 하는 파일
+ * @param buf 쓰고자 하는 버퍼
+ * @param len 버퍼의 길이
+ * @return int 정상적인 경우에는 0을, 쓰지 못한 경우 -errno를 반환한다.
+ */
+static int pa_output_write_all(int fd, const char *buf, size_t len)
+{
+        ssize_t ret;
+
+        while (len > 0) {
+                ret = write(fd, buf, len);
+                if (ret < 0) {
+                        if (errno == EINTR) {
+                                continue;
+                        }
+                        return -errno;
+                }
+                buf += ret;
+                len -= (size_t)ret;
+        }
+        return 0;
+}
+
+/**
+ * @brief 넘겨받은 버퍼를 파일에 쓰는 thread이다.
+ *
+ * @param arg 결과를 쓰는 출력
+ * @return void* 항상 NULL을 반환한다.
+ */
+static void *pa_output_writer(void *arg)
+{
+        struct pa_output *out = (struct pa_output *)arg;
+        char *buf;
+        size_t len;
+        int ret;
+
+        pthread_mutex_lock(&out->lock);
+        for (;;) {
+                while (out->pending == NULL && !out->closing) {
+                        pthread_cond_wait(&out->cond, &out->lock);
+                }
+                if (out->pending == NULL) {
+                        break;
+                }
+                buf = out->pending;
+                len = out->pending_len;
+                pthread_mutex_unlock(&out->lock);
+
+                ret = pa_output_write_all(out->fd, buf, len);
+
+                pthread_mutex_lock(&out->lock);
+                if (ret != 0 && out->error == 0) {
+                        out->error = ret;
+                }
+                out->spare = buf;
+                out->pending = NULL;
+                pthread_cond_broadcast(&out->cond);
+        }
+        pthread_mutex_unlock(&out->lock);
+        return NULL;
+}
+
+/**
+ * @brief 출력 파일을 열고 버퍼를 할당한다.
+ *
+ * @param out 초기화할 출력
+ * @param path 출력 파일의 경로
+ * @param async 0이 아니면 쓰기 thread를 만들어서 버퍼를 비동기로 쓴다.
+ * @return int 정상적인 경우에는 0을, 그렇지 않으면 음수 값을 반환한다.
+ */
+int pa_output_open(struct pa_output *out, const char *path, int async)
+{
+        out->buf = out->spare = out->pending = NULL;
+        out->len = out->pending_len = 0;
+        out->async = async;
+        out->closing = 0;
+        out->error = 0;
+
+        out->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (out->fd < 0) {
+                return -errno;
+        }
+
+        out->buf = (char *)malloc(PA_OUTPUT_BUFFER_SIZE);
+        if (async) {
+                out->spare = (char *)malloc(PA_OUTPUT_BUFFER_SIZE);
+        }
+        if (out->buf == NULL || (async && out->spare == NULL)) {
+                goto exception;
+        }
+
+        if (async) {
+                pthread_mutex_init(&out->lock, NULL);
+                pthread_cond_init(&out->cond, NULL);
+                if (pthread_create(&out->thread, NULL, pa_output_writer,
+                                   out)) {
+                        pthread_mutex_destroy(&out->lock);
+                        pthread_cond_destroy(&out->cond);
+                        goto exception;
+                }
+        }
+        return 0;
+
+exception:
+        free(out->buf);
+        free(out->spare);
+        close(out->fd);
+        return -ENOMEM;
+}
+
+/**
+ * @brief 지금까지 모은 결과를 파일에 쓴다.
+ * @details 비동기 모드에서는 이전 버퍼의 쓰기가 끝나기를 기다린 뒤 현재
+ 버퍼를 쓰기 thread에 넘기고, 쓰기가 끝난 버퍼를 이어서 채운다.
+ *
+ * @param out 결과를 쓰는 출력
+ * @return int 정상적인 경우에는 0을, 쓰기에 실패한 적이 있으면 -errno를 반환한다.
+ */
+int pa_output_flush(struct pa_output *out)
+{
+        int ret;
+
+        if (out->len == 0) {
+                return out->error;
+        }
+        if (!out->async) {
+                ret = pa_output_write_all(out->fd, out->buf, out->len);
+                if (ret != 0 && out->error == 0) {
+                        out->error = ret;
+                }
+                out->len = 0;
+                return out->error;
+        }
+
+        pthread_mutex_lock(&out->lock);
+        while (out->pending != NULL) {
+                pthread_cond_wait(&out->cond, &out->lock);
+        }
+        out->pending = out->buf;
+        out->pending_len = out->len;
+        out->buf = out->spare;
+        out->spare = NULL;
+        out->len = 0;
+        ret = out->error;
+        pthread_cond_broadcast(&out->cond);
+        pthread_mutex_unlock(&out->lock);
+        return ret;
+}
+
+/**
+ * @brief 문자열을 버퍼에 추가한다.
+ *
+ * @param out 결과를 쓰는 출력
+ * @param str 추가하고자 하는 문자열
+ * @param len 문자열의 길이
+ */
+void pa_output_mem(struct pa_output *out, const char *str, size_t len)
+{
+        size_t n;
+
+        while (len > 0) {
+                if (out->len == PA_OUTPUT_BUFFER_SIZE) {
+                        pa_output_flush(out);
+                }
+                n = PA_OUTPUT_BUFFER_SIZE - out->len;
+                n = (n < len ? n : len);
+                memcpy(out->buf + out->len, str, n);
+                out->len += n;
+                str += n;
+                len -= n;
+        }
+}
+
+/**
+ * @brief 정수를 10진수 문자열로 바꾸어서 버퍼에 추가한다.
+ * @details 두 자리씩 표를 찾아서 뒤에서부터 채우므로 나눗셈 횟수가 자릿수의
+ 절반이다.
+ *
+ * @param out 결과를 쓰는 출력
+ * @param value 추가하고자 하는 정수
+ */
+void pa_output_int(struct pa_output *out, int value)
+{
+        char temp[12]; /**< temp < 부호와 10자리 숫자를 담을 수 있다. */
+        char *ptr = temp + sizeof(temp);
+        unsigned int v = (value < 0 ? 0U - (unsigned int)value :
+                                      (unsigned int)value);
+        unsigned int i;
+
+        while (v >= 100) {
+                i = (v % 100) * 2;
+                v /= 100;
+                *--ptr = pa_output_digits[i + 1];
+                *--ptr = pa_output_digits[i];
+        }
+        if (v >= 10) {
+                i = v * 2;
+                *--ptr = pa_output_digits[i + 1];
+                *--ptr = pa_output_digits[i];
+        } else {
+                *--ptr = (char)('0' + v);
+        }
+        if (value < 0) {
+                *--ptr = '-';
+        }
+        pa_output_mem(out, ptr, (size_t)(temp + sizeof(temp) - ptr));
+}
+
+/**
+ * @brief `COMMAND\tid\n` 형태의 결과를 추가한다.
+ *
+ * @param out 결과를 쓰는 출력
+ * @param command 명령의 이름
+ * @param id 레코드의 id
+ */
+void pa_output_id(struct pa_output *out, const char *command, int id)
+{
+        pa_output_str(out, command);
+        pa_output_char(out, '\t');
+        pa_output_int(out, id);
+        pa_output_char(out, '\n');
+}
+
+/**
+ * @brief `id\tname\tbban\temail\n` 형태의 레코드를 추가한다.
+ *
+ * @param out 결과를 쓰는 출력
+ * @param id 레코드의 id
+ * @param name 레코드의 name
+ * @param bban 레코드의 bban
+ * @param email 레코드의 email
+ */
+static void pa_output_row(struct pa_output *out, int id, const char *name,
+                          const char *bban, const char *email)
+{
+        pa_output_int(out, id);
+        pa_output_char(out, '\t');
+        pa_output_str(out, name);
+        pa_output_char(out, '\t');
+        pa_output_str(out, bban);
+        pa_output_char(out, '\t');
+        pa_output_str(out, email);
+        pa_output_char(out, '\n');
+}
+
+/**
+ * @brief `COMMAND\tid\tname\tbban\temail\n` 형태의 결과를 추가한다.
+ *
+ * @param out 결과를 쓰는 출력
+ * @param command 명령의 이름
+ * @param id 레코드의 id
+ * @param name 레코드의 name
+ * @param bban 레코드의 bban
+ * @param email 레코드의 email
+ */
+void pa_output_record(struct pa_output *out, const char *command, int id,
+                      const char *name, const char *bban, const char *email)
+{
+        pa_output_str(out, command);
+        pa_output_char(out, '\t');
+        pa_output_row(out, id, name, bban, email);
+}
+
+/**
+ * @brief shard들이 고른 레코드를 (id, order) 순서로 한 행씩 추가한다.
+ * @details shard마다 정렬되어 있으므로 각 selection의 맨 앞 레코드 중 가장
+ 앞서는 것을 차례로 꺼낸다. selection의 수는 shard의 수를 넘지 않는다.
+ *
+ * @param out 결과를 쓰는 출력
+ * @param selection 이어진 selection들 (NULL이면 아무것도 추가하지 않는다.)
+ */
+void pa_output_selection(struct pa_output *out,
+                         const struct pa_selection *selection)
+{
+        const struct pa_selection *part[PA_MAX_SHARDS];
+        const struct pa_record *record;
+        int pos[PA_MAX_SHARDS];
+        int i, best, nr_parts = 0;
+
+        for (; selection != NULL && nr_parts < PA_MAX_SHARDS;
+             selection = selection->next) {
+                if (selection->nr_records > 0) {
+                        part[nr_parts] = selection;
+                        pos[nr_parts++] = 0;
+                }
+        }
+        for (;;) {
+                best = -1;
+                for (i = 0; i < nr_parts; i++) {
+                        if (pos[i] < part[i]->nr_records &&
+                            (best < 0 ||
+                             pa_record_precede(&part[i]->record[pos[i]],
+                                               &part[best]->record[pos[best]]))) {
+                                best = i;
+                        }
+                }
+                if (best < 0) {
+                        break;
+                }
+                record = &part[best]->record[pos[best]++];
+                pa_output_row(out, record->id, record->name, record->bban,
+                              record->email);
+        }
+}
+
+/**
+ * @brief 명령의 결과를 형식에 맞추어서 추가한다.
+ *
+ * @param out 결과를 쓰는 출력
+ * @param type 명령의 종류
+ * @param result 명령을 수행한 결과
+ */
+void pa_output_result(struct pa_output *out, enum pa_command_type type,
+                      const struct pa_result *result)
+{
+        static const char *const command[] = {
+                [PA_CMD_INSERT] = "INSERT",
+                [PA_CMD_SEARCH] = "SEARCH",
+                [PA_CMD_REMOVE] = "REMOVE",
+                [PA_CMD_SEARCH_EMAIL] = "SEARCH_EMAIL",
+                [PA_CMD_SEARCH_NAME_PREFIX] = "SEARCH_NAME_PREFIX",
+                [PA_CMD_SCAN_COUNT] = "SCAN_COUNT",
+                [PA_CMD_SCAN_SELECT] = "SCAN_SELECT",
+                [PA_CMD_OTHERS] = "OTHERS",
+        };
+
+        if (type == PA_CMD_OTHERS || result->status != 0) {
+                pa_output_str(out, command[type]);
+                pa_output_str(out, " <FAIL>\n");
+        } else if (type == PA_CMD_SCAN_COUNT || type == PA_CMD_SCAN_SELECT) {
+                /* SCAN_SELECT는 고른 행의 수 뒤에 레코드를 한 행씩 쓴다. */
+                pa_output_id(out, command[type], result->count);
+                if (type == PA_CMD_SCAN_SELECT) {
+                        pa_output_selection(out, result->selection);
+                }
+        } else if (result->has_record) {
+                pa_output_record(out, command[type], result->id, result->name,
+                                 result->bban, result->email);
+        } else {
+                pa_output_id(out, command[type], result->id);
+        }
+}
+
+/**
+ * @brief 남은 결과를 모두 쓰고 출력을 닫는다.
+ *
+ * @param out 결과를 쓰는 출력
+ * @return int 정상적인 경우에는 0을, 쓰기에 실패한 적이 있으면 -errno를 반환한다.
+ */
+int pa_output_close(struct pa_output *out)
+{
+        int ret;
+
+        pa_output_flush(out);
+        if (out->async) {
+                pthread_mutex_lock(&out->lock);
+                out->closing = 1;
+                pthread_cond_broadcast(&out->cond);
+                pthread_mutex_unlock(&out->lock);
+                pthread_join(out->thread, NULL);
+                pthread_mutex_destroy(&out->lock);
+                pthread_cond_destroy(&out->cond);
+        }
+        ret = out->error;
+        free(out->buf);
+        free(out->spare);
+        out->buf = out->spare = NULL;
+        if (close(out->fd) < 0 && ret == 0) {
+                ret = -errno;
+        }
+        return ret;
+}
@@ -0,0 +1,622 @@
+/**
+ * @file parallel-pipeline.c
+ * @author 오기준 (kijunking@pusan.ac.kr)
+ * @brief 입력 해석, 명령 수행, 결과 출력을 나누어서 동시에 진행하는 부분을 가진다.
+ * @details 해석 thread는 입력 파일을 field로 나누고 명령의 종류와 수행할
+ shard를 정해서 batch에 담고, shard마다 그 shard가 수행할 명령의 위치만 모은
+ shard별 batch를 만든다. 각 shard는 자신만의 PA(store)를 가지는 수행 thread
+ 하나가 맡으며, 같은 id의 명령은 항상 같은 shard로 가므로 store마다 lock이
+ 필요 없다. 수행 thread는 명령이 있는 shard별 batch만 받으므로 자신의 명령 수에
+ 비례하는 일만 한다. 출력 thread는 batch를 해석된 순서대로 받아서 명령을 받은
+ shard들이 끝내기를 기다린 뒤 결과를 형식에 맞추어 쓴다. 단계 사이에는 batch를
+ 가리키는 포인터를 단일 생산자/단일 소비자 ring으로 주고받으며, 다 쓴 batch는
+ 다시 해석 thread로 돌아간다.
+
+ 한 id에 대한 명령은 한 shard에서 입력 순서대로 수행되고 출력은 입력 순서로
+ 다시 맞추어지므로, 결과는 하나의 PA에서 순차적으로 수행했을 때와 같다.
+ email이나 name으로 찾는 명령은 id를 모르므로 모든 shard가 수행하고, 출력
+ thread가 각 shard가 찾은 레코드 중 정해진 순서로 가장 앞선 것을 결과로 합친다.
+ * @date 2020-04-15
+ *
+ */
+#include "parallel.h"
+
+#include <sched.h>
+#include <unistd.h>
+
+/**
+ * @brief pipeline의 단계들이 공유하는 정보이다.
+ *
+ */
+struct pa_pipeline {
+        struct pa_ring work[PA_MAX_SHARDS]; /**< work < 해석 -> shard별 수행 */
+        struct pa_ring parsed; /**< parsed < 해석 -> 출력 (입력 순서) */
+        struct pa_ring recycled; /**< recycled < 출력 -> 해석 */
+        struct pa_batch *batches;
+        struct pa_shard_batch *parts; /**< parts < batch마다 nr_shards개의 shard별 batch */
+
+        struct pa_input *input;
+        int nr_commands;
+        const struct op *operation;
+        void **stores;
+        int nr_shards;
+        struct pa_output *output;
+        clock_t start;
+        struct pa_stats *stats; /**< stats < 명령별 지연 시간을 모을 곳 (모으지 않으면 NULL) */
+};
+
+/**
+ * @brief 수행 thread가 pipeline과 자신이 맡은 shard를 가진다.
+ *
+ */
+struct pa_worker {
+        struct pa_pipeline *pipeline;
+        int shard;
+        pthread_t thread;
+};
+
+/**
+ * @brief 시스템의 CPU 수를 가져온다.
+ *
+ * @return int 사용할 수 있는 CPU 수 (알 수 없으면 1)
+ */
+int pa_pipeline_nr_cpus(void)
+{
+        long nr_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        return (nr_cpus > 0 ? (int)nr_cpus : 1);
+}
+
+/**
+ * @brief 지연 시간을 재기 위한 현재 시각을 가져온다.
+ *
+ * @return unsigned long long 단조 증가하는 시각(ns)
+ */
+static inline unsigned long long pa_pipeline_now(void)
+{
+        struct timespec now;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return (unsigned long long)now.tv_sec * 1000000000ULL +
+               (unsigned long long)now.tv_nsec;
+}
+
+/**
+ * @brief COMMAND field를 명령의 종류로 바꾼다.
+ *
+ * @param field COMMAND field
+ * @return enum pa_command_type 명령의 종류
+ */
+static enum pa_command_type pa_pipeline_decode(const struct pa_field *field)
+{
+        if (pa_field_equal(field, "INSERT")) {
+                return PA_CMD_INSERT;
+        } else if (pa_field_equal(field, "SEARCH")) {
+                return PA_CMD_SEARCH;
+        } else if (pa_field_equal(field, "REMOVE")) {
+                return PA_CMD_REMOVE;
+        } else if (pa_field_equal(field, "SEARCH_EMAIL")) {
+                return PA_CMD_SEARCH_EMAIL;
+        } else if (pa_field_equal(field, "SEARCH_NAME_PREFIX")) {
+                return PA_CMD_SEARCH_NAME_PREFIX;
+        } else if (pa_field_equal(field, "SCAN_COUNT")) {
+                return PA_CMD_SCAN_COUNT;
+        } else if (pa_field_equal(field, "SCAN_SELECT")) {
+                return PA_CMD_SCAN_SELECT;
+        }
+        return PA_CMD_OTHERS;
+}
+
+/**
+ * @brief 명령을 수행할 shard를 정한다.
+ * @details 해시 값의 상위 비트로 shard를 고른다(`h * n >> 32`). shard 안의
+ 해시 인덱스는 하위 비트로 bucket을 고르므로, `h % n`을 사용할 때와 달리 한
+ shard의 id들이 특정 bucket에 몰리지 않는다.
+ *
+ * @param command 해석된 명령
+ * @param nr_shards shard의 수
+ * @return int 명령을 수행할 shard로 수행할 필요가 없으면 -1을, 모든 shard가
+ 수행해야 하면 PA_SHARD_ALL을 반환한다.
+ */
+static int pa_pipeline_route(const struct pa_command *command, int nr_shards)
+{
+        unsigned int h;
+
+        switch (command->type) {
+        case PA_CMD_OTHERS:
+                return -1;
+        case PA_CMD_SEARCH_EMAIL:
+        case PA_CMD_SEARCH_NAME_PREFIX:
+        case PA_CMD_SCAN_COUNT:
+        case PA_CMD_SCAN_SELECT:
+                return PA_SHARD_ALL;
+        default:
+                break;
+        }
+        h = pa_hash_mix(pa_field_atoi(&command->line.field[1]));
+        return (int)(((unsigned long long)h * nr_shards) >> 32);
+}
+
+/**
+ * @brief 모든 shard의 결과를 더하는 SCAN 명령인지 확인한다.
+ *
+ * @param type 명령의 종류
+ * @return int SCAN 명령이면 1을, 그렇지 않으면 0을 반환한다.
+ */
+static inline int pa_pipeline_scan(enum pa_command_type type)
+{
+        return type == PA_CMD_SCAN_COUNT || type == PA_CMD_SCAN_SELECT;
+}
+
+/**
+ * @brief 해석한 명령을 수행할 shard의 batch에 넣는다.
+ * @details 모든 shard가 수행하는 명령은 모든 shard의 batch에 넣고, 각 shard의
+ 결과를 둘 위치를 정한다.
+ *
+ * @param pipeline pipeline
+ * @param batch 명령이 속한 batch
+ * @param command 넣고자 하는 명령 (batch->nr_commands번째)
+ */
+static void pa_pipeline_assign(struct pa_pipeline *pipeline,
+                               struct pa_batch *batch,
+                               struct pa_command *command)
+{
+        struct pa_shard_batch *part;
+        int shard;
+
+        if (command->shard >= 0) {
+                part = &batch->shard[command->shard];
+                part->index[part->nr_commands++] =
+                        (unsigned short)batch->nr_commands;
+                return;
+        }
+        if (command->shard != PA_SHARD_ALL) {
+                return;
+        }
+        command->gather = batch->nr_gathers++;
+        for (shard = 0; shard < pipeline->nr_shards; shard++) {
+                part = &batch->shard[shard];
+                part->index[part->nr_commands++] =
+                        (unsigned short)batch->nr_commands;
+        }
+}
+
+/**
+ * @brief 입력 파일을 해석해서 batch를 채우는 thread이다.
+ *
+ * @param arg pipeline
+ * @return void* 항상 NULL을 반환한다.
+ */
+static void *pa_pipeline_parse(void *arg)
+{
+        struct pa_pipeline *pipeline = (struct pa_pipeline *)arg;
+        struct pa_batch *batch;
+        struct pa_command *command;
+        struct pa_shard_batch *part;
+        int i = 0, last = 0, shard;
+
+        while (!last) {
+                batch = (struct pa_batch *)pa_ring_pop(&pipeline->recycled);
+                batch->nr_commands = 0;
+                batch->nr_gathers = 0;
+                for (shard = 0; shard < pipeline->nr_shards; shard++) {
+                        batch->shard[shard].nr_commands = 0;
+                }
+                while (batch->nr_commands < PA_BATCH_SIZE &&
+                       batch->nr_gathers < PA_BATCH_GATHER) {
+                        command = &batch->command[batch->nr_commands];
+                        if (i == pipeline->nr_commands ||
+                            !pa_input_next(pipeline->input, &command->line)) {
+                                last = 1;
+                                break;
+                        }
+                        command->type =
+                                pa_pipeline_decode(&command->line.field[0]);
+                        command->shard = pa_pipeline_route(
+                                command, pipeline->nr_shards);
+                        /* SEARCH_*는 어떤 shard도 찾지 못하면 실패로 남고,
+                           SCAN_*은 shard들의 결과를 더해 간다. */
+                        command->result.status =
+                                (command->shard == PA_SHARD_ALL &&
+                                                 !pa_pipeline_scan(
+                                                         command->type) ?
+                                         -ENOENT :
+                                         0);
+                        command->result.has_record = 0;
+                        command->result.count = 0;
+                        command->result.selection = NULL;
+                        command->latency = 0;
+                        pa_pipeline_assign(pipeline, batch, command);
+                        batch->nr_commands++;
+                        i++;
+                }
+                batch->last = last;
+                for (shard = 0; shard < pipeline->nr_shards; shard++) {
+                        part = &batch->shard[shard];
+                        /* 명령이 없는 shard는 마지막 batch만 받는다. */
+                        if (part->nr_commands == 0 && !last) {
+                                atomic_store_explicit(&part->done, 1,
+                                                      memory_order_relaxed);
+                                continue;
+                        }
+                        atomic_store_explicit(&part->done, 0,
+                                              memory_order_relaxed);
+                        pa_ring_push(&pipeline->work[shard], part);
+                }
+                pa_ring_push(&pipeline->parsed, batch);
+        }
+        return NULL;
+}
+
+/**
+ * @brief 명령 하나를 PA에 적용한다.
+ *
+ * @param operation trivial, improve 중 선택된 함수들
+ * @param store 명령을 적용할 store
+ * @param type 명령의 종류
+ * @param line 명령의 field들
+ * @param result 명령을 수행한 결과가 저장된다.
+ */
+static void pa_pipeline_execute(const struct op *operation, void *store,
+                                enum pa_command_type type,
+                                const struct pa_line *line,
+                                struct pa_result *result)
+{
+        int (*fn)(void *, const struct pa_line *, struct pa_result *) = NULL;
+
+        result->status = 0;
+        result->has_record = 0;
+        switch (type) {
+        case PA_CMD_INSERT:
+                fn = operation->insert;
+                break;
+        case PA_CMD_SEARCH:
+                fn = operation->search;
+                break;
+        case PA_CMD_REMOVE:
+                fn = operation->remove;
+                break;
+        case PA_CMD_SEARCH_EMAIL:
+                fn = operation->search_email;
+                break;
+        case PA_CMD_SEARCH_NAME_PREFIX:
+                fn = operation->search_name_prefix;
+                break;
+        case PA_CMD_SCAN_COUNT:
+                fn = operation->scan_count;
+                break;
+        case PA_CMD_SCAN_SELECT:
+                fn = operation->scan_select;
+                break;
+        default:
+#ifdef DEBUG
+                fprintf(stderr, "[%s:%s(%d)] invalid command detected",
+                        __FILE__, __FUNCTION__, __LINE__);
+#endif
+                return;
+        }
+        result->status = (fn != NULL ? fn(store, line, result) : -EOPNOTSUPP);
+}
+
+/**
+ * @brief 두 shard가 찾은 레코드 중 앞서는 것을 고른다.
+ * @details email은 id가, name prefix는 (name, id)가 작은 레코드가 앞선다.
+ 같은 id는 한 shard에만 있으므로 shard의 수와 관계없이 같은 레코드가 선택된다.
+ *
+ * @param type 명령의 종류
+ * @param a 비교하고자 하는 결과
+ * @param b 비교하고자 하는 결과
+ * @return int a가 앞서면 1을, 그렇지 않으면 0을 반환한다.
+ */
+static int pa_pipeline_precede(enum pa_command_type type,
+                               const struct pa_result *a,
+                               const struct pa_result *b)
+{
+        int cmp;
+
+        if (type == PA_CMD_SEARCH_NAME_PREFIX) {
+                cmp = strcmp(a->name, b->name);
+                if (cmp != 0) {
+                        return cmp < 0;
+                }
+        }
+        return a->id < b->id;
+}
+
+/**
+ * @brief 모든 shard가 수행한 명령의 결과를 합친다.
+ * @details SEARCH_*는 앞서는 레코드 하나를 고르고, SCAN_*은 행의 수를 더하고
+ 고른 레코드를 shard별로 이어 두기만 한다. 레코드의 순서는 출력할 때 맞춘다.
+ 지연 시간은 가장 늦게 끝난 shard의 값을 사용한다.
+ *
+ * @param pipeline pipeline
+ * @param batch 명령이 속한 batch
+ * @param command 합칠 명령으로 합친 결과가 저장된다.
+ */
+static void pa_pipeline_merge(struct pa_pipeline *pipeline,
+                              struct pa_batch *batch,
+                              struct pa_command *command)
+{
+        struct pa_shard_batch *part;
+        struct pa_result *result;
+        int shard;
+
+        for (shard = 0; shard < pipeline->nr_shards; shard++) {
+                part = &batch->shard[shard];
+                result = &part->gathered[command->gather];
+                if (pa_pipeline_scan(command->type)) {
+                        /* 어느 shard라도 실패하면 명령 전체가 실패한다. */
+                        if (result->status != 0) {
+                                command->result.status = result->status;
+                        }
+                        command->result.count += result->count;
+                        if (result->selection != NULL) {
+                                result->selection->next =
+                                        command->result.selection;
+                                command->result.selection = result->selection;
+                        }
+                } else if (result->status == 0 &&
+                           (command->result.status != 0 ||
+                            pa_pipeline_precede(command->type, result,
+                                                &command->result))) {
+                        command->result = *result;
+                }
+                if (command->latency < part->latency[command->gather]) {
+                        command->latency = part->latency[command->gather];
+                }
+        }
+}
+
+/**
+ * @brief shard 하나에 속한 명령들을 수행하는 thread이다.
+ * @details 모든 shard가 수행하는 명령의 결과는 shard별 batch의 gathered에
+ 쓰므로 수행 thread들이 같은 결과를 쓰지 않는다. done을 설정한 뒤에는 출력
+ thread가 batch를 다시 쓸 수 있으므로 batch에 접근하지 않는다.
+ *
+ * @param arg 수행 thread의 정보
+ * @return void* 항상 NULL을 반환한다.
+ */
+static void *pa_pipeline_work(void *arg)
+{
+        struct pa_worker *worker = (struct pa_worker *)arg;
+        struct pa_pipeline *pipeline = worker->pipeline;
+        void *store = pipeline->stores[worker->shard];
+        struct pa_shard_batch *part;
+        struct pa_command *command;
+        struct pa_result *result;
+        unsigned int *latency;
+        unsigned long long begin = 0;
+        int i, last = 0, timed = (pipeline->stats != NULL);
+#ifdef DEBUG
+        int max = -1;
+#endif
+
+        while (!last) {
+                part = (struct pa_shard_batch *)pa_ring_pop(
+                        &pipeline->work[worker->shard]);
+                for (i = 0; i < part->nr_commands; i++) {
+                        command = &part->batch->command[part->index[i]];
+                        if (command->shard == PA_SHARD_ALL) {
+                                result = &part->gathered[command->gather];
+                                latency = &part->latency[command->gather];
+                                result->count = 0;
+                                result->selection = NULL;
+                                *latency = 0;
+                        } else {
+                                result = &command->result;
+                                latency = &command->latency;
+                        }
+                        if (timed) {
+                                begin = pa_pipeline_now();
+                        }
+                        pa_pipeline_execute(pipeline->operation, store,
+                                            command->type, &command->line,
+                                            result);
+                        if (timed) {
+                                *latency = (unsigned int)(pa_pipeline_now() -
+                                                          begin);
+                        }
+#ifdef DEBUG
+                        if (max < pipeline->operation->get_current_usage(
+                                          store)) {
+                                max = pipeline->operation->get_current_usage(
+                                        store);
+                                printf("max usage(shard %d): %d\n",
+                                       worker->shard, max);
+                        }
+#endif
+                }
+                last = part->batch->last;
+                atomic_store_explicit(&part->done, 1, memory_order_release);
+        }
+        return NULL;
+}
+
+/**
+ * @brief 수행한 결과를 입력 순서대로 출력하는 thread이다.
+ *
+ * @param arg pipeline
+ * @return void* 항상 NULL을 반환한다.
+ */
+static void *pa_pipeline_emit(void *arg)
+{
+        struct pa_pipeline *pipeline = (struct pa_pipeline *)arg;
+        struct pa_batch *batch;
+        struct pa_command *command;
+        const int _10_percent = (pipeline->nr_commands / 10 > 0 ?
+                                         pipeline->nr_commands / 10 :
+                                         1);
+        int i, n = 0, last = 0, shard;
+
+        while (!last) {
+                batch = (struct pa_batch *)pa_ring_pop(&pipeline->parsed);
+                for (shard = 0; shard < pipeline->nr_shards; shard++) {
+                        while (atomic_load_explicit(&batch->shard[shard].done,
+                                                    memory_order_acquire) ==
+                               0) {
+                                sched_yield();
+                        }
+                }
+                for (i = 0; i < batch->nr_commands; i++, n++) {
+                        if (n % _10_percent == 0) {
+                                printf("[%s:%s(%d)] %.2lf%% done (%.2lfs)\n",
+                                       __FILE__, __FUNCTION__, __LINE__,
+                                       (double)n / pipeline->nr_commands * 100,
+                                       (double)(clock() - pipeline->start) /
+                                               CLOCKS_PER_SEC);
+                        }
+                        command = &batch->command[i];
+                        if (command->shard == PA_SHARD_ALL) {
+                                pa_pipeline_merge(pipeline, batch, command);
+                        }
+                        pa_output_result(pipeline->output, command->type,
+                                         &command->result);
+                        pa_selection_free(command->result.selection);
+                        if (pipeline->stats != NULL &&
+                            n < pipeline->stats->capacity) {
+                                pipeline->stats->latency[n] = command->latency;
+                        }
+                }
+                last = batch->last;
+                pa_ring_push(&pipeline->recycled, batch);
+        }
+        if (pipeline->stats != NULL) {
+                pipeline->stats->nr_commands = n;
+        }
+        return NULL;
+}
+
+/**
+ * @brief 해석 thread를 대신해서 빈 마지막 batch를 넣어 다른 thread들을 끝낸다.
+ *
+ * @param pipeline pipeline
+ * @param has_emitter 출력 thread가 실행 중이면 1
+ */
+static void pa_pipeline_stop(struct pa_pipeline *pipeline, int has_emitter)
+{
+        struct pa_batch *batch;
+        int shard;
+
+        batch = (struct pa_batch *)pa_ring_pop(&pipeline->recycled);
+        batch->nr_commands = 0;
+        batch->nr_gathers = 0;
+        batch->last = 1;
+        for (shard = 0; shard < pipeline->nr_shards; shard++) {
+                batch->shard[shard].nr_commands = 0;
+                atomic_store_explicit(&batch->shard[shard].done, 0,
+                                      memory_order_relaxed);
+                pa_ring_push(&pipeline->work[shard], &batch->shard[shard]);
+        }
+        if (has_emitter) {
+                pa_ring_push(&pipeline->parsed, batch);
+        }
+}
+
+/**
+ * @brief 해석, 수행, 출력 thread를 띄우고 모든 명령을 수행한다.
+ * @details 호출한 thread는 0번 shard를 맡는다. 수행 thread를 만들지 못하면
+ 그때까지 만든 수만큼의 shard로 수행한다.
+ *
+ * @param input mmap된 입력 파일 (첫 행은 이미 읽은 상태)
+ * @param nr_commands 수행할 명령의 수
+ * @param operation trivial, improve 중 선택된 함수들
+ * @param stores shard별 store
+ * @param nr_shards shard의 수 (1 이상 PA_MAX_SHARDS 이하)
+ * @param output 결과를 쓰는 출력
+ * @param start 진행 상황을 출력할 때 사용하는 시작 시각
+ * @param stats 명령별 지연 시간과 전체 수행 시간을 모을 곳 (NULL이면 재지 않는다)
+ * @return int 정상적인 경우에는 0을, 그렇지 않으면 음수 값을 반환한다.
+ */
+int pa_pipeline_run(struct pa_input *input, int nr_commands,
+                    const struct op *operation, void **stores, int nr_shards,
+                    struct pa_output *output, clock_t start,
+                    struct pa_stats *stats)
+{
+        struct pa_pipeline pipeline = { .input = input,
+                                        .nr_commands = nr_commands,
+                                        .operation = operation,
+                                        .stores = stores,
+                                        .output = output,
+                                        .start = start,
+                                        .stats = stats };
+        unsigned long long begin = pa_pipeline_now();
+        struct pa_worker worker[PA_MAX_SHARDS];
+        pthread_t parser, emitter;
+        int i, nr_rings = 0, ret = -ENOMEM;
+
+        pipeline.batches = (struct pa_batch *)aligned_alloc(
+                64, sizeof(struct pa_batch) * PA_NR_BATCHES);
+        if (pipeline.batches == NULL) {
+                return -ENOMEM;
+        }
+        pipeline.parts = (struct pa_shard_batch *)aligned_alloc(
+                64, sizeof(struct pa_shard_batch) * PA_NR_BATCHES * nr_shards);
+        if (pipeline.parts == NULL) {
+                goto free_batches;
+        }
+        if (pa_ring_init(&pipeline.parsed, PA_NR_BATCHES)) {
+                goto free_parts;
+        }
+        if (pa_ring_init(&pipeline.recycled, PA_NR_BATCHES)) {
+                goto free_parsed;
+        }
+        for (nr_rings = 0; nr_rings < nr_shards; nr_rings++) {
+                if (pa_ring_init(&pipeline.work[nr_rings], PA_NR_BATCHES)) {
+                        goto free_rings;
+                }
+        }
+        for (i = 0; i < PA_NR_BATCHES * nr_shards; i++) {
+                pipeline.parts[i].batch = &pipeline.batches[i / nr_shards];
+        }
+        for (i = 0; i < PA_NR_BATCHES; i++) {
+                pipeline.batches[i].shard = &pipeline.parts[i * nr_shards];
+                pa_ring_push(&pipeline.recycled, &pipeline.batches[i]);
+        }
+
+        pipeline.nr_shards = 1;
+        for (i = 0; i < nr_shards; i++) {
+                worker[i].pipeline = &pipeline;
+                worker[i].shard = i;
+                if (i > 0 && pthread_create(&worker[i].thread, NULL,
+                                            pa_pipeline_work, &worker[i])) {
+                        break;
+                }
+                pipeline.nr_shards = i + 1;
+        }
+
+        if (pthread_create(&emitter, NULL, pa_pipeline_emit, &pipeline)) {
+                pa_pipeline_stop(&pipeline, 0);
+                pa_pipeline_work(&worker[0]);
+                goto join_workers;
+        }
+        if (pthread_create(&parser, NULL, pa_pipeline_parse, &pipeline)) {
+                pa_pipeline_stop(&pipeline, 1);
+                pa_pipeline_work(&worker[0]);
+                pthread_join(emitter, NULL);
+                goto join_workers;
+        }
+
+        pa_pipeline_work(&worker[0]);
+        pthread_join(parser, NULL);
+        pthread_join(emitter, NULL);
+        if (stats != NULL) {
+                stats->elapsed = (double)(pa_pipeline_now() - begin) / 1e9;
+        }
+        ret = 0;
+
+join_workers:
+        for (i = 1; i < pipeline.nr_shards; i++) {
+                pthread_join(worker[i].thread, NULL);
+        }
+free_rings:
+        for (i = 0; i < nr_rings; i++) {
+                pa_ring_free(&pipeline.work[i]);
+        }
+        pa_ring_free(&pipeline.recycled);
+free_parsed:
+        pa_ring_free(&pipeline.parsed);
+free_parts:
+        free(pipeline.parts);
+free_batches:
+        free(pipeline.batches);
+        return ret;
+}
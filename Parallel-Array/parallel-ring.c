@@ -0,0 +1,106 @@
+/**
+ * @file parallel-ring.c
+ * @author 오기준 (kijunking@pusan.ac.kr)
+ * @brief pipeline의 단계를 잇는 단일 생산자/단일 소비자 ring을 가진다.
+ * @details 생산자만 tail을, 소비자만 head를 쓰므로 lock 없이 release/acquire
+ 순서만으로 slot의 내용이 상대 thread에 보이도록 할 수 있다. ring이 가득
+ 차거나 비어 있으면 잠시 spin한 뒤 CPU를 양보한다.
+ * @date 2020-04-15
+ *
+ */
+#include "parallel.h"
+
+#include <sched.h>
+
+#define PA_RING_SPIN 128 /**< PA_RING_SPIN < CPU를 양보하기 전에 spin하는 횟수 */
+
+/**
+ * @brief ring을 초기화한다.
+ *
+ * @param ring 초기화할 ring
+ * @param size slot의 수 (2의 거듭제곱)
+ * @return int 정상적인 경우에는 0을, 그렇지 않으면 음수 값을 반환한다.
+ */
+int pa_ring_init(struct pa_ring *ring, unsigned int size)
+{
+        if (size == 0 || (size & (size - 1)) != 0) {
+                return -EINVAL;
+        }
+        ring->slot = (void **)malloc(sizeof(void *) * size);
+        if (ring->slot == NULL) {
+                return -ENOMEM;
+        }
+        ring->mask = size - 1;
+        atomic_init(&ring->head, 0);
+        atomic_init(&ring->tail, 0);
+        return 0;
+}
+
+/**
+ * @brief 상대 thread를 기다린다.
+ *
+ * @param spins 지금까지 기다린 횟수
+ */
+static inline void pa_ring_wait(int *spins)
+{
+        if (++(*spins) > PA_RING_SPIN) {
+                sched_yield();
+        }
+}
+
+/**
+ * @brief ring에 포인터를 넣는다. ring이 가득 차 있으면 빈 slot이 생길 때까지
+ 기다린다.
+ * @warning 한 ring에 대해서 하나의 thread만 호출해야 한다.
+ *
+ * @param ring 넣고자 하는 ring
+ * @param ptr 넣고자 하는 포인터
+ */
+void pa_ring_push(struct pa_ring *ring, void *ptr)
+{
+        unsigned int tail =
+                atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        int spins = 0;
+
+        while (tail - atomic_load_explicit(&ring->head,
+                                           memory_order_acquire) >
+               ring->mask) {
+                pa_ring_wait(&spins);
+        }
+        ring->slot[tail & ring->mask] = ptr;
+        atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
+
+/**
+ * @brief ring에서 포인터를 꺼낸다. ring이 비어 있으면 들어올 때까지 기다린다.
+ * @warning 한 ring에 대해서 하나의 thread만 호출해야 한다.
+ *
+ * @param ring 꺼내고자 하는 ring
+ * @return void* 꺼낸 포인터
+ */
+void *pa_ring_pop(struct pa_ring *ring)
+{
+        unsigned int head =
+                atomic_load_explicit(&ring->head, memory_order_relaxed);
+        void *ptr;
+        int spins = 0;
+
+        while (atomic_load_explicit(&ring->tail, memory_order_acquire) ==
+               head) {
+                pa_ring_wait(&spins);
+        }
+        ptr = ring->slot[head & ring->mask];
+        atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+        return ptr;
+}
+
+/**
+ * @brief ring에서 사용한 메모리를 해제한다.
+ *
+ * @param ring 해제할 ring
+ */
+void pa_ring_free(struct pa_ring *ring)
+{
+        free(ring->slot);
+        ring->slot = NULL;
+}
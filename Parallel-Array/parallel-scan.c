@@ -0,0 +1,417 @@
+/**
+ * @file parallel-scan.c
+ * @author 오기준 (kijunking@pusan.ac.kr)
+ * @brief column을 순서대로 읽으면서 조건을 만족하는 행을 고르는 부분을 가진다.
+ * @details 조건(predicate)은 id 범위, email domain, name prefix 중 하나이다.
+ PA의 column은 행마다 고정 길이로 연속되어 있으므로 64개의 행을 한 block으로
+ 보고, SIMD 비교(AVX2 또는 SSE2, 없으면 scalar)로 block의 결과를 64 비트 선택
+ 마스크로 만든다. 마스크는 비트맵의 word와 같은 단위이므로 사용 중인 행의
+ word와 AND하기만 하면 지워진 행이 걸러진다.
+ * @date 2020-04-19
+ *
+ */
+#include "parallel.h"
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/**
+ * @brief email이 domain으로 끝나는지 확인한다.
+ * @details domain 앞의 문자는 `@` 또는 `.`이어야 하므로 `ac.kr`은
+ `kim@pusan.ac.kr`과 맞지만 `mail.com`은 `kim@gmail.com`과 맞지 않는다. domain이
+ `@`나 `.`으로 시작하면 그대로 끝부분만 비교한다.
+ *
+ * @param predicate email domain 조건
+ * @param email 확인하고자 하는 email
+ * @param len email의 길이
+ * @return int 맞으면 1을, 그렇지 않으면 0을 반환한다.
+ */
+static inline int pa_predicate_domain(const struct pa_predicate *predicate,
+                                      const char *email, int len)
+{
+        const char *tail;
+        char first = predicate->str[0];
+
+        if (len < predicate->len) { /**< tail이 email 밖을 가리키지 않도록 먼저 확인한다. */
+                return 0;
+        }
+        tail = email + len - predicate->len;
+        if (memcmp(tail, predicate->str, predicate->len) != 0) {
+                return 0;
+        }
+        if (first == '@' || first == '.') {
+                return 1;
+        }
+        return len > predicate->len && (tail[-1] == '@' || tail[-1] == '.');
+}
+
+/**
+ * @brief SCAN 명령의 field로 조건을 만든다.
+ * @details `ID,lo,hi`는 lo 이상 hi 이하의 id를, `EMAIL_DOMAIN,domain`은 domain의
+ email을, `NAME_PREFIX,prefix`는 prefix로 시작하는 name을 고른다.
+ *
+ * @param predicate 조건이 저장된다.
+ * @param line COMMAND와 조건의 field들로 나누어진 행
+ * @return int 정상적인 경우에는 0을, 조건이 잘못된 경우 -EINVAL을 반환한다.
+ */
+int pa_predicate_parse(struct pa_predicate *predicate,
+                       const struct pa_line *line)
+{
+        const struct pa_field *kind = &line->field[1];
+
+        memset(predicate, 0, sizeof(*predicate));
+        if (pa_field_equal(kind, "ID")) {
+                if (line->field[2].len == 0 || line->field[3].len == 0) {
+                        return -EINVAL;
+                }
+                predicate->type = PA_PREDICATE_ID;
+                predicate->lo = pa_field_atoi(&line->field[2]);
+                predicate->hi = pa_field_atoi(&line->field[3]);
+                return 0;
+        }
+        if (pa_field_equal(kind, "EMAIL_DOMAIN")) {
+                predicate->type = PA_PREDICATE_EMAIL_DOMAIN;
+        } else if (pa_field_equal(kind, "NAME_PREFIX")) {
+                predicate->type = PA_PREDICATE_NAME_PREFIX;
+        } else {
+                return -EINVAL;
+        }
+        if (line->field[2].len != 0) {
+                pa_field_copy(predicate->str, &line->field[2]);
+        }
+        predicate->len = (int)strlen(predicate->str);
+        if (predicate->type == PA_PREDICATE_EMAIL_DOMAIN &&
+            predicate->len == 0) {
+                return -EINVAL;
+        }
+        return 0;
+}
+
+/**
+ * @brief 행 하나가 조건을 만족하는지 확인한다.
+ *
+ * @param predicate 조건
+ * @param id 행의 id
+ * @param name 행의 name
+ * @param email 행의 email
+ * @return int 만족하면 1을, 그렇지 않으면 0을 반환한다.
+ */
+int pa_predicate_test(const struct pa_predicate *predicate, int id,
+                      const char *name, const char *email)
+{
+        switch (predicate->type) {
+        case PA_PREDICATE_ID:
+                return predicate->lo <= id && id <= predicate->hi;
+        case PA_PREDICATE_EMAIL_DOMAIN:
+                return pa_predicate_domain(
+                        predicate, email,
+                        (int)strnlen(email, MAX_CHAR_LEN));
+        case PA_PREDICATE_NAME_PREFIX:
+                return strncmp(name, predicate->str, predicate->len) == 0;
+        }
+        return 0;
+}
+
+/**
+ * @brief block의 id가 [lo, hi]에 속하는지를 마스크로 만든다.
+ *
+ * @param id block의 id column
+ * @param lo 범위의 시작
+ * @param hi 범위의 끝
+ * @return unsigned long long i번째 행이 범위에 속하면 i번째 비트가 1인 마스크
+ */
+static inline unsigned long long pa_scan_id(const int *id, int lo, int hi)
+{
+        unsigned long long mask = 0;
+        int i;
+#if defined(__AVX2__)
+        const __m256i low = _mm256_set1_epi32(lo);
+        const __m256i high = _mm256_set1_epi32(hi);
+        __m256i v, out;
+
+        for (i = 0; i < PA_SCAN_BLOCK; i += 8) {
+                v = _mm256_loadu_si256((const __m256i *)(id + i));
+                out = _mm256_or_si256(_mm256_cmpgt_epi32(low, v),
+                                      _mm256_cmpgt_epi32(v, high));
+                mask |= (unsigned long long)(~_mm256_movemask_ps(
+                                                     _mm256_castsi256_ps(out)) &
+                                             0xff)
+                        << i;
+        }
+#elif defined(__SSE2__)
+        const __m128i low = _mm_set1_epi32(lo);
+        const __m128i high = _mm_set1_epi32(hi);
+        __m128i v, out;
+
+        for (i = 0; i < PA_SCAN_BLOCK; i += 4) {
+                v = _mm_loadu_si128((const __m128i *)(id + i));
+                out = _mm_or_si128(_mm_cmpgt_epi32(low, v),
+                                   _mm_cmpgt_epi32(v, high));
+                mask |= (unsigned long long)(~_mm_movemask_ps(
+                                                     _mm_castsi128_ps(out)) &
+                                             0xf)
+                        << i;
+        }
+#else
+        for (i = 0; i < PA_SCAN_BLOCK; i++) {
+                mask |= (unsigned long long)(lo <= id[i] && id[i] <= hi) << i;
+        }
+#endif
+        return mask;
+}
+
+#if defined(__AVX2__)
+#define PA_SCAN_VECTOR 32 /**< PA_SCAN_VECTOR < 문자열을 한 번에 비교하는 바이트 수 */
+typedef __m256i pa_scan_vector;
+#define pa_scan_load(ptr) _mm256_loadu_si256((const __m256i *)(ptr))
+#define pa_scan_eq(a, b)                                                       \
+        ((unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8((a), (b))))
+#define pa_scan_zero() _mm256_setzero_si256()
+#elif defined(__SSE2__)
+#define PA_SCAN_VECTOR 16
+typedef __m128i pa_scan_vector;
+#define pa_scan_load(ptr) _mm_loadu_si128((const __m128i *)(ptr))
+#define pa_scan_eq(a, b)                                                       \
+        ((unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8((a), (b))))
+#define pa_scan_zero() _mm_setzero_si128()
+#endif
+
+#ifdef PA_SCAN_VECTOR
+#define PA_SCAN_NR_VECTORS (MAX_CHAR_LEN / PA_SCAN_VECTOR)
+
+/**
+ * @brief 고정 길이 문자열의 길이를 구한다.
+ *
+ * @param str MAX_CHAR_LEN 바이트를 읽을 수 있는 문자열
+ * @param zero 0으로 채워진 vector
+ * @return int 문자열의 길이 (NUL이 없으면 MAX_CHAR_LEN)
+ */
+static inline int pa_scan_strlen(const char *str, pa_scan_vector zero)
+{
+        unsigned int eq;
+        int c;
+
+        for (c = 0; c < PA_SCAN_NR_VECTORS; c++) {
+                eq = pa_scan_eq(pa_scan_load(str + c * PA_SCAN_VECTOR), zero);
+                if (eq != 0) {
+                        return c * PA_SCAN_VECTOR + __builtin_ctz(eq);
+                }
+        }
+        return MAX_CHAR_LEN;
+}
+#endif
+
+/**
+ * @brief block의 name이 prefix로 시작하는지를 마스크로 만든다.
+ * @details prefix를 vector 단위로 미리 읽어 두고 행마다 prefix의 길이만큼의
+ 바이트가 모두 같은지를 movemask로 확인한다. name이 prefix보다 짧으면 NUL이
+ prefix의 문자와 다르므로 따로 길이를 확인하지 않는다.
+ *
+ * @param name block의 name column
+ * @param predicate name prefix 조건
+ * @return unsigned long long 조건을 만족하는 행의 마스크
+ */
+static inline unsigned long long
+pa_scan_prefix(const char (*name)[MAX_CHAR_LEN],
+               const struct pa_predicate *predicate)
+{
+        unsigned long long mask = 0;
+        int i;
+#ifdef PA_SCAN_VECTOR
+        pa_scan_vector prefix[PA_SCAN_NR_VECTORS];
+        unsigned int need[PA_SCAN_NR_VECTORS];
+        int c, nr_vectors = 0, len = predicate->len;
+
+        for (c = 0; c * PA_SCAN_VECTOR < len; c++) {
+                prefix[c] = pa_scan_load(predicate->str + c * PA_SCAN_VECTOR);
+                need[c] = (len - c * PA_SCAN_VECTOR >= PA_SCAN_VECTOR ?
+                                   (unsigned int)((1ULL << PA_SCAN_VECTOR) -
+                                                  1) :
+                                   (1U << (len - c * PA_SCAN_VECTOR)) - 1);
+                nr_vectors++;
+        }
+        for (i = 0; i < PA_SCAN_BLOCK; i++) {
+                for (c = 0; c < nr_vectors; c++) {
+                        if ((pa_scan_eq(pa_scan_load(name[i] +
+                                                     c * PA_SCAN_VECTOR),
+                                        prefix[c]) &
+                             need[c]) != need[c]) {
+                                break;
+                        }
+                }
+                mask |= (unsigned long long)(c == nr_vectors) << i;
+        }
+#else
+        for (i = 0; i < PA_SCAN_BLOCK; i++) {
+                mask |= (unsigned long long)(memcmp(name[i], predicate->str,
+                                                    predicate->len) == 0)
+                        << i;
+        }
+#endif
+        return mask;
+}
+
+/**
+ * @brief block의 email이 domain으로 끝나는지를 마스크로 만든다.
+ * @details 행마다 NUL의 위치를 SIMD 비교로 찾고 끝부분만 비교한다.
+ *
+ * @param email block의 email column
+ * @param predicate email domain 조건
+ * @return unsigned long long 조건을 만족하는 행의 마스크
+ */
+static inline unsigned long long
+pa_scan_domain(const char (*email)[MAX_CHAR_LEN],
+               const struct pa_predicate *predicate)
+{
+        unsigned long long mask = 0;
+        int i, len;
+#ifdef PA_SCAN_VECTOR
+        const pa_scan_vector zero = pa_scan_zero();
+#endif
+
+        for (i = 0; i < PA_SCAN_BLOCK; i++) {
+#ifdef PA_SCAN_VECTOR
+                len = pa_scan_strlen(email[i], zero);
+#else
+                len = (int)strnlen(email[i], MAX_CHAR_LEN);
+#endif
+                mask |= (unsigned long long)pa_predicate_domain(
+                                predicate, email[i], len)
+                        << i;
+        }
+        return mask;
+}
+
+/**
+ * @brief 연속된 PA_SCAN_BLOCK개의 행이 조건을 만족하는지를 마스크로 만든다.
+ * @note 초기화되지 않은 행도 읽으므로 사용 중인 행의 마스크와 AND해서 사용해야
+ 한다.
+ *
+ * @param predicate 조건
+ * @param id block의 id column
+ * @param name block의 name column
+ * @param email block의 email column
+ * @return unsigned long long i번째 행이 조건을 만족하면 i번째 비트가 1인 마스크
+ */
+unsigned long long pa_predicate_block(const struct pa_predicate *predicate,
+                                      const int *id,
+                                      const char (*name)[MAX_CHAR_LEN],
+                                      const char (*email)[MAX_CHAR_LEN])
+{
+        switch (predicate->type) {
+        case PA_PREDICATE_ID:
+                return pa_scan_id(id, predicate->lo, predicate->hi);
+        case PA_PREDICATE_EMAIL_DOMAIN:
+                return pa_scan_domain(email, predicate);
+        case PA_PREDICATE_NAME_PREFIX:
+                return (predicate->len == 0 ? ~0ULL :
+                                              pa_scan_prefix(name, predicate));
+        }
+        return 0;
+}
+
+/**
+ * @brief 고른 레코드를 selection에 추가한다.
+ *
+ * @param selection 레코드를 추가할 selection을 가리키는 변수 (NULL이면 새로 만든다.)
+ * @param id 레코드의 id
+ * @param order 같은 id 사이의 순서
+ * @param name 레코드의 name
+ * @param bban 레코드의 bban
+ * @param email 레코드의 email
+ * @return int 정상적인 경우에는 0을, 메모리가 부족한 경우 -ENOMEM을 반환한다.
+ */
+int pa_selection_add(struct pa_selection **selection, int id, int order,
+                     const char *name, const char *bban, const char *email)
+{
+        struct pa_selection *sel = *selection;
+        struct pa_record *record;
+        int capacity;
+
+        if (sel == NULL) {
+                sel = (struct pa_selection *)calloc(
+                        1, sizeof(struct pa_selection));
+                if (sel == NULL) {
+                        return -ENOMEM;
+                }
+                *selection = sel;
+        }
+        if (sel->nr_records == sel->capacity) {
+                capacity = (sel->capacity > 0 ? sel->capacity * 2 : 64);
+                record = (struct pa_record *)realloc(
+                        sel->record, sizeof(struct pa_record) * capacity);
+                if (record == NULL) {
+                        return -ENOMEM;
+                }
+                sel->record = record;
+                sel->capacity = capacity;
+        }
+        record = &sel->record[sel->nr_records++];
+        record->id = id;
+        record->order = order;
+        strcpy(record->name, name);
+        strcpy(record->bban, bban);
+        strcpy(record->email, email);
+        return 0;
+}
+
+/**
+ * @brief 레코드의 순서를 비교한다. (id, order 순)
+ *
+ * @param a 비교하고자 하는 레코드
+ * @param b 비교하고자 하는 레코드
+ * @return int a가 앞서면 음수를, b가 앞서면 양수를 반환한다.
+ */
+static int pa_record_compare(const void *a, const void *b)
+{
+        const struct pa_record *x = (const struct pa_record *)a;
+        const struct pa_record *y = (const struct pa_record *)b;
+
+        if (x->id != y->id) {
+                return (x->id < y->id ? -1 : 1);
+        }
+        return (x->order > y->order) - (x->order < y->order);
+}
+
+/**
+ * @brief selection의 레코드를 (id, order) 순서로 정렬한다.
+ *
+ * @param selection 정렬하고자 하는 selection (NULL이면 아무것도 하지 않는다.)
+ */
+void pa_selection_sort(struct pa_selection *selection)
+{
+        if (selection != NULL && selection->nr_records > 1) {
+                qsort(selection->record, selection->nr_records,
+                      sizeof(struct pa_record), pa_record_compare);
+        }
+}
+
+/**
+ * @brief 레코드 a가 b보다 앞서는지 확인한다.
+ *
+ * @param a 비교하고자 하는 레코드
+ * @param b 비교하고자 하는 레코드
+ * @return int a가 앞서면 1을, 그렇지 않으면 0을 반환한다.
+ */
+int pa_record_precede(const struct pa_record *a, const struct pa_record *b)
+{
+        return pa_record_compare(a, b) < 0;
+}
+
+/**
+ * @brief 이어진 selection들을 모두 해제한다.
+ *
+ * @param selection 해제하고자 하는 selection
+ */
+void pa_selection_free(struct pa_selection *selection)
+{
+        struct pa_selection *next;
+
+        while (selection != NULL) {
+                next = selection->next;
+                free(selection->record);
+                free(selection);
+                selection = next;
+        }
+}
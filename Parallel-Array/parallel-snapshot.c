@@ -0,0 +1,297 @@
+/**
+ * @file parallel-snapshot.c
+ * @author 오기준 (kijunking@pusan.ac.kr)
+ * @brief PA를 파일에 저장하고 다시 불러오는 snapshot을 가진다.
+ * @details snapshot은 header 뒤에 PA_SNAPSHOT_ALIGN 단위로 정렬된 section들을
+ 가진다. section은 column, 비트맵, 해시 테이블을 메모리에 있는 모습 그대로
+ 담고 있고, 서로의 위치는 포인터 대신 파일 안의 offset으로 가리킨다. 따라서
+ 읽을 때에는 파일 전체를 한 번 mmap하고 offset을 포인터로 바꾸기만 하면 되며,
+ 행의 수와 관계없이 행마다 하는 일이 없다. mmap은 MAP_PRIVATE이므로 이후의
+ 명령이 고치는 page만 복사되고 파일은 바뀌지 않는다.
+ * @date 2020-04-17
+ *
+ */
+#include "parallel.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * @brief offset을 PA_SNAPSHOT_ALIGN의 배수로 올린다.
+ *
+ * @param offset 올리고자 하는 offset
+ * @return unsigned long long 정렬된 offset
+ */
+static inline unsigned long long pa_snapshot_align(unsigned long long offset)
+{
+        return (offset + PA_SNAPSHOT_ALIGN - 1) &
+               ~(unsigned long long)(PA_SNAPSHOT_ALIGN - 1);
+}
+
+/**
+ * @brief 버퍼의 내용을 모두 fd의 offset 위치에 쓴다.
+ *
+ * @param fd 쓰고자 하는 파일
+ * @param buf 쓰고자 하는 버퍼
+ * @param len 버퍼의 길이
+ * @param offset 파일 안에서 쓰기 시작할 위치
+ * @return int 정상적인 경우에는 0을, 쓰지 못한 경우 -errno를 반환한다.
+ */
+static int pa_snapshot_pwrite(int fd, const char *buf, size_t len,
+                              unsigned long long offset)
+{
+        ssize_t ret;
+
+        while (len > 0) {
+                ret = pwrite(fd, buf, len, (off_t)offset);
+                if (ret < 0) {
+                        if (errno == EINTR) {
+                                continue;
+                        }
+                        return -errno;
+                }
+                buf += ret;
+                len -= (size_t)ret;
+                offset += (unsigned long long)ret;
+        }
+        return 0;
+}
+
+/**
+ * @brief 새로운 section을 쓴다.
+ * @details section은 reserve 바이트를 차지하지만 앞의 len 바이트만 쓴다.
+ 나머지는 파일의 hole로 남으므로 디스크를 차지하지 않고 0으로 읽힌다.
+ *
+ * @param snapshot 쓰고 있는 snapshot
+ * @param data 쓰고자 하는 내용
+ * @param len 쓰고자 하는 내용의 길이
+ * @param reserve section의 크기 (len 이상)
+ * @return unsigned long long section이 시작하는 offset
+ */
+unsigned long long pa_snapshot_write(struct pa_snapshot *snapshot,
+                                     const void *data, size_t len,
+                                     size_t reserve)
+{
+        unsigned long long offset = pa_snapshot_align(snapshot->offset);
+        int ret;
+
+        if (len > 0 && snapshot->error == 0) {
+                ret = pa_snapshot_pwrite(snapshot->fd, (const char *)data, len,
+                                         offset);
+                if (ret != 0) {
+                        snapshot->error = ret;
+                }
+        }
+        snapshot->offset = offset + (reserve > len ? reserve : len);
+        return offset;
+}
+
+/**
+ * @brief mmap된 snapshot 안의 section을 가리키는 포인터를 가져온다.
+ *
+ * @param snapshot mmap된 snapshot
+ * @param offset section의 offset
+ * @param len section의 길이
+ * @return void* section의 시작 위치로 파일의 범위를 벗어나면 NULL을 반환한다.
+ */
+void *pa_snapshot_ptr(const struct pa_snapshot *snapshot,
+                      unsigned long long offset, size_t len)
+{
+        if (offset < sizeof(struct pa_snapshot_header) ||
+            offset % PA_SNAPSHOT_ALIGN != 0 || offset > snapshot->size ||
+            len > snapshot->size - offset) {
+                return NULL;
+        }
+        return snapshot->base + offset;
+}
+
+/**
+ * @brief 모든 shard의 store를 snapshot 파일로 저장한다.
+ * @details 같은 경로에 `.tmp`를 붙인 파일에 먼저 쓴 뒤 rename하므로 저장
+ 도중에 실패하더라도 이전 snapshot은 그대로 남는다. 이전 snapshot을 mmap해서
+ 사용하고 있는 경우에도 그 mapping은 rename과 관계없이 유지된다.
+ *
+ * @param path snapshot 파일의 경로
+ * @param operation store를 다루는 함수들
+ * @param stores 저장하고자 하는 store들
+ * @param nr_shards store의 수
+ * @return int 정상적인 경우에는 0을, 그렇지 않으면 음수 값을 반환한다.
+ */
+int pa_snapshot_save(const char *path, const struct op *operation,
+                     void **stores, int nr_shards)
+{
+        struct pa_snapshot snapshot;
+        struct pa_snapshot_header header;
+        char temp[PATH_MAX];
+        int ret = 0, i;
+
+        if (operation->save == NULL) {
+                return -EOPNOTSUPP;
+        }
+        if (nr_shards <= 0 || nr_shards > PA_MAX_SHARDS) {
+                return -EINVAL;
+        }
+        if (snprintf(temp, sizeof(temp), "%s.tmp", path) >=
+            (int)sizeof(temp)) {
+                return -ENAMETOOLONG;
+        }
+
+        snapshot.fd = open(temp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (snapshot.fd < 0) {
+                return -errno;
+        }
+        snapshot.offset = sizeof(header);
+        snapshot.error = 0;
+        snapshot.base = NULL;
+        snapshot.size = 0;
+
+        memset(&header, 0, sizeof(header));
+        for (i = 0; i < nr_shards; i++) {
+                ret = operation->save(stores[i], &snapshot, &header.store[i]);
+                if (ret != 0) {
+                        goto exception;
+                }
+        }
+        if (snapshot.error != 0) {
+                ret = snapshot.error;
+                goto exception;
+        }
+
+        memcpy(header.magic, PA_SNAPSHOT_MAGIC, sizeof(header.magic));
+        header.version = PA_SNAPSHOT_VERSION;
+        header.max_char_len = MAX_CHAR_LEN;
+        header.segment_base = PA_SEGMENT_BASE;
+        header.nr_shards = (unsigned int)nr_shards;
+        header.size = pa_snapshot_align(snapshot.offset);
+
+        /* 마지막 section의 hole도 파일의 크기에 포함되도록 한다. */
+        if (ftruncate(snapshot.fd, (off_t)header.size) < 0) {
+                ret = -errno;
+                goto exception;
+        }
+        ret = pa_snapshot_pwrite(snapshot.fd, (const char *)&header,
+                                 sizeof(header), 0);
+        if (ret != 0) {
+                goto exception;
+        }
+        if (fsync(snapshot.fd) < 0 || close(snapshot.fd) < 0) {
+                ret = -errno;
+                unlink(temp);
+                return ret;
+        }
+        if (rename(temp, path) < 0) {
+                ret = -errno;
+                unlink(temp);
+                return ret;
+        }
+        return 0;
+
+exception:
+        close(snapshot.fd);
+        unlink(temp);
+        return ret;
+}
+
+/**
+ * @brief snapshot 파일을 mmap하고 shard별 store를 만든다.
+ * @details store들은 mmap된 영역을 직접 가리키므로 store를 모두 해제한 뒤에
+ pa_snapshot_close()를 호출해야 한다. shard의 수는 snapshot을 저장할 때의
+ 값으로 바뀐다. id를 shard로 나누는 방식이 shard의 수에 따라 다르기 때문이다.
+ *
+ * @param snapshot mmap된 snapshot이 저장된다.
+ * @param path snapshot 파일의 경로
+ * @param operation store를 다루는 함수들
+ * @param stores 만들어진 store들이 저장된다.
+ * @param nr_shards snapshot에 있는 store의 수가 저장된다.
+ * @return int 정상적인 경우에는 0을, 파일이 없으면 -ENOENT를, 형식이 맞지
+ 않으면 -EINVAL을, 그 밖의 경우 음수 값을 반환한다.
+ */
+int pa_snapshot_load(struct pa_snapshot *snapshot, const char *path,
+                     const struct op *operation, void **stores,
+                     int *nr_shards)
+{
+        const struct pa_snapshot_header *header;
+        struct stat st;
+        void *base;
+        int fd, ret = 0, i, n;
+
+        snapshot->fd = -1;
+        snapshot->offset = 0;
+        snapshot->error = 0;
+        snapshot->base = NULL;
+        snapshot->size = 0;
+        if (operation->load == NULL) {
+                return -EOPNOTSUPP;
+        }
+
+        fd = open(path, O_RDONLY);
+        if (fd < 0) {
+                return -errno;
+        }
+        if (fstat(fd, &st) < 0) {
+                ret = -errno;
+                close(fd);
+                return ret;
+        }
+        if ((size_t)st.st_size < sizeof(struct pa_snapshot_header)) {
+                close(fd);
+                return -EINVAL;
+        }
+        base = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE, fd, 0);
+        ret = (base == MAP_FAILED ? -errno : 0);
+        close(fd); /**< mmap은 fd를 닫아도 유지된다. */
+        if (ret != 0) {
+                return ret;
+        }
+        snapshot->base = (char *)base;
+        snapshot->size = (size_t)st.st_size;
+
+        header = (const struct pa_snapshot_header *)snapshot->base;
+        if (memcmp(header->magic, PA_SNAPSHOT_MAGIC, sizeof(header->magic)) ||
+            header->version != PA_SNAPSHOT_VERSION ||
+            header->max_char_len != MAX_CHAR_LEN ||
+            header->segment_base != PA_SEGMENT_BASE ||
+            header->size != snapshot->size || header->nr_shards == 0 ||
+            header->nr_shards > PA_MAX_SHARDS) {
+                ret = -EINVAL;
+                goto exception;
+        }
+
+        n = (int)header->nr_shards;
+        for (i = 0; i < n; i++) {
+                ret = operation->load(&stores[i], snapshot, header->store[i]);
+                if (ret != 0) {
+                        break;
+                }
+        }
+        if (ret != 0) {
+                while (i-- > 0) {
+                        operation->free(stores[i]);
+                }
+                goto exception;
+        }
+        *nr_shards = n;
+        return 0;
+
+exception:
+        pa_snapshot_close(snapshot);
+        return ret;
+}
+
+/**
+ * @brief mmap한 snapshot을 해제한다.
+ *
+ * @param snapshot mmap된 snapshot
+ */
+void pa_snapshot_close(struct pa_snapshot *snapshot)
+{
+        if (snapshot->base != NULL) {
+                munmap(snapshot->base, snapshot->size);
+        }
+        snapshot->base = NULL;
+        snapshot->size = 0;
+}
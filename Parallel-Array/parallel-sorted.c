@@ -0,0 +1,450 @@
+/**
+ * @file parallel-sorted.c
+ * @author 오기준 (kijunking@pusan.ac.kr)
+ * @brief 문자열 key의 순서를 유지하는 treap 인덱스를 가진다.
+ * @details 항목은 (문자열, id, WP)의 순서로 정렬되므로 prefix로 시작하는 가장
+ 작은 항목은 prefix 이상인 첫 항목이다. 문자열 자체는 PA의 column에 있으므로
+ 항목은 WP만 가지고, 비교할 때 필요한 문자열은 key 함수로 가져온다. 대신 앞의
+ 8 바이트를 big endian 정수로 항목에 넣어 두어서 대부분의 비교는 column을 읽지
+ 않고 정수 비교로 끝난다. node는 포인터 대신 배열의 index로 서로를 가리키므로
+ 배열을 그대로 snapshot에 저장할 수 있다.
+ * @date 2020-04-18
+ *
+ */
+#include "parallel.h"
+
+#define PA_SORTED_MIN_CAPACITY 16
+
+/**
+ * @brief 문자열의 앞 8 바이트를 big endian 정수로 만든다.
+ * @details 정수의 대소가 앞 8 바이트의 사전 순서와 같다. NUL 뒤는 0으로
+ 채우므로 마지막 바이트가 0이 아니면 문자열이 8 바이트보다 길다.
+ *
+ * @param str NUL로 끝나는 문자열
+ * @return unsigned long long 앞 8 바이트의 값
+ */
+static inline unsigned long long pa_sorted_prefix(const char *str)
+{
+        unsigned long long prefix = 0;
+        int i;
+
+        for (i = 0; i < 8; i++) {
+                prefix <<= 8;
+                if (*str != 0x00) {
+                        prefix |= (unsigned char)*str++;
+                }
+        }
+        return prefix;
+}
+
+/**
+ * @brief 0이 아닌 의사 난수를 만든다. (xorshift32)
+ *
+ * @param sorted 인덱스
+ * @return unsigned int 의사 난수
+ */
+static inline unsigned int pa_sorted_random(struct pa_sorted *sorted)
+{
+        unsigned int x = sorted->seed;
+
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        sorted->seed = x;
+        return x;
+}
+
+/**
+ * @brief 찾고자 하는 문자열과 node의 문자열을 비교한다.
+ *
+ * @param sorted 인덱스
+ * @param prefix 찾고자 하는 문자열의 앞 8 바이트 값
+ * @param str 찾고자 하는 문자열
+ * @param node 비교하고자 하는 node
+ * @return int str이 작으면 음수를, 같으면 0을, 크면 양수를 반환한다.
+ */
+static int pa_sorted_compare_str(const struct pa_sorted *sorted,
+                                 unsigned long long prefix, const char *str,
+                                 const struct pa_sorted_node *node)
+{
+        if (prefix != node->prefix) {
+                return (prefix < node->prefix ? -1 : 1);
+        }
+        if ((prefix & 0xff) == 0) {
+                return 0; /**< 두 문자열 모두 8 바이트 안에서 끝난다. */
+        }
+        return strcmp(str + 8, sorted->key(sorted->arg, node->wp) + 8);
+}
+
+/**
+ * @brief 찾고자 하는 key와 node를 (문자열, id, WP) 순서로 비교한다.
+ *
+ * @param sorted 인덱스
+ * @param key 찾고자 하는 key
+ * @param str key의 문자열
+ * @param node 비교하고자 하는 node
+ * @return int key가 작으면 음수를, 같으면 0을, 크면 양수를 반환한다.
+ */
+static int pa_sorted_compare(const struct pa_sorted *sorted,
+                             const struct pa_sorted_node *key,
+                             const char *str, const struct pa_sorted_node *node)
+{
+        int cmp = pa_sorted_compare_str(sorted, key->prefix, str, node);
+
+        if (cmp != 0) {
+                return cmp;
+        }
+        if (key->id != node->id) {
+                return (key->id < node->id ? -1 : 1);
+        }
+        return (key->wp > node->wp) - (key->wp < node->wp);
+}
+
+/**
+ * @brief 인덱스를 초기화한다.
+ *
+ * @param sorted 초기화할 인덱스
+ * @param capacity 담고자 하는 항목의 수
+ * @param key WP의 문자열을 가져오는 함수
+ * @param arg key 함수에 넘겨줄 값
+ * @return int 정상적인 경우에는 0을, 메모리가 부족한 경우 -ENOMEM을 반환한다.
+ */
+int pa_sorted_init(struct pa_sorted *sorted, int capacity,
+                   const char *(*key)(void *arg, int wp), void *arg)
+{
+        if (capacity < PA_SORTED_MIN_CAPACITY) {
+                capacity = PA_SORTED_MIN_CAPACITY;
+        }
+        sorted->nodes = (struct pa_sorted_node *)malloc(
+                sizeof(struct pa_sorted_node) * capacity);
+        if (sorted->nodes == NULL) {
+                return -ENOMEM;
+        }
+        sorted->capacity = capacity;
+        sorted->nr_nodes = 0;
+        sorted->free_node = -1;
+        sorted->root = -1;
+        sorted->nr_entries = 0;
+        sorted->seed = 0x9e3779b9U;
+        sorted->borrowed = NULL;
+        sorted->key = key;
+        sorted->arg = arg;
+        return 0;
+}
+
+/**
+ * @brief 사용하지 않는 node를 하나 가져온다.
+ * @details 지워진 node는 left로 이어진 목록에 두었다가 다시 사용한다. 배열이
+ 가득 차면 2배로 늘리며, snapshot에서 빌려온 배열은 복사만 하고 해제하지 않는다.
+ *
+ * @param sorted 인덱스
+ * @return int node의 index로 메모리가 부족하면 -ENOMEM을 반환한다.
+ */
+static int pa_sorted_alloc(struct pa_sorted *sorted)
+{
+        struct pa_sorted_node *nodes;
+        int node, capacity;
+
+        if (sorted->free_node >= 0) {
+                node = sorted->free_node;
+                sorted->free_node = sorted->nodes[node].left;
+                return node;
+        }
+        if (sorted->nr_nodes == sorted->capacity) {
+                capacity = (sorted->capacity < PA_SORTED_MIN_CAPACITY ?
+                                    PA_SORTED_MIN_CAPACITY :
+                                    sorted->capacity * 2);
+                nodes = (struct pa_sorted_node *)malloc(
+                        sizeof(struct pa_sorted_node) * capacity);
+                if (nodes == NULL) {
+                        return -ENOMEM;
+                }
+                memcpy(nodes, sorted->nodes,
+                       sizeof(struct pa_sorted_node) * sorted->nr_nodes);
+                if (sorted->nodes != sorted->borrowed) {
+                        free(sorted->nodes);
+                }
+                sorted->nodes = nodes;
+                sorted->capacity = capacity;
+        }
+        return sorted->nr_nodes++;
+}
+
+/**
+ * @brief tree를 key보다 작은 부분과 크거나 같은 부분으로 나눈다.
+ *
+ * @param sorted 인덱스
+ * @param root 나누고자 하는 tree
+ * @param key 나누는 기준이 되는 key
+ * @param str key의 문자열
+ * @param left key보다 작은 부분이 저장된다.
+ * @param right key보다 크거나 같은 부분이 저장된다.
+ */
+static void pa_sorted_split(struct pa_sorted *sorted, int root,
+                            const struct pa_sorted_node *key, const char *str,
+                            int *left, int *right)
+{
+        struct pa_sorted_node *node;
+
+        if (root < 0) {
+                *left = *right = -1;
+                return;
+        }
+        node = &sorted->nodes[root];
+        if (pa_sorted_compare(sorted, key, str, node) > 0) {
+                pa_sorted_split(sorted, node->right, key, str, &node->right,
+                                right);
+                *left = root;
+        } else {
+                pa_sorted_split(sorted, node->left, key, str, left,
+                                &node->left);
+                *right = root;
+        }
+}
+
+/**
+ * @brief 모든 key가 right보다 작은 left와 right를 하나의 tree로 합친다.
+ *
+ * @param sorted 인덱스
+ * @param left 왼쪽 tree
+ * @param right 오른쪽 tree
+ * @return int 합쳐진 tree의 root
+ */
+static int pa_sorted_merge(struct pa_sorted *sorted, int left, int right)
+{
+        struct pa_sorted_node *nodes = sorted->nodes;
+
+        if (left < 0 || right < 0) {
+                return (left < 0 ? right : left);
+        }
+        if (nodes[left].priority > nodes[right].priority) {
+                nodes[left].right =
+                        pa_sorted_merge(sorted, nodes[left].right, right);
+                return left;
+        }
+        nodes[right].left = pa_sorted_merge(sorted, left, nodes[right].left);
+        return right;
+}
+
+/**
+ * @brief tree에 node를 넣는다.
+ *
+ * @param sorted 인덱스
+ * @param root 넣고자 하는 tree
+ * @param node 넣고자 하는 node (key가 채워져 있다.)
+ * @param str node의 문자열
+ * @return int node가 들어간 tree의 root
+ */
+static int pa_sorted_insert_at(struct pa_sorted *sorted, int root, int node,
+                               const char *str)
+{
+        struct pa_sorted_node *nodes = sorted->nodes;
+
+        if (root < 0) {
+                return node;
+        }
+        if (nodes[node].priority > nodes[root].priority) {
+                pa_sorted_split(sorted, root, &nodes[node], str,
+                                &nodes[node].left, &nodes[node].right);
+                return node;
+        }
+        if (pa_sorted_compare(sorted, &nodes[node], str, &nodes[root]) < 0) {
+                nodes[root].left =
+                        pa_sorted_insert_at(sorted, nodes[root].left, node, str);
+        } else {
+                nodes[root].right = pa_sorted_insert_at(
+                        sorted, nodes[root].right, node, str);
+        }
+        return root;
+}
+
+/**
+ * @brief (str, id, wp) 항목을 인덱스에 넣는다.
+ *
+ * @param sorted 인덱스
+ * @param str wp 행의 문자열
+ * @param id wp 행의 id
+ * @param wp 넣고자 하는 WP
+ * @return int 정상적인 경우에는 0을, 메모리가 부족한 경우 -ENOMEM을 반환한다.
+ */
+int pa_sorted_insert(struct pa_sorted *sorted, const char *str, int id, int wp)
+{
+        struct pa_sorted_node *node;
+        int index = pa_sorted_alloc(sorted);
+
+        if (index < 0) {
+                return index;
+        }
+        node = &sorted->nodes[index];
+        node->prefix = pa_sorted_prefix(str);
+        node->id = id;
+        node->wp = wp;
+        node->left = node->right = -1;
+        node->priority = pa_sorted_random(sorted);
+        sorted->root = pa_sorted_insert_at(sorted, sorted->root, index, str);
+        sorted->nr_entries++;
+        return 0;
+}
+
+/**
+ * @brief tree에서 key와 같은 node를 찾아서 제거한다.
+ *
+ * @param sorted 인덱스
+ * @param root 찾고자 하는 tree를 가리키는 변수 (제거 후의 root로 바뀐다.)
+ * @param key 제거하고자 하는 key
+ * @param str key의 문자열
+ * @return int 제거된 node의 index로 찾지 못하면 -ENOENT를 반환한다.
+ */
+static int pa_sorted_remove_at(struct pa_sorted *sorted, int *root,
+                               const struct pa_sorted_node *key,
+                               const char *str)
+{
+        struct pa_sorted_node *node;
+        int cmp, index;
+
+        while (*root >= 0) {
+                node = &sorted->nodes[*root];
+                cmp = pa_sorted_compare(sorted, key, str, node);
+                if (cmp == 0) {
+                        index = *root;
+                        *root = pa_sorted_merge(sorted, node->left,
+                                                node->right);
+                        return index;
+                }
+                root = (cmp < 0 ? &node->left : &node->right);
+        }
+        return -ENOENT;
+}
+
+/**
+ * @brief (str, id, wp) 항목을 인덱스에서 제거한다.
+ * @warning 행의 문자열을 바꾸거나 지우기 전에 호출해야 한다.
+ *
+ * @param sorted 인덱스
+ * @param str wp 행의 문자열
+ * @param id wp 행의 id
+ * @param wp 제거하고자 하는 WP
+ * @return int 정상적인 경우에는 0을, 찾지 못한 경우 -ENOENT를 반환한다.
+ */
+int pa_sorted_remove(struct pa_sorted *sorted, const char *str, int id, int wp)
+{
+        struct pa_sorted_node key = { .prefix = pa_sorted_prefix(str),
+                                      .id = id,
+                                      .wp = wp };
+        int index = pa_sorted_remove_at(sorted, &sorted->root, &key, str);
+
+        if (index < 0) {
+                return index;
+        }
+        sorted->nodes[index].left = sorted->free_node;
+        sorted->free_node = index;
+        sorted->nr_entries--;
+        return 0;
+}
+
+/**
+ * @brief 행이 옮겨졌을 때 (str, id, wp) 항목이 새 WP를 가리키도록 한다.
+ * @details node를 다시 넣지 않고 WP만 바꾸므로, 같은 (str, id)를 가진 다른
+ 행이 wp와 new_wp 사이에 없어야 순서가 유지된다. 행의 상대적인 순서를
+ 유지하면서 빈 곳으로 당기는 compaction은 이를 만족한다.
+ * @warning 행을 new_wp에 복사한 뒤, wp 행을 지우기 전에 호출해야 한다.
+ *
+ * @param sorted 인덱스
+ * @param str 옮겨진 행의 문자열
+ * @param id 옮겨진 행의 id
+ * @param wp 행이 있던 WP
+ * @param new_wp 행이 옮겨진 WP
+ * @return int 정상적인 경우에는 0을, 찾지 못한 경우 -ENOENT를 반환한다.
+ */
+int pa_sorted_move(struct pa_sorted *sorted, const char *str, int id, int wp,
+                   int new_wp)
+{
+        struct pa_sorted_node key = { .prefix = pa_sorted_prefix(str),
+                                      .id = id,
+                                      .wp = wp };
+        struct pa_sorted_node *node;
+        int root = sorted->root, cmp;
+
+        while (root >= 0) {
+                node = &sorted->nodes[root];
+                cmp = pa_sorted_compare(sorted, &key, str, node);
+                if (cmp == 0) {
+                        node->wp = new_wp;
+                        return 0;
+                }
+                root = (cmp < 0 ? node->left : node->right);
+        }
+        return -ENOENT;
+}
+
+/**
+ * @brief 문자열이 str 이상인 가장 작은 항목을 찾는다.
+ * @details str로 시작하는 항목이 있다면 그 중 가장 작은 항목이 선택된다.
+ *
+ * @param sorted 인덱스
+ * @param str 찾고자 하는 문자열
+ * @return int 찾은 항목의 WP로 없으면 -ENOENT를 반환한다.
+ */
+int pa_sorted_lower_bound(const struct pa_sorted *sorted, const char *str)
+{
+        unsigned long long prefix = pa_sorted_prefix(str);
+        const struct pa_sorted_node *node;
+        int root = sorted->root, wp = -ENOENT;
+
+        while (root >= 0) {
+                node = &sorted->nodes[root];
+                if (pa_sorted_compare_str(sorted, prefix, str, node) <= 0) {
+                        wp = node->wp;
+                        root = node->left;
+                } else {
+                        root = node->right;
+                }
+        }
+        return wp;
+}
+
+/**
+ * @brief 이미 만들어진 node 배열을 복사하지 않고 인덱스로 사용한다.
+ * @details snapshot을 mmap한 영역의 배열을 그대로 사용하기 위한 것으로, 이
+ 배열은 이후에 늘어나더라도 해제되지 않는다.
+ *
+ * @param sorted 초기화할 인덱스
+ * @param nodes 사용할 node 배열
+ * @param nr_nodes 배열에서 사용된 node의 수
+ * @param root tree의 root (비어 있으면 -1)
+ * @param free_node 지워진 node 목록의 처음 (없으면 -1)
+ * @param nr_entries tree에 있는 항목의 수
+ * @param key WP의 문자열을 가져오는 함수
+ * @param arg key 함수에 넘겨줄 값
+ */
+void pa_sorted_attach(struct pa_sorted *sorted, struct pa_sorted_node *nodes,
+                      int nr_nodes, int root, int free_node, int nr_entries,
+                      const char *(*key)(void *arg, int wp), void *arg)
+{
+        sorted->nodes = nodes;
+        sorted->capacity = nr_nodes;
+        sorted->nr_nodes = nr_nodes;
+        sorted->free_node = free_node;
+        sorted->root = root;
+        sorted->nr_entries = nr_entries;
+        sorted->seed = (0x9e3779b9U ^ (unsigned int)nr_nodes) | 1U;
+        sorted->borrowed = nodes;
+        sorted->key = key;
+        sorted->arg = arg;
+}
+
+/**
+ * @brief 인덱스에서 사용한 메모리를 해제한다.
+ *
+ * @param sorted 인덱스
+ */
+void pa_sorted_free(struct pa_sorted *sorted)
+{
+        if (sorted->nodes != sorted->borrowed) {
+                free(sorted->nodes);
+        }
+        sorted->nodes = NULL;
+        sorted->borrowed = NULL;
+        sorted->capacity = sorted->nr_nodes = sorted->nr_entries = 0;
+        sorted->root = sorted->free_node = -1;
+}
@@ -56,34 +56,40 @@ static int trivial_find_wp(const int id)
 /**
  * @brief 문자열을 가지는 PA에 값을 넣도록 한다.
  *
- * @param str 현재 쓰고 있는 문자열 값
+ * @param field 현재 쓰고 있는 문자열 field
  * @param arr 쓰고자 하는 PA 포인터
  * @param wp 현재 쓰는 위치
  */
-static void trivial_insert_string(char **str, char **arr, const int wp)
+static void trivial_insert_string(const struct pa_field *field, char **arr,
+                                  const int wp)
 {
-        int is_valid;
-        char *ptr;
-        ptr = get_csv_field(str, ",\n");
-        is_valid = (ptr != NULL && strlen(ptr) != 0);
+        int is_valid = (field->len != 0);
 #ifdef DEBUG
         if (!is_valid) {
                 fprintf(stderr, "[%s:%s(%d)] Cannot find field value(id: %d)\n",
                         __FILE__, __FUNCTION__, __LINE__, _id[wp]);
         }
 #endif
-        strncpy(arr[wp], (is_valid ? ptr : "<EMPTY>"), MAX_CHAR_LEN);
+        if (is_valid) {
+                pa_field_copy(arr[wp], field);
+        } else {
+                strcpy(arr[wp], "<EMPTY>");
+        }
 }
 
 /**
  * @brief trivial 방식을 초기화 하도록 한다.
+ * @note trivial은 전역 변수에 PA를 가지므로 store는 NULL이며 하나만 만들 수 있다.
  *
+ * @param storep 할당된 store가 저장된다.
  * @return int 정상적인 종료 때에는 0을 비정상 종료의 경우 음수 값을 반환한다.
  */
-int trivial_init(void)
+int trivial_init(void **storep)
 {
         int i;
 
+        *storep = NULL;
+        _wp = 0;
         _id = (int *)malloc(sizeof(int) * MAX_ENTRY_SIZE);
         _name = (char **)malloc(sizeof(char *) * MAX_ENTRY_SIZE);
         _bban = (char **)malloc(sizeof(char *) * MAX_ENTRY_SIZE);
@@ -114,15 +120,17 @@ exception:
 /**
  * @brief PA에 값을 집어넣도록 한다.
  *
- * @param str COMMAND를 제외한 csv 형태의 행을 의미한다.
- * @param outp_fp 출력을 하는 파일에 대한 포인터이다.
+ * @param store trivial에서는 사용하지 않는다.
+ * @param line COMMAND와 레코드의 field들로 나누어진 행을 의미한다.
+ * @param result 명령을 수행한 결과가 저장된다.
  *
  * @return int 정상적인 종료 때에는 0을 비정상 종료의 경우 음수 값을 반환한다.
  */
-int trivial_insert(char *str, FILE *outp_fp)
+int trivial_insert(void *store, const struct pa_line *line,
+                   struct pa_result *result)
 {
         int wp, is_valid;
-        char *ptr;
+        (void)store;
         wp = trivial_get_free_wp();
         if (wp < 0) {
 #ifdef DEBUG
@@ -132,8 +140,7 @@ int trivial_insert(char *str, FILE *outp_fp)
                 return -ENOMEM;
         }
 
-        ptr = get_csv_field(&str, ",\n");
-        is_valid = (ptr != NULL && strlen(ptr) != 0);
+        is_valid = (line->field[1].len != 0);
         if (!is_valid) {
 #ifdef DEBUG
                 fprintf(stderr, "[%s:%s(%d)] Cannot allow the empty \"id\"\n",
@@ -141,17 +148,16 @@ int trivial_insert(char *str, FILE *outp_fp)
 #endif
                 return -EINVAL;
         }
-        _id[wp] = atoi(ptr);
+        _id[wp] = pa_field_atoi(&line->field[1]);
 
-        trivial_insert_string(&str, _name, wp);
-        trivial_insert_string(&str, _bban, wp);
-        trivial_insert_string(&str, _email, wp);
+        trivial_insert_string(&line->field[2], _name, wp);
+        trivial_insert_string(&line->field[3], _bban, wp);
+        trivial_insert_string(&line->field[4], _email, wp);
 
 #ifdef DEBUG
-        fprintf(outp_fp, "INSERT\t%d\t%s\t%s\t%s\n", _id[wp], _name[wp],
-                _bban[wp], _email[wp]);
+        pa_result_record(result, _id[wp], _name[wp], _bban[wp], _email[wp]);
 #else
-        fprintf(outp_fp, "INSERT\t%d\n", _id[wp]);
+        result->id = _id[wp];
 #endif
         _wp = wp + 1;
         return 0;
@@ -160,15 +166,18 @@ int trivial_insert(char *str, FILE *outp_fp)
 /**
  * @brief id에 기반하여 PA에 존재하는 값을 찾는 함수에 해당한다.
  *
- * @param str COMMAND를 제외한 csv 형태의 행을 의미한다.
- * @param outp_fp 출력하는 파일에 대한 포인터이다.
+ * @param store trivial에서는 사용하지 않는다.
+ * @param line COMMAND와 레코드의 field들로 나누어진 행을 의미한다.
+ * @param result 명령을 수행한 결과가 저장된다.
  *
  * @return int 정상 종료 시에 0을 반환하고 비정상 종료시 -1을 반환한다.
  */
-int trivial_search(char *str, FILE *outp_fp)
+int trivial_search(void *store, const struct pa_line *line,
+                   struct pa_result *result)
 {
         int wp, id;
-        id = atoi(get_csv_field(&str, ","));
+        (void)store;
+        id = pa_field_atoi(&line->field[1]);
         wp = trivial_find_wp(id);
         if (wp < 0) {
 #ifdef DEBUG
@@ -177,23 +186,25 @@ int trivial_search(char *str, FILE *outp_fp)
 #endif
                 return -ENOMEM;
         }
-        fprintf(outp_fp, "SEARCH\t%d\t%s\t%s\t%s\n", _id[wp], _name[wp],
-                _bban[wp], _email[wp]);
+        pa_result_record(result, _id[wp], _name[wp], _bban[wp], _email[wp]);
         return 0;
 }
 
 /**
  * @brief id에 기반하여 PA에 해당하는 값을 제거한다.
  *
- * @param str COMMAND를 제외한 csv 형태의 행을 의미한다.
- * @param outp_fp 출력하는 파일에 대한 포인터이다.
+ * @param store trivial에서는 사용하지 않는다.
+ * @param line COMMAND와 레코드의 field들로 나누어진 행을 의미한다.
+ * @param result 명령을 수행한 결과가 저장된다.
  *
  * @return int 정상 종료 시에 0을 반환하고 비정상 종료시 -1을 반환한다.
  */
-int trivial_remove(char *str, FILE *outp_fp)
+int trivial_remove(void *store, const struct pa_line *line,
+                   struct pa_result *result)
 {
         int wp, id;
-        id = atoi(get_csv_field(&str, ",\n"));
+        (void)store;
+        id = pa_field_atoi(&line->field[1]);
         wp = trivial_find_wp(id);
         if (wp < 0) {
 #ifdef DEBUG
@@ -203,18 +214,166 @@ int trivial_remove(char *str, FILE *outp_fp)
                 return -ENOMEM;
         }
         _id[wp] = -1;
-        fprintf(outp_fp, "REMOVE\t%d\n", id);
+        result->id = id;
+        return 0;
+}
+
+/**
+ * @brief field를 검색에 사용할 문자열로 복사한다.
+ *
+ * @param dest 문자열이 저장될 버퍼 (MAX_CHAR_LEN 바이트)
+ * @param field 복사하고자 하는 field
+ */
+static void trivial_query(char *dest, const struct pa_field *field)
+{
+        dest[0] = 0x00;
+        if (field->len != 0) {
+                pa_field_copy(dest, field);
+        }
+}
+
+/**
+ * @brief email이 같은 레코드 중 id가 가장 작은 것을 찾는다.
+ *
+ * @param store trivial에서는 사용하지 않는다.
+ * @param line COMMAND와 email로 나누어진 행을 의미한다.
+ * @param result 명령을 수행한 결과가 저장된다.
+ *
+ * @return int 정상 종료 시에 0을, 찾지 못하면 -ENOENT를 반환한다.
+ */
+int trivial_search_email(void *store, const struct pa_line *line,
+                         struct pa_result *result)
+{
+        char email[MAX_CHAR_LEN];
+        int wp, found = -ENOENT;
+        (void)store;
+        trivial_query(email, &line->field[1]);
+        for (wp = 0; wp < MAX_ENTRY_SIZE; wp++) {
+                if (_id[wp] != -1 && strcmp(_email[wp], email) == 0 &&
+                    (found < 0 || _id[wp] < _id[found])) {
+                        found = wp;
+                }
+        }
+        if (found < 0) {
+                return -ENOENT;
+        }
+        pa_result_record(result, _id[found], _name[found], _bban[found],
+                         _email[found]);
+        return 0;
+}
+
+/**
+ * @brief name이 prefix로 시작하는 레코드 중 (name, id)가 가장 작은 것을 찾는다.
+ *
+ * @param store trivial에서는 사용하지 않는다.
+ * @param line COMMAND와 name prefix로 나누어진 행을 의미한다.
+ * @param result 명령을 수행한 결과가 저장된다.
+ *
+ * @return int 정상 종료 시에 0을, 찾지 못하면 -ENOENT를 반환한다.
+ */
+int trivial_search_name_prefix(void *store, const struct pa_line *line,
+                               struct pa_result *result)
+{
+        char prefix[MAX_CHAR_LEN];
+        size_t len;
+        int wp, found = -ENOENT, cmp;
+        (void)store;
+        trivial_query(prefix, &line->field[1]);
+        len = strlen(prefix);
+        for (wp = 0; wp < MAX_ENTRY_SIZE; wp++) {
+                if (_id[wp] == -1 || strncmp(_name[wp], prefix, len) != 0) {
+                        continue;
+                }
+                if (found >= 0) {
+                        cmp = strcmp(_name[wp], _name[found]);
+                        if (cmp > 0 || (cmp == 0 && _id[wp] >= _id[found])) {
+                                continue;
+                        }
+                }
+                found = wp;
+        }
+        if (found < 0) {
+                return -ENOENT;
+        }
+        pa_result_record(result, _id[found], _name[found], _bban[found],
+                         _email[found]);
+        return 0;
+}
+
+/**
+ * @brief 조건을 만족하는 행의 수를 센다.
+ *
+ * @param store trivial에서는 사용하지 않는다.
+ * @param line COMMAND와 조건으로 나누어진 행을 의미한다.
+ * @param result 고른 행의 수가 저장된다.
+ *
+ * @return int 정상 종료 시에 0을, 조건이 잘못되면 -EINVAL을 반환한다.
+ */
+int trivial_scan_count(void *store, const struct pa_line *line,
+                       struct pa_result *result)
+{
+        struct pa_predicate predicate;
+        int wp, ret;
+        (void)store;
+        ret = pa_predicate_parse(&predicate, line);
+        if (ret != 0) {
+                return ret;
+        }
+        for (wp = 0; wp < MAX_ENTRY_SIZE; wp++) {
+                if (_id[wp] != -1 && pa_predicate_test(&predicate, _id[wp],
+                                                       _name[wp], _email[wp])) {
+                        result->count++;
+                }
+        }
+        return 0;
+}
+
+/**
+ * @brief 조건을 만족하는 행을 모두 고른다.
+ *
+ * @param store trivial에서는 사용하지 않는다.
+ * @param line COMMAND와 조건으로 나누어진 행을 의미한다.
+ * @param result 고른 행의 수와 레코드가 저장된다.
+ *
+ * @return int 정상 종료 시에 0을, 조건이 잘못되면 -EINVAL을, 메모리가
+ 부족하면 -ENOMEM을 반환한다.
+ */
+int trivial_scan_select(void *store, const struct pa_line *line,
+                        struct pa_result *result)
+{
+        struct pa_predicate predicate;
+        int wp, ret;
+        (void)store;
+        ret = pa_predicate_parse(&predicate, line);
+        for (wp = 0; ret == 0 && wp < MAX_ENTRY_SIZE; wp++) {
+                if (_id[wp] == -1 || !pa_predicate_test(&predicate, _id[wp],
+                                                        _name[wp], _email[wp])) {
+                        continue;
+                }
+                ret = pa_selection_add(&result->selection, _id[wp], wp,
+                                       _name[wp], _bban[wp], _email[wp]);
+                result->count++;
+        }
+        if (ret != 0) {
+                pa_selection_free(result->selection);
+                result->selection = NULL;
+                result->count = 0;
+                return ret;
+        }
+        pa_selection_sort(result->selection);
         return 0;
 }
 
 /**
  * @brief 현재 사용량을 출력하도록 한다.
  *
+ * @param store trivial에서는 사용하지 않는다.
  * @return int 현재 사용량을 출력한다.
  */
-int trivial_get_current_usage()
+int trivial_get_current_usage(void *store)
 {
         int wp, count = 0;
+        (void)store;
         for (wp = 0; wp < MAX_ENTRY_SIZE; wp++) {
                 if (_id[wp] != -1) {
                         count++;
@@ -226,10 +385,12 @@ int trivial_get_current_usage()
 /**
  * @brief trivial에서 설정된 것들을 해제한다.
  *
+ * @param store trivial에서는 사용하지 않는다.
  */
-void trivial_free(void)
+void trivial_free(void *store)
 {
         int i;
+        (void)store;
 
         free(_id);
         for (i = 0; i < MAX_ENTRY_SIZE; i++) {
@@ -14,81 +14,690 @@
 #include <string.h>
 #include <errno.h>
 #include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
 #define MAX_CHAR_LEN                                                           \
         64 /** MAX_CHAR_LEN < 레코드에서 값을 받을j수 있는 최대 크기 */
-#define MAX_ENTRY_SIZE 10000 /** MAX_ENTRY_SIZE < 기본 값은 10000 */
+#define MAX_ENTRY_SIZE 10000 /** MAX_ENTRY_SIZE < 기본 값은 10000 (trivial 전용) */
+#define PA_SEGMENT_BASE                                                        \
+        1024 /** PA_SEGMENT_BASE < improve의 첫 segment 행 수 (64의 배수) */
+#define PA_MAX_SEGMENTS                                                        \
+        21 /** PA_MAX_SEGMENTS < segment 수의 한계 (전체 행 수가 int 범위를 넘지 않는다) */
 #define NR_ITEMS 4
 #define MAX_LINE_LEN (MAX_CHAR_LEN * NR_ITEMS)
+#define PA_MAX_FIELDS                                                          \
+        (NR_ITEMS + 1) /** PA_MAX_FIELDS < COMMAND와 레코드의 field 수 */
+#define PA_OUTPUT_BUFFER_SIZE                                                  \
+        (1 << 20) /** PA_OUTPUT_BUFFER_SIZE < 결과를 모았다가 한 번에 쓰는 크기 */
+#define PA_OUTPUT_ASYNC                                                        \
+        1 /** PA_OUTPUT_ASYNC < 1이면 별도의 thread가 결과 버퍼를 파일에 쓴다. */
+#define PA_BATCH_SIZE 256 /** PA_BATCH_SIZE < pipeline의 단계 사이에 한 번에 넘기는 명령 수 */
+#define PA_NR_BATCHES                                                          \
+        16 /** PA_NR_BATCHES < pipeline에서 돌려 쓰는 batch 수 (2의 거듭제곱) */
+#define PA_BATCH_GATHER                                                        \
+        32 /** PA_BATCH_GATHER < batch 하나에 담는 모든 shard가 수행하는 명령 수의 한계 */
+#define PA_MAX_SHARDS 64 /** PA_MAX_SHARDS < 명령을 나누어 수행하는 shard 수의 한계 */
+#define PA_NR_SHARDS                                                           \
+        0 /** PA_NR_SHARDS < shard 수로 0이면 CPU 수만큼 만든다. (trivial은 항상 1) */
+#define PA_SHARD_ALL                                                           \
+        -2 /** PA_SHARD_ALL < 모든 shard가 수행하고 결과를 합치는 명령의 shard */
+#define PA_COMPACT_THRESHOLD                                                   \
+        40 /** PA_COMPACT_THRESHOLD < 빈 행의 비율(%)이 이 값 이상이면 compaction을 시작한다. (0이면 하지 않는다.) */
+#define PA_COMPACT_STEP                                                        \
+        16 /** PA_COMPACT_STEP < 명령마다 compaction이 옮기는 행 또는 건너뛰는 비트맵 word 수의 한계 */
+#define PA_ID_FILTER_RATIO                                                     \
+        8 /** PA_ID_FILTER_RATIO < id 인덱스가 없는 store가 행마다 두는 id counter 수 (2의 거듭제곱) */
 
-//#define TRIVIAL /** TRIVIAL < 이것을 enable하면 TRIVIAL한 버전이 실행된다. */
+#define PA_DEFAULT_BACKEND                                                     \
+        "sorted-array" /** PA_DEFAULT_BACKEND < `-b`로 backend를 고르지 않았을 때 사용하는 backend */
 //#define DEBUG /** DEBUG < 이것을 enable하면 DEBUG 로그가 찍히게 된다. */
 
 #define FAIL_TO_SEARCH -1
 
+/**
+ * @brief 입력 파일 안의 field를 복사하지 않고 가리킨다.
+ * @warning ptr은 NUL로 끝나지 않으므로 반드시 len과 함께 사용해야 한다.
+ *
+ */
+struct pa_field {
+        const char *ptr;
+        int len; /**< len < field의 길이 (없는 field는 0) */
+};
+
+/**
+ * @brief 입력 파일의 한 행에 해당한다.
+ * @details field[0]은 COMMAND이고 field[1]부터 레코드의 값이다.
+ *
+ */
+struct pa_line {
+        struct pa_field field[PA_MAX_FIELDS];
+        int nr_fields;
+};
+
+/**
+ * @brief mmap된 입력 파일과 구분자를 찾는 위치를 가진다.
+ *
+ */
+struct pa_input {
+        const char *base; /**< base < mmap된 입력 파일의 시작 위치 */
+        size_t size;
+        size_t block; /**< block < mask가 가리키는 64 바이트 block의 위치 */
+        unsigned long long mask; /**< mask < block에서 아직 처리하지 않은 구분자의 위치 */
+        size_t start; /**< start < 현재 field의 시작 위치 */
+};
+
+int pa_input_open(struct pa_input *input, const char *path);
+int pa_input_next(struct pa_input *input, struct pa_line *line);
+void pa_input_close(struct pa_input *input);
+
+/**
+ * @brief 명령의 종류에 해당한다.
+ *
+ */
+enum pa_command_type {
+        PA_CMD_INSERT = 0,
+        PA_CMD_SEARCH,
+        PA_CMD_REMOVE,
+        PA_CMD_SEARCH_EMAIL,
+        PA_CMD_SEARCH_NAME_PREFIX,
+        PA_CMD_SCAN_COUNT,
+        PA_CMD_SCAN_SELECT,
+        PA_CMD_OTHERS,
+};
+
+/**
+ * @brief SCAN_SELECT가 고른 레코드 하나에 해당한다.
+ *
+ */
+struct pa_record {
+        int id;
+        int order; /**< order < 같은 id의 레코드 사이의 순서 (shard 안의 WP) */
+        char name[MAX_CHAR_LEN];
+        char bban[MAX_CHAR_LEN];
+        char email[MAX_CHAR_LEN];
+};
+
+/**
+ * @brief shard 하나가 고른 레코드들로 (id, order) 순서로 정렬되어 있다.
+ *
+ */
+struct pa_selection {
+        struct pa_selection *next; /**< next < 다른 shard가 고른 레코드들 (없으면 NULL) */
+        int nr_records;
+        int capacity;
+        struct pa_record *record;
+};
+
+int pa_selection_add(struct pa_selection **selection, int id, int order,
+                     const char *name, const char *bban, const char *email);
+void pa_selection_sort(struct pa_selection *selection);
+int pa_record_precede(const struct pa_record *a, const struct pa_record *b);
+void pa_selection_free(struct pa_selection *selection);
+
+/**
+ * @brief 명령을 수행한 결과로 출력 형식과는 무관하다.
+ * @details 레코드의 문자열은 복사해서 가지므로 이후의 명령이 같은 행을
+ 덮어써도 결과는 바뀌지 않는다.
+ *
+ */
+struct pa_result {
+        int status; /**< status < backend가 반환한 값 (0이 아니면 실패) */
+        int id;
+        int has_record; /**< has_record < 1이면 레코드 전체를 출력한다. */
+        char name[MAX_CHAR_LEN];
+        char bban[MAX_CHAR_LEN];
+        char email[MAX_CHAR_LEN];
+        int count; /**< count < SCAN 명령이 고른 행의 수 */
+        struct pa_selection *selection; /**< selection < SCAN_SELECT가 고른 레코드 (출력한 뒤 해제한다.) */
+};
+
+/**
+ * @brief 결과에 레코드 전체를 복사한다.
+ *
+ * @param result 결과
+ * @param id 레코드의 id
+ * @param name 레코드의 name
+ * @param bban 레코드의 bban
+ * @param email 레코드의 email
+ */
+static inline void pa_result_record(struct pa_result *result, int id,
+                                    const char *name, const char *bban,
+                                    const char *email)
+{
+        result->id = id;
+        result->has_record = 1;
+        strcpy(result->name, name);
+        strcpy(result->bban, bban);
+        strcpy(result->email, email);
+}
+
+/**
+ * @brief 결과를 모아서 한꺼번에 파일에 쓰는 출력이다.
+ * @details 비동기 모드에서는 buf를 채우는 동안 쓰기 thread가 pending을 쓴다.
+ *
+ */
+struct pa_output {
+        int fd;
+        char *buf; /**< buf < 지금 채우고 있는 버퍼 */
+        size_t len;
+        int async;
+        int error; /**< error < 처음 실패한 쓰기의 -errno (없으면 0) */
+
+        pthread_t thread;
+        pthread_mutex_t lock;
+        pthread_cond_t cond;
+        char *pending; /**< pending < 쓰기 thread에 넘긴 버퍼 (없으면 NULL) */
+        size_t pending_len;
+        char *spare; /**< spare < 쓰기가 끝나서 다시 채울 수 있는 버퍼 */
+        int closing;
+};
+
+int pa_output_open(struct pa_output *out, const char *path, int async);
+int pa_output_flush(struct pa_output *out);
+void pa_output_mem(struct pa_output *out, const char *str, size_t len);
+void pa_output_int(struct pa_output *out, int value);
+void pa_output_id(struct pa_output *out, const char *command, int id);
+void pa_output_record(struct pa_output *out, const char *command, int id,
+                      const char *name, const char *bban, const char *email);
+void pa_output_selection(struct pa_output *out,
+                         const struct pa_selection *selection);
+void pa_output_result(struct pa_output *out, enum pa_command_type type,
+                      const struct pa_result *result);
+int pa_output_close(struct pa_output *out);
+
+/**
+ * @brief NUL로 끝나는 문자열을 출력 버퍼에 추가한다.
+ *
+ * @param out 결과를 쓰는 출력
+ * @param str 추가하고자 하는 문자열
+ */
+static inline void pa_output_str(struct pa_output *out, const char *str)
+{
+        pa_output_mem(out, str, strlen(str));
+}
+
+/**
+ * @brief 문자 하나를 출력 버퍼에 추가한다.
+ *
+ * @param out 결과를 쓰는 출력
+ * @param c 추가하고자 하는 문자
+ */
+static inline void pa_output_char(struct pa_output *out, char c)
+{
+        if (out->len == PA_OUTPUT_BUFFER_SIZE) {
+                pa_output_flush(out);
+        }
+        out->buf[out->len++] = c;
+}
+
+#define PA_SNAPSHOT_MAGIC "PASNAP1" /** PA_SNAPSHOT_MAGIC < snapshot 파일의 처음 8 바이트 */
+#define PA_SNAPSHOT_VERSION 3
+#define PA_SNAPSHOT_ALIGN 64 /** PA_SNAPSHOT_ALIGN < section의 시작 위치를 맞추는 단위 */
+
+/**
+ * @brief snapshot 파일의 맨 앞에 위치한다.
+ * @details 구조체와 column을 그대로 저장하므로 같은 빌드(같은 MAX_CHAR_LEN,
+ PA_SEGMENT_BASE, byte order)에서만 읽을 수 있다.
+ *
+ */
+struct pa_snapshot_header {
+        char magic[8];
+        unsigned int version;
+        unsigned int max_char_len;
+        unsigned int segment_base;
+        unsigned int nr_shards;
+        unsigned long long size; /**< size < 파일 전체의 크기 */
+        unsigned long long store[PA_MAX_SHARDS]; /**< store < shard별 store가 저장된 section의 위치 */
+};
+
+/**
+ * @brief snapshot 파일을 쓰거나 mmap해서 읽는 상태를 가진다.
+ *
+ */
+struct pa_snapshot {
+        int fd; /**< fd < 쓰고 있는 파일 */
+        unsigned long long offset; /**< offset < 다음 section을 쓸 위치 */
+        int error; /**< error < 처음 실패한 쓰기의 -errno (없으면 0) */
+        char *base; /**< base < mmap된 snapshot (읽지 않았으면 NULL) */
+        size_t size;
+};
+
 /**
  * @brief trivial, improve의 함수를 선택할 수 있는 구조체이다.
  *
  */
 struct op {
-        int (*init)(void);
+        int (*init)(
+                void **store); /** int (*init)(void **store); < PA 하나(store)를 만든다. */
         int (*insert)(
-                char *str,
-                FILE *outp_fp); /** int (*insert)(char *str, FILE *outp_fp); < PA에 insert를 수행한다. */
+                void *store, const struct pa_line *line,
+                struct pa_result *result); /** int (*insert)(void *store, const struct pa_line *line, struct pa_result *result); < PA에 insert를 수행한다. */
         int (*search)(
-                char *str,
-                FILE *outp_fp); /** int (*search)(char *str, FILE *outp_fp); < PA에 search 수행, search도 겸한다. */
+                void *store, const struct pa_line *line,
+                struct pa_result *result); /** int (*search)(void *store, const struct pa_line *line, struct pa_result *result); < PA에 search 수행, search도 겸한다. */
         int (*remove)(
-                char *str,
-                FILE *outp_fp); /** int (*remove)(char *str, FILE *outp_fp); < PA에 remove를 수행한다. */
-        void (*free)(void);
+                void *store, const struct pa_line *line,
+                struct pa_result *result); /** int (*remove)(void *store, const struct pa_line *line, struct pa_result *result); < PA에 remove를 수행한다. */
+        int (*search_email)(
+                void *store, const struct pa_line *line,
+                struct pa_result *result); /** int (*search_email)(void *store, const struct pa_line *line, struct pa_result *result); < email이 같은 레코드 중 id가 가장 작은 것을 찾는다. */
+        int (*search_name_prefix)(
+                void *store, const struct pa_line *line,
+                struct pa_result *result); /** int (*search_name_prefix)(void *store, const struct pa_line *line, struct pa_result *result); < name이 prefix로 시작하는 레코드 중 (name, id)가 가장 작은 것을 찾는다. */
+        int (*scan_count)(
+                void *store, const struct pa_line *line,
+                struct pa_result *result); /** int (*scan_count)(void *store, const struct pa_line *line, struct pa_result *result); < 조건을 만족하는 행의 수를 센다. */
+        int (*scan_select)(
+                void *store, const struct pa_line *line,
+                struct pa_result *result); /** int (*scan_select)(void *store, const struct pa_line *line, struct pa_result *result); < 조건을 만족하는 행을 모두 고른다. */
+        void (*free)(void *store);
         int (*get_current_usage)(
-                void); /** int (*get_current_usage)(void); < PA의 현재 메모리 사용량을 보여준다.(DEBUG 전용) */
-};
-
-#ifdef TRIVIAL
-int trivial_init(void);
-int trivial_insert(char *str, FILE *outp_fp);
-int trivial_search(char *str, FILE *outp_fp);
-int trivial_remove(char *str, FILE *outp_fp);
-int trivial_get_current_usage();
-void trivial_free(void);
-#else
-int improve_init(void);
-int improve_insert(char *str, FILE *outp_fp);
-int improve_search(char *str, FILE *outp_fp);
-int improve_remove(char *str, FILE *outp_fp);
-int improve_get_current_usage();
-void improve_free(void);
-#endif
+                void *store); /** int (*get_current_usage)(void *store); < PA의 현재 메모리 사용량을 보여준다.(DEBUG 전용) */
+        int (*get_fragmentation)(
+                void *store); /** int (*get_fragmentation)(void *store); < 초기화된 행 중 빈 행의 비율(%)을 보여준다. (없으면 NULL) */
+        int (*save)(
+                void *store, struct pa_snapshot *snapshot,
+                unsigned long long *offset); /** int (*save)(void *store, struct pa_snapshot *snapshot, unsigned long long *offset); < store를 snapshot에 쓴다. (없으면 NULL) */
+        int (*load)(
+                void **store, const struct pa_snapshot *snapshot,
+                unsigned long long offset); /** int (*load)(void **store, const struct pa_snapshot *snapshot, unsigned long long offset); < mmap된 snapshot으로 store를 만든다. (없으면 NULL) */
+};
+
+unsigned long long pa_snapshot_write(struct pa_snapshot *snapshot,
+                                     const void *data, size_t len,
+                                     size_t reserve);
+void *pa_snapshot_ptr(const struct pa_snapshot *snapshot,
+                      unsigned long long offset, size_t len);
+int pa_snapshot_save(const char *path, const struct op *operation,
+                     void **stores, int nr_shards);
+int pa_snapshot_load(struct pa_snapshot *snapshot, const char *path,
+                     const struct op *operation, void **stores,
+                     int *nr_shards);
+void pa_snapshot_close(struct pa_snapshot *snapshot);
+
+/**
+ * @brief id 해시 인덱스의 항목에 해당한다.
+ *
+ */
+struct pa_hash_entry {
+        int id;
+        int wp; /**< wp < id가 위치한 PA의 index */
+        unsigned int dist; /**< dist < home bucket으로부터의 거리 + 1 (0이면 빈 bucket) */
+};
 
 /**
- * @brief CSV 값을 하나하나 읽어오도록 한다.
- * @warning 원본이 수정되므로 유의해야 한다.
+ * @brief id를 WP로 바꾸어 주는 Robin Hood 해시 인덱스이다.
  *
- * @param strptr 현재 field를 가져오고자 하는 CSV 행
- * @param delim field를 나누는 기준 값
- * @return char* field에 해당하는 포인터
  */
-static inline char *get_csv_field(char **strptr, const char *delim)
+struct pa_hash {
+        struct pa_hash_entry *entries;
+        unsigned int mask; /**< mask < bucket 수 - 1 (bucket 수는 2의 거듭제곱) */
+        int nr_entries; /**< nr_entries < 두 테이블에 있는 전체 항목 수 */
+        struct pa_hash_entry *old; /**< old < 옮기는 중인 이전 테이블 (없으면 NULL) */
+        unsigned int old_mask;
+        unsigned int cursor; /**< cursor < 다음에 옮길 이전 테이블의 bucket */
+        int nr_old; /**< nr_old < 이전 테이블에 남은 항목 수 */
+        struct pa_hash_entry *borrowed; /**< borrowed < snapshot에서 빌려와서 해제하지 않는 테이블 */
+};
+
+/**
+ * @brief id를 섞어서 해시 값을 만든다.
+ * @details 연속된 id가 연속된 bucket에 몰리지 않도록 murmur3의 finalizer를
+ 사용한다.
+ *
+ * @param id 해시 값을 구하고자 하는 id
+ * @return unsigned int 해시 값
+ */
+static inline unsigned int pa_hash_mix(int id)
 {
-        char *ptr = *strptr;
+        unsigned int h = (unsigned int)id;
 
-        if (ptr == NULL) {
-                return NULL;
-        }
+        h ^= h >> 16;
+        h *= 0x85ebca6bU;
+        h ^= h >> 13;
+        h *= 0xc2b2ae35U;
+        h ^= h >> 16;
+        return h;
+}
+
+int pa_hash_init(struct pa_hash *hash, int capacity);
+int pa_hash_insert(struct pa_hash *hash, int id, int wp);
+int pa_hash_find(const struct pa_hash *hash, int id);
+void pa_hash_find_each(const struct pa_hash *hash, int id,
+                       void (*visit)(void *arg, int wp), void *arg);
+int pa_hash_remove(struct pa_hash *hash, int id, int wp);
+int pa_hash_move(struct pa_hash *hash, int id, int wp, int new_wp);
+void pa_hash_settle(struct pa_hash *hash);
+void pa_hash_attach(struct pa_hash *hash, struct pa_hash_entry *entries,
+                    unsigned int mask, int nr_entries);
+void pa_hash_free(struct pa_hash *hash);
+
+/**
+ * @brief 정렬된 인덱스의 node 하나에 해당한다.
+ *
+ */
+struct pa_sorted_node {
+        unsigned long long prefix; /**< prefix < 문자열의 앞 8 바이트 (big endian) */
+        int id;
+        int wp;
+        int left; /**< left < 왼쪽 자식의 index (없으면 -1) */
+        int right;
+        unsigned int priority;
+};
+
+/**
+ * @brief (문자열, id, WP)의 순서를 유지하는 treap 인덱스이다.
+ *
+ */
+struct pa_sorted {
+        struct pa_sorted_node *nodes;
+        int capacity;
+        int nr_nodes; /**< nr_nodes < 한 번이라도 사용된 node의 수 */
+        int free_node; /**< free_node < 지워진 node 목록의 처음 (없으면 -1) */
+        int root;
+        int nr_entries;
+        unsigned int seed;
+        struct pa_sorted_node *borrowed; /**< borrowed < snapshot에서 빌려와서 해제하지 않는 배열 */
+        const char *(*key)(void *arg, int wp); /**< key < WP 행의 문자열을 가져온다. */
+        void *arg;
+};
+
+int pa_sorted_init(struct pa_sorted *sorted, int capacity,
+                   const char *(*key)(void *arg, int wp), void *arg);
+int pa_sorted_insert(struct pa_sorted *sorted, const char *str, int id,
+                     int wp);
+int pa_sorted_remove(struct pa_sorted *sorted, const char *str, int id,
+                     int wp);
+int pa_sorted_move(struct pa_sorted *sorted, const char *str, int id, int wp,
+                   int new_wp);
+int pa_sorted_lower_bound(const struct pa_sorted *sorted, const char *str);
+void pa_sorted_attach(struct pa_sorted *sorted, struct pa_sorted_node *nodes,
+                      int nr_nodes, int root, int free_node, int nr_entries,
+                      const char *(*key)(void *arg, int wp), void *arg);
+void pa_sorted_free(struct pa_sorted *sorted);
+
+#define PA_BITMAP_WORD_BITS 64 /** PA_BITMAP_WORD_BITS < unsigned long long의 비트 수 */
+#define PA_BITMAP_WORD_FULL (~0ULL)
+#define PA_BITMAP_MAX_LEVEL 6 /** PA_BITMAP_MAX_LEVEL < 64^6 > INT_MAX 이므로 충분하다. */
+#define PA_SCAN_BLOCK                                                          \
+        PA_BITMAP_WORD_BITS /** PA_SCAN_BLOCK < 조건을 한 번에 확인하는 행의 수 (비트맵 word 하나) */
+
+/**
+ * @brief SCAN 명령의 조건의 종류에 해당한다.
+ *
+ */
+enum pa_predicate_type {
+        PA_PREDICATE_ID = 0,
+        PA_PREDICATE_EMAIL_DOMAIN,
+        PA_PREDICATE_NAME_PREFIX,
+};
+
+/**
+ * @brief SCAN 명령의 조건이다.
+ *
+ */
+struct pa_predicate {
+        enum pa_predicate_type type;
+        int lo; /**< lo < id 범위의 시작 (포함) */
+        int hi; /**< hi < id 범위의 끝 (포함) */
+        int len; /**< len < str의 길이 */
+        char str[MAX_CHAR_LEN]; /**< str < email domain 또는 name prefix (뒤는 0으로 채운다.) */
+};
+
+int pa_predicate_parse(struct pa_predicate *predicate,
+                       const struct pa_line *line);
+int pa_predicate_test(const struct pa_predicate *predicate, int id,
+                      const char *name, const char *email);
+unsigned long long pa_predicate_block(const struct pa_predicate *predicate,
+                                      const int *id,
+                                      const char (*name)[MAX_CHAR_LEN],
+                                      const char (*email)[MAX_CHAR_LEN]);
 
-        while (**strptr) {
-                if (strchr(delim, **strptr) != NULL) {
-                        **strptr = 0x00;
-                        (*strptr)++;
-                        return ptr;
-                }
-                (*strptr)++;
+/**
+ * @brief 가장 앞의 빈 비트를 O(1)에 찾는 계층형 비트맵이다.
+ *
+ */
+struct pa_bitmap {
+        unsigned long long *level[PA_BITMAP_MAX_LEVEL]; /**< level < level[0]은 행마다 한 비트, level[k]는 아래 word가 가득 찼는지 */
+        int nr_levels;
+        int nr_bits;
+};
+
+int pa_bitmap_init(struct pa_bitmap *bitmap, int nr_bits);
+void pa_bitmap_set(struct pa_bitmap *bitmap, int bit);
+void pa_bitmap_clear(struct pa_bitmap *bitmap, int bit);
+int pa_bitmap_find_zero(const struct pa_bitmap *bitmap);
+int pa_bitmap_count(const struct pa_bitmap *bitmap);
+void pa_bitmap_free(struct pa_bitmap *bitmap);
+
+/**
+ * @brief 비트가 사용 중인지 확인한다.
+ *
+ * @param bitmap 비트맵
+ * @param bit 확인할 비트
+ * @return int 사용 중이면 1을, 그렇지 않으면 0을 반환한다.
+ */
+static inline int pa_bitmap_test(const struct pa_bitmap *bitmap, int bit)
+{
+        return (bitmap->level[0][bit / PA_BITMAP_WORD_BITS] >>
+                (bit % PA_BITMAP_WORD_BITS)) &
+               1;
+}
+
+/**
+ * @brief 모든 비트가 사용 중인지 확인한다.
+ *
+ * @param bitmap 비트맵
+ * @return int 가득 찼으면 1을, 그렇지 않으면 0을 반환한다.
+ */
+static inline int pa_bitmap_full(const struct pa_bitmap *bitmap)
+{
+        return bitmap->level[bitmap->nr_levels - 1][0] == PA_BITMAP_WORD_FULL;
+}
+
+/**
+ * @brief 단계 사이에서 포인터를 넘기는 lock-free 단일 생산자/단일 소비자 ring이다.
+ * @details head와 tail을 다른 cache line에 두어서 두 thread가 서로의 cache
+ line을 빼앗지 않도록 한다.
+ *
+ */
+struct pa_ring {
+        void **slot;
+        unsigned int mask; /**< mask < slot 수 - 1 (slot 수는 2의 거듭제곱) */
+        _Atomic unsigned int head
+                __attribute__((aligned(64))); /**< head < 소비자가 다음에 꺼낼 위치 */
+        _Atomic unsigned int tail
+                __attribute__((aligned(64))); /**< tail < 생산자가 다음에 넣을 위치 */
+};
+
+int pa_ring_init(struct pa_ring *ring, unsigned int size);
+void pa_ring_push(struct pa_ring *ring, void *ptr);
+void *pa_ring_pop(struct pa_ring *ring);
+void pa_ring_free(struct pa_ring *ring);
+
+/**
+ * @brief pipeline의 단계 사이에서 넘겨지는 명령 하나에 해당한다.
+ * @details 이웃한 명령을 서로 다른 shard가 수행하므로, 결과를 쓰는 cache line을
+ 공유하지 않도록 cache line 단위로 정렬한다.
+ *
+ */
+struct pa_command {
+        enum pa_command_type type;
+        int shard; /**< shard < 명령을 수행할 shard (수행할 필요가 없으면 -1) */
+        int gather; /**< gather < shard가 PA_SHARD_ALL이면 shard별 결과의 위치 */
+        unsigned int latency; /**< latency < 명령을 수행하는 데 걸린 시간(ns, 통계를 모을 때만) */
+        struct pa_line line;
+        struct pa_result result;
+} __attribute__((aligned(64)));
+
+struct pa_batch;
+
+/**
+ * @brief batch 중에서 shard 하나가 수행할 명령들이다.
+ * @details 수행 thread는 자신의 명령만 입력 순서대로 수행하고, 모든 shard가
+ 수행하는 명령의 결과는 명령 대신 gathered에 써 둔다. 출력 thread가 done을
+ 확인한 뒤 이를 합친다.
+ *
+ */
+struct pa_shard_batch {
+        struct pa_batch *batch;
+        int nr_commands;
+        atomic_int done
+                __attribute__((aligned(64))); /**< done < 1이면 shard가 명령을 모두 수행했다. */
+        unsigned short index[PA_BATCH_SIZE]; /**< index < 수행할 명령의 batch 안 위치 */
+        struct pa_result gathered[PA_BATCH_GATHER];
+        unsigned int latency[PA_BATCH_GATHER]; /**< latency < gathered를 구하는 데 걸린 시간(ns) */
+};
+
+/**
+ * @brief pipeline의 단계 사이에서 한 번에 넘겨지는 명령의 묶음이다.
+ *
+ */
+struct pa_batch {
+        int nr_commands;
+        int last; /**< last < 1이면 입력의 마지막 batch이다. */
+        int nr_gathers; /**< nr_gathers < 모든 shard가 수행하는 명령의 수 */
+        struct pa_shard_batch *shard; /**< shard < shard별 명령 (nr_shards개) */
+        struct pa_command command[PA_BATCH_SIZE];
+};
+
+/**
+ * @brief pipeline을 한 번 수행한 처리량과 명령별 지연 시간이다.
+ *
+ */
+struct pa_stats {
+        int nr_commands; /**< nr_commands < 출력한 명령의 수 */
+        double elapsed; /**< elapsed < pipeline을 수행한 실제 시간(s) */
+        unsigned int *latency; /**< latency < 입력 순서대로 명령을 수행하는 데 걸린 시간(ns) */
+        int capacity; /**< capacity < latency 배열의 크기 */
+        int sorted; /**< sorted < latency가 이미 오름차순으로 정렬되었으면 1 */
+};
+
+int pa_pipeline_nr_cpus(void);
+int pa_pipeline_run(struct pa_input *input, int nr_commands,
+                    const struct op *operation, void **stores, int nr_shards,
+                    struct pa_output *output, clock_t start,
+                    struct pa_stats *stats);
+
+/**
+ * @brief 명령행에서 이름으로 고를 수 있는 backend이다.
+ *
+ */
+struct pa_backend {
+        const char *name;
+        const char *description;
+        int sharded; /**< sharded < 0이면 전역 변수를 사용하므로 shard를 하나만 만든다. */
+        struct op operation;
+};
+
+extern const struct pa_backend pa_backends[];
+extern const int pa_nr_backends;
+const struct pa_backend *pa_backend_find(const char *name);
+
+int pa_stats_init(struct pa_stats *stats, int nr_commands);
+unsigned int pa_stats_percentile(struct pa_stats *stats, double percent);
+void pa_stats_free(struct pa_stats *stats);
+int pa_bench_diff(const char *path_a, const char *path_b);
+
+int trivial_init(void **store);
+int trivial_insert(void *store, const struct pa_line *line,
+                   struct pa_result *result);
+int trivial_search(void *store, const struct pa_line *line,
+                   struct pa_result *result);
+int trivial_remove(void *store, const struct pa_line *line,
+                   struct pa_result *result);
+int trivial_search_email(void *store, const struct pa_line *line,
+                         struct pa_result *result);
+int trivial_search_name_prefix(void *store, const struct pa_line *line,
+                               struct pa_result *result);
+int trivial_scan_count(void *store, const struct pa_line *line,
+                       struct pa_result *result);
+int trivial_scan_select(void *store, const struct pa_line *line,
+                        struct pa_result *result);
+int trivial_get_current_usage(void *store);
+void trivial_free(void *store);
+
+int improve_bitmap_init(void **store);
+int improve_hashed_init(void **store);
+int improve_init(void **store);
+int improve_insert(void *store, const struct pa_line *line,
+                   struct pa_result *result);
+int improve_search(void *store, const struct pa_line *line,
+                   struct pa_result *result);
+int improve_remove(void *store, const struct pa_line *line,
+                   struct pa_result *result);
+int improve_search_email(void *store, const struct pa_line *line,
+                         struct pa_result *result);
+int improve_search_name_prefix(void *store, const struct pa_line *line,
+                               struct pa_result *result);
+int improve_scan_count(void *store, const struct pa_line *line,
+                       struct pa_result *result);
+int improve_scan_select(void *store, const struct pa_line *line,
+                        struct pa_result *result);
+int improve_get_current_usage(void *store);
+int improve_get_fragmentation(void *store);
+int improve_save(void *store, struct pa_snapshot *snapshot,
+                 unsigned long long *offset);
+int improve_bitmap_load(void **store, const struct pa_snapshot *snapshot,
+                        unsigned long long offset);
+int improve_hashed_load(void **store, const struct pa_snapshot *snapshot,
+                        unsigned long long offset);
+int improve_load(void **store, const struct pa_snapshot *snapshot,
+                 unsigned long long offset);
+void improve_free(void *store);
+
+/**
+ * @brief field가 COMMAND 문자열과 같은지 확인한다.
+ *
+ * @param field 확인하고자 하는 field
+ * @param str NUL로 끝나는 COMMAND 문자열
+ * @return int 같으면 1을, 그렇지 않으면 0을 반환한다.
+ */
+static inline int pa_field_equal(const struct pa_field *field, const char *str)
+{
+        return (size_t)field->len == strlen(str) &&
+               memcmp(field->ptr, str, field->len) == 0;
+}
+
+/**
+ * @brief field를 정수로 바꾼다.
+ * @details `atoi`와 같이 앞의 공백과 부호를 허용하고 숫자가 아닌 문자에서
+ 멈추지만, field의 길이를 넘어서 읽지 않는다.
+ *
+ * @param field 바꾸고자 하는 field
+ * @return int field의 정수 값 (숫자가 없으면 0)
+ */
+static inline int pa_field_atoi(const struct pa_field *field)
+{
+        const char *ptr = field->ptr, *end = field->ptr + field->len;
+        unsigned int value = 0;
+        int negative = 0;
+
+        while (ptr < end && (*ptr == ' ' || (*ptr >= '\t' && *ptr <= '\r'))) {
+                ptr++;
         }
-        *strptr = NULL;
+        if (ptr < end && (*ptr == '-' || *ptr == '+')) {
+                negative = (*ptr++ == '-');
+        }
+        while (ptr < end && *ptr >= '0' && *ptr <= '9') {
+                value = value * 10 + (unsigned int)(*ptr++ - '0');
+        }
+        return (int)(negative ? 0U - value : value);
+}
+
+/**
+ * @brief field를 PA의 문자열 원소에 복사한다.
+ *
+ * @param dest 쓰고자 하는 PA의 원소 (MAX_CHAR_LEN 바이트)
+ * @param field 복사하고자 하는 field
+ */
+static inline void pa_field_copy(char *dest, const struct pa_field *field)
+{
+        int len = (field->len < MAX_CHAR_LEN ? field->len : MAX_CHAR_LEN - 1);
 
-        return ptr;
+        memcpy(dest, field->ptr, len);
+        dest[len] = 0x00; /**< 옆 행의 문자열과 붙지 않도록 한다. */
 }
 
 #endif
@@ -0,0 +1,82 @@
+/**
+ * @file bench-btree.c
+ * @author BlaCkinkGJ (ss5kijun@gmail.com)
+ * @brief B-Tree wrapper for the benchmark driver
+ * @version 0.1
+ * @date 2020-06-17
+ * 
+ * @copyright Copyright (c) 2020 BlaCkinkGJ
+ * 
+ */
+#include "btree.h"
+#include "bench-btree.h"
+
+/**
+ * @brief Allocate the B-Tree which has the keys
+ * 
+ * @param keys keys in insert order (must fit in B-Tree's key_t)
+ * @param nr_keys number of keys
+ * @return void* B-Tree
+ */
+void *bench_btree_alloc(uint64_t *keys, size_t nr_keys)
+{
+        struct btree *tree = btree_alloc(BENCH_BTREE_MIN_DEGREE);
+        size_t i;
+
+        if (!tree) {
+                return NULL;
+        }
+        for (i = 0; i < nr_keys; i++) {
+                btree_insert(tree, (key_t)keys[i], NULL);
+        }
+
+        return tree;
+}
+
+/**
+ * @brief Search the key in the B-Tree
+ * 
+ * @param tree B-Tree
+ * @param key key which want to find
+ * @return int 1 if the key exists
+ */
+int bench_btree_search(void *tree, uint64_t key)
+{
+        return btree_search((struct btree *)tree, (key_t)key).node != NULL;
+}
+
+/**
+ * @brief Count the nodes which the search of the key visits
+ * 
+ * @param tree B-Tree
+ * @param key key which want to find
+ * @return size_t number of visited nodes
+ */
+size_t bench_btree_visits(void *tree, uint64_t key)
+{
+        struct btree_node *x = ((struct btree *)tree)->root;
+        size_t visits = 0;
+        int i;
+
+        while (x) {
+                visits++;
+                for (i = 0; i < x->n && (key_t)key > x->items[i].key; i++)
+                        ;
+                if ((i < x->n && (key_t)key == x->items[i].key) || x->is_leaf) {
+                        break;
+                }
+                x = x->child[i];
+        }
+
+        return visits;
+}
+
+/**
+ * @brief Deallocate the B-Tree
+ * 
+ * @param tree B-Tree
+ */
+void bench_btree_dealloc(void *tree)
+{
+        btree_free((struct btree *)tree);
+}
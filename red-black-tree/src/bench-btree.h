@@ -0,0 +1,27 @@
+/**
+ * @file bench-btree.h
+ * @author BlaCkinkGJ (ss5kijun@gmail.com)
+ * @brief B-Tree wrapper for the benchmark driver
+ * @details B-Tree's header defines its own key_t and pr_info, so it can't
+ * be included with rb-tree.h. The wrapper hides the B-Tree in its own
+ * translation unit and uses uint64_t keys.
+ * @version 0.1
+ * @date 2020-06-17
+ * 
+ * @copyright Copyright (c) 2020 BlaCkinkGJ
+ * 
+ */
+#ifndef BENCH_BTREE_H_
+#define BENCH_BTREE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define BENCH_BTREE_MIN_DEGREE (16) /**< node size is about a few cache lines */
+
+void *bench_btree_alloc(uint64_t *keys, size_t nr_keys);
+int bench_btree_search(void *tree, uint64_t key);
+size_t bench_btree_visits(void *tree, uint64_t key);
+void bench_btree_dealloc(void *tree);
+
+#endif
@@ -0,0 +1,110 @@
+/**
+ * @file bench-perf.c
+ * @author BlaCkinkGJ (ss5kijun@gmail.com)
+ * @brief timer and hardware counter for the benchmark driver
+ * @details Cache misses are counted by perf_event_open(2). If the kernel
+ * or the container doesn't allow it, the counter is reported as not
+ * supported and the benchmark still runs.
+ * @version 0.1
+ * @date 2020-06-17
+ * 
+ * @copyright Copyright (c) 2020 BlaCkinkGJ
+ * 
+ */
+#define _GNU_SOURCE
+#include <string.h>
+#include <time.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "bench-perf.h"
+
+/**
+ * @brief Open the hardware cache miss counter of this process
+ * 
+ * @return int file descriptor. -1 if the counter is not supported
+ */
+int bench_perf_open(void)
+{
+#ifdef __linux__
+        struct perf_event_attr attr;
+
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+        return -1;
+#endif
+}
+
+/**
+ * @brief Reset and enable the counter
+ * 
+ * @param fd counter's file descriptor
+ */
+void bench_perf_start(int fd)
+{
+#ifdef __linux__
+        if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#else
+        (void)fd;
+#endif
+}
+
+/**
+ * @brief Stop the counter and read it
+ * 
+ * @param fd counter's file descriptor
+ * @return long long number of cache misses. -1 if not supported
+ */
+long long bench_perf_stop(int fd)
+{
+        long long count = -1;
+#ifdef __linux__
+        if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+                if (read(fd, &count, sizeof(count)) != sizeof(count)) {
+                        count = -1;
+                }
+        }
+#else
+        (void)fd;
+#endif
+        return count;
+}
+
+void bench_perf_close(int fd)
+{
+#ifdef __linux__
+        if (fd >= 0) {
+                close(fd);
+        }
+#else
+        (void)fd;
+#endif
+}
+
+/**
+ * @brief Get the monotonic time
+ * 
+ * @return double time in nanoseconds
+ */
+double bench_now(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
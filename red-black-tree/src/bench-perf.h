@@ -0,0 +1,22 @@
+/**
+ * @file bench-perf.h
+ * @author BlaCkinkGJ (ss5kijun@gmail.com)
+ * @brief timer and hardware counter for the benchmark driver
+ * @details POSIX headers define their own key_t when the system interfaces
+ * are enabled, so they are used only in this translation unit.
+ * @version 0.1
+ * @date 2020-06-17
+ * 
+ * @copyright Copyright (c) 2020 BlaCkinkGJ
+ * 
+ */
+#ifndef BENCH_PERF_H_
+#define BENCH_PERF_H_
+
+int bench_perf_open(void);
+void bench_perf_start(int fd);
+long long bench_perf_stop(int fd);
+void bench_perf_close(int fd);
+double bench_now(void);
+
+#endif
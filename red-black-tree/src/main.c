@@ -2,15 +2,508 @@
  * @file main.c
  * @author BlaCkinkGJ (ss5kijun@gmail.com)
  * @brief driver program for rb-tree
+ * @details Runs the standard access sequences against each search tree and
+ * reports the cost of the access. Each (sequence, tree) pair is run twice
+ * on the fresh tree. First run is timed (and counts cache misses), second
+ * run counts nodes on the access path and the preferred child switches.
+ *
+ * usage: run.out [nr_keys] [nr_ops] [seed]
  * @version 0.1
  * @date 2020-05-29
- * 
+ *
  * @copyright Copyright (c) 2020 BlaCkinkGJ
- * 
+ *
+ * @ref Wilber, R. (1989). Lower bounds for accessing binary search trees with rotations.
+ * @ref Demaine, E. D., Harmon, D., Iacono, J., & Pătraşcu, M. (2007). Dynamic optimality—almost.
  */
 #include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
 
-int main(void)
+#include "rb-tree.h"
+#include "tg-tree.h"
+#include "sp-tree.h"
+#include "ms-tree.h"
+#include "bench-btree.h"
+#include "bench-perf.h"
+
+#define BENCH_DEFAULT_KEYS (1 << 16)
+#define BENCH_DEFAULT_OPS (1 << 16)
+#define BENCH_WORKING_SET (64) /**< size of the working-set window */
+#define BENCH_FINGER_DISTANCE (16) /**< maximum distance of the dynamic finger */
+#define BENCH_ZIPF_SKEW (1.0)
+
+/**
+ * @brief Search tree which is compared by the benchmark
+ *
+ */
+struct bench_tree {
+        const char *name;
+        void *(*alloc)(key_t *keys, size_t nr_keys);
+        int (*search)(void *tree, key_t key); /**< 1 if the key exists */
+        /** number of nodes on the access path (called before the search) */
+        size_t (*visits)(void *tree, key_t key);
+        size_t (*switches)(void *tree); /**< NULL if not a path based tree */
+        void (*dealloc)(void *tree);
+};
+
+/**
+ * @brief Access sequence generator
+ *
+ */
+struct bench_sequence {
+        const char *name;
+        void (*generate)(key_t *seq, size_t nr_ops, size_t nr_keys);
+};
+
+static uint64_t bench_seed = 1;
+
+/**
+ * @brief Reproducible pseudo random number generator (xorshift64*)
+ *
+ * @return uint64_t random number
+ */
+static uint64_t bench_rand(void)
+{
+        bench_seed ^= bench_seed >> 12;
+        bench_seed ^= bench_seed << 25;
+        bench_seed ^= bench_seed >> 27;
+        return bench_seed * 2685821657736338717ULL;
+}
+
+static void bench_shuffle(key_t *keys, size_t nr_keys)
+{
+        size_t i, j;
+        key_t temp;
+
+        for (i = nr_keys; i > 1; i--) {
+                j = bench_rand() % i;
+                temp = keys[i - 1];
+                keys[i - 1] = keys[j];
+                keys[j] = temp;
+        }
+}
+
+/**
+ * @brief Count the nodes on the search path of the red-black tree
+ */
+static size_t bench_rb_path(struct rb_tree *tree, key_t key)
+{
+        struct rb_node *x = tree->root;
+        size_t visits = 0;
+
+        while (x != tree->nil) {
+                visits++;
+                if (key == x->key) {
+                        break;
+                }
+                x = (key < x->key ? x->left : x->right);
+        }
+        return visits;
+}
+
+static void *bench_rb_alloc(key_t *keys, size_t nr_keys)
+{
+        struct rb_tree *tree = rb_tree_alloc();
+        size_t i;
+
+        for (i = 0; tree && i < nr_keys; i++) {
+                if (rb_tree_insert(tree, keys[i], NULL)) {
+                        rb_tree_dealloc(tree);
+                        return NULL;
+                }
+        }
+        return tree;
+}
+
+static int bench_rb_search(void *tree, key_t key)
+{
+        return rb_tree_search((struct rb_tree *)tree, key) != NULL;
+}
+
+static size_t bench_rb_visits(void *tree, key_t key)
+{
+        return bench_rb_path((struct rb_tree *)tree, key);
+}
+
+static void bench_rb_dealloc(void *tree)
+{
+        rb_tree_dealloc((struct rb_tree *)tree);
+}
+
+static void *bench_tg_alloc(key_t *keys, size_t nr_keys)
+{
+        return tg_tree_alloc(keys, nr_keys);
+}
+
+static int bench_tg_search(void *tree, key_t key)
+{
+        return tg_tree_search((struct tg_tree *)tree, key) != NULL;
+}
+
+/**
+ * @brief Count the auxiliary nodes which the tango search visits
+ * @details Search visits the auxiliary tree of each preferred path which
+ * the reference tree's search path passes.
+ */
+static size_t bench_tg_visits(void *tree, key_t key)
+{
+        struct tg_bst_node *x = ((struct tg_tree *)tree)->ref->root;
+        size_t visits = 0;
+
+        while (x) {
+                if (x->path) {
+                        visits += bench_rb_path(x->path->aux, key);
+                }
+                if (key == x->key) {
+                        break;
+                }
+                x = (key < x->key ? x->left : x->right);
+        }
+        return visits;
+}
+
+static size_t bench_tg_switches(void *tree)
+{
+        return ((struct tg_tree *)tree)->nr_switches;
+}
+
+static void bench_tg_dealloc(void *tree)
+{
+        tg_tree_dealloc((struct tg_tree *)tree);
+}
+
+static void *bench_sp_alloc(key_t *keys, size_t nr_keys)
+{
+        struct sp_tree *tree = sp_tree_alloc();
+        size_t i;
+
+        for (i = 0; tree && i < nr_keys; i++) {
+                if (sp_tree_insert(tree, keys[i], NULL)) {
+                        sp_tree_dealloc(tree);
+                        return NULL;
+                }
+        }
+        return tree;
+}
+
+static int bench_sp_search(void *tree, key_t key)
+{
+        return sp_tree_search((struct sp_tree *)tree, key) != NULL;
+}
+
+static size_t bench_sp_visits(void *tree, key_t key)
+{
+        struct sp_node *x = ((struct sp_tree *)tree)->root;
+        size_t visits = 0;
+
+        while (x) {
+                visits++;
+                if (key == x->key) {
+                        break;
+                }
+                x = (key < x->key ? x->left : x->right);
+        }
+        return visits;
+}
+
+static void bench_sp_dealloc(void *tree)
+{
+        sp_tree_dealloc((struct sp_tree *)tree);
+}
+
+static void *bench_ms_alloc(key_t *keys, size_t nr_keys)
+{
+        return ms_tree_alloc(keys, nr_keys);
+}
+
+static int bench_ms_search(void *tree, key_t key)
 {
+        return ms_tree_search((struct ms_tree *)tree, key) != NULL;
+}
+
+/**
+ * @brief Count the nodes on the search path of the whole multi-splay tree
+ */
+static size_t bench_ms_visits(void *tree, key_t key)
+{
+        struct ms_node *x = ((struct ms_tree *)tree)->root;
+        size_t visits = 0;
+
+        while (x) {
+                visits++;
+                if (key == x->key) {
+                        break;
+                }
+                x = (key < x->key ? x->left : x->right);
+        }
+        return visits;
+}
+
+static size_t bench_ms_switches(void *tree)
+{
+        return ((struct ms_tree *)tree)->nr_switches;
+}
+
+static void bench_ms_dealloc(void *tree)
+{
+        ms_tree_dealloc((struct ms_tree *)tree);
+}
+
+static void *bench_bt_alloc(key_t *keys, size_t nr_keys)
+{
+        return bench_btree_alloc(keys, nr_keys);
+}
+
+static const struct bench_tree bench_trees[] = {
+        { "rb-tree", bench_rb_alloc, bench_rb_search, bench_rb_visits, NULL,
+          bench_rb_dealloc },
+        { "tango", bench_tg_alloc, bench_tg_search, bench_tg_visits,
+          bench_tg_switches, bench_tg_dealloc },
+        { "b-tree", bench_bt_alloc, bench_btree_search, bench_btree_visits,
+          NULL, bench_btree_dealloc },
+        { "splay", bench_sp_alloc, bench_sp_search, bench_sp_visits, NULL,
+          bench_sp_dealloc },
+        { "multi-splay", bench_ms_alloc, bench_ms_search, bench_ms_visits,
+          bench_ms_switches, bench_ms_dealloc },
+};
+
+static void bench_sequential(key_t *seq, size_t nr_ops, size_t nr_keys)
+{
+        size_t i;
+
+        for (i = 0; i < nr_ops; i++) {
+                seq[i] = i % nr_keys;
+        }
+}
+
+/**
+ * @brief Bit-reversal permutation which is the worst case of Wilber's
+ * first lower bound (every access switches O(log n) preferred children)
+ */
+static void bench_bit_reversal(key_t *seq, size_t nr_ops, size_t nr_keys)
+{
+        size_t bits = 0, i = 0, j = 0, b;
+        key_t key;
+
+        while (((size_t)1 << bits) < nr_keys) {
+                bits++;
+        }
+
+        while (i < nr_ops) {
+                for (key = 0, b = 0; b < bits; b++) {
+                        key |= (key_t)((j >> b) & 1) << (bits - 1 - b);
+                }
+                j = (j + 1) & (((size_t)1 << bits) - 1);
+                if (key < nr_keys) {
+                        seq[i++] = key;
+                }
+        }
+}
+
+/**
+ * @brief Access in the small window which slides slowly
+ */
+static void bench_working_set(key_t *seq, size_t nr_ops, size_t nr_keys)
+{
+        key_t window[BENCH_WORKING_SET];
+        size_t i;
+
+        for (i = 0; i < BENCH_WORKING_SET; i++) {
+                window[i] = bench_rand() % nr_keys;
+        }
+        for (i = 0; i < nr_ops; i++) {
+                if (i % BENCH_WORKING_SET == 0) {
+                        window[bench_rand() % BENCH_WORKING_SET] =
+                                bench_rand() % nr_keys;
+                }
+                seq[i] = window[bench_rand() % BENCH_WORKING_SET];
+        }
+}
+
+/**
+ * @brief Zipf distribution whose popular keys are scattered in key space
+ */
+static void bench_zipf(key_t *seq, size_t nr_ops, size_t nr_keys)
+{
+        double *cdf = (double *)malloc(sizeof(double) * nr_keys);
+        key_t *rank = (key_t *)malloc(sizeof(key_t) * nr_keys);
+        double sum = 0.0, u;
+        size_t i, lo, hi, mid;
+
+        if (!cdf || !rank) {
+                pr_info("Memory allocation failed\n");
+                bench_sequential(seq, nr_ops, nr_keys);
+                goto exception;
+        }
+
+        for (i = 0; i < nr_keys; i++) {
+                sum += 1.0 / pow((double)(i + 1), BENCH_ZIPF_SKEW);
+                cdf[i] = sum;
+                rank[i] = i;
+        }
+        bench_shuffle(rank, nr_keys);
+
+        for (i = 0; i < nr_ops; i++) {
+                u = (double)(bench_rand() >> 11) / (double)(1ULL << 53) * sum;
+                lo = 0;
+                hi = nr_keys - 1;
+                while (lo < hi) {
+                        mid = lo + (hi - lo) / 2;
+                        if (cdf[mid] < u) {
+                                lo = mid + 1;
+                        } else {
+                                hi = mid;
+                        }
+                }
+                seq[i] = rank[lo];
+        }
+
+exception:
+        free(cdf);
+        free(rank);
+}
+
+/**
+ * @brief Each access is near the previous access (dynamic finger)
+ */
+static void bench_dynamic_finger(key_t *seq, size_t nr_ops, size_t nr_keys)
+{
+        key_t key = bench_rand() % nr_keys;
+        size_t i, distance;
+
+        for (i = 0; i < nr_ops; i++) {
+                distance = bench_rand() % (2 * BENCH_FINGER_DISTANCE + 1);
+                key = (key + nr_keys + distance - BENCH_FINGER_DISTANCE) %
+                      nr_keys;
+                seq[i] = key;
+        }
+}
+
+static const struct bench_sequence bench_sequences[] = {
+        { "sequential", bench_sequential },
+        { "bit-reversal", bench_bit_reversal },
+        { "working-set", bench_working_set },
+        { "zipf", bench_zipf },
+        { "dynamic-finger", bench_dynamic_finger },
+};
+
+/**
+ * @brief Run the sequence on the tree and print one row of the result
+ *
+ * @return int 0 means success. -ENOMEM means tree allocation failed
+ */
+static int bench_run(const struct bench_tree *bt, const char *seq_name,
+                     key_t *keys, size_t nr_keys, key_t *seq, size_t nr_ops,
+                     int perf_fd)
+{
+        void *tree = NULL;
+        size_t i, found = 0, visits = 0, switches = 0;
+        long long misses;
+        double begin, elapsed;
+
+        tree = bt->alloc(keys, nr_keys);
+        if (!tree) {
+                pr_info("%s allocation failed\n", bt->name);
+                return -ENOMEM;
+        }
+        bench_perf_start(perf_fd);
+        begin = bench_now();
+        for (i = 0; i < nr_ops; i++) {
+                found += bt->search(tree, seq[i]);
+        }
+        elapsed = bench_now() - begin;
+        misses = bench_perf_stop(perf_fd);
+        bt->dealloc(tree);
+
+        tree = bt->alloc(keys, nr_keys);
+        if (!tree) {
+                pr_info("%s allocation failed\n", bt->name);
+                return -ENOMEM;
+        }
+        for (i = 0; i < nr_ops; i++) {
+                visits += bt->visits(tree, seq[i]);
+                bt->search(tree, seq[i]);
+        }
+        if (bt->switches) {
+                switches = bt->switches(tree);
+        }
+        bt->dealloc(tree);
+
+        if (found != nr_ops) {
+                pr_info("%s misses %zu keys\n", bt->name, nr_ops - found);
+        }
+
+        printf("%-15s %-12s %10.1f %10.2f", seq_name, bt->name,
+               elapsed / nr_ops, (double)visits / nr_ops);
+        if (bt->switches) {
+                printf(" %10.2f", (double)switches / nr_ops);
+        } else {
+                printf(" %10s", "-");
+        }
+        if (misses >= 0) {
+                printf(" %12.2f\n", (double)misses / nr_ops);
+        } else {
+                printf(" %12s\n", "n/a");
+        }
+
         return 0;
-}
\ No newline at end of file
+}
+
+int main(int argc, char *argv[])
+{
+        size_t nr_keys = BENCH_DEFAULT_KEYS, nr_ops = BENCH_DEFAULT_OPS;
+        size_t nr_trees = sizeof(bench_trees) / sizeof(bench_trees[0]);
+        size_t nr_sequences = sizeof(bench_sequences) / sizeof(bench_sequences[0]);
+        key_t *keys = NULL, *seq = NULL;
+        size_t i, j;
+        int perf_fd = -1, ret = 0;
+
+        if (argc > 1) {
+                nr_keys = strtoul(argv[1], NULL, 10);
+        }
+        if (argc > 2) {
+                nr_ops = strtoul(argv[2], NULL, 10);
+        }
+        if (argc > 3) {
+                bench_seed = strtoull(argv[3], NULL, 10) | 1;
+        }
+        if (nr_keys == 0 || nr_ops == 0) {
+                fprintf(stderr, "usage: %s [nr_keys] [nr_ops] [seed]\n",
+                        argv[0]);
+                return 1;
+        }
+
+        keys = (key_t *)malloc(sizeof(key_t) * nr_keys);
+        seq = (key_t *)malloc(sizeof(key_t) * nr_ops);
+        if (!keys || !seq) {
+                pr_info("Memory allocation failed\n");
+                ret = 1;
+                goto exception;
+        }
+        for (i = 0; i < nr_keys; i++) {
+                keys[i] = i;
+        }
+        bench_shuffle(keys, nr_keys); /**< insert order of dynamic trees */
+
+        perf_fd = bench_perf_open();
+        printf("keys: %zu, ops: %zu\n", nr_keys, nr_ops);
+        printf("%-15s %-12s %10s %10s %10s %12s\n", "sequence", "tree",
+               "ns/op", "visits/op", "switch/op", "miss/op");
+        for (i = 0; i < nr_sequences; i++) {
+                bench_sequences[i].generate(seq, nr_ops, nr_keys);
+                for (j = 0; j < nr_trees; j++) {
+                        if (bench_run(&bench_trees[j], bench_sequences[i].name,
+                                      keys, nr_keys, seq, nr_ops, perf_fd)) {
+                                ret = 1;
+                                goto exception;
+                        }
+                }
+        }
+
+exception:
+        bench_perf_close(perf_fd);
+        free(keys);
+        free(seq);
+        return ret;
+}
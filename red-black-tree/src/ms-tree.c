@@ -0,0 +1,375 @@
+/**
+ * @file ms-tree.c
+ * @author BlaCkinkGJ (ss5kijun@gmail.com)
+ * @brief multi-splay tree implementation part
+ * @details Like the tango tree, the reference tree is partitioned into
+ * preferred paths. But each path is stored in a splay tree, and the splay
+ * trees are hung below each other to make one binary search tree. The
+ * child which is the root of another path is marked by `is_aux_root`, and
+ * splaying treats it as a leaf. The topmost path always contains the
+ * search path of the last access. So, when the search leaves the path, the
+ * node where it leaves is splayed to the root and its preferred child is
+ * changed by splaying the nearest ancestors on both sides below it.
+ * @version 0.1
+ * @date 2020-06-16
+ *
+ * @copyright Copyright (c) 2020 BlaCkinkGJ
+ *
+ */
+#include "ms-tree.h"
+
+/**
+ * @brief Top-down splay in the path's splay tree
+ * @details Same as `sp_tree_splay` except that the root of another path is
+ * treated as a leaf. Such subtree moves with its parent, so it still hangs
+ * in the right key range after the splaying.
+ *
+ * @param t root of the subtree which is in the path's splay tree
+ * @param key key which want to find
+ * @return struct ms_node* new root of the subtree. Its key is the key or
+ * the predecessor or successor of the key in the path
+ */
+static struct ms_node *ms_tree_splay(struct ms_node *t, key_t key)
+{
+        struct ms_node header;
+        struct ms_node *l = NULL, *r = NULL, *y = NULL;
+
+        header.left = header.right = NULL;
+        l = r = &header;
+        for (;;) {
+                if (key < t->key) {
+                        if (ms_node_is_external(t->left)) {
+                                break;
+                        }
+                        if (key < t->left->key) { /**< zig-zig */
+                                y = t->left;
+                                t->left = y->right;
+                                y->right = t;
+                                t = y;
+                                if (ms_node_is_external(t->left)) {
+                                        break;
+                                }
+                        }
+                        r->left = t; /**< link right */
+                        r = t;
+                        t = t->left;
+                } else if (key > t->key) {
+                        if (ms_node_is_external(t->right)) {
+                                break;
+                        }
+                        if (key > t->right->key) { /**< zag-zag */
+                                y = t->right;
+                                t->right = y->left;
+                                y->left = t;
+                                t = y;
+                                if (ms_node_is_external(t->right)) {
+                                        break;
+                                }
+                        }
+                        l->right = t; /**< link left */
+                        l = t;
+                        t = t->right;
+                } else {
+                        break;
+                }
+        }
+
+        l->right = t->left; /**< assemble */
+        r->left = t->right;
+        t->left = header.right;
+        t->right = header.left;
+
+        return t;
+}
+
+/**
+ * @brief Find the deepest ancestor on one side in the reference tree
+ * @details Ancestor whose key is closest to the node's key. It is found in
+ * O(log n) by the index of the implicit array.
+ *
+ * @param tree multi-splay tree structure
+ * @param node node which is located in the reference tree
+ * @param smaller 1 for the ancestor which has a smaller key, 0 for larger
+ * @return struct ms_node* ancestor. NULL if not exist
+ */
+static struct ms_node *ms_tree_bound(struct ms_tree *tree,
+                                     struct ms_node *node, int smaller)
+{
+        size_t i = (size_t)(node - tree->nodes);
+
+        /**< odd index is the left child */
+        while (i > 0 && (int)(i % 2) == smaller) {
+                i = (i - 1) / 2;
+        }
+
+        return i > 0 ? &tree->nodes[(i - 1) / 2] : NULL;
+}
+
+/**
+ * @brief Get the subtree between the root and the bound
+ * @details The bound is splayed to the root's child, so the keys between
+ * the root and the bound are located in one subtree.
+ *
+ * @param root root of the whole tree
+ * @param bound deepest ancestor of the root node on the side (can be NULL)
+ * @param left 1 for the left side, 0 for the right side
+ * @return struct ms_node** location of the subtree
+ */
+static struct ms_node **ms_tree_between(struct ms_node *root,
+                                        struct ms_node *bound, int left)
+{
+        if (left) {
+                if (!bound) {
+                        return &root->left;
+                }
+                root->left = ms_tree_splay(root->left, bound->key);
+                return &root->left->right;
+        }
+
+        if (!bound) {
+                return &root->right;
+        }
+        root->right = ms_tree_splay(root->right, bound->key);
+        return &root->right->left;
+}
+
+/**
+ * @brief Change the preferred child of the root
+ * @details Nodes between the root and its nearest ancestors are the root's
+ * descendants. On the old side, they are the lower part of the top path,
+ * so the subtree is cut off. On the new side, they are the path which
+ * starts at the new preferred child, so the subtree is joined.
+ *
+ * @param tree multi-splay tree structure
+ * @param to_left 1 if the new preferred child is the left child
+ */
+static void ms_tree_switch(struct ms_tree *tree, int to_left)
+{
+        struct ms_node *root = tree->root;
+        struct ms_node *lo = ms_tree_bound(tree, root, 1);
+        struct ms_node *hi = ms_tree_bound(tree, root, 0);
+        struct ms_node **sub = NULL;
+
+        sub = ms_tree_between(root, to_left ? hi : lo, !to_left);
+        if (*sub) {
+                (*sub)->is_aux_root = 1;
+        }
+
+        sub = ms_tree_between(root, to_left ? lo : hi, to_left);
+        (*sub)->is_aux_root = 0;
+
+        tree->nr_switches++;
+}
+
+/**
+ * @brief Get the minimum node of the path's splay tree
+ *
+ * @param node root of the subtree
+ * @return struct ms_node* minimum node. NULL if the subtree is external
+ */
+static struct ms_node *ms_aux_minimum(struct ms_node *node)
+{
+        if (ms_node_is_external(node)) {
+                return NULL;
+        }
+        while (!ms_node_is_external(node->left)) {
+                node = node->left;
+        }
+        return node;
+}
+
+/**
+ * @brief Get the maximum node of the path's splay tree
+ *
+ * @param node root of the subtree
+ * @return struct ms_node* maximum node. NULL if the subtree is external
+ */
+static struct ms_node *ms_aux_maximum(struct ms_node *node)
+{
+        if (ms_node_is_external(node)) {
+                return NULL;
+        }
+        while (!ms_node_is_external(node->right)) {
+                node = node->right;
+        }
+        return node;
+}
+
+/**
+ * @brief Search the key in the multi-splay tree
+ * @details Search in the top path. If the key isn't in the path, the
+ * deeper one of the predecessor and successor is the node where the search
+ * leaves the path. Its preferred child is changed and the search is
+ * repeated in the extended top path.
+ *
+ * @param tree multi-splay tree structure
+ * @param key key which want to find
+ * @return struct ms_node* node which has the key. NULL if not exist
+ */
+struct ms_node *ms_tree_search(struct ms_tree *tree, key_t key)
+{
+        struct ms_node *t = NULL;
+        struct ms_node *pred = NULL, *succ = NULL, *y = NULL;
+        size_t child;
+
+        if (!tree->root) {
+                return NULL;
+        }
+
+        for (;;) {
+                t = tree->root = ms_tree_splay(tree->root, key);
+                if (t->key == key) {
+                        return t;
+                }
+
+                if (t->key < key) {
+                        pred = t;
+                        succ = ms_aux_minimum(t->right);
+                } else {
+                        pred = ms_aux_maximum(t->left);
+                        succ = t;
+                }
+                y = pred;
+                if (!y || (succ && succ->depth > y->depth)) {
+                        y = succ;
+                }
+
+                child = 2 * (size_t)(y - tree->nodes) + (key < y->key ? 1 : 2);
+                if (child >= tree->nr_nodes) {
+                        return NULL;
+                }
+
+                if (y != t) {
+                        tree->root = ms_tree_splay(tree->root, y->key);
+                }
+                ms_tree_switch(tree, key < y->key);
+        }
+}
+
+static int ms_key_compare(const void *a, const void *b)
+{
+        key_t x = *(const key_t *)a;
+        key_t y = *(const key_t *)b;
+        return (x > y) - (x < y);
+}
+
+/**
+ * @brief Fill the keys to the implicit array by in-order traversal
+ *
+ * @param nodes implicit array of the reference tree
+ * @param keys sorted keys
+ * @param size number of nodes
+ * @param i current node's index
+ * @param k index of the next key
+ * @return size_t index of the next key after the subtree
+ */
+static size_t __ms_tree_build(struct ms_node *nodes, key_t *keys, size_t size,
+                              size_t i, size_t k)
+{
+        if (i >= size) {
+                return k;
+        }
+
+        k = __ms_tree_build(nodes, keys, size, 2 * i + 1, k);
+        nodes[i].key = keys[k++];
+        return __ms_tree_build(nodes, keys, size, 2 * i + 2, k);
+}
+
+/**
+ * @brief Allocation of the multi-splay tree
+ * @details Reference tree is built as the complete binary search tree.
+ * Initial preferred child of each node is its left child, so each right
+ * child starts a path. Initial splay tree of each path is the path itself.
+ *
+ * @param keys keys of the tree (any order, duplicates are ignored)
+ * @param size number of keys
+ * @return struct ms_tree* allocated multi-splay tree
+ */
+struct ms_tree *ms_tree_alloc(key_t *keys, size_t size)
+{
+        struct ms_tree *tree = (struct ms_tree *)malloc(sizeof(struct ms_tree));
+        struct ms_node *node = NULL;
+        key_t *sorted = NULL;
+        size_t i, nr = 0;
+
+        if (!tree) {
+                pr_info("Multi-splay tree allocation failed...\n");
+                goto exception;
+        }
+        tree->root = NULL;
+        tree->nodes = NULL;
+        tree->nr_nodes = 0;
+        tree->nr_switches = 0;
+
+        sorted = (key_t *)malloc(sizeof(key_t) * (size ? size : 1));
+        if (!sorted) {
+                pr_info("Memory allocation failed\n");
+                goto exception;
+        }
+        memcpy(sorted, keys, sizeof(key_t) * size);
+        qsort(sorted, size, sizeof(key_t), ms_key_compare);
+        for (i = 0; i < size; i++) {
+                if (nr == 0 || sorted[nr - 1] != sorted[i]) {
+                        sorted[nr++] = sorted[i];
+                }
+        }
+
+        if (nr == 0) {
+                free(sorted);
+                return tree;
+        }
+
+        tree->nodes = (struct ms_node *)malloc(sizeof(struct ms_node) * nr);
+        if (!tree->nodes) {
+                pr_info("Memory allocation failed\n");
+                goto exception;
+        }
+
+        __ms_tree_build(tree->nodes, sorted, nr, 0, 0);
+        free(sorted);
+        sorted = NULL;
+
+        for (i = 0; i < nr; i++) {
+                node = &tree->nodes[i];
+                node->data = NULL;
+                node->depth = (i > 0 ? tree->nodes[(i - 1) / 2].depth + 1 : 1);
+                node->is_aux_root = (i > 0 && i % 2 == 0);
+                node->left = (2 * i + 1 < nr ? &tree->nodes[2 * i + 1] : NULL);
+                node->right = (2 * i + 2 < nr ? &tree->nodes[2 * i + 2] : NULL);
+        }
+        tree->root = &tree->nodes[0];
+        tree->nr_nodes = nr;
+
+        return tree;
+
+exception:
+        if (sorted) {
+                free(sorted);
+        }
+        if (tree) {
+                ms_tree_dealloc(tree);
+        }
+        return NULL;
+}
+
+/**
+ * @brief Deallocate the multi-splay tree
+ *
+ * @param tree multi-splay tree structure
+ */
+void ms_tree_dealloc(struct ms_tree *tree)
+{
+        size_t i;
+
+        for (i = 0; i < tree->nr_nodes; i++) {
+                if (tree->nodes[i].data) {
+                        free(tree->nodes[i].data);
+                }
+        }
+        if (tree->nodes) {
+                free(tree->nodes);
+        }
+        tree->root = NULL;
+        tree->nodes = NULL;
+        free(tree);
+}
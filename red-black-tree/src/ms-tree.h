@@ -0,0 +1,60 @@
+/**
+ * @file ms-tree.h
+ * @author BlaCkinkGJ (ss5kijun@gmail.com)
+ * @brief multi-splay tree's declaration part
+ * @version 0.1
+ * @date 2020-06-16
+ *
+ * @copyright Copyright (c) 2020 BlaCkinkGJ
+ *
+ * @ref Wang, C. C., Derryberry, J., & Sleator, D. D. (2006). O(log log n)-competitive dynamic binary search trees.
+ *
+ */
+#ifndef MS_TREE_H_
+#define MS_TREE_H_
+
+#include "rb-tree.h"
+
+/**
+ * @brief Multi-splay tree's node
+ * @details Node is located in the reference tree (complete binary search
+ * tree in the implicit array) and in the splay tree of its preferred path
+ * at the same time. Splay trees of the paths are hung below each other,
+ * so all nodes make one binary search tree.
+ */
+struct ms_node {
+        key_t key;
+        void *data; /**< tree frees it when the tree is deallocated */
+        size_t depth; /**< depth in the reference tree (root is 1) */
+        int is_aux_root; /**< root of the path which hangs below another path */
+
+        struct ms_node *left, *right;
+};
+
+/**
+ * @brief Multi-splay tree structure
+ *
+ */
+struct ms_tree {
+        struct ms_node *root;
+        struct ms_node *nodes; /**< reference tree in BFS order */
+        size_t nr_nodes;
+        size_t nr_switches; /**< number of preferred child changes */
+};
+
+struct ms_tree *ms_tree_alloc(key_t *keys, size_t size);
+struct ms_node *ms_tree_search(struct ms_tree *tree, key_t key);
+void ms_tree_dealloc(struct ms_tree *tree);
+
+/**
+ * @brief Check the child is out of the current path's splay tree
+ *
+ * @param node child node
+ * @return int 1 if the node is NULL or the root of another path
+ */
+static inline int ms_node_is_external(struct ms_node *node)
+{
+        return node == NULL || node->is_aux_root;
+}
+
+#endif
@@ -0,0 +1,596 @@
+/**
+ * @file prb-tree.c
+ * @author BlaCkinkGJ (ss5kijun@gmail.com)
+ * @brief persistent (path-copying) red-black tree implementation
+ * @details Each insert and delete makes a new version and the previous
+ * version is never changed. Only the nodes which the operation touches
+ * (search path and their children) are copied, and everything else is
+ * shared between versions by reference counting. So, a version costs
+ * O(log n) memory. When the version is deallocated, the nodes which no
+ * other version points are released.
+ * @version 0.1
+ * @date 2020-06-14
+ * 
+ * @copyright Copyright (c) 2020 BlaCkinkGJ
+ * 
+ */
+#include "prb-tree.h"
+
+/**
+ * @brief Fill the free node cache up to nr_nodes
+ * 
+ * @param cache free node cache of the tree
+ * @param nr_nodes number of nodes which the operation may need
+ * @return int 0 means success. -ENOMEM means allocation failed
+ */
+static int prb_node_reserve(struct prb_node_cache *cache, size_t nr_nodes)
+{
+        struct prb_node *node = NULL;
+
+        while (cache->nr_spare < nr_nodes) {
+                node = (struct prb_node *)malloc(sizeof(struct prb_node));
+                if (!node) {
+                        pr_info("Memory allocation failed\n");
+                        return -ENOMEM;
+                }
+                node->right = cache->spare;
+                cache->spare = node;
+                cache->nr_spare++;
+        }
+
+        return 0;
+}
+
+/**
+ * @brief Get the node from the free node cache
+ * 
+ * @param cache free node cache of the tree
+ * @return struct prb_node* uninitialized node
+ * @warning `prb_node_reserve` must be called before.
+ */
+static struct prb_node *prb_node_pop(struct prb_node_cache *cache)
+{
+        struct prb_node *node = cache->spare;
+
+        cache->spare = node->right;
+        cache->nr_spare--;
+
+        return node;
+}
+
+/**
+ * @brief Generate new node
+ * 
+ * @param cache free node cache of the tree
+ * @param key node's key
+ * @param data node's data
+ * @return struct prb_node* red node which has reference counter 1
+ */
+static struct prb_node *prb_node_alloc(struct prb_node_cache *cache,
+                                       const key_t key, void *data)
+{
+        struct prb_node *node = prb_node_pop(cache);
+
+        node->color = RB_NODE_COLOR_RED;
+        node->key = key;
+        node->data = data;
+        node->ref = 1;
+        node->left = node->right = NULL;
+
+        return node;
+}
+
+/**
+ * @brief Increase the reference counter of node
+ * 
+ * @param node target node (can be NULL)
+ * @return struct prb_node* node
+ */
+static inline struct prb_node *prb_node_get(struct prb_node *node)
+{
+        if (node) {
+                node->ref++;
+        }
+        return node;
+}
+
+/**
+ * @brief Decrease the reference counter of node and release the nodes which
+ * are no longer pointed
+ * 
+ * @param cache free node cache of the tree
+ * @param node target node (can be NULL)
+ */
+static void prb_node_put(struct prb_node_cache *cache, struct prb_node *node)
+{
+        struct prb_node *next = NULL;
+
+        while (node && --node->ref == 0) {
+                prb_node_put(cache, node->left);
+                next = node->right;
+
+                if (cache->nr_spare < PRB_TREE_MAX_SPARE) {
+                        node->right = cache->spare;
+                        cache->spare = node;
+                        cache->nr_spare++;
+                } else {
+                        free(node);
+                }
+
+                node = next;
+        }
+}
+
+/**
+ * @brief Get the node which can be modified in place (copy-on-write)
+ * @details The node which is pointed by one parent belongs to the version
+ * which is being built. Otherwise, the node is copied and the copy takes
+ * over the parent's reference.
+ * 
+ * @param cache free node cache of the tree
+ * @param node target node
+ * @return struct prb_node* node which has reference counter 1
+ */
+static struct prb_node *prb_node_mut(struct prb_node_cache *cache,
+                                     struct prb_node *node)
+{
+        struct prb_node *copy = NULL;
+
+        if (node->ref == 1) {
+                return node;
+        }
+
+        copy = prb_node_pop(cache);
+        memcpy(copy, node, sizeof(struct prb_node));
+        copy->ref = 1;
+        prb_node_get(copy->left);
+        prb_node_get(copy->right);
+        node->ref--;
+
+        return copy;
+}
+
+static inline int prb_node_is_red(struct prb_node *node)
+{
+        return node != NULL && node->color == RB_NODE_COLOR_RED;
+}
+
+/**
+ * @brief Left rotation of the left-leaning red-black tree
+ * 
+ * @param cache free node cache of the tree
+ * @param h mutable subtree's root node
+ * @return struct prb_node* new subtree's root node
+ */
+static struct prb_node *prb_tree_left_rotate(struct prb_node_cache *cache,
+                                             struct prb_node *h)
+{
+        struct prb_node *x = prb_node_mut(cache, h->right);
+
+        h->right = x->left;
+        x->left = h;
+        x->color = h->color;
+        h->color = RB_NODE_COLOR_RED;
+
+        return x;
+}
+
+/**
+ * @brief Right rotation of the left-leaning red-black tree
+ * 
+ * @param cache free node cache of the tree
+ * @param h mutable subtree's root node
+ * @return struct prb_node* new subtree's root node
+ */
+static struct prb_node *prb_tree_right_rotate(struct prb_node_cache *cache,
+                                              struct prb_node *h)
+{
+        struct prb_node *x = prb_node_mut(cache, h->left);
+
+        h->left = x->right;
+        x->right = h;
+        x->color = h->color;
+        h->color = RB_NODE_COLOR_RED;
+
+        return x;
+}
+
+static inline void prb_node_flip_color(struct prb_node *node)
+{
+        node->color = (node->color == RB_NODE_COLOR_RED ? RB_NODE_COLOR_BLACK :
+                                                          RB_NODE_COLOR_RED);
+}
+
+/**
+ * @brief Flip the colors of node and its children
+ * 
+ * @param cache free node cache of the tree
+ * @param h mutable node
+ */
+static void prb_tree_flip_colors(struct prb_node_cache *cache,
+                                 struct prb_node *h)
+{
+        prb_node_flip_color(h);
+        if (h->left) {
+                h->left = prb_node_mut(cache, h->left);
+                prb_node_flip_color(h->left);
+        }
+        if (h->right) {
+                h->right = prb_node_mut(cache, h->right);
+                prb_node_flip_color(h->right);
+        }
+}
+
+/**
+ * @brief Restore the left-leaning red-black tree's invariants on the way up
+ * 
+ * @param cache free node cache of the tree
+ * @param h mutable subtree's root node
+ * @return struct prb_node* new subtree's root node
+ */
+static struct prb_node *prb_tree_fixup(struct prb_node_cache *cache,
+                                       struct prb_node *h)
+{
+        if (prb_node_is_red(h->right) && !prb_node_is_red(h->left)) {
+                h = prb_tree_left_rotate(cache, h);
+        }
+        if (prb_node_is_red(h->left) && prb_node_is_red(h->left->left)) {
+                h = prb_tree_right_rotate(cache, h);
+        }
+        if (prb_node_is_red(h->left) && prb_node_is_red(h->right)) {
+                prb_tree_flip_colors(cache, h);
+        }
+        return h;
+}
+
+/**
+ * @brief Maximum number of nodes which an operation can copy
+ * @details The height is at most 2 * bh + 1 and an operation touches at
+ * most the search path, their children and their grandchildren.
+ * 
+ * @param tree base version
+ * @return size_t number of nodes which must be reserved
+ */
+static size_t prb_tree_nr_reserve(struct prb_tree *tree)
+{
+        struct prb_node *node = tree->root;
+        size_t bh = 0;
+
+        while (node) {
+                if (node->color == RB_NODE_COLOR_BLACK) {
+                        bh++;
+                }
+                node = node->left;
+        }
+
+        return 7 * (2 * bh + 2) + 1;
+}
+
+/**
+ * @brief Drop the version's reference of the free node cache
+ * @details Last version releases every cached node and the cache itself.
+ * 
+ * @param cache free node cache of the tree
+ */
+static void prb_node_cache_put(struct prb_node_cache *cache)
+{
+        struct prb_node *node = NULL;
+
+        if (--cache->ref > 0) {
+                return;
+        }
+
+        while (cache->spare) {
+                node = cache->spare;
+                cache->spare = node->right;
+                free(node);
+        }
+
+        free(cache);
+}
+
+/**
+ * @brief Allocation of the version structure
+ * 
+ * @param cache free node cache which the version shares. If NULL, the new
+ * cache is allocated
+ * @return struct prb_tree* allocated version which has no node
+ */
+static struct prb_tree *__prb_tree_alloc(struct prb_node_cache *cache)
+{
+        struct prb_tree *tree = (struct prb_tree *)malloc(sizeof(struct prb_tree));
+        if (!tree) {
+                pr_info("Memory shortage detected! Allocation failed...");
+                return NULL;
+        }
+
+        if (!cache) {
+                cache = (struct prb_node_cache *)malloc(
+                        sizeof(struct prb_node_cache));
+                if (!cache) {
+                        pr_info("Memory shortage detected! Allocation failed...");
+                        free(tree);
+                        return NULL;
+                }
+                cache->spare = NULL;
+                cache->nr_spare = 0;
+                cache->ref = 0;
+        }
+        cache->ref++;
+
+        tree->root = NULL;
+        tree->nr_nodes = 0;
+        tree->cache = cache;
+
+        return tree;
+}
+
+/**
+ * @brief Allocation of the empty version
+ * 
+ * @return struct prb_tree* allocated version
+ */
+struct prb_tree *prb_tree_alloc(void)
+{
+        return __prb_tree_alloc(NULL);
+}
+
+/**
+ * @brief Make the snapshot of the version in O(1)
+ * 
+ * @param tree base version
+ * @return struct prb_tree* version which shares every node with tree
+ */
+struct prb_tree *prb_tree_clone(struct prb_tree *tree)
+{
+        struct prb_tree *version = __prb_tree_alloc(tree->cache);
+        if (!version) {
+                return NULL;
+        }
+
+        version->root = prb_node_get(tree->root);
+        version->nr_nodes = tree->nr_nodes;
+
+        return version;
+}
+
+/**
+ * @brief Search persistent red-black tree's node which the same value of key
+ * 
+ * @param tree version which I want to search
+ * @param key the key which I want to search
+ * @return struct prb_node* if find success then return specific node pointer.
+ * but if find failed then return NULL pointer
+ */
+struct prb_node *prb_tree_search(struct prb_tree *tree, key_t key)
+{
+        struct prb_node *node = tree->root;
+
+        while (node && node->key != key) {
+                node = (key < node->key ? node->left : node->right);
+        }
+
+        return node;
+}
+
+static struct prb_node *__prb_tree_insert(struct prb_node_cache *cache,
+                                          struct prb_node *h, const key_t key,
+                                          void *data)
+{
+        if (!h) {
+                return prb_node_alloc(cache, key, data);
+        }
+
+        h = prb_node_mut(cache, h);
+        if (key < h->key) {
+                h->left = __prb_tree_insert(cache, h->left, key, data);
+        } else if (key > h->key) {
+                h->right = __prb_tree_insert(cache, h->right, key, data);
+        } else {
+                h->data = data;
+        }
+
+        return prb_tree_fixup(cache, h);
+}
+
+/**
+ * @brief Insert the key and make the new version
+ * 
+ * @param tree base version which is not changed
+ * @param key new node's key
+ * @param data new node's data
+ * @param version new version is stored in this location
+ * @return int successfully insert status (0: success, else: fail)
+ */
+int prb_tree_insert(struct prb_tree *tree, const key_t key, void *data,
+                    struct prb_tree **version)
+{
+        struct prb_tree *new_tree = NULL;
+        int is_new = (prb_tree_search(tree, key) == NULL);
+
+        *version = NULL;
+        if (key >= RB_MAX_KEY) {
+                pr_info("Invalid key value\n");
+                return -EINVAL;
+        }
+
+        new_tree = prb_tree_clone(tree);
+        if (!new_tree ||
+            prb_node_reserve(tree->cache, prb_tree_nr_reserve(tree))) {
+                if (new_tree) {
+                        prb_tree_dealloc(new_tree);
+                }
+                return -ENOMEM;
+        }
+
+        new_tree->root =
+                __prb_tree_insert(tree->cache, new_tree->root, key, data);
+        new_tree->root->color = RB_NODE_COLOR_BLACK;
+        new_tree->nr_nodes += is_new;
+
+        *version = new_tree;
+        return 0;
+}
+
+/**
+ * @brief Push a red link down to the left child
+ * 
+ * @param cache free node cache of the tree
+ * @param h mutable subtree's root node
+ * @return struct prb_node* new subtree's root node
+ */
+static struct prb_node *prb_tree_move_red_left(struct prb_node_cache *cache,
+                                               struct prb_node *h)
+{
+        prb_tree_flip_colors(cache, h);
+        if (prb_node_is_red(h->right->left)) {
+                h->right = prb_tree_right_rotate(
+                        cache, prb_node_mut(cache, h->right));
+                h = prb_tree_left_rotate(cache, h);
+                prb_tree_flip_colors(cache, h);
+        }
+        return h;
+}
+
+/**
+ * @brief Push a red link down to the right child
+ * 
+ * @param cache free node cache of the tree
+ * @param h mutable subtree's root node
+ * @return struct prb_node* new subtree's root node
+ */
+static struct prb_node *prb_tree_move_red_right(struct prb_node_cache *cache,
+                                                struct prb_node *h)
+{
+        prb_tree_flip_colors(cache, h);
+        if (prb_node_is_red(h->left->left)) {
+                h = prb_tree_right_rotate(cache, h);
+                prb_tree_flip_colors(cache, h);
+        }
+        return h;
+}
+
+static struct prb_node *prb_tree_delete_min(struct prb_node_cache *cache,
+                                            struct prb_node *h)
+{
+        if (!h->left) {
+                prb_node_put(cache, h);
+                return NULL;
+        }
+
+        h = prb_node_mut(cache, h);
+        if (!prb_node_is_red(h->left) && !prb_node_is_red(h->left->left)) {
+                h = prb_tree_move_red_left(cache, h);
+        }
+        h->left = prb_tree_delete_min(cache, h->left);
+
+        return prb_tree_fixup(cache, h);
+}
+
+/**
+ * @brief Delete the key from the subtree
+ * 
+ * @param cache free node cache of the tree
+ * @param h subtree's root node
+ * @param key delete target key which must exist in the subtree
+ * @return struct prb_node* new subtree's root node
+ */
+static struct prb_node *__prb_tree_delete(struct prb_node_cache *cache,
+                                          struct prb_node *h, key_t key)
+{
+        struct prb_node *min = NULL;
+
+        h = prb_node_mut(cache, h);
+        if (key < h->key) {
+                if (!prb_node_is_red(h->left) &&
+                    !prb_node_is_red(h->left->left)) {
+                        h = prb_tree_move_red_left(cache, h);
+                }
+                h->left = __prb_tree_delete(cache, h->left, key);
+        } else {
+                if (prb_node_is_red(h->left)) {
+                        h = prb_tree_right_rotate(cache, h);
+                }
+                if (key == h->key && !h->right) {
+                        prb_node_put(cache, h);
+                        return NULL;
+                }
+                if (!prb_node_is_red(h->right) &&
+                    !prb_node_is_red(h->right->left)) {
+                        h = prb_tree_move_red_right(cache, h);
+                }
+                if (key == h->key) {
+                        for (min = h->right; min->left; min = min->left) {
+                                ;
+                        }
+                        h->key = min->key;
+                        h->data = min->data;
+                        h->right = prb_tree_delete_min(cache, h->right);
+                } else {
+                        h->right = __prb_tree_delete(cache, h->right, key);
+                }
+        }
+
+        return prb_tree_fixup(cache, h);
+}
+
+/**
+ * @brief Delete the key and make the new version
+ * 
+ * @param tree base version which is not changed
+ * @param key delete target node's key
+ * @param version new version is stored in this location
+ * @return int 0 means that delete success. Not 0 means delete fail.
+ */
+int prb_tree_delete(struct prb_tree *tree, key_t key,
+                    struct prb_tree **version)
+{
+        struct prb_node_cache *cache = tree->cache;
+        struct prb_tree *new_tree = NULL;
+        struct prb_node *root = NULL;
+
+        *version = NULL;
+        if (!prb_tree_search(tree, key)) {
+                return -ENODATA;
+        }
+
+        new_tree = prb_tree_clone(tree);
+        if (!new_tree ||
+            prb_node_reserve(tree->cache, prb_tree_nr_reserve(tree))) {
+                if (new_tree) {
+                        prb_tree_dealloc(new_tree);
+                }
+                return -ENOMEM;
+        }
+
+        root = new_tree->root;
+        if (!prb_node_is_red(root->left) && !prb_node_is_red(root->right)) {
+                root = prb_node_mut(cache, root);
+                root->color = RB_NODE_COLOR_RED;
+        }
+        root = __prb_tree_delete(cache, root, key);
+        if (root) {
+                root->color = RB_NODE_COLOR_BLACK;
+        }
+        new_tree->root = root;
+        new_tree->nr_nodes--;
+
+        *version = new_tree;
+        return 0;
+}
+
+/**
+ * @brief Deallocate the version
+ * @details The nodes which are shared with other versions are kept. The
+ * free node cache is released with the last version of the tree.
+ * 
+ * @param tree deallocate target version
+ */
+void prb_tree_dealloc(struct prb_tree *tree)
+{
+        prb_node_put(tree->cache, tree->root);
+        prb_node_cache_put(tree->cache);
+        tree->root = NULL;
+        tree->cache = NULL;
+        free(tree);
+}
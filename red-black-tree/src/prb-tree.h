@@ -0,0 +1,69 @@
+/**
+ * @file prb-tree.h
+ * @author BlaCkinkGJ (ss5kijun@gmail.com)
+ * @brief persistent (path-copying) red-black tree's declaration part
+ * @version 0.1
+ * @date 2020-06-14
+ * 
+ * @copyright Copyright (c) 2020 BlaCkinkGJ
+ * 
+ * @ref Sedgewick, R. (2008). Left-leaning red-black trees.
+ * @ref Driscoll, J. R., Sarnak, N., Sleator, D. D., & Tarjan, R. E. (1989). Making data structures persistent.
+ * 
+ */
+#ifndef PRB_TREE_H_
+#define PRB_TREE_H_
+
+#include "rb-tree.h"
+
+#define PRB_TREE_MAX_SPARE (4096) /**< maximum number of cached free nodes */
+
+/**
+ * @brief Persistent red-black tree's node
+ * @details Node is immutable after it is shared by more than one parent.
+ * Only the node whose reference counter is 1 can be modified in place.
+ */
+struct prb_node {
+        enum rb_node_color color;
+
+        key_t key;
+        void *data; /**< shared by versions. So, tree doesn't free it */
+        size_t ref; /**< number of parents and versions which point it */
+
+        struct prb_node *left, *right;
+};
+
+/**
+ * @brief Cache of free nodes
+ * @details Every node which an operation may need is reserved before the
+ * operation starts. So, the operation never fails in the middle of the
+ * path copying. Versions which come from the same `prb_tree_alloc` share
+ * their nodes, so they share this cache too and must be used by one thread
+ * at a time. Independent trees have their own caches.
+ */
+struct prb_node_cache {
+        struct prb_node *spare; /**< linked by right pointer */
+        size_t nr_spare;
+        unsigned long ref; /**< number of versions which use this cache */
+};
+
+/**
+ * @brief Version of the persistent red-black tree
+ * 
+ */
+struct prb_tree {
+        struct prb_node *root;
+        size_t nr_nodes;
+        struct prb_node_cache *cache; /**< shared by every version */
+};
+
+struct prb_tree *prb_tree_alloc(void);
+struct prb_tree *prb_tree_clone(struct prb_tree *tree);
+struct prb_node *prb_tree_search(struct prb_tree *tree, key_t key);
+int prb_tree_insert(struct prb_tree *tree, const key_t key, void *data,
+                    struct prb_tree **version);
+int prb_tree_delete(struct prb_tree *tree, key_t key,
+                    struct prb_tree **version);
+void prb_tree_dealloc(struct prb_tree *tree);
+
+#endif
@@ -0,0 +1,238 @@
+/**
+ * @file rb-interval.c
+ * @author BlaCkinkGJ (ss5kijun@gmail.com)
+ * @brief interval tree implementation
+ * @details Intervals are ordered by their low endpoint and every node keeps
+ * the maximum high endpoint of its subtree. Insert and delete are the
+ * red-black tree's one. So, the maximum is maintained by the augment
+ * callback which is called in rotations and fix-ups.
+ * @version 0.1
+ * @date 2020-06-12
+ * 
+ * @copyright Copyright (c) 2020 BlaCkinkGJ
+ * 
+ */
+#include "rb-interval.h"
+
+/**
+ * @brief Recalculate the maximum high endpoint of the subtree
+ * 
+ * @param tree interval tree
+ * @param node recalculate target node
+ */
+static void rb_interval_augment(struct rb_tree *tree, struct rb_node *node)
+{
+        struct rb_interval_node *x = rb_interval_entry(node);
+        key_t max = x->hi;
+
+        if (node->left != tree->nil &&
+            rb_interval_entry(node->left)->max > max) {
+                max = rb_interval_entry(node->left)->max;
+        }
+        if (node->right != tree->nil &&
+            rb_interval_entry(node->right)->max > max) {
+                max = rb_interval_entry(node->right)->max;
+        }
+
+        x->max = max;
+}
+
+/**
+ * @brief Get the maximum high endpoint of the subtree
+ * 
+ * @param tree interval tree
+ * @param node root of the subtree
+ * @return key_t maximum high endpoint. 0 if the subtree is empty
+ */
+static inline key_t rb_interval_max(struct rb_tree *tree, struct rb_node *node)
+{
+        return node == tree->nil ? 0 : rb_interval_entry(node)->max;
+}
+
+/**
+ * @brief Allocation of the interval tree
+ * 
+ * @return struct rb_tree* allocated interval tree. It can be deallocated by
+ * `rb_tree_dealloc`
+ */
+struct rb_tree *rb_interval_tree_alloc(void)
+{
+        struct rb_tree *tree = rb_tree_alloc();
+        if (!tree) {
+                return NULL;
+        }
+
+        tree->flags |= RB_TREE_FLAG_DUP_KEY;
+        tree->augment = rb_interval_augment;
+
+        return tree;
+}
+
+/**
+ * @brief Insert the interval [lo, hi] to the interval tree
+ * 
+ * @param tree interval tree
+ * @param lo low endpoint
+ * @param hi high endpoint
+ * @param data interval's data
+ * @return int successfully insert status (0: success, else: fail)
+ */
+int rb_interval_insert(struct rb_tree *tree, key_t lo, key_t hi, void *data)
+{
+        struct rb_interval_node *x = NULL;
+        int ret;
+
+        if (lo > hi || lo >= RB_MAX_KEY) {
+                pr_info("Invalid interval [%ld, %ld]\n", lo, hi);
+                return -EINVAL;
+        }
+
+        x = (struct rb_interval_node *)malloc(sizeof(struct rb_interval_node));
+        if (!x) {
+                pr_info("Memory allocation failed\n");
+                return -ENOMEM;
+        }
+
+        x->node.color = RB_NODE_COLOR_UNDEFINED;
+        x->node.parent = x->node.left = x->node.right = NULL;
+        x->node.key = lo;
+        x->node.data = data;
+        x->node.size = 1;
+        x->hi = hi;
+        x->max = hi;
+
+        ret = rb_tree_insert_node(tree, &x->node);
+        if (ret) {
+                x->node.data = NULL;
+                rb_node_dealloc(&x->node);
+        }
+
+        return ret;
+}
+
+/**
+ * @brief Delete the interval [lo, hi] from the interval tree
+ * 
+ * @param tree interval tree
+ * @param lo low endpoint
+ * @param hi high endpoint
+ * @return int 0 means that delete success. -ENODATA means no such interval
+ */
+int rb_interval_delete(struct rb_tree *tree, key_t lo, key_t hi)
+{
+        struct rb_node *node = rb_tree_lower_bound(tree, lo);
+
+        while (node && node != tree->nil && node->key == lo) {
+                if (rb_interval_entry(node)->hi == hi) {
+                        rb_tree_delete_node(tree, node);
+                        return 0;
+                }
+                node = rb_tree_successor(tree, node);
+        }
+
+        return -ENODATA;
+}
+
+/**
+ * @brief Find the overlapped interval which has the smallest low endpoint
+ * @details If the left subtree's maximum is not less than lo, then the left
+ * subtree has an overlapped interval or there is no overlapped interval in
+ * the right side of it. So, the search path goes down only once (O(log n)).
+ * 
+ * @param tree interval tree
+ * @param lo low endpoint of the query
+ * @param hi high endpoint of the query
+ * @return struct rb_interval_node* overlapped interval. If there is no
+ * overlapped interval then return NULL pointer
+ */
+struct rb_interval_node *rb_interval_overlap_first(struct rb_tree *tree,
+                                                   key_t lo, key_t hi)
+{
+        struct rb_node *x = tree->root;
+
+        while (x != tree->nil) {
+                if (x->left != tree->nil &&
+                    rb_interval_max(tree, x->left) >= lo) {
+                        x = x->left;
+                } else if (rb_interval_is_overlap(rb_interval_entry(x), lo,
+                                                  hi)) {
+                        return rb_interval_entry(x);
+                } else if (x->key > hi) {
+                        break;
+                } else {
+                        x = x->right;
+                }
+        }
+
+        return NULL;
+}
+
+/**
+ * @brief Visit every overlapped interval in the subtree
+ * @details The subtree is skipped when its maximum is less than lo, and the
+ * right subtree is skipped when the low endpoint is greater than hi.
+ * 
+ * @param tree interval tree
+ * @param x root of the subtree
+ * @param lo low endpoint of the query
+ * @param hi high endpoint of the query
+ * @param fn callback function
+ * @param arg argument of the callback function
+ * @return int non-zero return value of fn which stops the traverse
+ */
+static int __rb_interval_overlap_all(struct rb_tree *tree, struct rb_node *x,
+                                     key_t lo, key_t hi,
+                                     int (*fn)(struct rb_interval_node *node,
+                                               void *arg),
+                                     void *arg)
+{
+        int ret = 0;
+
+        if (x == tree->nil || rb_interval_max(tree, x) < lo) {
+                return 0;
+        }
+
+        ret = __rb_interval_overlap_all(tree, x->left, lo, hi, fn, arg);
+        if (ret) {
+                return ret;
+        }
+
+        if (x->key > hi) {
+                return 0;
+        }
+
+        if (rb_interval_is_overlap(rb_interval_entry(x), lo, hi)) {
+                ret = fn(rb_interval_entry(x), arg);
+                if (ret) {
+                        return ret;
+                }
+        }
+
+        return __rb_interval_overlap_all(tree, x->right, lo, hi, fn, arg);
+}
+
+/**
+ * @brief Call fn for each interval which overlaps [lo, hi] by ascending
+ * order of the low endpoint
+ * @details In-order walk which prunes the subtree whose maximum is less than
+ * lo and stops at the low endpoint greater than hi. A subtree is entered only
+ * when it has an interval which reaches lo, so each of the k reported
+ * intervals costs at most one root-to-leaf descent. The bound is
+ * O((k + 1) log n), never worse than O(n). The max augmentation cannot give
+ * O(log n + k) for the general intervals.
+ * 
+ * @param tree interval tree
+ * @param lo low endpoint of the query
+ * @param hi high endpoint of the query
+ * @param fn callback function. Non-zero return value stops the traverse
+ * @param arg argument which passes to the callback function
+ * @return int 0 means that all intervals are visited. Otherwise, the return
+ * value of fn which stops the traverse
+ */
+int rb_interval_overlap_all(struct rb_tree *tree, key_t lo, key_t hi,
+                            int (*fn)(struct rb_interval_node *node,
+                                      void *arg),
+                            void *arg)
+{
+        return __rb_interval_overlap_all(tree, tree->root, lo, hi, fn, arg);
+}
@@ -0,0 +1,62 @@
+/**
+ * @file rb-interval.h
+ * @author BlaCkinkGJ (ss5kijun@gmail.com)
+ * @brief interval tree which is built on the red-black tree
+ * @version 0.1
+ * @date 2020-06-12
+ * 
+ * @copyright Copyright (c) 2020 BlaCkinkGJ
+ * 
+ * @ref Introduction to Algorithms(CLRS) ▶ augmenting data structures ▶ interval trees
+ * 
+ */
+#ifndef RB_INTERVAL_H_
+#define RB_INTERVAL_H_
+
+#include "rb-tree.h"
+
+/**
+ * @brief Interval tree's node which represents closed interval [lo, hi]
+ * 
+ */
+struct rb_interval_node {
+        struct rb_node node; /**< node.key is the low endpoint (lo) */
+        key_t hi; /**< high endpoint */
+        key_t max; /**< maximum high endpoint of the subtree */
+};
+
+struct rb_tree *rb_interval_tree_alloc(void);
+int rb_interval_insert(struct rb_tree *tree, key_t lo, key_t hi, void *data);
+int rb_interval_delete(struct rb_tree *tree, key_t lo, key_t hi);
+struct rb_interval_node *rb_interval_overlap_first(struct rb_tree *tree,
+                                                   key_t lo, key_t hi);
+int rb_interval_overlap_all(struct rb_tree *tree, key_t lo, key_t hi,
+                            int (*fn)(struct rb_interval_node *node,
+                                      void *arg),
+                            void *arg);
+
+/**
+ * @brief Get the interval node which contains the red-black tree node
+ * 
+ * @param node red-black tree node (must not be tree->nil)
+ * @return struct rb_interval_node* interval node
+ */
+static inline struct rb_interval_node *rb_interval_entry(struct rb_node *node)
+{
+        return (struct rb_interval_node *)node;
+}
+
+/**
+ * @brief Check [lo, hi] overlaps the interval of node
+ * 
+ * @param node interval node
+ * @param lo low endpoint
+ * @param hi high endpoint
+ * @return int 1 means overlap. 0 means not overlap
+ */
+static inline int rb_interval_is_overlap(struct rb_interval_node *node,
+                                         key_t lo, key_t hi)
+{
+        return node->node.key <= hi && lo <= node->hi;
+}
+#endif
@@ -18,6 +18,7 @@ static struct rb_global_info rb_info = {
 
                 .key = RB_NODE_NIL_KEY_VALUE,
                 .data = NULL,
+                .size = 0,
 
                 .left = NULL,
                 .right = NULL,
@@ -41,6 +42,12 @@ struct rb_tree *rb_tree_alloc(void)
         tree->nil = &rb_info.nil;
         tree->root = tree->nil;
         tree->bh = 0;
+        tree->flags = 0;
+        tree->augment = NULL;
+        tree->sync = NULL;
+        tree->finger = NULL;
+        tree->max = NULL;
+        tree->pool = NULL;
 
         return tree;
 exception:
@@ -55,6 +62,457 @@ exception:
         return NULL;
 }
 
+/**
+ * @brief Add the new chunk to the pool
+ * 
+ * @param pool node pool
+ * @return int 0 means success. -ENOMEM means allocation failed
+ */
+static int rb_node_pool_grow(struct rb_node_pool *pool)
+{
+        struct rb_node_chunk *chunk = NULL;
+
+        chunk = (struct rb_node_chunk *)malloc(
+                sizeof(struct rb_node_chunk) +
+                pool->chunk_size * sizeof(struct rb_node));
+        if (!chunk) {
+                pr_info("Memory allocation failed\n");
+                return -ENOMEM;
+        }
+
+        chunk->nr_nodes = pool->chunk_size;
+        chunk->nr_used = 0;
+        chunk->next = pool->chunks;
+        pool->chunks = chunk;
+        pool->chunk_size *= 2;
+
+        return 0;
+}
+
+/**
+ * @brief Generate new node from the pool
+ * 
+ * @param pool node pool
+ * @param key node's key
+ * @return struct rb_node* allocated node
+ */
+static struct rb_node *rb_node_pool_alloc(struct rb_node_pool *pool,
+                                          const key_t key)
+{
+        struct rb_node_chunk *chunk = pool->chunks;
+        struct rb_node *node = NULL;
+
+        if (key >= RB_MAX_KEY) {
+                pr_info("Invalid key value\n");
+                return NULL;
+        }
+
+        if (pool->free_list) {
+                node = pool->free_list;
+                pool->free_list = node->parent;
+        } else {
+                if (!chunk || chunk->nr_used == chunk->nr_nodes) {
+                        if (rb_node_pool_grow(pool)) {
+                                return NULL;
+                        }
+                        chunk = pool->chunks;
+                }
+                node = &chunk->nodes[chunk->nr_used++];
+        }
+
+        node->color = RB_NODE_COLOR_UNDEFINED;
+        node->parent = node->left = node->right = NULL;
+        node->data = NULL;
+        node->size = 1;
+
+        node->key = key;
+
+        return node;
+}
+
+/**
+ * @brief Return the node to the pool's free list
+ * 
+ * @param pool node pool
+ * @param node deallocate target
+ */
+static void rb_node_pool_free(struct rb_node_pool *pool, struct rb_node *node)
+{
+        if (node->data) {
+                free(node->data);
+                node->data = NULL;
+        }
+        node->parent = pool->free_list;
+        pool->free_list = node;
+}
+
+/**
+ * @brief Check the node is carved out of the pool's chunks
+ * @details Chunk sizes grow geometrically, so only O(log n) chunks are
+ * checked.
+ * 
+ * @param pool node pool (can be NULL)
+ * @param node check target node
+ * @return int 1 means that node belongs to the pool
+ */
+static int rb_node_pool_owns(struct rb_node_pool *pool, struct rb_node *node)
+{
+        struct rb_node_chunk *chunk = NULL;
+
+        for (chunk = (pool ? pool->chunks : NULL); chunk;
+             chunk = chunk->next) {
+                if (node >= chunk->nodes &&
+                    node < chunk->nodes + chunk->nr_used) {
+                        return 1;
+                }
+        }
+
+        return 0;
+}
+
+/**
+ * @brief Move every chunk and free node of source to dest
+ * 
+ * @param dest pool which survives
+ * @param source pool which is deallocated
+ */
+static void rb_node_pool_merge(struct rb_node_pool *dest,
+                               struct rb_node_pool *source)
+{
+        struct rb_node_chunk *chunk = source->chunks;
+        struct rb_node *node = source->free_list;
+
+        if (chunk) {
+                while (chunk->next) {
+                        chunk = chunk->next;
+                }
+                chunk->next = dest->chunks->next;
+                dest->chunks->next = source->chunks;
+        }
+
+        if (node) {
+                while (node->parent) {
+                        node = node->parent;
+                }
+                node->parent = dest->free_list;
+                dest->free_list = source->free_list;
+        }
+
+        free(source);
+}
+
+/**
+ * @brief Drop the tree's reference of the pool
+ * @details Last user releases the whole chunks. Nodes which are in use are
+ * found by sweeping the chunks sequentially. So, no tree traverse is needed.
+ * 
+ * @param pool node pool
+ */
+static void rb_node_pool_put(struct rb_node_pool *pool)
+{
+        struct rb_node_chunk *chunk = pool->chunks;
+        struct rb_node_chunk *next = NULL;
+        size_t i;
+
+        if (--pool->ref > 0) {
+                return;
+        }
+
+        while (chunk) {
+                for (i = 0; i < chunk->nr_used; i++) {
+                        if (chunk->nodes[i].data) {
+                                free(chunk->nodes[i].data);
+                        }
+                }
+                next = chunk->next;
+                free(chunk);
+                chunk = next;
+        }
+
+        free(pool);
+}
+
+/**
+ * @brief Allocation of red-black tree which allocates nodes from the pool
+ * 
+ * @param capacity_hint expected number of nodes
+ * @return struct rb_tree* allocated red-black tree
+ */
+struct rb_tree *rb_tree_alloc_with_pool(size_t capacity_hint)
+{
+        struct rb_tree *tree = NULL;
+        struct rb_node_pool *pool = NULL;
+
+        tree = rb_tree_alloc();
+        if (!tree) {
+                return NULL;
+        }
+
+        pool = (struct rb_node_pool *)malloc(sizeof(struct rb_node_pool));
+        if (!pool) {
+                pr_info("Memory shortage detected! Allocation failed...");
+                goto exception;
+        }
+
+        pool->chunks = NULL;
+        pool->free_list = NULL;
+        pool->chunk_size = (capacity_hint > RB_NODE_POOL_MIN_CHUNK ?
+                                    capacity_hint :
+                                    RB_NODE_POOL_MIN_CHUNK);
+        pool->ref = 1;
+        tree->pool = pool;
+
+        if (rb_node_pool_grow(pool)) {
+                goto exception;
+        }
+
+        return tree;
+exception:
+        rb_tree_dealloc(tree);
+        return NULL;
+}
+
+/**
+ * @brief Generate new node for the tree
+ * 
+ * @param tree red-black tree structure
+ * @param key node's key
+ * @return struct rb_node* allocated node
+ */
+static struct rb_node *rb_tree_node_alloc(struct rb_tree *tree,
+                                          const key_t key)
+{
+        if (tree->pool) {
+                return rb_node_pool_alloc(tree->pool, key);
+        }
+        return rb_node_alloc(key);
+}
+
+/**
+ * @brief Deallocate the node which is generated by `rb_tree_node_alloc`
+ * 
+ * @param tree red-black tree structure
+ * @param node deallocate target
+ */
+static void rb_tree_node_free(struct rb_tree *tree, struct rb_node *node)
+{
+        if (tree->pool) {
+                rb_node_pool_free(tree->pool, node);
+                return;
+        }
+        rb_node_dealloc(node);
+}
+
+static size_t rb_next_reader_slot; /**< slot of the next new reader thread */
+static _Thread_local size_t rb_reader_slot = RB_TREE_NR_READER_SLOTS;
+
+/**
+ * @brief Deallocate the retired node list
+ * 
+ * @param tree red-black tree structure
+ * @param node head of the list which is linked by parent pointer
+ */
+static void rb_tree_free_retired(struct rb_tree *tree, struct rb_node *node)
+{
+        struct rb_node *next = NULL;
+
+        while (node) {
+                next = node->parent;
+                rb_tree_node_free(tree, node);
+                node = next;
+        }
+}
+
+/**
+ * @brief Free the retired nodes whose grace period is over
+ * @details The grace period starts when the retired list moves to the
+ * waiting list. At that time, only busy reader slots can hold the waiting
+ * nodes. After each of them is observed idle, no reader can reach them.
+ * 
+ * @param tree concurrent red-black tree
+ */
+static void rb_tree_reclaim(struct rb_tree *tree)
+{
+        struct rb_tree_sync *sync = tree->sync;
+        size_t i;
+
+        __atomic_thread_fence(__ATOMIC_SEQ_CST); /**< unlink before the check */
+        for (;;) {
+                if (sync->waiting) {
+                        for (i = 0; i < RB_TREE_NR_READER_SLOTS; i++) {
+                                if ((sync->pending & (1ULL << i)) &&
+                                    !__atomic_load_n(&sync->readers[i].count,
+                                                     __ATOMIC_ACQUIRE)) {
+                                        sync->pending &= ~(1ULL << i);
+                                }
+                        }
+                        if (sync->pending) {
+                                return;
+                        }
+                        rb_tree_free_retired(tree, sync->waiting);
+                        sync->waiting = NULL;
+                }
+
+                if (!sync->retired) {
+                        return;
+                }
+
+                sync->waiting = sync->retired;
+                sync->retired = NULL;
+                sync->pending = 0;
+                for (i = 0; i < RB_TREE_NR_READER_SLOTS; i++) {
+                        if (__atomic_load_n(&sync->readers[i].count,
+                                            __ATOMIC_ACQUIRE)) {
+                                sync->pending |= (1ULL << i);
+                        }
+                }
+        }
+}
+
+/**
+ * @brief Start the modification of the tree (writer side)
+ * 
+ * @param tree red-black tree structure
+ */
+static inline void rb_tree_write_begin(struct rb_tree *tree)
+{
+        if (!tree->sync) {
+                return;
+        }
+        __atomic_store_n(&tree->sync->seq, tree->sync->seq + 1,
+                         __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Finish the modification of the tree and reclaim nodes (writer side)
+ * 
+ * @param tree red-black tree structure
+ */
+static inline void rb_tree_write_end(struct rb_tree *tree)
+{
+        if (!tree->sync) {
+                return;
+        }
+        __atomic_store_n(&tree->sync->seq, tree->sync->seq + 1,
+                         __ATOMIC_RELEASE);
+        rb_tree_reclaim(tree);
+}
+
+/**
+ * @brief Deallocate the node which is detached from the tree
+ * @details In the concurrent tree, the lockless reader may still read the
+ * node. So, it is deferred until the grace period is over.
+ * 
+ * @param tree red-black tree structure
+ * @param node detached node
+ */
+static void rb_tree_node_release(struct rb_tree *tree, struct rb_node *node)
+{
+        if (tree->sync) {
+                node->parent = tree->sync->retired;
+                tree->sync->retired = node;
+                return;
+        }
+        rb_tree_node_free(tree, node);
+}
+
+/**
+ * @brief Enter the read-side critical section
+ * 
+ * @param tree concurrent red-black tree
+ * @return struct rb_tree_reader* reader slot of this thread
+ */
+static struct rb_tree_reader *rb_tree_read_enter(struct rb_tree *tree)
+{
+        struct rb_tree_reader *reader = NULL;
+
+        if (rb_reader_slot == RB_TREE_NR_READER_SLOTS) {
+                rb_reader_slot = __atomic_fetch_add(&rb_next_reader_slot, 1,
+                                                    __ATOMIC_RELAXED) %
+                                 RB_TREE_NR_READER_SLOTS;
+        }
+
+        reader = &tree->sync->readers[rb_reader_slot];
+        __atomic_fetch_add(&reader->count, 1, __ATOMIC_SEQ_CST);
+        return reader;
+}
+
+/**
+ * @brief Exit the read-side critical section
+ * 
+ * @param reader reader slot of this thread
+ */
+static inline void rb_tree_read_exit(struct rb_tree_reader *reader)
+{
+        __atomic_fetch_sub(&reader->count, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Get the sequence number which is not in the middle of write
+ * 
+ * @param tree concurrent red-black tree
+ * @return unsigned long even sequence number
+ */
+static inline unsigned long rb_tree_read_begin(struct rb_tree *tree)
+{
+        unsigned long seq;
+
+        while ((seq = __atomic_load_n(&tree->sync->seq, __ATOMIC_ACQUIRE)) &
+               1) {
+                ; /**< writer is modifying the tree */
+        }
+
+        return seq;
+}
+
+/**
+ * @brief Check the tree is modified during the read
+ * 
+ * @param tree concurrent red-black tree
+ * @param seq return value of `rb_tree_read_begin`
+ * @return int 1 means that read result is invalid and must retry
+ */
+static inline int rb_tree_read_retry(struct rb_tree *tree, unsigned long seq)
+{
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        return __atomic_load_n(&tree->sync->seq, __ATOMIC_RELAXED) != seq;
+}
+
+/**
+ * @brief Recalculate the augmented information of node from its children
+ * 
+ * @param tree red-black tree structure
+ * @param node recalculate target node (must not be tree->nil)
+ */
+static inline void rb_tree_update(struct rb_tree *tree, struct rb_node *node)
+{
+        if (tree->flags & RB_TREE_FLAG_ORDER_STAT) {
+                node->size = node->left->size + node->right->size + 1;
+        }
+        if (tree->augment) {
+                tree->augment(tree, node);
+        }
+}
+
+/**
+ * @brief Recalculate the augmented information from node to the root
+ * 
+ * @param tree red-black tree structure
+ * @param node the lowest node whose subtree is changed
+ */
+static void rb_tree_update_path(struct rb_tree *tree, struct rb_node *node)
+{
+        if (!(tree->flags & RB_TREE_FLAG_ORDER_STAT) && !tree->augment) {
+                return;
+        }
+
+        while (node != tree->nil) {
+                rb_tree_update(tree, node);
+                node = node->parent;
+        }
+}
+
 /**
  * @brief Red-black tree left rotation
  *     (x)                    (y)
@@ -72,22 +530,25 @@ static void rb_tree_left_rotate(struct rb_tree *tree, struct rb_node *x)
 
         y = x->right; /**< set right node */
 
-        x->right = y->left; /**< move subtree */
+        rb_assign_pointer(x->right, y->left); /**< move subtree */
         if (y->left != tree->nil) {
                 y->left->parent = x;
         }
         y->parent = x->parent; /**< change parents */
 
         if (x->parent == tree->nil) {
-                tree->root = y;
+                rb_assign_pointer(tree->root, y);
         } else if (x == x->parent->left) {
-                x->parent->left = y;
+                rb_assign_pointer(x->parent->left, y);
         } else {
-                x->parent->right = y;
+                rb_assign_pointer(x->parent->right, y);
         }
 
-        y->left = x;
+        rb_assign_pointer(y->left, x);
         x->parent = y;
+
+        rb_tree_update(tree, x);
+        rb_tree_update(tree, y);
 }
 
 /**
@@ -107,22 +568,25 @@ static void rb_tree_right_rotate(struct rb_tree *tree, struct rb_node *y)
 
         x = y->left; /**< set left node */
 
-        y->left = x->right; /**< move subtree */
+        rb_assign_pointer(y->left, x->right); /**< move subtree */
         if (x->right != tree->nil) {
                 x->right->parent = y;
         }
         x->parent = y->parent; /**< change parents */
 
         if (y->parent == tree->nil) {
-                tree->root = x;
+                rb_assign_pointer(tree->root, x);
         } else if (y == y->parent->right) {
-                y->parent->right = x;
+                rb_assign_pointer(y->parent->right, x);
         } else {
-                y->parent->left = x;
+                rb_assign_pointer(y->parent->left, x);
         }
 
-        x->right = y;
+        rb_assign_pointer(x->right, y);
         y->parent = x;
+
+        rb_tree_update(tree, y);
+        rb_tree_update(tree, x);
 }
 
 /**
@@ -273,17 +737,17 @@ static void rb_tree_insert_fixup(struct rb_tree *tree, struct rb_node *z)
 }
 
 /**
- * @brief Insert node to red-black tree
+ * @brief Insert node to the subtree of red-black tree
  * 
  * @param tree red-black tree structure
+ * @param y parent of x
+ * @param x root of the subtree whose key range contains z->key
  * @param z new node which insert into red-black tree
  * @return int successfully insert status (0: success, else: fail)
  */
-static int __rb_tree_insert(struct rb_tree *tree, struct rb_node *z)
+static int __rb_tree_insert_from(struct rb_tree *tree, struct rb_node *y,
+                                 struct rb_node *x, struct rb_node *z)
 {
-        struct rb_node *y = NULL;
-        struct rb_node *x = NULL;
-
         if (z == NULL) {
                 pr_info("z must be not null");
                 return -ENOMEM;
@@ -295,11 +759,14 @@ static int __rb_tree_insert(struct rb_tree *tree, struct rb_node *z)
                 return -EINVAL;
         }
 
-        y = tree->nil;
-        x = tree->root;
         while (x != tree->nil) {
-                if (x->key == z->key) { /**< update key's data */
-                        rb_node_move(x, z);
+                if (x->key == z->key &&
+                    !(tree->flags & RB_TREE_FLAG_DUP_KEY)) {
+                        void *data = x->data; /**< update key's data */
+                        rb_assign_pointer(x->data, z->data);
+                        z->data = data;
+                        rb_tree_node_release(tree, z);
+                        tree->finger = x;
                         return 0;
                 }
                 y = x;
@@ -310,15 +777,6 @@ static int __rb_tree_insert(struct rb_tree *tree, struct rb_node *z)
                 }
         } /**< traverse valid insert location */
 
-        z->parent = y;
-        if (y == tree->nil) { /**< set y state */
-                tree->root = z;
-        } else if (z->key < y->key) {
-                y->left = z;
-        } else {
-                y->right = z;
-        }
-
         if (z->left == NULL) {
                 z->left = tree->nil;
         }
@@ -327,150 +785,780 @@ static int __rb_tree_insert(struct rb_tree *tree, struct rb_node *z)
         }
         z->color = RB_NODE_COLOR_RED;
 
-        rb_tree_insert_fixup(tree, z);
+        z->parent = y; /**< z must be initialized before it is published */
+        if (y == tree->nil) { /**< set y state */
+                rb_assign_pointer(tree->root, z);
+        } else if (z->key < y->key) {
+                rb_assign_pointer(y->left, z);
+        } else {
+                rb_assign_pointer(y->right, z);
+        }
+
+        if (y == tree->nil || (y == tree->max && z == y->right)) {
+                tree->max = rb_tree_maximum(tree, z);
+        }
+        tree->finger = z;
+
+        rb_tree_update_path(tree, z);
+        rb_tree_insert_fixup(tree, z);
+
+        return 0;
+}
+
+/**
+ * @brief Insert node to red-black tree
+ * @details If the key is greater than the maximum key, which is common in the
+ * sequential key stream, it is appended to the maximum node directly.
+ * 
+ * @param tree red-black tree structure
+ * @param z new node which insert into red-black tree
+ * @return int successfully insert status (0: success, else: fail)
+ */
+static int __rb_tree_insert(struct rb_tree *tree, struct rb_node *z)
+{
+        if (z && tree->max && z->key > tree->max->key) {
+                return __rb_tree_insert_from(tree, tree->max, tree->nil, z);
+        }
+        return __rb_tree_insert_from(tree, tree->nil, tree->root, z);
+}
+
+/**
+ * @brief Find the subtree from the finger whose key range contains key
+ * @details Climb up from the finger until the key is bounded by the
+ * ancestor. So, the cost is proportional to the distance between the
+ * finger and the key, not to the height of the tree.
+ * 
+ * @param tree red-black tree structure
+ * @param x finger node which is located in tree
+ * @param key key which want to insert
+ * @return struct rb_node* root of the subtree where the descent starts
+ */
+static struct rb_node *rb_tree_finger_search(struct rb_tree *tree,
+                                             struct rb_node *x, key_t key)
+{
+        struct rb_node *p = NULL;
+
+        if (tree->max && key > tree->max->key) {
+                return tree->max;
+        }
+
+        if (key > x->key) {
+                while (x != tree->root) {
+                        p = x->parent;
+                        if (x == p->left && key < p->key) {
+                                break;
+                        }
+                        x = p;
+                }
+        } else if (key < x->key) {
+                while (x != tree->root) {
+                        p = x->parent;
+                        if (x == p->right && key > p->key) {
+                                break;
+                        }
+                        x = p;
+                }
+        }
+
+        return x;
+}
+
+/**
+ * @brief Wrapping function of `__rb_tree_insert`
+ * 
+ * @param tree red-black tree structure
+ * @param key new node's key
+ * @param data new node's data
+ * @return int successfully insert status (0: success, else: fail)
+ */
+int rb_tree_insert(struct rb_tree *tree, const key_t key, void *data)
+{
+        struct rb_node *node = NULL;
+        int ret;
+
+        node = rb_tree_node_alloc(tree, key);
+        if (!node) {
+                pr_info("Allocate the node failed");
+                return -ENOMEM;
+        }
+
+        node->data = data;
+
+        rb_tree_write_begin(tree);
+        ret = __rb_tree_insert(tree, node);
+        rb_tree_write_end(tree);
+        if (ret == -EINVAL) {
+                rb_tree_node_free(tree, node);
+        }
+
+        return ret;
+}
+
+/**
+ * @brief Insert the key by starting from the hint node
+ * @details Works like `std::map::emplace_hint`. When the key is near the
+ * hint, the location is found in amortized O(1) instead of O(log n).
+ * 
+ * @param tree red-black tree structure
+ * @param hint node near the key. If NULL, the last inserted node is used
+ * @param key new node's key
+ * @param data new node's data
+ * @return int successfully insert status (0: success, else: fail)
+ */
+int rb_tree_insert_hint(struct rb_tree *tree, struct rb_node *hint,
+                        const key_t key, void *data)
+{
+        struct rb_node *node = NULL;
+        struct rb_node *x = NULL;
+        int ret;
+
+        if (!hint) {
+                hint = tree->finger;
+        }
+
+        node = rb_tree_node_alloc(tree, key);
+        if (!node) {
+                pr_info("Allocate the node failed");
+                return -ENOMEM;
+        }
+
+        node->data = data;
+
+        rb_tree_write_begin(tree);
+        if (!hint || hint == tree->nil) {
+                ret = __rb_tree_insert(tree, node);
+        } else {
+                x = rb_tree_finger_search(tree, hint, key);
+                ret = __rb_tree_insert_from(tree, x->parent, x, node);
+        }
+        rb_tree_write_end(tree);
+        if (ret == -EINVAL) {
+                rb_tree_node_free(tree, node);
+        }
+
+        return ret;
+}
+
+/**
+ * @brief Insert the node which is allocated by caller
+ * @details This is used for the tree whose nodes embed `struct rb_node`
+ * (e.g. interval tree). Node's left, right must be NULL.
+ * 
+ * @param tree red-black tree structure
+ * @param node new node which insert into red-black tree
+ * @return int successfully insert status (0: success, else: fail)
+ * @warning If the key already exists and RB_TREE_FLAG_DUP_KEY is not set,
+ * node is merged and deallocated. The tree must not have a node pool.
+ */
+int rb_tree_insert_node(struct rb_tree *tree, struct rb_node *node)
+{
+        int ret;
+
+        if (tree->pool) {
+                pr_info("pooled tree cannot take the caller's node\n");
+                return -EINVAL;
+        }
+
+        rb_tree_write_begin(tree);
+        ret = __rb_tree_insert(tree, node);
+        rb_tree_write_end(tree);
+
+        return ret;
+}
+
+/**
+ * @brief Translant previous root to next root
+ * @details tree->nil is shared by every tree, so its parent is never written.
+ * Otherwise, writers of two different trees race on it.
+ * 
+ * @param tree red-black tree whole
+ * @param prev_root previous root node
+ * @param next_root next root node which want to transplant
+ */
+static void rb_tree_transplant(struct rb_tree *tree, struct rb_node *prev_root,
+                               struct rb_node *next_root)
+{
+        if (prev_root->parent == tree->nil) {
+                rb_assign_pointer(tree->root, next_root);
+        } else if (prev_root == prev_root->parent->left) {
+                rb_assign_pointer(prev_root->parent->left, next_root);
+        } else {
+                rb_assign_pointer(prev_root->parent->right, next_root);
+        }
+
+        if (next_root != tree->nil) {
+                next_root->parent = prev_root->parent;
+        }
+}
+
+/**
+ * @brief Get red-black tree's minimum node
+ * 
+ * @param tree red-black tree whole
+ * @param root root of red-black tree
+ * @return struct rb_node* minimum red-black tree node
+ */
+struct rb_node *rb_tree_minimum(struct rb_tree *tree, struct rb_node *root)
+{
+        if (root == tree->nil) {
+                return root;
+        }
+
+        while (root->left != tree->nil) {
+                root = root->left;
+        }
+
+        return root;
+}
+
+/**
+ * @brief Get red-black tree's maximum node
+ * 
+ * @param tree red-black tree whole
+ * @param root root of red-black tree
+ * @return struct rb_node* maximum red-black tree node
+ */
+struct rb_node *rb_tree_maximum(struct rb_tree *tree, struct rb_node *root)
+{
+        if (root == tree->nil) {
+                return root;
+        }
+
+        while (root->right != tree->nil) {
+                root = root->right;
+        }
+
+        return root;
+}
+
+/**
+ * @brief successor of specific node location
+ * 
+ * @param tree red-black tree whole
+ * @param x specific node location of tree
+ * @return struct rb_node* node which successor of specific node location
+ */
+struct rb_node *rb_tree_successor(struct rb_tree *tree, struct rb_node *x)
+{
+        struct rb_node *y = NULL;
+
+        if (x->right != tree->nil) {
+                return rb_tree_minimum(tree, x->right);
+        }
+
+        y = x->parent;
+
+        while (y != tree->nil && x == y->right) {
+                x = y;
+                y = y->parent;
+        }
+
+        return y;
+}
+
+/**
+ * @brief predecessor of specific node location
+ * 
+ * @param tree red-black tree whole
+ * @param x specific node location of tree
+ * @return struct rb_node* node which predecessor of specific node location
+ */
+struct rb_node *rb_tree_predecessor(struct rb_tree *tree, struct rb_node *y)
+{
+        struct rb_node *x = NULL;
+
+        if (y->left != tree->nil) {
+                return rb_tree_maximum(tree, y->left);
+        }
+
+        x = y->parent;
+
+        while (x != tree->nil && y == x->left) {
+                y = x;
+                x = x->parent;
+        }
+
+        return x;
+}
+
+/**
+ * @brief Get the first node whose key is not less than key
+ * 
+ * @param tree red-black tree whole
+ * @param key lower bound key
+ * @return struct rb_node* first node which key >= key.
+ * If there is no such node then return NULL pointer
+ */
+struct rb_node *rb_tree_lower_bound(struct rb_tree *tree, key_t key)
+{
+        struct rb_node *x = tree->root;
+        struct rb_node *y = NULL;
+
+        while (x != tree->nil) {
+                if (x->key >= key) {
+                        y = x;
+                        x = x->left;
+                } else {
+                        x = x->right;
+                }
+        }
+
+        return y;
+}
+
+/**
+ * @brief Get the first node whose key is greater than key
+ * 
+ * @param tree red-black tree whole
+ * @param key upper bound key
+ * @return struct rb_node* first node which key > key.
+ * If there is no such node then return NULL pointer
+ */
+struct rb_node *rb_tree_upper_bound(struct rb_tree *tree, key_t key)
+{
+        struct rb_node *x = tree->root;
+        struct rb_node *y = NULL;
+
+        while (x != tree->nil) {
+                if (x->key > key) {
+                        y = x;
+                        x = x->left;
+                } else {
+                        x = x->right;
+                }
+        }
+
+        return y;
+}
+
+/**
+ * @brief Push the left spine of the subtree to the iterator stack
+ * 
+ * @param iter range iterator
+ * @param x root of the subtree
+ */
+static void rb_tree_iter_push_left(struct rb_tree_iter *iter, struct rb_node *x)
+{
+        while (x != iter->tree->nil) {
+                iter->stack[iter->top++] = x;
+                x = x->left;
+        }
+}
+
+/**
+ * @brief Initialize the iterator which walks [lo, hi) in ascending order
+ * @details Only the ancestors where the lower bound search goes left are
+ * pushed. Thus, the top of the stack is always the next node to visit.
+ * 
+ * @param iter iterator which want to initialize
+ * @param tree red-black tree whole
+ * @param lo inclusive lower bound
+ * @param hi exclusive upper bound
+ */
+void rb_tree_iter_init(struct rb_tree_iter *iter, struct rb_tree *tree,
+                       key_t lo, key_t hi)
+{
+        struct rb_node *x = tree->root;
+
+        iter->tree = tree;
+        iter->hi = hi;
+        iter->top = 0;
+
+        while (x != tree->nil) {
+                if (x->key >= lo) {
+                        iter->stack[iter->top++] = x;
+                        x = x->left;
+                } else {
+                        x = x->right;
+                }
+        }
+}
+
+/**
+ * @brief Get the next node of the range
+ * @details Every node is pushed and popped only once. So, walking k nodes
+ * costs O(log n + k) which means amortized O(1) per node.
+ * 
+ * @param iter range iterator
+ * @return struct rb_node* next node in the range. If range is exhausted then
+ * return NULL pointer
+ */
+struct rb_node *rb_tree_iter_next(struct rb_tree_iter *iter)
+{
+        struct rb_node *node = NULL;
+
+        if (iter->top == 0) {
+                return NULL;
+        }
+
+        node = iter->stack[--iter->top];
+        if (node->key >= iter->hi) {
+                iter->top = 0;
+                return NULL;
+        }
+        rb_tree_iter_push_left(iter, node->right);
+
+        return node;
+}
+
+/**
+ * @brief Call fn for each node in [lo, hi) with ascending order
+ * 
+ * @param tree red-black tree whole
+ * @param lo inclusive lower bound
+ * @param hi exclusive upper bound
+ * @param fn callback function. Non-zero return value stops the traverse
+ * @param arg argument which passes to the callback function
+ * @return int 0 means that all nodes are visited. Otherwise, the return
+ * value of fn which stops the traverse
+ */
+int rb_tree_range_foreach(struct rb_tree *tree, key_t lo, key_t hi,
+                          int (*fn)(struct rb_node *node, void *arg),
+                          void *arg)
+{
+        struct rb_tree_iter iter;
+        struct rb_node *node = NULL;
+        int ret = 0;
+
+        rb_tree_iter_init(&iter, tree, lo, hi);
+        while ((node = rb_tree_iter_next(&iter)) != NULL) {
+                ret = fn(node, arg);
+                if (ret) {
+                        break;
+                }
+        }
+
+        return ret;
+}
+
+/**
+ * @brief Calculate the subtree size of every node in the subtree
+ * 
+ * @param tree red-black tree whole
+ * @param node the root of the subtree
+ * @return size_t number of nodes in the subtree
+ */
+static size_t __rb_tree_calc_size(struct rb_tree *tree, struct rb_node *node)
+{
+        if (node == tree->nil) {
+                return 0;
+        }
+
+        node->size = __rb_tree_calc_size(tree, node->left) +
+                     __rb_tree_calc_size(tree, node->right) + 1;
+        return node->size;
+}
+
+/**
+ * @brief Start to maintain the subtree size of each node
+ * @details The sizes are calculated in O(n) at the first call. After that,
+ * rotations, insert, delete and concat keep them up to date. Queries never
+ * turn this on by themselves, so this must be called by the writer before
+ * `rb_tree_select`, `rb_tree_rank` and `rb_tree_range_count` are used.
+ * 
+ * @param tree red-black tree whole
+ */
+void rb_tree_enable_order_stat(struct rb_tree *tree)
+{
+        if (tree->flags & RB_TREE_FLAG_ORDER_STAT) {
+                return;
+        }
+
+        __rb_tree_calc_size(tree, tree->root);
+        tree->flags |= RB_TREE_FLAG_ORDER_STAT;
+}
+
+/**
+ * @brief Get the i-th smallest node of the tree
+ * 
+ * @param tree red-black tree whole
+ * @param i rank of the node which starts from 1
+ * @return struct rb_node* i-th smallest node. If i is out of range or the
+ * tree does not maintain the subtree size then return NULL pointer
+ * 
+ * @ref Introduction to Algorithms(CLRS) ▶ augmenting data structures ▶ OS-SELECT
+ */
+struct rb_node *rb_tree_select(struct rb_tree *tree, size_t i)
+{
+        struct rb_node *x = NULL;
+        size_t r = 0;
+
+        if (!(tree->flags & RB_TREE_FLAG_ORDER_STAT)) {
+                pr_info("order statistic is not enabled\n");
+                return NULL;
+        }
+
+        x = tree->root;
+        while (x != tree->nil) {
+                r = x->left->size + 1;
+                if (i == r) {
+                        return x;
+                }
+
+                if (i < r) {
+                        x = x->left;
+                } else {
+                        i -= r;
+                        x = x->right;
+                }
+        }
 
-        return 0;
+        return NULL;
 }
 
 /**
- * @brief Wrapping function of `__rb_tree_insert`
+ * @brief Count nodes whose key is less than (or equal to) key
  * 
- * @param tree red-black tree structure
- * @param key new node's key
- * @param data new node's data
- * @return int successfully insert status (0: success, else: fail)
+ * @param tree red-black tree whole
+ * @param key boundary key
+ * @param inclusive count the node which has the same key or not
+ * @return size_t number of nodes
  */
-int rb_tree_insert(struct rb_tree *tree, const key_t key, void *data)
+static size_t rb_tree_count_below(struct rb_tree *tree, key_t key,
+                                  int inclusive)
 {
-        struct rb_node *node = NULL;
-        int ret;
-
-        node = rb_node_alloc(key);
-        if (!node) {
-                pr_info("Allocate the node failed");
-                return -ENOMEM;
-        }
-
-        node->data = data;
+        struct rb_node *x = tree->root;
+        size_t count = 0;
 
-        ret = __rb_tree_insert(tree, node);
-        if (ret == -EINVAL) {
-                rb_node_dealloc(node);
+        while (x != tree->nil) {
+                if (key < x->key || (!inclusive && key == x->key)) {
+                        x = x->left;
+                } else {
+                        count += x->left->size + 1;
+                        x = x->right;
+                }
         }
 
-        return ret;
+        return count;
 }
 
 /**
- * @brief Translant previous root to next root
+ * @brief Get the rank of key
  * 
  * @param tree red-black tree whole
- * @param prev_root previous root node
- * @param next_root next root node which want to transplant
+ * @param key the key which I want to get rank
+ * @return size_t number of nodes whose key is less than or equal to key.
+ * So, if key exists then it is the position of key which starts from 1.
+ * RB_INVALID_RANK means that the order statistic is not enabled
+ * 
+ * @ref Introduction to Algorithms(CLRS) ▶ augmenting data structures ▶ OS-RANK
  */
-static void rb_tree_transplant(struct rb_tree *tree, struct rb_node *prev_root,
-                               struct rb_node *next_root)
+size_t rb_tree_rank(struct rb_tree *tree, key_t key)
 {
-        if (prev_root->parent == tree->nil) {
-                tree->root = next_root;
-        } else if (prev_root == prev_root->parent->left) {
-                prev_root->parent->left = next_root;
-        } else {
-                prev_root->parent->right = next_root;
+        if (!(tree->flags & RB_TREE_FLAG_ORDER_STAT)) {
+                pr_info("order statistic is not enabled\n");
+                return RB_INVALID_RANK;
         }
-
-        next_root->parent = prev_root->parent;
+        return rb_tree_count_below(tree, key, 1);
 }
 
 /**
- * @brief Get red-black tree's minimum node
+ * @brief Count nodes in [lo, hi)
  * 
  * @param tree red-black tree whole
- * @param root root of red-black tree
- * @return struct rb_node* minimum red-black tree node
+ * @param lo inclusive lower bound
+ * @param hi exclusive upper bound
+ * @return size_t number of nodes in the range. RB_INVALID_RANK means that
+ * the order statistic is not enabled
  */
-struct rb_node *rb_tree_minimum(struct rb_tree *tree, struct rb_node *root)
+size_t rb_tree_range_count(struct rb_tree *tree, key_t lo, key_t hi)
 {
-        if (root == tree->nil) {
-                return root;
+        if (!(tree->flags & RB_TREE_FLAG_ORDER_STAT)) {
+                pr_info("order statistic is not enabled\n");
+                return RB_INVALID_RANK;
         }
 
-        while (root->left != tree->nil) {
-                root = root->left;
+        if (lo >= hi) {
+                return 0;
         }
 
-        return root;
+        return rb_tree_count_below(tree, hi, 0) -
+               rb_tree_count_below(tree, lo, 0);
 }
 
 /**
- * @brief Get red-black tree's maximum node
+ * @brief Make the tree readable without the lock
+ * @details After this, `rb_tree_insert` and `rb_tree_delete` are executed as
+ * the writer. They must be serialized by caller (single writer), but readers
+ * which use `*_lockless` functions never block them.
  * 
  * @param tree red-black tree whole
- * @param root root of red-black tree
- * @return struct rb_node* maximum red-black tree node
+ * @return int 0 means success. -ENOMEM means allocation failed
+ * @warning concat and split are not supported in the concurrent tree.
  */
-struct rb_node *rb_tree_maximum(struct rb_tree *tree, struct rb_node *root)
+int rb_tree_enable_concurrent(struct rb_tree *tree)
 {
-        if (root == tree->nil) {
-                return root;
+        struct rb_tree_sync *sync = NULL;
+
+        if (tree->sync) {
+                return 0;
         }
 
-        while (root->right != tree->nil) {
-                root = root->right;
+        sync = (struct rb_tree_sync *)aligned_alloc(
+                RB_TREE_CACHE_LINE_SIZE, sizeof(struct rb_tree_sync));
+        if (!sync) {
+                pr_info("Memory allocation failed\n");
+                return -ENOMEM;
         }
+        memset(sync, 0, sizeof(struct rb_tree_sync));
 
-        return root;
+        tree->sync = sync;
+        tree->flags |= RB_TREE_FLAG_CONCURRENT;
+        return 0;
 }
 
 /**
- * @brief successor of specific node location
+ * @brief Search the key without the lock
+ * @details Traverse is retried when the writer modifies the tree during it.
+ * The number of steps is bounded by the maximum height, so the traverse
+ * which races with rotations always terminates.
  * 
- * @param tree red-black tree whole
- * @param x specific node location of tree
- * @return struct rb_node* node which successor of specific node location
+ * @param tree concurrent red-black tree
+ * @param key key which I want to find
+ * @param data data of the key is stored in this location (can be NULL)
+ * @return int 0 means found. -ENODATA means not found
+ * @warning data is valid only while the writer does not delete the key.
  */
-struct rb_node *rb_tree_successor(struct rb_tree *tree, struct rb_node *x)
+int rb_tree_search_lockless(struct rb_tree *tree, key_t key, void **data)
 {
-        struct rb_node *y = NULL;
+        struct rb_tree_reader *reader = NULL;
+        struct rb_node *x = NULL;
+        void *found = NULL;
+        unsigned long seq;
+        size_t step;
+        int ret;
 
-        if (x->right != tree->nil) {
-                return rb_tree_minimum(tree, x->right);
+        if (!tree->sync) {
+                pr_info("tree is not concurrent\n");
+                return -EINVAL;
         }
 
-        y = x->parent;
+        reader = rb_tree_read_enter(tree);
+        do {
+                seq = rb_tree_read_begin(tree);
+                ret = -ENODATA;
+                x = rb_dereference(tree->root);
+                for (step = 0; x != tree->nil && step < RB_TREE_ITER_STACK_SIZE;
+                     step++) {
+                        if (key == x->key) {
+                                found = rb_dereference(x->data);
+                                ret = 0;
+                                break;
+                        }
+                        x = (key < x->key ? rb_dereference(x->left) :
+                                            rb_dereference(x->right));
+                }
+        } while (rb_tree_read_retry(tree, seq));
+        rb_tree_read_exit(reader);
 
-        while (y != tree->nil && x == y->right) {
-                x = y;
-                y = y->parent;
+        if (!ret && data) {
+                *data = found;
         }
-
-        return y;
+        return ret;
 }
 
 /**
- * @brief predecessor of specific node location
+ * @brief Find the nearest key of key without the lock
  * 
- * @param tree red-black tree whole
- * @param x specific node location of tree
- * @return struct rb_node* node which predecessor of specific node location
+ * @param tree concurrent red-black tree
+ * @param key base key
+ * @param is_next find the smallest key > key if 1, else the largest key < key
+ * @param near found key is stored in this location
+ * @param data data of the found key is stored in this location (can be NULL)
+ * @return int 0 means found. -ENODATA means not found
  */
-struct rb_node *rb_tree_predecessor(struct rb_tree *tree, struct rb_node *y)
+static int rb_tree_near_lockless(struct rb_tree *tree, key_t key, int is_next,
+                                 key_t *near, void **data)
 {
+        struct rb_tree_reader *reader = NULL;
         struct rb_node *x = NULL;
+        void *found_data = NULL;
+        key_t found_key = RB_NODE_NIL_KEY_VALUE;
+        unsigned long seq;
+        size_t step;
+        int ret;
 
-        if (y->left != tree->nil) {
-                return rb_tree_maximum(tree, y->left);
+        if (!tree->sync) {
+                pr_info("tree is not concurrent\n");
+                return -EINVAL;
         }
 
-        x = y->parent;
+        reader = rb_tree_read_enter(tree);
+        do {
+                seq = rb_tree_read_begin(tree);
+                ret = -ENODATA;
+                x = rb_dereference(tree->root);
+                for (step = 0; x != tree->nil && step < RB_TREE_ITER_STACK_SIZE;
+                     step++) {
+                        if (is_next ? (x->key > key) : (x->key < key)) {
+                                found_key = x->key;
+                                found_data = rb_dereference(x->data);
+                                ret = 0;
+                                x = (is_next ? rb_dereference(x->left) :
+                                               rb_dereference(x->right));
+                        } else {
+                                x = (is_next ? rb_dereference(x->right) :
+                                               rb_dereference(x->left));
+                        }
+                }
+        } while (rb_tree_read_retry(tree, seq));
+        rb_tree_read_exit(reader);
 
-        while (x != tree->nil && y == x->left) {
-                y = x;
-                x = x->parent;
+        if (!ret) {
+                *near = found_key;
+                if (data) {
+                        *data = found_data;
+                }
         }
+        return ret;
+}
 
-        return x;
+/**
+ * @brief Get the successor key of key without the lock
+ * 
+ * @param tree concurrent red-black tree
+ * @param key base key (need not exist in tree)
+ * @param next the smallest key which is greater than key
+ * @param data data of next (can be NULL)
+ * @return int 0 means found. -ENODATA means there is no successor
+ */
+int rb_tree_next_lockless(struct rb_tree *tree, key_t key, key_t *next,
+                          void **data)
+{
+        return rb_tree_near_lockless(tree, key, 1, next, data);
+}
+
+/**
+ * @brief Get the predecessor key of key without the lock
+ * 
+ * @param tree concurrent red-black tree
+ * @param key base key (need not exist in tree)
+ * @param prev the largest key which is less than key
+ * @param data data of prev (can be NULL)
+ * @return int 0 means found. -ENODATA means there is no predecessor
+ */
+int rb_tree_prev_lockless(struct rb_tree *tree, key_t key, key_t *prev,
+                          void **data)
+{
+        return rb_tree_near_lockless(tree, key, 0, prev, data);
+}
+
+/**
+ * @brief Wait until every retired node is freed (writer side)
+ * 
+ * @param tree concurrent red-black tree
+ */
+void rb_tree_synchronize(struct rb_tree *tree)
+{
+        if (!tree->sync) {
+                return;
+        }
+
+        do {
+                rb_tree_reclaim(tree);
+        } while (tree->sync->waiting || tree->sync->retired);
 }
+
 /**
  * @brief Re-color nodes and perform rotations
  * @details
@@ -478,11 +1566,16 @@ struct rb_node *rb_tree_predecessor(struct rb_tree *tree, struct rb_node *y)
  * case 2: x's sibling w is black, and both of w's children are black 
  * case 3: x's sibling w is black, w's left child is red, and w's right child is black
  * case 4: x's sibling w is black, and w's right child is red
+ *
+ * x can be tree->nil which is shared by every tree. So, unlike CLRS, the
+ * parent of x is passed by xp instead of being stored in nil's parent.
  * 
  * @param tree red-black tree structure
  * @param x rotation key node pointer
+ * @param xp parent of x
  */
-static void rb_tree_delete_fixup(struct rb_tree *tree, struct rb_node *x)
+static void rb_tree_delete_fixup(struct rb_tree *tree, struct rb_node *x,
+                                 struct rb_node *xp)
 {
         struct rb_node *w = NULL;
         int is_forced = 0;
@@ -490,61 +1583,63 @@ static void rb_tree_delete_fixup(struct rb_tree *tree, struct rb_node *x)
 
         while (x != tree->root && x->color == RB_NODE_COLOR_BLACK) {
                 is_goes_up = 1;
-                if (x == x->parent->left) {
-                        w = x->parent->right;
+                if (x == xp->left) {
+                        w = xp->right;
                         if (w->color == RB_NODE_COLOR_RED) {
                                 w->color = RB_NODE_COLOR_BLACK;
-                                x->parent->color = RB_NODE_COLOR_RED;
-                                rb_tree_left_rotate(tree, x->parent);
-                                w = x->parent->right;
+                                xp->color = RB_NODE_COLOR_RED;
+                                rb_tree_left_rotate(tree, xp);
+                                w = xp->right;
                         } /**< case 1 */
 
                         if (w->left->color == RB_NODE_COLOR_BLACK &&
                             w->right->color == RB_NODE_COLOR_BLACK) {
                                 w->color = RB_NODE_COLOR_RED;
-                                x = x->parent;
+                                x = xp;
+                                xp = x->parent;
                         } /**< case 2 */
                         else {
                                 if (w->right->color == RB_NODE_COLOR_BLACK) {
                                         w->left->color = RB_NODE_COLOR_BLACK;
                                         w->color = RB_NODE_COLOR_RED;
                                         rb_tree_right_rotate(tree, w);
-                                        w = x->parent->right;
+                                        w = xp->right;
                                 } /**< case 3 */
 
-                                w->color = x->parent->color;
-                                x->parent->color = RB_NODE_COLOR_BLACK;
+                                w->color = xp->color;
+                                xp->color = RB_NODE_COLOR_BLACK;
                                 w->right->color = RB_NODE_COLOR_BLACK;
-                                rb_tree_left_rotate(tree, x->parent);
+                                rb_tree_left_rotate(tree, xp);
                                 x = tree->root; /**< case 4 */
                                 is_forced = 1;
                         }
                 } else { /**< only different part is left and right */
-                        w = x->parent->left;
+                        w = xp->left;
                         if (w->color == RB_NODE_COLOR_RED) {
                                 w->color = RB_NODE_COLOR_BLACK;
-                                x->parent->color = RB_NODE_COLOR_RED;
-                                rb_tree_right_rotate(tree, x->parent);
-                                w = x->parent->left;
+                                xp->color = RB_NODE_COLOR_RED;
+                                rb_tree_right_rotate(tree, xp);
+                                w = xp->left;
                         } /**< case 1 */
 
                         if (w->right->color == RB_NODE_COLOR_BLACK &&
                             w->left->color == RB_NODE_COLOR_BLACK) {
                                 w->color = RB_NODE_COLOR_RED;
-                                x = x->parent;
+                                x = xp;
+                                xp = x->parent;
                         } /**< case 2 */
                         else {
                                 if (w->left->color == RB_NODE_COLOR_BLACK) {
                                         w->right->color = RB_NODE_COLOR_BLACK;
                                         w->color = RB_NODE_COLOR_RED;
                                         rb_tree_left_rotate(tree, w);
-                                        w = x->parent->left;
+                                        w = xp->left;
                                 } /**< case 3 */
 
-                                w->color = x->parent->color;
-                                x->parent->color = RB_NODE_COLOR_BLACK;
+                                w->color = xp->color;
+                                xp->color = RB_NODE_COLOR_BLACK;
                                 w->left->color = RB_NODE_COLOR_BLACK;
-                                rb_tree_right_rotate(tree, x->parent);
+                                rb_tree_right_rotate(tree, xp);
                                 x = tree->root; /**< case 4 */
                                 is_forced = 1;
                         }
@@ -553,7 +1648,9 @@ static void rb_tree_delete_fixup(struct rb_tree *tree, struct rb_node *x)
         if (x == tree->nil || (is_goes_up && !is_forced && x == tree->root)) {
                 tree->bh -= 1;
         }
-        x->color = RB_NODE_COLOR_BLACK;
+        if (x != tree->nil) {
+                x->color = RB_NODE_COLOR_BLACK;
+        }
 }
 
 /**
@@ -565,40 +1662,77 @@ static void rb_tree_delete_fixup(struct rb_tree *tree, struct rb_node *x)
 static void __rb_tree_delete(struct rb_tree *tree, struct rb_node *z)
 {
         struct rb_node *x = NULL;
+        struct rb_node *xp = NULL; /**< parent of x (x can be tree->nil) */
         struct rb_node *y = NULL;
+        struct rb_node *s = NULL; /**< the lowest node whose subtree changed */
 
         enum rb_node_color y_original_color;
 
+        if (z == tree->finger) {
+                tree->finger = NULL;
+        }
+        if (z == tree->max) {
+                tree->max = rb_tree_predecessor(tree, z);
+                if (tree->max == tree->nil) {
+                        tree->max = NULL;
+                }
+        }
+
         y = z;
         y_original_color = y->color;
+        s = z->parent;
         if (z->left == tree->nil) {
                 x = z->right;
+                xp = z->parent;
                 rb_tree_transplant(tree, z, z->right);
         } else if (z->right == tree->nil) {
                 x = z->left;
+                xp = z->parent;
                 rb_tree_transplant(tree, z, z->left);
         } else {
                 y = rb_tree_minimum(tree, z->right);
                 y_original_color = y->color;
                 x = y->right;
+                xp = y->parent;
+                s = y->parent;
                 if (y->parent == z) {
-                        x->parent = y;
+                        xp = y;
+                        s = y;
                 } else {
                         rb_tree_transplant(tree, y, y->right);
-                        y->right = z->right;
+                        rb_assign_pointer(y->right, z->right);
                         y->right->parent = y;
                 }
                 rb_tree_transplant(tree, z, y);
-                y->left = z->left;
+                rb_assign_pointer(y->left, z->left);
                 y->left->parent = y;
                 y->color = z->color;
         }
 
+        rb_tree_update_path(tree, s);
         if (y_original_color == RB_NODE_COLOR_BLACK) {
-                rb_tree_delete_fixup(tree, x);
+                rb_tree_delete_fixup(tree, x, xp);
         }
 }
 
+/**
+ * @brief Detach the node from the red-black tree and release it
+ * @details The node is released like `rb_tree_delete` does. So, in the
+ * concurrent tree, it is freed after the grace period.
+ * 
+ * @param tree red-black tree whole
+ * @param node delete target node which is located in tree
+ * @note Caller must not deallocate node. It must be allocated by `malloc`
+ * (or the tree's pool) with `struct rb_node` at the first member.
+ */
+void rb_tree_delete_node(struct rb_tree *tree, struct rb_node *node)
+{
+        rb_tree_write_begin(tree);
+        __rb_tree_delete(tree, node);
+        rb_tree_node_release(tree, node);
+        rb_tree_write_end(tree);
+}
+
 /**
  * @brief Wrapping function of `__rb_tree_delete`
  * 
@@ -612,130 +1746,257 @@ int rb_tree_delete(struct rb_tree *tree, key_t key)
         if (!node) {
                 return -ENODATA;
         }
+        rb_tree_write_begin(tree);
         __rb_tree_delete(tree, node);
-        rb_node_dealloc(node);
+        rb_tree_node_release(tree, node);
+        rb_tree_write_end(tree);
         return 0;
 }
 
+/**
+ * @brief Join t1, x and t2 into t1
+ * @details Walk down the spine of the taller tree until the black height
+ * matches the shorter tree, hang x there as a red node and fix up. This
+ * takes O(|t1->bh - t2->bh| + 1).
+ * 
+ * @param t1 red-black tree whose keys are not greater than x->key.
+ * It has the result after the join.
+ * @param x detached node which joins the two trees
+ * @param t2 red-black tree whose keys are not smaller than x->key.
+ * Its nodes are moved to t1.
+ * @warning Both roots must be black and their parent must be nil.
+ * 
+ * @ref Introduction to Algorithms(CLRS) ▶ red-black tree chapter ▶ problem 13-2
+ */
+static void rb_tree_join(struct rb_tree *t1, struct rb_node *x,
+                         struct rb_tree *t2)
+{
+        struct rb_node *nil = t1->nil;
+        struct rb_node *root = NULL;
+        struct rb_node *p = nil;
+        struct rb_node *y = NULL;
+        size_t bh = 0;
+
+        x->color = RB_NODE_COLOR_RED;
+        x->size = 1;
+        if (t1->bh >= t2->bh) {
+                y = t1->root;
+                bh = t1->bh;
+                while (y != nil &&
+                       (y->color == RB_NODE_COLOR_RED || bh > t2->bh)) {
+                        p = y;
+                        y = y->right;
+                        if (y->color == RB_NODE_COLOR_BLACK) {
+                                bh -= 1;
+                        }
+                }
+
+                x->left = y;
+                x->right = t2->root;
+                if (p == nil) {
+                        t1->root = x;
+                } else {
+                        p->right = x;
+                }
+        } else { /**> symmetric of previous sequence */
+                y = t2->root;
+                bh = t2->bh;
+                while (y != nil &&
+                       (y->color == RB_NODE_COLOR_RED || bh > t1->bh)) {
+                        p = y;
+                        y = y->left;
+                        if (y->color == RB_NODE_COLOR_BLACK) {
+                                bh -= 1;
+                        }
+                }
+
+                root = (p == nil ? x : t2->root);
+                x->left = t1->root;
+                x->right = y;
+                if (p != nil) {
+                        p->left = x;
+                }
+                t1->root = root;
+                t1->bh = t2->bh;
+        }
+
+        x->parent = p;
+        if (x->left != nil) {
+                x->left->parent = x;
+        }
+        if (x->right != nil) {
+                x->right->parent = x;
+        }
+        t2->root = nil;
+        t2->bh = 0;
+
+        rb_tree_update_path(t1, x);
+        rb_tree_insert_fixup(t1, x);
+}
+
 /**
  * @brief Concatenate two red-black tree by using node x
+ * @details Either tree can be empty. If x is the maximum node of t1 or the
+ * minimum node of t2, it is detached from the tree and reused. Nothing is
+ * allocated in that case, so the concatenation of valid trees never fails.
  * 
  * @param t1 red-black tree which have all value is smaller than x->key
  * @param t2 red-black tree which have all value is greater than x->key
- * @param x node which value is over max(t1->key) < x < min(t2->key)
- * @return struct rb_tree* 
+ * @param x node which value is over max(t1->key) < x < min(t2->key).
+ * It must be allocated by `rb_node_alloc` or come from the trees' pool.
+ * A malloc-ed x which joins the pooled tree is moved to the pool node.
+ * @return struct rb_tree* concatenated tree which reuses t1's structure.
+ * t2 is deallocated. If NULL is returned, both trees are not changed.
  * 
  * @ref Introduction to Algorithms(CLRS) ▶ red-black tree chapter ▶ problem 13-2
  */
 struct rb_tree *rb_tree_concat(struct rb_tree *t1, struct rb_tree *t2,
                                struct rb_node *x)
 {
-        struct rb_tree *new_tree = NULL;
-        struct rb_node *y = NULL;
         struct rb_node *x1_max_node = NULL;
         struct rb_node *x2_min_node = NULL;
 
-        key_t x1_max_key = RB_NODE_NIL_KEY_VALUE;
-        key_t x2_min_key = RB_NODE_NIL_KEY_VALUE;
+        if (t1->sync || t2->sync) {
+                pr_info("concurrent tree cannot be concatenated\n");
+                return NULL;
+        }
 
-        size_t bh = 0;
+        if (!t1->pool != !t2->pool) {
+                pr_info("pooled tree cannot be concatenated with unpooled tree\n");
+                return NULL;
+        }
+
+        if (t1->pool != t2->pool && (t1->pool->ref > 1 || t2->pool->ref > 1)) {
+                pr_info("pool which is shared cannot be merged\n");
+                return NULL;
+        }
 
         x1_max_node = rb_tree_maximum(t1, t1->root);
         x2_min_node = rb_tree_minimum(t2, t2->root);
 
-        x1_max_key = x1_max_node->key;
-        x2_min_key = x2_min_node->key;
-
         /**< Originally allow the same key. But this version doesn't allow it */
-        if (!(x1_max_key <= x->key && x->key <= x2_min_key)) {
-                pr_info("invalid state key state x1.key(%ld) <= x.key(%ld) <= x2.key(%ld)\n",
-                        x1_max_key, x->key, x2_min_key);
+        if ((x1_max_node != t1->nil && x1_max_node != x &&
+             x1_max_node->key >= x->key) ||
+            (x2_min_node != t2->nil && x2_min_node != x &&
+             x->key >= x2_min_node->key)) {
+                pr_info("invalid state key state x1.key(%ld) < x.key(%ld) < x2.key(%ld)\n",
+                        x1_max_node->key, x->key, x2_min_node->key);
                 return NULL;
         }
 
-        if (x->key == x1_max_key || x->key == x2_min_key) {
+        if (x == x1_max_node || x == x2_min_node) {
+                __rb_tree_delete(x == x1_max_node ? t1 : t2, x);
+        } else if (t1->pool && !rb_node_pool_owns(t1->pool, x) &&
+                   !rb_node_pool_owns(t2->pool, x)) {
+                /**< x is allocated by `rb_node_alloc` */
                 struct rb_node *prev_x = x;
-                struct rb_tree *tree = (x->key == x1_max_key ? t1 : t2);
-                __rb_tree_delete(tree, prev_x);
-                x = rb_node_alloc(prev_x->key);
+                x = rb_node_pool_alloc(t1->pool, prev_x->key);
+                if (!x) {
+                        return NULL;
+                }
                 x->data = prev_x->data;
                 prev_x->data = NULL;
                 rb_node_dealloc(prev_x);
         }
 
-        new_tree = rb_tree_alloc();
-        if (!new_tree) {
-                pr_info("new tree allocation failed...\n");
-                return NULL;
+        if (t1->pool && t1->pool != t2->pool) {
+                rb_node_pool_merge(t1->pool, t2->pool);
+                t2->pool = t1->pool;
+                t1->pool->ref++;
         }
 
-        if (t1->bh >= t2->bh) {
-                y = t1->root;
-                bh = t1->bh;
-                while (bh != t2->bh) {
-                        if (y->right != t1->nil) {
-                                y = y->right;
-                        } else if (y->left != t1->nil) {
-                                y = y->left;
-                        } else {
-                                break;
-                        }
-
-                        if (y->color == RB_NODE_COLOR_BLACK) {
-                                bh -= 1;
-                        }
-                }
-
-                rb_tree_transplant(t1, y, x);
-                x->left = y;
-                x->right = t2->root;
-                y->parent = x;
-                t2->root->parent = x;
+        if ((t1->flags | t2->flags) & RB_TREE_FLAG_ORDER_STAT) {
+                rb_tree_enable_order_stat(t1);
+                rb_tree_enable_order_stat(t2);
+        }
 
-                rb_tree_insert_fixup(t1, x);
+        rb_tree_join(t1, x, t2);
 
-                rb_tree_copy(new_tree, t1);
-        } else { /**> symmetric of previous sequence */
-                y = t2->root;
-                bh = t2->bh;
-                while (bh != t1->bh) {
-                        if (y->left != t2->nil) {
-                                y = y->left;
-                        } else if (y->right != t2->nil) {
-                                y = y->right;
-                        } else {
-                                break;
-                        }
+        t1->finger = NULL;
+        t1->max = rb_tree_maximum(t1, t1->root);
+        if (t1->pool) {
+                t1->pool->ref--; /**< t2 becomes the part of t1 */
+        }
 
-                        if (y->color == RB_NODE_COLOR_BLACK) {
-                                bh -= 1;
-                        }
-                }
+        free(t2);
 
-                rb_tree_transplant(t2, y, x);
-                x->left = t1->root;
-                x->right = y;
-                y->parent = x;
-                t1->root->parent = x;
+        return t1;
+}
 
-                rb_tree_insert_fixup(t2, x);
+/**
+ * @brief Make the subtree as the independent red-black tree
+ * 
+ * @param sub tree structure which has the result
+ * @param tree tree which has the subtree
+ * @param node root of the subtree
+ * @param bh black height of node (same as `tree->bh` definition)
+ */
+static void rb_tree_subtree(struct rb_tree *sub, struct rb_tree *tree,
+                            struct rb_node *node, size_t bh)
+{
+        rb_tree_copy(sub, tree);
+        sub->root = node;
+        sub->bh = bh;
+        if (node != tree->nil) {
+                node->parent = tree->nil;
+                node->color = RB_NODE_COLOR_BLACK;
+        }
+}
 
-                rb_tree_copy(new_tree, t2);
+/**
+ * @brief Split the subtree into t1 (key <= x) and t2 (x < key)
+ * @details Subtrees which hang off the search path are joined bottom-up.
+ * Because the black heights of the joined trees are non-decreasing, the
+ * whole split takes O(log n).
+ * 
+ * @param tree split target tree
+ * @param node root of the subtree
+ * @param bh black height of node
+ * @param x split point
+ * @param t1 tree which has the keys less than or equal to x
+ * @param t2 tree which has the keys greater than x
+ */
+static void __rb_tree_split(struct rb_tree *tree, struct rb_node *node,
+                            size_t bh, const key_t x, struct rb_tree *t1,
+                            struct rb_tree *t2)
+{
+        struct rb_tree sub;
+        struct rb_node *left = NULL;
+        struct rb_node *right = NULL;
+        size_t left_bh, right_bh;
+
+        if (node == tree->nil) {
+                t1->root = t2->root = tree->nil;
+                t1->bh = t2->bh = 0;
+                return;
         }
 
-        free(t1);
-        free(t2);
+        left = node->left;
+        right = node->right;
+        left_bh = bh - (left->color == RB_NODE_COLOR_BLACK);
+        right_bh = bh - (right->color == RB_NODE_COLOR_BLACK);
 
-        return new_tree;
+        if (x < node->key) {
+                __rb_tree_split(tree, left, left_bh, x, t1, t2);
+                rb_tree_subtree(&sub, tree, right, right_bh);
+                rb_tree_join(t2, node, &sub);
+        } else {
+                __rb_tree_split(tree, right, right_bh, x, t1, t2);
+                rb_tree_subtree(&sub, tree, left, left_bh);
+                rb_tree_join(&sub, node, t1);
+                t1->root = sub.root;
+                t1->bh = sub.bh;
+        }
 }
 
 /**
  * @brief Split tree to t1, t2 based on key value x
+ * @details Nodes are moved to t1 and t2 without allocation.
  * 
- * @param tree split target tree
+ * @param tree split target tree. It is deallocated after the split.
  * @param x split point
- * @param result1 t1 stored location
- * @param result2 t2 stored location
+ * @param result1 t1 stored location (key <= x)
+ * @param result2 t2 stored location (x < key)
  * @return int If return value is 0 then success.
  * However, if return value is not 0 then failed.
  */
@@ -745,10 +2006,14 @@ int rb_tree_split(struct rb_tree *tree, const key_t x, struct rb_tree **result1,
         struct rb_tree *t1 = NULL;
         struct rb_tree *t2 = NULL;
 
-        struct rb_node *k = NULL;
-
         int ret = 0;
 
+        if (tree->sync) {
+                pr_info("concurrent tree cannot be split\n");
+                ret = -EINVAL;
+                goto exception;
+        }
+
         t1 = rb_tree_alloc();
         if (!t1) {
                 ret = -ENOMEM;
@@ -760,29 +2025,24 @@ int rb_tree_split(struct rb_tree *tree, const key_t x, struct rb_tree **result1,
                 goto exception;
         }
 
-        k = tree->root;
-
-        while (k != tree->nil) {
-                struct rb_node *temp = k;
-                if (x < k->key) {
-                        if (k->right != tree->nil) {
-                                __rb_tree_insert(t2, k->right);
-                        }
-                        rb_tree_insert(t2, k->key, k->data);
-                        k = k->left;
-                } else {
-                        if (k->left != tree->nil) {
-                                __rb_tree_insert(t1, k->left);
-                        }
-                        rb_tree_insert(t1, k->key, k->data);
-                        k = k->right;
-                }
-
-                free(temp);
+        rb_tree_copy(t1, tree);
+        rb_tree_copy(t2, tree);
+        if (tree->pool) {
+                tree->pool->ref += 2;
         }
 
+        __rb_tree_split(tree, tree->root, tree->bh, x, t1, t2);
+        t1->finger = t2->finger = NULL;
+        t1->max = rb_tree_maximum(t1, t1->root);
+        t1->max = (t1->max == t1->nil ? NULL : t1->max);
+        t2->max = rb_tree_maximum(t2, t2->root);
+        t2->max = (t2->max == t2->nil ? NULL : t2->max);
+
         *result1 = t1;
         *result2 = t2;
+        if (tree->pool) {
+                rb_node_pool_put(tree->pool);
+        }
         free(tree);
         return ret;
 exception:
@@ -802,6 +2062,8 @@ exception:
  * 
  * @param tree red-black tree whole
  * @param node the root of the subtree
+ * @note If the tree is the last user of the pool, whole chunks are released
+ * by `rb_node_pool_put` instead.
  */
 static void __rb_tree_dealloc(struct rb_tree *tree, struct rb_node *node)
 {
@@ -814,7 +2076,7 @@ static void __rb_tree_dealloc(struct rb_tree *tree, struct rb_node *node)
         __rb_tree_dealloc(tree, node->right);
         node->right = NULL;
 
-        rb_node_dealloc(node);
+        rb_tree_node_free(tree, node);
 }
 
 /**
@@ -824,7 +2086,22 @@ static void __rb_tree_dealloc(struct rb_tree *tree, struct rb_node *node)
  */
 void rb_tree_dealloc(struct rb_tree *tree)
 {
-        __rb_tree_dealloc(tree, tree->root);
+        if (tree->sync) {
+                rb_tree_free_retired(tree, tree->sync->waiting);
+                rb_tree_free_retired(tree, tree->sync->retired);
+                free(tree->sync);
+                tree->sync = NULL;
+        }
+
+        if (tree->pool && tree->pool->ref == 1) {
+                rb_node_pool_put(tree->pool);
+        } else {
+                __rb_tree_dealloc(tree, tree->root);
+                if (tree->pool) {
+                        rb_node_pool_put(tree->pool);
+                }
+        }
+        tree->pool = NULL;
         tree->root = NULL;
 
         tree->nil = NULL;
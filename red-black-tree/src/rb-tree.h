@@ -28,8 +28,28 @@ typedef uint64_t key_t;
 #endif
 
 #define RB_INVALID_BLACK_HEIGHT (-1)
+#define RB_INVALID_RANK ((size_t)-1) /**< tree has no RB_TREE_FLAG_ORDER_STAT */
 #define RB_MAX_KEY ((key_t)(LONG_MAX))
 #define RB_NODE_NIL_KEY_VALUE (RB_MAX_KEY)
+#define RB_TREE_FLAG_ORDER_STAT                                                \
+        (0x1) /**< keep the subtree size of each node up to date */
+#define RB_TREE_FLAG_DUP_KEY                                                   \
+        (0x2) /**< insert the same key as a new node instead of update */
+#define RB_TREE_FLAG_CONCURRENT                                                \
+        (0x4) /**< lockless readers with the single writer */
+#define RB_TREE_NR_READER_SLOTS (64) /**< must not exceed 64 (pending mask) */
+#define RB_TREE_CACHE_LINE_SIZE (64)
+#define RB_TREE_ITER_STACK_SIZE                                                \
+        (2 * sizeof(size_t) * 8) /**< red-black tree height <= 2lg(n+1) */
+#define RB_NODE_POOL_MIN_CHUNK (64) /**< minimum number of nodes in a chunk */
+
+/**
+ * @brief Pointer load and store which can be raced with the lockless reader.
+ * Store publishes the initialized node (release) and load pairs with it
+ * (acquire) like rcu_assign_pointer()/rcu_dereference() do.
+ */
+#define rb_dereference(p) __atomic_load_n(&(p), __ATOMIC_ACQUIRE)
+#define rb_assign_pointer(p, v) __atomic_store_n(&(p), (v), __ATOMIC_RELEASE)
 
 #ifndef pr_info
 #define pr_info(msg, ...)                                                      \
@@ -57,6 +77,7 @@ struct rb_node {
 
         key_t key;
         void *data; /**< must be allocated in HEAP location */
+        size_t size; /**< number of nodes in the subtree (order-statistic) */
 
         struct rb_node *left, *right;
         struct rb_node *parent; /**< same as P in CLRS books */
@@ -66,6 +87,53 @@ struct rb_global_info {
         struct rb_node nil;
 };
 
+/**
+ * @brief Number of readers which use the same slot
+ * 
+ */
+struct rb_tree_reader {
+        _Alignas(RB_TREE_CACHE_LINE_SIZE) unsigned long count;
+};
+
+/**
+ * @brief Synchronization state of the concurrent red-black tree
+ * @details Writer makes seq odd while it modifies the tree, and reader
+ * retries when seq is changed during its traverse. Deleted nodes are not
+ * freed immediately. They are freed after every reader slot which was busy
+ * at the retire time has been observed idle (grace period).
+ */
+struct rb_tree_sync {
+        _Alignas(RB_TREE_CACHE_LINE_SIZE) unsigned long seq;
+        struct rb_tree_reader readers[RB_TREE_NR_READER_SLOTS];
+        struct rb_node *retired; /**< retired after the grace period starts */
+        struct rb_node *waiting; /**< wait for the current grace period */
+        uint64_t pending; /**< busy reader slots of the grace period */
+};
+
+/**
+ * @brief Slab of nodes which is allocated at once
+ * 
+ */
+struct rb_node_chunk {
+        struct rb_node_chunk *next;
+        size_t nr_nodes; /**< capacity of the chunk */
+        size_t nr_used; /**< nodes which have been handed out at least once */
+        struct rb_node nodes[];
+};
+
+/**
+ * @brief Node pool of the red-black tree
+ * @details Nodes are carved out of the chunks and deleted nodes are kept on
+ * the free list. The pool is shared by the trees which are split from the
+ * same tree, and chunks are released when the last tree is deallocated.
+ */
+struct rb_node_pool {
+        struct rb_node_chunk *chunks;
+        struct rb_node *free_list; /**< linked by parent pointer */
+        size_t chunk_size; /**< capacity of the next chunk */
+        unsigned long ref; /**< number of trees which use this pool */
+};
+
 /**
  * @brief Red black tree structure
  * 
@@ -74,12 +142,36 @@ struct rb_tree {
         struct rb_node *root;
         struct rb_node *nil; /**< same as Nil in CLRS books */
         size_t bh;
+        unsigned int flags; /**< RB_TREE_FLAG_* augmentation flags */
+        /** recalculate node's augmented data from its children */
+        void (*augment)(struct rb_tree *tree, struct rb_node *node);
+        struct rb_tree_sync *sync; /**< only for RB_TREE_FLAG_CONCURRENT */
+        struct rb_node *finger; /**< last inserted node (can be NULL) */
+        struct rb_node *max; /**< maximum node (NULL if tree is empty) */
+        struct rb_node_pool *pool; /**< node allocator (NULL means malloc) */
+};
+
+/**
+ * @brief Ordered iterator over the key range [lo, hi)
+ * @details Pending ancestors are kept on an explicit stack, so each node is
+ * pushed and popped exactly once and no parent climbing is required.
+ *
+ * @warning Iterator is invalidated by any insert or delete on the tree.
+ */
+struct rb_tree_iter {
+        struct rb_tree *tree;
+        key_t hi; /**< exclusive upper bound of the range */
+        size_t top;
+        struct rb_node *stack[RB_TREE_ITER_STACK_SIZE];
 };
 
 struct rb_tree *rb_tree_alloc(void);
+struct rb_tree *rb_tree_alloc_with_pool(size_t capacity_hint);
 struct rb_node *rb_tree_search(struct rb_tree *tree, key_t key);
 size_t rb_tree_get_bh(struct rb_tree *tree, key_t key);
 int rb_tree_insert(struct rb_tree *tree, const key_t key, void *data);
+int rb_tree_insert_hint(struct rb_tree *tree, struct rb_node *hint,
+                        const key_t key, void *data);
 struct rb_node *rb_tree_minimum(struct rb_tree *tree, struct rb_node *root);
 struct rb_node *rb_tree_maximum(struct rb_tree *tree, struct rb_node *root);
 struct rb_node *rb_tree_successor(struct rb_tree *tree, struct rb_node *x);
@@ -89,6 +181,27 @@ struct rb_tree *rb_tree_concat(struct rb_tree *t1, struct rb_tree *t2,
 int rb_tree_split(struct rb_tree *tree, const key_t x, struct rb_tree **result1,
                   struct rb_tree **result2);
 int rb_tree_delete(struct rb_tree *tree, key_t key);
+int rb_tree_insert_node(struct rb_tree *tree, struct rb_node *node);
+void rb_tree_delete_node(struct rb_tree *tree, struct rb_node *node);
+struct rb_node *rb_tree_lower_bound(struct rb_tree *tree, key_t key);
+struct rb_node *rb_tree_upper_bound(struct rb_tree *tree, key_t key);
+void rb_tree_enable_order_stat(struct rb_tree *tree);
+struct rb_node *rb_tree_select(struct rb_tree *tree, size_t i);
+size_t rb_tree_rank(struct rb_tree *tree, key_t key);
+size_t rb_tree_range_count(struct rb_tree *tree, key_t lo, key_t hi);
+int rb_tree_enable_concurrent(struct rb_tree *tree);
+int rb_tree_search_lockless(struct rb_tree *tree, key_t key, void **data);
+int rb_tree_next_lockless(struct rb_tree *tree, key_t key, key_t *next,
+                          void **data);
+int rb_tree_prev_lockless(struct rb_tree *tree, key_t key, key_t *prev,
+                          void **data);
+void rb_tree_synchronize(struct rb_tree *tree);
+void rb_tree_iter_init(struct rb_tree_iter *iter, struct rb_tree *tree,
+                       key_t lo, key_t hi);
+struct rb_node *rb_tree_iter_next(struct rb_tree_iter *iter);
+int rb_tree_range_foreach(struct rb_tree *tree, key_t lo, key_t hi,
+                          int (*fn)(struct rb_node *node, void *arg),
+                          void *arg);
 void rb_tree_dealloc(struct rb_tree *tree);
 
 #ifdef RB_TREE_DEBUG
@@ -142,6 +255,7 @@ static inline struct rb_node *rb_node_alloc(const key_t key)
         new_node->color = RB_NODE_COLOR_UNDEFINED;
         new_node->parent = new_node->left = new_node->right = NULL;
         new_node->data = NULL;
+        new_node->size = 1;
 
         new_node->key = key;
 
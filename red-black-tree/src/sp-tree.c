@@ -0,0 +1,235 @@
+/**
+ * @file sp-tree.c
+ * @author BlaCkinkGJ (ss5kijun@gmail.com)
+ * @brief splay tree implementation part
+ * @details Splaying is done top-down. While the search descends, the nodes
+ * which are smaller than the key are linked to the left tree and the
+ * others are linked to the right tree, and both are assembled below the
+ * last node. So, no recursion and no parent pointer are needed.
+ * @version 0.1
+ * @date 2020-06-16
+ *
+ * @copyright Copyright (c) 2020 BlaCkinkGJ
+ *
+ */
+#include "sp-tree.h"
+
+/**
+ * @brief Splay the node which is the closest to the key to the root
+ *
+ * @param t root of the subtree
+ * @param key key which want to find
+ * @return struct sp_node* new root of the subtree. Its key is the key or
+ * the predecessor or successor of the key
+ */
+static struct sp_node *sp_tree_splay(struct sp_node *t, key_t key)
+{
+        struct sp_node header;
+        struct sp_node *l = NULL, *r = NULL, *y = NULL;
+
+        if (!t) {
+                return NULL;
+        }
+
+        header.left = header.right = NULL;
+        l = r = &header;
+        for (;;) {
+                if (key < t->key) {
+                        if (!t->left) {
+                                break;
+                        }
+                        if (key < t->left->key) { /**< zig-zig */
+                                y = t->left;
+                                t->left = y->right;
+                                y->right = t;
+                                t = y;
+                                if (!t->left) {
+                                        break;
+                                }
+                        }
+                        r->left = t; /**< link right */
+                        r = t;
+                        t = t->left;
+                } else if (key > t->key) {
+                        if (!t->right) {
+                                break;
+                        }
+                        if (key > t->right->key) { /**< zag-zag */
+                                y = t->right;
+                                t->right = y->left;
+                                y->left = t;
+                                t = y;
+                                if (!t->right) {
+                                        break;
+                                }
+                        }
+                        l->right = t; /**< link left */
+                        l = t;
+                        t = t->right;
+                } else {
+                        break;
+                }
+        }
+
+        l->right = t->left; /**< assemble */
+        r->left = t->right;
+        t->left = header.right;
+        t->right = header.left;
+
+        return t;
+}
+
+/**
+ * @brief Allocation of the splay tree
+ *
+ * @return struct sp_tree* empty splay tree
+ */
+struct sp_tree *sp_tree_alloc(void)
+{
+        struct sp_tree *tree = (struct sp_tree *)malloc(sizeof(struct sp_tree));
+        if (!tree) {
+                pr_info("Memory allocation failed\n");
+                return NULL;
+        }
+
+        tree->root = NULL;
+        tree->nr_nodes = 0;
+
+        return tree;
+}
+
+/**
+ * @brief Search the key and move it to the root
+ *
+ * @param tree splay tree structure
+ * @param key key which want to find
+ * @return struct sp_node* node which has the key. NULL if not exist
+ */
+struct sp_node *sp_tree_search(struct sp_tree *tree, key_t key)
+{
+        tree->root = sp_tree_splay(tree->root, key);
+        if (tree->root && tree->root->key == key) {
+                return tree->root;
+        }
+        return NULL;
+}
+
+/**
+ * @brief Insert the key to the splay tree
+ * @details If the key already exists, its data is replaced and the old
+ * data is freed (same as `rb_tree_insert`).
+ *
+ * @param tree splay tree structure
+ * @param key new node's key
+ * @param data new node's data
+ * @return int successfully insert status (0: success, else: fail)
+ */
+int sp_tree_insert(struct sp_tree *tree, const key_t key, void *data)
+{
+        struct sp_node *node = NULL;
+        struct sp_node *t = NULL;
+
+        if (key >= RB_MAX_KEY) {
+                pr_info("Invalid key value\n");
+                return -EINVAL;
+        }
+
+        t = tree->root = sp_tree_splay(tree->root, key);
+        if (t && t->key == key) {
+                if (t->data && t->data != data) {
+                        free(t->data);
+                }
+                t->data = data;
+                return 0;
+        }
+
+        node = (struct sp_node *)malloc(sizeof(struct sp_node));
+        if (!node) {
+                pr_info("Memory allocation failed\n");
+                return -ENOMEM;
+        }
+        node->key = key;
+        node->data = data;
+        node->left = node->right = NULL;
+
+        if (t && key < t->key) {
+                node->left = t->left;
+                node->right = t;
+                t->left = NULL;
+        } else if (t) {
+                node->right = t->right;
+                node->left = t;
+                t->right = NULL;
+        }
+
+        tree->root = node;
+        tree->nr_nodes++;
+
+        return 0;
+}
+
+/**
+ * @brief Delete the key from the splay tree
+ *
+ * @param tree splay tree structure
+ * @param key key which want to delete
+ * @return int 0 means success. -ENODATA means the key doesn't exist
+ */
+int sp_tree_delete(struct sp_tree *tree, key_t key)
+{
+        struct sp_node *t = NULL;
+
+        t = tree->root = sp_tree_splay(tree->root, key);
+        if (!t || t->key != key) {
+                return -ENODATA;
+        }
+
+        if (!t->left) {
+                tree->root = t->right;
+        } else {
+                /* maximum of the left subtree has no right child */
+                tree->root = sp_tree_splay(t->left, key);
+                tree->root->right = t->right;
+        }
+
+        if (t->data) {
+                free(t->data);
+        }
+        free(t);
+        tree->nr_nodes--;
+
+        return 0;
+}
+
+/**
+ * @brief Deallocate the splay tree
+ * @details Splay tree can be a long chain. So, the left child is rotated
+ * up until the root has no left child and the root is released. Each
+ * rotation moves one node to the right spine, so it takes O(n) without
+ * recursion.
+ *
+ * @param tree splay tree structure
+ */
+void sp_tree_dealloc(struct sp_tree *tree)
+{
+        struct sp_node *t = tree->root;
+        struct sp_node *y = NULL;
+
+        while (t) {
+                if (t->left) {
+                        y = t->left;
+                        t->left = y->right;
+                        y->right = t;
+                        t = y;
+                        continue;
+                }
+                y = t->right;
+                if (t->data) {
+                        free(t->data);
+                }
+                free(t);
+                t = y;
+        }
+
+        free(tree);
+}
@@ -0,0 +1,45 @@
+/**
+ * @file sp-tree.h
+ * @author BlaCkinkGJ (ss5kijun@gmail.com)
+ * @brief splay tree's declaration part
+ * @version 0.1
+ * @date 2020-06-16
+ *
+ * @copyright Copyright (c) 2020 BlaCkinkGJ
+ *
+ * @ref Sleator, D. D., & Tarjan, R. E. (1985). Self-adjusting binary search trees.
+ *
+ */
+#ifndef SP_TREE_H_
+#define SP_TREE_H_
+
+#include "rb-tree.h"
+
+/**
+ * @brief Splay tree's node
+ *
+ */
+struct sp_node {
+        key_t key;
+        void *data; /**< tree frees it when the node is released */
+
+        struct sp_node *left, *right;
+};
+
+/**
+ * @brief Splay tree structure
+ * @details Recently accessed key is located at the root. So, the key which
+ * is accessed again soon is found in a few steps (working-set property).
+ */
+struct sp_tree {
+        struct sp_node *root;
+        size_t nr_nodes;
+};
+
+struct sp_tree *sp_tree_alloc(void);
+struct sp_node *sp_tree_search(struct sp_tree *tree, key_t key);
+int sp_tree_insert(struct sp_tree *tree, const key_t key, void *data);
+int sp_tree_delete(struct sp_tree *tree, key_t key);
+void sp_tree_dealloc(struct sp_tree *tree);
+
+#endif
@@ -11,21 +11,16 @@
 #include "tg-tree.h"
 
 /**
- * @brief calculate depth of the complete binary tree
+ * @brief calculate depth of the node
  * 
- * @param tree complete binary tree
+ * @param tree reference tree
  * @param node start location
- * @return size_t depth of node
- * 
- * @warning only works when reference tree is complete binary tree
+ * @return size_t depth of node (root's depth is 1)
  */
 size_t tg_bst_get_depth(struct tg_bst_tree *tree, struct tg_bst_node *node)
 {
-        size_t depth = 1;
-        while (node->left) {
-                depth++;
-        }
-        return depth;
+        (void)tree;
+        return node->depth;
 }
 
 struct tg_bst_tree *tg_bst_tree_alloc(void)
@@ -38,30 +33,123 @@ struct tg_bst_tree *tg_bst_tree_alloc(void)
                 return NULL;
         }
         tree->root = NULL;
+        tree->nr_nodes = 0;
+        tree->nodes = NULL;
+        tree->nr_built = 0;
+        return tree;
+}
+
+/**
+ * @brief Fill the keys to the implicit complete tree in in-order
+ * 
+ * @param nodes implicit array (children of i are 2i+1 and 2i+2)
+ * @param keys sorted keys
+ * @param size number of nodes
+ * @param i current node's index
+ * @param k index of the next key
+ * @return size_t index of the next key after the subtree
+ */
+static size_t __tg_bst_tree_build(struct tg_bst_node *nodes, key_t *keys,
+                                  size_t size, size_t i, size_t k)
+{
+        if (i >= size) {
+                return k;
+        }
+
+        k = __tg_bst_tree_build(nodes, keys, size, 2 * i + 1, k);
+        nodes[i].key = keys[k++];
+        return __tg_bst_tree_build(nodes, keys, size, 2 * i + 2, k);
+}
+
+/**
+ * @brief Build the complete binary search tree in O(n)
+ * @details Nodes are located in the implicit array (BFS order), so the top
+ * levels which every search passes are packed in a few cache lines. Depth
+ * of each node is calculated from its index. Initial preferred child of
+ * each node is its left child.
+ * 
+ * @param keys sorted keys which have no duplicates
+ * @param size number of keys
+ * @return struct tg_bst_tree* complete binary search tree
+ */
+struct tg_bst_tree *tg_bst_tree_build(key_t *keys, size_t size)
+{
+        struct tg_bst_tree *tree = NULL;
+        struct tg_bst_node *nodes = NULL;
+        struct tg_bst_node *node = NULL;
+        size_t i;
+
+        for (i = 1; i < size; i++) {
+                if (keys[i - 1] >= keys[i]) {
+                        pr_info("keys must be sorted and unique\n");
+                        return NULL;
+                }
+        }
+
+        tree = tg_bst_tree_alloc();
+        if (!tree || size == 0) {
+                return tree;
+        }
+
+        nodes = (struct tg_bst_node *)malloc(sizeof(struct tg_bst_node) *
+                                             size);
+        if (!nodes) {
+                pr_info("tg_bst node allocation failed...\n");
+                free(tree);
+                return NULL;
+        }
+
+        __tg_bst_tree_build(nodes, keys, size, 0, 0);
+        for (i = 0; i < size; i++) {
+                node = &nodes[i];
+                node->data = NULL;
+                node->path = NULL;
+                node->parent = (i > 0 ? &nodes[(i - 1) / 2] : NULL);
+                node->depth = (i > 0 ? node->parent->depth + 1 : 1);
+                node->left = (2 * i + 1 < size ? &nodes[2 * i + 1] : NULL);
+                node->right = (2 * i + 2 < size ? &nodes[2 * i + 2] : NULL);
+                if (node->left) {
+                        node->prefer = TG_BST_LEFT;
+                } else {
+                        node->prefer = TG_BST_UNKNOWN;
+                }
+        }
+
+        tree->root = &nodes[0];
+        tree->nr_nodes = size;
+        tree->nodes = nodes;
+        tree->nr_built = size;
+
         return tree;
 }
 
-static void __tg_bst_tree_dealloc(struct tg_bst_node *root)
+static void __tg_bst_tree_dealloc(struct tg_bst_tree *tree,
+                                  struct tg_bst_node *root)
 {
         if (!root) {
                 return;
         }
 
-        __tg_bst_tree_dealloc(root->left);
+        __tg_bst_tree_dealloc(tree, root->left);
         root->left = NULL;
-        __tg_bst_tree_dealloc(root->right);
+        __tg_bst_tree_dealloc(tree, root->right);
         root->right = NULL;
 
         if (root->data) {
                 free(root->data);
         }
-        free(root);
+        if (root < tree->nodes || root >= tree->nodes + tree->nr_built) {
+                free(root); /**< inserted after the build */
+        }
 }
 
 void tg_bst_tree_dealloc(struct tg_bst_tree *tree)
 {
         if (tree->root) {
-                __tg_bst_tree_dealloc(tree->root);
+                __tg_bst_tree_dealloc(tree, tree->root);
+        }
+        if (tree->nodes) {
+                free(tree->nodes);
         }
         free(tree);
 }
@@ -83,6 +171,8 @@ static int __tg_bst_tree_insert(struct tg_bst_tree *tree, struct tg_bst_node *z)
         }
 
         z->parent = y;
+        z->depth = (y ? y->depth + 1 : 1);
+        tree->nr_nodes++;
         if (y == NULL) {
                 tree->root = z;
         } else if (z->key < y->key) {
@@ -108,6 +198,7 @@ int tg_bst_tree_insert(struct tg_bst_tree *tree, key_t key, void *data)
         node->data = data;
         node->left = node->right = NULL;
         node->parent = NULL;
+        node->path = NULL;
         node->prefer = TG_BST_UNKNOWN;
 
         ret = __tg_bst_tree_insert(tree, node);
@@ -2,6 +2,14 @@
  * @file tg-tree.c
  * @author BlaCkinkGJ (ss5kijun@gmail.com)
  * @brief tango-tree implementation part
+ * @details Reference tree is partitioned into preferred paths and each path
+ * is stored in the auxiliary red-black tree keyed by key. Each auxiliary
+ * node remembers its depth in the reference tree. When the search leaves
+ * the path, the path is cut below the leaving point and the path which
+ * has the next node is joined. Both are done with `rb_tree_split` and
+ * `rb_tree_concat`. Each auxiliary node also keeps the minimum and maximum
+ * depth of its subtree, so the part of the path below some depth is found
+ * in O(log n).
  * @version 0.1
  * @date 2020-06-08
  * 
@@ -11,29 +19,392 @@
 
 #include "tg-tree.h"
 
+/**
+ * @brief Recalculate the minimum and maximum depth of the subtree
+ * 
+ * @param tree auxiliary tree
+ * @param node recalculate target node
+ */
+static void tg_aux_augment(struct rb_tree *tree, struct rb_node *node)
+{
+        struct tg_aux_node *x = tg_aux_entry(node);
+        struct tg_aux_node *child = NULL;
+
+        x->min_depth = x->max_depth = x->depth;
+        if (node->left != tree->nil) {
+                child = tg_aux_entry(node->left);
+                if (child->min_depth < x->min_depth) {
+                        x->min_depth = child->min_depth;
+                }
+                if (child->max_depth > x->max_depth) {
+                        x->max_depth = child->max_depth;
+                }
+        }
+        if (node->right != tree->nil) {
+                child = tg_aux_entry(node->right);
+                if (child->min_depth < x->min_depth) {
+                        x->min_depth = child->min_depth;
+                }
+                if (child->max_depth > x->max_depth) {
+                        x->max_depth = child->max_depth;
+                }
+        }
+}
+
+/**
+ * @brief Get the maximum depth of the subtree
+ * 
+ * @param tree auxiliary tree
+ * @param node root of the subtree
+ * @return size_t maximum depth. 0 if the subtree is empty
+ */
+static inline size_t tg_aux_max_depth(struct rb_tree *tree,
+                                      struct rb_node *node)
+{
+        return node == tree->nil ? 0 : tg_aux_entry(node)->max_depth;
+}
+
+/**
+ * @brief Get the shallowest node of the auxiliary tree
+ * @details Descend to the child whose minimum depth is the tree's minimum
+ * depth. So, it takes O(log k) for the path of k nodes instead of walking
+ * the reference tree.
+ * 
+ * @param aux auxiliary tree which is not empty
+ * @return struct tg_aux_node* node which has the minimum depth
+ */
+static struct tg_aux_node *tg_aux_shallowest(struct rb_tree *aux)
+{
+        struct rb_node *x = aux->root;
+        size_t depth = tg_aux_entry(x)->min_depth;
+
+        while (tg_aux_entry(x)->depth != depth) {
+                if (x->left != aux->nil &&
+                    tg_aux_entry(x->left)->min_depth == depth) {
+                        x = x->left;
+                } else {
+                        x = x->right;
+                }
+        }
+
+        return tg_aux_entry(x);
+}
+
+/**
+ * @brief Allocate the empty auxiliary tree
+ * 
+ * @return struct rb_tree* auxiliary tree
+ */
+static struct rb_tree *tg_aux_tree_alloc(void)
+{
+        struct rb_tree *tree = rb_tree_alloc();
+        if (!tree) {
+                return NULL;
+        }
+
+        tree->augment = tg_aux_augment;
+
+        return tree;
+}
+
+static struct rb_node *__tg_aux_successor_deeper(struct rb_tree *aux,
+                                                 struct rb_node *x, key_t key,
+                                                 size_t depth)
+{
+        struct rb_node *found = NULL;
+
+        if (tg_aux_max_depth(aux, x) <= depth) {
+                return NULL;
+        }
+
+        if (key <= x->key) {
+                found = __tg_aux_successor_deeper(aux, x->left, key, depth);
+                if (found) {
+                        return found;
+                }
+                if (tg_aux_entry(x)->depth > depth) {
+                        return x;
+                }
+        }
+
+        return __tg_aux_successor_deeper(aux, x->right, key, depth);
+}
+
+/**
+ * @brief Get the first node whose key >= key and depth > depth
+ * @details Subtree whose maximum depth is not deeper than depth is skipped.
+ * 
+ * @param aux auxiliary tree
+ * @param key lower bound key
+ * @param depth depth bound
+ * @return struct tg_aux_node* found node. NULL if there is no such node
+ */
+struct tg_aux_node *tg_aux_successor_deeper(struct rb_tree *aux, key_t key,
+                                            size_t depth)
+{
+        struct rb_node *x = __tg_aux_successor_deeper(aux, aux->root, key,
+                                                      depth);
+        return (x ? tg_aux_entry(x) : NULL);
+}
+
+static struct rb_node *__tg_aux_predecessor_deeper(struct rb_tree *aux,
+                                                   struct rb_node *x,
+                                                   key_t key, size_t depth)
+{
+        struct rb_node *found = NULL;
+
+        if (tg_aux_max_depth(aux, x) <= depth) {
+                return NULL;
+        }
+
+        if (x->key <= key) {
+                found = __tg_aux_predecessor_deeper(aux, x->right, key, depth);
+                if (found) {
+                        return found;
+                }
+                if (tg_aux_entry(x)->depth > depth) {
+                        return x;
+                }
+        }
+
+        return __tg_aux_predecessor_deeper(aux, x->left, key, depth);
+}
+
+/**
+ * @brief Get the last node whose key <= key and depth > depth
+ * 
+ * @param aux auxiliary tree
+ * @param key upper bound key
+ * @param depth depth bound
+ * @return struct tg_aux_node* found node. NULL if there is no such node
+ */
+struct tg_aux_node *tg_aux_predecessor_deeper(struct rb_tree *aux, key_t key,
+                                              size_t depth)
+{
+        struct rb_node *x = __tg_aux_predecessor_deeper(aux, aux->root, key,
+                                                        depth);
+        return (x ? tg_aux_entry(x) : NULL);
+}
+
+/**
+ * @brief Generate the auxiliary node of the reference tree's node
+ * 
+ * @param ref reference tree's node
+ * @return struct tg_aux_node* allocated node
+ */
+static struct tg_aux_node *tg_aux_node_alloc(struct tg_bst_node *ref)
+{
+        struct tg_aux_node *x = NULL;
+
+        x = (struct tg_aux_node *)malloc(sizeof(struct tg_aux_node));
+        if (!x) {
+                pr_info("Memory allocation failed\n");
+                return NULL;
+        }
+
+        x->node.color = RB_NODE_COLOR_UNDEFINED;
+        x->node.parent = x->node.left = x->node.right = NULL;
+        x->node.key = ref->key;
+        x->node.data = NULL;
+        x->node.size = 1;
+        x->depth = x->min_depth = x->max_depth = ref->depth;
+        x->ref = ref;
+
+        return x;
+}
+
+/**
+ * @brief Split the auxiliary tree after the node
+ * 
+ * @param aux split target tree
+ * @param node last node of t1. If it is nil, t1 becomes the empty tree
+ * @param t1 tree which has the keys less than or equal to node->key
+ * @param t2 tree which has the keys greater than node->key
+ * @return int 0 means success
+ */
+static int tg_aux_split(struct rb_tree *aux, struct rb_node *node,
+                        struct rb_tree **t1, struct rb_tree **t2)
+{
+        if (node == aux->nil) {
+                *t1 = tg_aux_tree_alloc();
+                *t2 = aux;
+                return (*t1 ? 0 : -ENOMEM);
+        }
+        return rb_tree_split(aux, node->key, t1, t2);
+}
+
+/**
+ * @brief Concatenate two auxiliary trees (keys of t1 < keys of t2)
+ * 
+ * @param t1 tree which has smaller keys
+ * @param t2 tree which has greater keys
+ * @return struct rb_tree* concatenated tree. t1 and t2 are consumed
+ */
+static struct rb_tree *tg_aux_concat(struct rb_tree *t1, struct rb_tree *t2)
+{
+        if (t2->root == t2->nil) {
+                rb_tree_dealloc(t2);
+                return t1;
+        }
+        if (t1->root == t1->nil) {
+                rb_tree_dealloc(t1);
+                return t2;
+        }
+        return rb_tree_concat(t1, t2, rb_tree_maximum(t1, t1->root));
+}
+
+/**
+ * @brief Get the preferred child of the reference tree's node
+ * 
+ * @param node reference tree's node
+ * @return struct tg_bst_node* preferred child (NULL if it doesn't exist)
+ */
+static struct tg_bst_node *tg_bst_preferred_child(struct tg_bst_node *node)
+{
+        if (node->prefer == TG_BST_LEFT) {
+                return node->left;
+        } else if (node->prefer == TG_BST_RIGHT) {
+                return node->right;
+        }
+        return NULL;
+}
+
+/**
+ * @brief Make the preferred path which starts from top
+ * 
+ * @param top the shallowest node of the path
+ * @return struct tg_node* generated path
+ */
+static struct tg_node *tg_tree_build_path(struct tg_bst_node *top)
+{
+        struct tg_node *path = NULL;
+        struct tg_aux_node *x = NULL;
+        struct tg_bst_node *node = NULL;
+
+        path = tg_node_alloc(NULL);
+        if (!path) {
+                return NULL;
+        }
+        path->aux = tg_aux_tree_alloc();
+        if (!path->aux) {
+                goto exception;
+        }
+
+        path->top = top;
+        top->path = path;
+        for (node = top; node; node = tg_bst_preferred_child(node)) {
+                x = tg_aux_node_alloc(node);
+                if (!x) {
+                        goto exception;
+                }
+                rb_tree_insert_node(path->aux, &x->node);
+                path->nr_nodes++;
+        }
+
+        return path;
+exception:
+        top->path = NULL;
+        tg_node_dealloc(path);
+        return NULL;
+}
+
+static int tg_key_compare(const void *a, const void *b)
+{
+        key_t x = *(const key_t *)a;
+        key_t y = *(const key_t *)b;
+        return (x > y) - (x < y);
+}
+
+/**
+ * @brief Make the sorted keys which have no duplicates
+ * 
+ * @param keys keys in any order
+ * @param size number of keys
+ * @param nr_keys number of unique keys is stored in this location
+ * @return key_t* sorted keys (caller must free)
+ */
+static key_t *tg_tree_sorted_keys(key_t *keys, size_t size, size_t *nr_keys)
+{
+        key_t *sorted = NULL;
+        int is_sorted = 1;
+        size_t i, nr = 0;
+
+        sorted = (key_t *)malloc(sizeof(key_t) * (size ? size : 1));
+        if (!sorted) {
+                pr_info("Memory allocation failed\n");
+                return NULL;
+        }
+        memcpy(sorted, keys, sizeof(key_t) * size);
+
+        for (i = 1; i < size && is_sorted; i++) {
+                is_sorted = (sorted[i - 1] <= sorted[i]);
+        }
+        if (!is_sorted) {
+                qsort(sorted, size, sizeof(key_t), tg_key_compare);
+        }
+
+        for (i = 0; i < size; i++) {
+                if (nr == 0 || sorted[nr - 1] != sorted[i]) {
+                        sorted[nr++] = sorted[i];
+                }
+        }
+        *nr_keys = nr;
+
+        return sorted;
+}
+
+/**
+ * @brief Allocation of the tango tree
+ * @details Reference tree is built as the complete binary search tree in
+ * O(n) (sorting is skipped when keys are already sorted).
+ * 
+ * @param keys keys of the tree (any order, duplicates are ignored)
+ * @param size number of keys
+ * @return struct tg_tree* allocated tango tree
+ */
 struct tg_tree *tg_tree_alloc(key_t *keys, size_t size)
 {
         struct tg_tree *tree = (struct tg_tree *)malloc(sizeof(struct tg_tree));
-        size_t i = 0;
+        struct tg_bst_node *node = NULL;
+        key_t *sorted = NULL;
+        size_t nr_keys = 0;
+        size_t i;
 
         if (!tree) {
                 pr_info("Tango tree allocation failed...\n");
                 goto exception;
         }
+        tree->ref = NULL;
+        tree->root = NULL;
+        tree->nr_switches = 0;
+
+        sorted = tg_tree_sorted_keys(keys, size, &nr_keys);
+        if (!sorted) {
+                goto exception;
+        }
 
-        tree->ref = tg_bst_tree_alloc();
+        tree->ref = tg_bst_tree_build(sorted, nr_keys);
+        free(sorted);
         if (!tree->ref) {
                 pr_info("Reference tree allocation failed\n");
                 goto exception;
         }
 
-        for (i = 0; i < size; i++) {
-                if (tg_bst_tree_insert(tree->ref, keys[i], NULL)) {
-                        pr_info("Insert error occurred!!\n");
-                        goto exception;
+        if (!tree->ref->root) {
+                return tree;
+        }
+
+        /**< each node which is not a preferred child starts a path */
+        for (i = 0; i < tree->ref->nr_built; i++) {
+                node = &tree->ref->nodes[i];
+                if (!node->parent ||
+                    tg_bst_preferred_child(node->parent) != node) {
+                        if (!tg_tree_build_path(node)) {
+                                goto exception;
+                        }
                 }
         }
-        tree->root = NULL;
+        tree->root = tree->ref->root->path;
 
         return tree;
 
@@ -44,22 +415,197 @@ exception:
         return NULL;
 }
 
-static void __tg_tree_dealloc(struct tg_tree *tree, struct tg_node *node)
+/**
+ * @brief Cut the preferred path below the depth
+ * @details Nodes deeper than depth make the contiguous key range in the
+ * auxiliary tree. The range's both ends are found by the depth bounded
+ * queries and taken out by two splits. And the rest is concatenated again.
+ * The top of the new path is found by the minimum depth of the taken out
+ * tree, not by walking the reference tree. So, cut takes O(log k) for the
+ * path of k nodes, which is O(log log n) in the balanced reference tree.
+ * Only the splits can fail and the path is restored when they do, because
+ * concatenating the split trees never fails.
+ * 
+ * @param path cut target path
+ * @param depth nodes whose depth is greater than this go to the new path
+ * @param lower new path is stored in this location. NULL if there is
+ * nothing to cut
+ * @return int 0 means success. -ENOMEM means that path is not changed
+ */
+int tg_tree_cut(struct tg_node *path, size_t depth, struct tg_node **lower)
+{
+        struct rb_tree *aux = path->aux;
+        struct rb_tree *left = NULL, *rest = NULL, *mid = NULL, *right = NULL;
+        struct tg_aux_node *lo = NULL, *hi = NULL;
+        struct tg_bst_node *top = NULL;
+        struct tg_node *new_path = NULL;
+        size_t nr_nodes = 0;
+        int ret = 0;
+
+        *lower = NULL;
+        lo = tg_aux_successor_deeper(aux, 0, depth);
+        if (!lo) {
+                return 0;
+        }
+        hi = tg_aux_predecessor_deeper(aux, RB_MAX_KEY, depth);
+
+        /**< depths of the path are contiguous */
+        nr_nodes = tg_aux_max_depth(aux, aux->root) - depth;
+
+        new_path = tg_node_alloc(NULL);
+        if (!new_path) {
+                return -ENOMEM;
+        }
+
+        ret = tg_aux_split(aux, rb_tree_predecessor(aux, &lo->node), &left,
+                           &rest);
+        if (ret) {
+                goto exception;
+        }
+        ret = tg_aux_split(rest, &hi->node, &mid, &right);
+        if (ret) {
+                path->aux = tg_aux_concat(left, rest);
+                goto exception;
+        }
+
+        path->aux = tg_aux_concat(left, right);
+        path->nr_nodes -= nr_nodes;
+
+        top = tg_aux_shallowest(mid)->ref; /**< its depth is depth + 1 */
+        new_path->aux = mid;
+        new_path->nr_nodes = nr_nodes;
+        new_path->top = top;
+        top->path = new_path;
+
+        *lower = new_path;
+        return 0;
+
+exception:
+        pr_info("preferred path split failed\n");
+        free(new_path);
+        return ret;
+}
+
+/**
+ * @brief Join the path which hangs below aux1 into aux1
+ * @details Every key of aux2 is located between two adjacent keys of aux1.
+ * So, aux1 is split at aux2's key and the three trees are concatenated.
+ * 
+ * @param tree tango tree
+ * @param aux1 upper path
+ * @param aux2 path whose top's parent is in aux1. It is deallocated
+ * @return struct tg_node* joined path (aux1). NULL if join failed
+ */
+struct tg_node *tg_tree_join(struct tg_tree *tree, struct tg_node *aux1,
+                             struct tg_node *aux2)
+{
+        struct rb_tree *left = NULL, *right = NULL;
+
+        if (rb_tree_split(aux1->aux, aux2->top->key, &left, &right)) {
+                pr_info("preferred path split failed\n");
+                return NULL;
+        }
+
+        aux1->aux = tg_aux_concat(tg_aux_concat(left, aux2->aux), right);
+        aux1->nr_nodes += aux2->nr_nodes;
+
+        aux2->top->path = NULL;
+        aux2->aux = NULL;
+        tg_node_dealloc(aux2);
+
+        tree->nr_switches++;
+
+        return aux1;
+}
+
+/**
+ * @brief Search the key and make the searched path preferred
+ * @details In each auxiliary tree, the search leaves the path at the deeper
+ * one of the predecessor and the successor of the key. The path is cut
+ * below it and the path of the next node is joined.
+ * 
+ * @param tree tango tree
+ * @param key the key which I want to search
+ * @return struct tg_bst_node* reference tree's node which has the key.
+ * NULL if there is no such key or the preferred paths cannot be changed
+ */
+struct tg_bst_node *tg_tree_search(struct tg_tree *tree, key_t key)
+{
+        struct tg_node *path = tree->root;
+        struct rb_tree *aux = NULL;
+        struct rb_node *succ = NULL;
+        struct rb_node *pred = NULL;
+        struct tg_bst_node *v = NULL;
+        struct tg_bst_node *child = NULL;
+        struct tg_node *lower = NULL;
+
+        if (!path) {
+                return NULL;
+        }
+
+        for (;;) {
+                aux = path->aux;
+                succ = rb_tree_lower_bound(aux, key);
+                if (succ && succ->key == key) {
+                        v = tg_aux_entry(succ)->ref;
+                        break;
+                }
+
+                pred = (succ ? rb_tree_predecessor(aux, succ) :
+                               rb_tree_maximum(aux, aux->root));
+                if (!succ || (pred != aux->nil &&
+                              tg_aux_entry(pred)->depth >
+                                      tg_aux_entry(succ)->depth)) {
+                        v = tg_aux_entry(pred)->ref;
+                } else {
+                        v = tg_aux_entry(succ)->ref;
+                }
+
+                child = (key < v->key ? v->left : v->right);
+                if (!child) {
+                        break;
+                }
+
+                if (tg_tree_cut(path, v->depth, &lower)) {
+                        return NULL;
+                }
+                path = tg_tree_join(tree, path, child->path);
+                if (!path) {
+                        return NULL;
+                }
+                v->prefer = (child == v->left ? TG_BST_LEFT : TG_BST_RIGHT);
+        }
+
+        if (tg_tree_cut(path, v->depth, &lower)) {
+                return NULL;
+        }
+        v->prefer = TG_BST_UNKNOWN;
+
+        return (v->key == key ? v : NULL);
+}
+
+static void __tg_tree_dealloc(struct tg_tree *tree, struct tg_bst_node *node)
 {
         if (!node) {
                 return;
         }
 
-        tg_node_dealloc(node);
+        __tg_tree_dealloc(tree, node->left);
+        __tg_tree_dealloc(tree, node->right);
+
+        if (node->path) {
+                tg_node_dealloc(node->path);
+                node->path = NULL;
+        }
 }
 
 void tg_tree_dealloc(struct tg_tree *tree)
 {
         if (tree->ref) {
+                __tg_tree_dealloc(tree, tree->ref->root);
                 tg_bst_tree_dealloc(tree->ref);
         }
         tree->ref = NULL;
-        __tg_tree_dealloc(tree, tree->root);
         tree->root = NULL;
         free(tree);
-}
\ No newline at end of file
+}
@@ -7,6 +7,8 @@
  * 
  * @copyright Copyright (c) 2020 BlaCkinkGJ
  * 
+ * @ref Demaine, E. D., Harmon, D., Iacono, J., & Pătraşcu, M. (2007). Dynamic optimality—almost. SIAM Journal on Computing, 37(1), 240-251.
+ * 
  */
 #ifndef TANGO_TREE_H_
 #define TANGO_TREE_H_
@@ -20,68 +22,99 @@ enum tg_bst_edge_prefer {
         TG_BST_UNKNOWN,
 };
 
+struct tg_node;
+
 struct tg_bst_node {
         key_t key;
         enum tg_bst_edge_prefer prefer;
         void *data;
-        size_t depth;
+        size_t depth; /**< root's depth is 1 */
         struct tg_bst_node *left;
         struct tg_bst_node *right;
         struct tg_bst_node *parent;
+        struct tg_node *path; /**< preferred path whose top is this node */
 };
 
 struct tg_bst_tree {
         struct tg_bst_node *root;
+        size_t nr_nodes;
+        struct tg_bst_node *nodes; /**< implicit array of the built tree */
+        size_t nr_built; /**< number of nodes in the implicit array */
 };
 
+/**
+ * @brief Auxiliary tree's node which represents the reference tree's node
+ * 
+ */
+struct tg_aux_node {
+        struct rb_node node; /**< must be the first member */
+        size_t depth; /**< depth of ref in the reference tree */
+        size_t min_depth; /**< minimum depth in the subtree (augmented) */
+        size_t max_depth; /**< maximum depth in the subtree (augmented) */
+        struct tg_bst_node *ref;
+};
+
+/**
+ * @brief Preferred path which is stored in the auxiliary red-black tree
+ * 
+ */
 struct tg_node {
         size_t nr_nodes;
-        struct rb_tree *aux;
+        struct rb_tree *aux; /**< keyed by key, each node has its depth */
+        struct tg_bst_node *top; /**< the shallowest node of the path */
 };
 
 struct tg_tree {
         struct tg_bst_tree *ref;
-        struct tg_node *root;
+        struct tg_node *root; /**< preferred path which has ref->root */
+        size_t nr_switches; /**< number of preferred child changes */
 };
 
 struct tg_bst_tree *tg_bst_tree_alloc(void);
+struct tg_bst_tree *tg_bst_tree_build(key_t *keys, size_t size);
 void tg_bst_tree_dealloc(struct tg_bst_tree *tree);
 int tg_bst_tree_insert(struct tg_bst_tree *tree, key_t key, void *data);
 struct tg_bst_node *tg_bst_tree_search(struct tg_bst_tree *tree, key_t key);
+size_t tg_bst_get_depth(struct tg_bst_tree *tree, struct tg_bst_node *node);
 #ifdef TG_BST_TREE_DEBUG
 void tg_bst_tree_dump(struct tg_bst_tree *tree);
 #endif
 
 struct tg_tree *tg_tree_alloc(key_t *keys, size_t size);
-struct tg_node *tg_tree_search(struct tg_tree *tree, key_t key);
-void tg_tree_cut(struct tg_tree *tree, key_t key);
-struct tg_tree *tg_tree_join(struct tg_tree *tree, struct tg_node *aux1,
+struct tg_bst_node *tg_tree_search(struct tg_tree *tree, key_t key);
+int tg_tree_cut(struct tg_node *path, size_t depth, struct tg_node **lower);
+struct tg_node *tg_tree_join(struct tg_tree *tree, struct tg_node *aux1,
                              struct tg_node *aux2);
 void tg_tree_dealloc(struct tg_tree *tree);
+struct tg_aux_node *tg_aux_successor_deeper(struct rb_tree *aux, key_t key,
+                                            size_t depth);
+struct tg_aux_node *tg_aux_predecessor_deeper(struct rb_tree *aux, key_t key,
+                                              size_t depth);
 
-static inline struct tg_node *tg_node_alloc(void)
+static inline struct tg_aux_node *tg_aux_entry(struct rb_node *node)
+{
+        return (struct tg_aux_node *)node;
+}
+
+/**
+ * @brief Generate the preferred path
+ * 
+ * @param aux auxiliary tree of the path (can be NULL and set later)
+ * @return struct tg_node* allocated path
+ */
+static inline struct tg_node *tg_node_alloc(struct rb_tree *aux)
 {
         struct tg_node *node = (struct tg_node *)malloc(sizeof(struct tg_node));
         if (!node) {
                 pr_info("Node allocation failed...\n");
-                goto exception;
+                return NULL;
         }
 
-        node->aux = rb_tree_alloc();
-        if (!node->aux) {
-                pr_info("Preferred path consists failed...\n");
-                goto exception;
-        }
+        node->nr_nodes = 0;
+        node->aux = aux;
+        node->top = NULL;
 
         return node;
-exception:
-        if (node->aux) {
-                rb_tree_dealloc(node->aux);
-        }
-        if (node) {
-                free(node);
-        }
-        return NULL;
 }
 
 static inline void tg_node_dealloc(struct tg_node *node)
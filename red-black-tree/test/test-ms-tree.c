@@ -0,0 +1,151 @@
+#include <stdlib.h>
+
+#include "ms-tree.h"
+#include "unity.h"
+
+#define KEY_SIZE(keys) (sizeof(keys) / sizeof(key_t))
+#define NR_BIG_KEYS (1023)
+#define NR_ACCESSES (5000)
+
+struct ms_tree *tree;
+key_t keys[] = { 8, 12, 14, 13, 15, 10, 11, 9, 4, 2, 3, 1, 6, 7, 5 };
+size_t path_of[NR_BIG_KEYS];
+
+void setUp(void)
+{
+        tree = ms_tree_alloc(keys, KEY_SIZE(keys));
+        TEST_ASSERT_NOT_NULL(tree);
+}
+
+void tearDown(void)
+{
+        ms_tree_dealloc(tree);
+}
+
+/**
+ * @brief Check the order of the whole tree and record the path of each
+ * node. Path is identified by the index of its splay tree's root.
+ */
+static size_t check_bst(struct ms_node *node, size_t path, key_t lo, key_t hi)
+{
+        size_t index;
+
+        if (node == NULL) {
+                return 0;
+        }
+        index = (size_t)(node - tree->nodes);
+        TEST_ASSERT_TRUE(lo <= node->key && node->key < hi);
+        if (node->is_aux_root) {
+                TEST_ASSERT_TRUE(node != tree->root);
+                path = index;
+        }
+        path_of[index] = path;
+        return 1 + check_bst(node->left, path, lo, node->key) +
+               check_bst(node->right, path, node->key + 1, hi);
+}
+
+/**
+ * @brief Check each path is a downward path in the reference tree and the
+ * top path contains every ancestor of the accessed node
+ */
+static void check_paths(struct ms_node *accessed)
+{
+        size_t nr_tops = 0, nr_paths = 0;
+        size_t root = (size_t)(tree->root - tree->nodes);
+        size_t i, p;
+
+        TEST_ASSERT_EQUAL(tree->nr_nodes,
+                          check_bst(tree->root, root, 0, RB_MAX_KEY));
+        for (i = 0; i < tree->nr_nodes; i++) {
+                nr_paths += (path_of[i] == i);
+                if (i == 0 || path_of[i] != path_of[(i - 1) / 2]) {
+                        nr_tops++;
+                        continue;
+                }
+                /* both children can't be in the parent's path */
+                p = (i - 1) / 2;
+                if (i % 2 == 0) {
+                        TEST_ASSERT_TRUE(path_of[p] != path_of[i - 1]);
+                }
+                TEST_ASSERT_EQUAL(tree->nodes[p].depth + 1,
+                                  tree->nodes[i].depth);
+        }
+        TEST_ASSERT_EQUAL(nr_paths, nr_tops);
+
+        if (accessed) {
+                i = (size_t)(accessed - tree->nodes);
+                TEST_ASSERT_TRUE(accessed == tree->root);
+                for (; i > 0; i = (i - 1) / 2) {
+                        TEST_ASSERT_EQUAL(path_of[0], path_of[i]);
+                }
+        }
+}
+
+void test_ms_search(void)
+{
+        check_paths(NULL);
+        for (size_t i = 0; i < KEY_SIZE(keys); i++) {
+                struct ms_node *node = ms_tree_search(tree, keys[i]);
+                TEST_ASSERT_NOT_NULL(node);
+                TEST_ASSERT_EQUAL(keys[i], node->key);
+                check_paths(node);
+        }
+        TEST_ASSERT_NULL(ms_tree_search(tree, 0));
+        TEST_ASSERT_NULL(ms_tree_search(tree, 16));
+        check_paths(NULL);
+}
+
+void test_ms_switches(void)
+{
+        /* initial preferred child is left. So, minimum needs no switch */
+        TEST_ASSERT_NOT_NULL(ms_tree_search(tree, 1));
+        TEST_ASSERT_EQUAL(0, tree->nr_switches);
+
+        /* maximum changes the preferred child of every right spine node */
+        TEST_ASSERT_NOT_NULL(ms_tree_search(tree, 15));
+        TEST_ASSERT_EQUAL(3, tree->nr_switches);
+        check_paths(tree->root);
+
+        /* repetitive access doesn't change any preferred child */
+        TEST_ASSERT_NOT_NULL(ms_tree_search(tree, 15));
+        TEST_ASSERT_NOT_NULL(ms_tree_search(tree, 14));
+        TEST_ASSERT_NOT_NULL(ms_tree_search(tree, 12));
+        TEST_ASSERT_EQUAL(3, tree->nr_switches);
+        check_paths(tree->root);
+}
+
+void test_ms_random_access(void)
+{
+        key_t big_keys[NR_BIG_KEYS];
+
+        ms_tree_dealloc(tree);
+        for (size_t i = 0; i < NR_BIG_KEYS; i++) {
+                big_keys[i] = 2 * (NR_BIG_KEYS - i);
+        }
+        tree = ms_tree_alloc(big_keys, NR_BIG_KEYS);
+        TEST_ASSERT_NOT_NULL(tree);
+        TEST_ASSERT_EQUAL(NR_BIG_KEYS, tree->nr_nodes);
+        TEST_ASSERT_EQUAL(10, tree->nodes[NR_BIG_KEYS - 1].depth);
+
+        for (int i = 0; i < NR_ACCESSES; i++) {
+                key_t key = rand() % (2 * NR_BIG_KEYS + 2);
+                struct ms_node *node = ms_tree_search(tree, key);
+                if (key % 2 == 0 && key > 0) {
+                        TEST_ASSERT_NOT_NULL(node);
+                        TEST_ASSERT_EQUAL(key, node->key);
+                } else {
+                        TEST_ASSERT_NULL(node);
+                        node = NULL;
+                }
+                check_paths(node);
+        }
+}
+
+int main(void)
+{
+        UNITY_BEGIN();
+        RUN_TEST(test_ms_search);
+        RUN_TEST(test_ms_switches);
+        RUN_TEST(test_ms_random_access);
+        return UNITY_END();
+}
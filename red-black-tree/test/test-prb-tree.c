@@ -0,0 +1,209 @@
+#include <stdlib.h>
+#include <errno.h>
+
+#include "prb-tree.h"
+#include "unity.h"
+
+#define NR_VERSIONS (1000)
+#define KEY_SPACE (500)
+
+struct prb_tree *versions[NR_VERSIONS + 1];
+char contains[NR_VERSIONS + 1][KEY_SPACE];
+
+void setUp(void)
+{
+        versions[0] = prb_tree_alloc();
+        TEST_ASSERT_NOT_NULL(versions[0]);
+        memset(contains, 0, sizeof(contains));
+}
+
+void tearDown(void)
+{
+        /* release in shuffled order to exercise shared node release */
+        for (int i = NR_VERSIONS; i > 0; i--) {
+                int j = rand() % (i + 1);
+                struct prb_tree *temp = versions[i];
+                versions[i] = versions[j];
+                versions[j] = temp;
+        }
+        for (int i = 0; i <= NR_VERSIONS; i++) {
+                if (versions[i]) {
+                        prb_tree_dealloc(versions[i]);
+                        versions[i] = NULL;
+                }
+        }
+}
+
+/**
+ * @brief Check left-leaning red-black property and return black height
+ */
+static int check_llrb(struct prb_node *node, key_t lo, key_t hi)
+{
+        int lbh, rbh;
+        if (node == NULL) {
+                return 0;
+        }
+        TEST_ASSERT_TRUE(node->ref > 0);
+        TEST_ASSERT_TRUE(lo <= node->key && node->key < hi);
+        TEST_ASSERT_FALSE(node->right &&
+                          node->right->color == RB_NODE_COLOR_RED);
+        if (node->color == RB_NODE_COLOR_RED) {
+                TEST_ASSERT_FALSE(node->left &&
+                                  node->left->color == RB_NODE_COLOR_RED);
+        }
+        lbh = check_llrb(node->left, lo, node->key);
+        rbh = check_llrb(node->right, node->key + 1, hi);
+        TEST_ASSERT_EQUAL(lbh, rbh);
+        return lbh + (node->color == RB_NODE_COLOR_BLACK);
+}
+
+static void check_version(int v)
+{
+        size_t count = 0;
+        struct prb_tree *tree = versions[v];
+
+        TEST_ASSERT_FALSE(tree->root &&
+                          tree->root->color == RB_NODE_COLOR_RED);
+        check_llrb(tree->root, 0, KEY_SPACE);
+        for (key_t key = 0; key < KEY_SPACE; key++) {
+                struct prb_node *node = prb_tree_search(tree, key);
+                if (contains[v][key]) {
+                        TEST_ASSERT_NOT_NULL(node);
+                        TEST_ASSERT_EQUAL(key, (key_t)node->data);
+                        count++;
+                } else {
+                        TEST_ASSERT_NULL(node);
+                }
+        }
+        TEST_ASSERT_EQUAL(count, tree->nr_nodes);
+}
+
+void test_versions(void)
+{
+        for (int v = 1; v <= NR_VERSIONS; v++) {
+                key_t key = rand() % KEY_SPACE;
+                struct prb_tree *prev = versions[v - 1];
+
+                memcpy(contains[v], contains[v - 1], KEY_SPACE);
+                if (rand() % 3 && !contains[v][key]) {
+                        TEST_ASSERT_EQUAL(0, prb_tree_insert(prev, key,
+                                                             (void *)key,
+                                                             &versions[v]));
+                        contains[v][key] = 1;
+                } else if (contains[v][key]) {
+                        TEST_ASSERT_EQUAL(0, prb_tree_delete(prev, key,
+                                                             &versions[v]));
+                        contains[v][key] = 0;
+                } else {
+                        TEST_ASSERT_EQUAL(-ENODATA,
+                                          prb_tree_delete(prev, key,
+                                                          &versions[v]));
+                        TEST_ASSERT_NULL(versions[v]);
+                        versions[v] = prb_tree_clone(prev);
+                }
+                TEST_ASSERT_NOT_NULL(versions[v]);
+        }
+
+        /* every old version must be untouched */
+        for (int v = 0; v <= NR_VERSIONS; v++) {
+                check_version(v);
+        }
+}
+
+void test_release_old_versions(void)
+{
+        for (int v = 1; v <= NR_VERSIONS; v++) {
+                key_t key = rand() % KEY_SPACE;
+                memcpy(contains[v], contains[v - 1], KEY_SPACE);
+                if (contains[v][key]) {
+                        TEST_ASSERT_EQUAL(0, prb_tree_delete(versions[v - 1],
+                                                             key,
+                                                             &versions[v]));
+                } else {
+                        TEST_ASSERT_EQUAL(0, prb_tree_insert(versions[v - 1],
+                                                             key, (void *)key,
+                                                             &versions[v]));
+                }
+                contains[v][key] = !contains[v][key];
+
+                /* keep only every 10th version alive */
+                if ((v - 1) % 10) {
+                        prb_tree_dealloc(versions[v - 1]);
+                        versions[v - 1] = NULL;
+                }
+        }
+
+        for (int v = 0; v <= NR_VERSIONS; v++) {
+                if (versions[v]) {
+                        check_version(v);
+                }
+        }
+}
+
+void test_path_copying(void)
+{
+        struct prb_tree *tree = versions[0], *next = NULL;
+        struct prb_node *left = NULL;
+
+        for (key_t key = 0; key < KEY_SPACE - 1; key++) {
+                TEST_ASSERT_EQUAL(0, prb_tree_insert(tree, key, (void *)key,
+                                                     &next));
+                if (tree != versions[0]) {
+                        prb_tree_dealloc(tree);
+                }
+                tree = next;
+        }
+
+        /* appending the maximum key must not touch the left subtree */
+        left = tree->root->left;
+        TEST_ASSERT_EQUAL(0, prb_tree_insert(tree, KEY_SPACE - 1,
+                                             (void *)(key_t)(KEY_SPACE - 1),
+                                             &next));
+        TEST_ASSERT_TRUE(left == next->root->left);
+        TEST_ASSERT_TRUE(left->ref == 2);
+        TEST_ASSERT_EQUAL(KEY_SPACE - 1, tree->nr_nodes);
+        TEST_ASSERT_EQUAL(KEY_SPACE, next->nr_nodes);
+        TEST_ASSERT_NULL(prb_tree_search(tree, KEY_SPACE - 1));
+        TEST_ASSERT_NOT_NULL(prb_tree_search(next, KEY_SPACE - 1));
+
+        TEST_ASSERT_EQUAL(-EINVAL,
+                          prb_tree_insert(tree, RB_MAX_KEY, NULL, &versions[1]));
+        TEST_ASSERT_NULL(versions[1]);
+
+        prb_tree_dealloc(tree);
+        TEST_ASSERT_TRUE(left->ref == 1);
+        versions[1] = next;
+}
+
+void test_node_cache(void)
+{
+        struct prb_tree *other = prb_tree_alloc();
+        struct prb_tree *next = NULL;
+
+        TEST_ASSERT_NOT_NULL(other);
+        TEST_ASSERT_TRUE(other->cache != versions[0]->cache);
+
+        TEST_ASSERT_EQUAL(0, prb_tree_insert(versions[0], 1, (void *)1,
+                                             &versions[1]));
+        TEST_ASSERT_TRUE(versions[1]->cache == versions[0]->cache);
+        TEST_ASSERT_EQUAL(2, versions[0]->cache->ref);
+
+        TEST_ASSERT_EQUAL(0, prb_tree_insert(other, 2, (void *)2, &next));
+        TEST_ASSERT_EQUAL(2, other->cache->ref);
+        TEST_ASSERT_NULL(prb_tree_search(versions[1], 2));
+        TEST_ASSERT_NOT_NULL(prb_tree_search(next, 2));
+
+        prb_tree_dealloc(other);
+        TEST_ASSERT_EQUAL(1, next->cache->ref);
+        prb_tree_dealloc(next); /**< cache is released with the last version */
+}
+
+int main(void)
+{
+        UNITY_BEGIN();
+        RUN_TEST(test_versions);
+        RUN_TEST(test_release_old_versions);
+        RUN_TEST(test_path_copying);
+        RUN_TEST(test_node_cache);
+        return UNITY_END();
+}
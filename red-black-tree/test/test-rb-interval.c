@@ -0,0 +1,155 @@
+#include <stdlib.h>
+#include <errno.h>
+
+#include "rb-interval.h"
+#include "unity.h"
+
+#define NR_INTERVALS (1000)
+#define KEY_SPACE (10000)
+#define MAX_LENGTH (100)
+#define NR_QUERIES (500)
+
+struct rb_tree *tree;
+key_t lo_arr[NR_INTERVALS];
+key_t hi_arr[NR_INTERVALS];
+int is_deleted[NR_INTERVALS];
+
+void setUp(void)
+{
+        tree = rb_interval_tree_alloc();
+        TEST_ASSERT_NOT_NULL(tree);
+
+        for (int i = 0; i < NR_INTERVALS; i++) {
+                lo_arr[i] = rand() % KEY_SPACE;
+                hi_arr[i] = lo_arr[i] + rand() % MAX_LENGTH;
+                is_deleted[i] = 0;
+        }
+}
+
+void tearDown(void)
+{
+        rb_tree_dealloc(tree);
+}
+
+static key_t check_max(struct rb_node *node)
+{
+        key_t max;
+        if (node == tree->nil) {
+                return 0;
+        }
+        max = rb_interval_entry(node)->hi;
+        if (check_max(node->left) > max) {
+                max = check_max(node->left);
+        }
+        if (check_max(node->right) > max) {
+                max = check_max(node->right);
+        }
+        TEST_ASSERT_EQUAL(max, rb_interval_entry(node)->max);
+        return max;
+}
+
+static int count_overlap(struct rb_interval_node *node, void *arg)
+{
+        key_t *range = (key_t *)arg;
+        TEST_ASSERT_TRUE(rb_interval_is_overlap(node, range[0], range[1]));
+        TEST_ASSERT_TRUE(range[3] <= node->node.key);
+        range[3] = node->node.key;
+        range[2]++;
+        return 0;
+}
+
+static void check_queries(void)
+{
+        for (int q = 0; q < NR_QUERIES; q++) {
+                key_t lo = rand() % KEY_SPACE;
+                key_t hi = lo + rand() % MAX_LENGTH;
+                key_t range[4] = { lo, hi, 0, 0 };
+                key_t expect = 0, first_lo = RB_MAX_KEY;
+                struct rb_interval_node *first;
+
+                for (int i = 0; i < NR_INTERVALS; i++) {
+                        if (!is_deleted[i] && lo_arr[i] <= hi &&
+                            lo <= hi_arr[i]) {
+                                expect++;
+                                if (lo_arr[i] < first_lo) {
+                                        first_lo = lo_arr[i];
+                                }
+                        }
+                }
+
+                TEST_ASSERT_EQUAL(0, rb_interval_overlap_all(tree, lo, hi,
+                                                             count_overlap,
+                                                             range));
+                TEST_ASSERT_EQUAL(expect, range[2]);
+
+                first = rb_interval_overlap_first(tree, lo, hi);
+                if (expect == 0) {
+                        TEST_ASSERT_NULL(first);
+                } else {
+                        TEST_ASSERT_NOT_NULL(first);
+                        TEST_ASSERT_EQUAL(first_lo, first->node.key);
+                }
+        }
+}
+
+void test_rb_interval_insert(void)
+{
+        for (int i = 0; i < NR_INTERVALS; i++) {
+                TEST_ASSERT_EQUAL(0, rb_interval_insert(tree, lo_arr[i],
+                                                        hi_arr[i], NULL));
+        }
+        check_max(tree->root);
+        TEST_ASSERT_EQUAL(-EINVAL, rb_interval_insert(tree, 10, 5, NULL));
+}
+
+void test_rb_interval_overlap(void)
+{
+        test_rb_interval_insert();
+        check_queries();
+}
+
+void test_rb_interval_delete(void)
+{
+        test_rb_interval_insert();
+        for (int i = 0; i < NR_INTERVALS; i += 3) {
+                TEST_ASSERT_EQUAL(0, rb_interval_delete(tree, lo_arr[i],
+                                                        hi_arr[i]));
+                is_deleted[i] = 1;
+        }
+        TEST_ASSERT_EQUAL(-ENODATA,
+                          rb_interval_delete(tree, KEY_SPACE, KEY_SPACE));
+        check_max(tree->root);
+        check_queries();
+}
+
+void test_rb_interval_delete_concurrent(void)
+{
+        struct rb_tree_reader *reader = NULL;
+
+        test_rb_interval_insert();
+        TEST_ASSERT_EQUAL(0, rb_tree_enable_concurrent(tree));
+
+        reader = &tree->sync->readers[0];
+        reader->count++; /**< reader which is in the middle of the traverse */
+        TEST_ASSERT_EQUAL(0, rb_interval_delete(tree, lo_arr[0], hi_arr[0]));
+        TEST_ASSERT_NOT_NULL(tree->sync->waiting);
+        TEST_ASSERT_EQUAL(lo_arr[0], tree->sync->waiting->key);
+
+        reader->count--;
+        rb_tree_synchronize(tree);
+        TEST_ASSERT_NULL(tree->sync->waiting);
+        TEST_ASSERT_NULL(tree->sync->retired);
+        check_max(tree->root);
+}
+
+int main(void)
+{
+        UNITY_BEGIN();
+
+        RUN_TEST(test_rb_interval_insert);
+        RUN_TEST(test_rb_interval_overlap);
+        RUN_TEST(test_rb_interval_delete);
+        RUN_TEST(test_rb_interval_delete_concurrent);
+
+        return UNITY_END();
+}
@@ -1,6 +1,7 @@
 #include <stdlib.h>
 #include <time.h>
 #include <errno.h>
+#include <pthread.h>
 
 #include "rb-tree.h"
 #include "unity.h"
@@ -187,6 +188,8 @@ void test_rb_bh(void)
         }
 }
 
+static void check_tree(struct rb_tree *tree);
+
 void test_rb_concat(void)
 {
         struct rb_tree *t1 = tree_arr[0];
@@ -244,7 +247,10 @@ void test_rb_split(void)
                 TEST_ASSERT_EQUAL(0, rb_tree_insert(tree, tree_data[i], NULL));
         }
 
-        rb_tree_split(tree, SPLIT_POINT, &t1, &t2);
+        TEST_ASSERT_EQUAL(0, rb_tree_split(tree, SPLIT_POINT, &t1, &t2));
+        check_tree(t1);
+        check_tree(t2);
+        TEST_ASSERT_EQUAL(SPLIT_POINT, t1->max->key);
         for (int i = 0; i < nr_tree_data; i++) {
                 size_t t1_addr = (size_t)rb_tree_search(t1, tree_data[i]);
                 size_t t2_addr = (size_t)rb_tree_search(t2, tree_data[i]);
@@ -256,6 +262,437 @@ void test_rb_split(void)
         rb_tree_dealloc(t2);
 }
 
+void test_rb_lower_and_upper_bound(void)
+{
+        key_t values[] = { 10, 35, 5, 22 };
+        const int nr_values = (int)(sizeof(values) / sizeof(key_t));
+        for (int i = 0; i < nr_values; i++) {
+                TEST_ASSERT_EQUAL(0, rb_tree_insert(tree, values[i], NULL));
+        }
+
+        TEST_ASSERT_EQUAL(5, rb_tree_lower_bound(tree, 0)->key);
+        TEST_ASSERT_EQUAL(10, rb_tree_lower_bound(tree, 10)->key);
+        TEST_ASSERT_EQUAL(22, rb_tree_lower_bound(tree, 11)->key);
+        TEST_ASSERT_NULL(rb_tree_lower_bound(tree, 36));
+
+        TEST_ASSERT_EQUAL(5, rb_tree_upper_bound(tree, 0)->key);
+        TEST_ASSERT_EQUAL(22, rb_tree_upper_bound(tree, 10)->key);
+        TEST_ASSERT_EQUAL(35, rb_tree_upper_bound(tree, 34)->key);
+        TEST_ASSERT_NULL(rb_tree_upper_bound(tree, 35));
+}
+
+void test_rb_range_iter(void)
+{
+        struct rb_tree_iter iter;
+        struct rb_node *node;
+        key_t expect;
+
+        for (key_t key = 0; key < INSERT_SIZE; key += 2) {
+                TEST_ASSERT_EQUAL(0, rb_tree_insert(tree, key, NULL));
+        }
+
+        expect = 100;
+        rb_tree_iter_init(&iter, tree, 99, 201);
+        while ((node = rb_tree_iter_next(&iter)) != NULL) {
+                TEST_ASSERT_EQUAL(expect, node->key);
+                expect += 2;
+        }
+        TEST_ASSERT_EQUAL(202, expect);
+
+        rb_tree_iter_init(&iter, tree, 0, INSERT_SIZE);
+        for (expect = 0; (node = rb_tree_iter_next(&iter)) != NULL;
+             expect += 2) {
+                TEST_ASSERT_EQUAL(expect, node->key);
+        }
+        TEST_ASSERT_EQUAL(INSERT_SIZE, expect);
+
+        rb_tree_iter_init(&iter, tree, 51, 52);
+        TEST_ASSERT_NULL(rb_tree_iter_next(&iter));
+}
+
+static int sum_until_limit(struct rb_node *node, void *arg)
+{
+        key_t *sum = (key_t *)arg;
+        if (node->key > 50) {
+                return 1;
+        }
+        *sum += node->key;
+        return 0;
+}
+
+void test_rb_range_foreach(void)
+{
+        key_t sum = 0;
+
+        for (key_t key = 1; key <= 100; key++) {
+                TEST_ASSERT_EQUAL(0, rb_tree_insert(tree, key, NULL));
+        }
+
+        TEST_ASSERT_EQUAL(0, rb_tree_range_foreach(tree, 1, 11,
+                                                   sum_until_limit, &sum));
+        TEST_ASSERT_EQUAL(55, sum);
+
+        sum = 0;
+        TEST_ASSERT_EQUAL(1, rb_tree_range_foreach(tree, 41, 100,
+                                                   sum_until_limit, &sum));
+        TEST_ASSERT_EQUAL(455, sum);
+}
+
+static size_t check_size(struct rb_tree *tree, struct rb_node *node)
+{
+        size_t size;
+        if (node == tree->nil) {
+                return 0;
+        }
+        size = check_size(tree, node->left) + check_size(tree, node->right) +
+               1;
+        TEST_ASSERT_EQUAL(size, node->size);
+        return size;
+}
+
+void test_rb_order_statistic(void)
+{
+        const key_t STRIDE = 3;
+        size_t nr_nodes = 0;
+
+        TEST_ASSERT_EQUAL(0, rb_tree_insert(tree, STRIDE, NULL));
+        TEST_ASSERT_NULL(rb_tree_select(tree, 1));
+        TEST_ASSERT_EQUAL(RB_INVALID_RANK, rb_tree_rank(tree, STRIDE));
+        TEST_ASSERT_EQUAL(RB_INVALID_RANK, rb_tree_range_count(tree, 0, 10));
+        TEST_ASSERT_EQUAL(0, tree->flags & RB_TREE_FLAG_ORDER_STAT);
+
+        rb_tree_enable_order_stat(tree);
+        for (int i = 0; i < INSERT_SIZE; i++) {
+                TEST_ASSERT_EQUAL(0, rb_tree_insert(tree, i * STRIDE, NULL));
+        }
+        for (int i = 0; i < INSERT_SIZE; i += 4) {
+                TEST_ASSERT_EQUAL(0, rb_tree_delete(tree, i * STRIDE));
+        }
+        nr_nodes = check_size(tree, tree->root);
+        TEST_ASSERT_EQUAL(INSERT_SIZE - INSERT_SIZE / 4, nr_nodes);
+
+        for (size_t i = 1; i <= nr_nodes; i++) {
+                struct rb_node *node = rb_tree_select(tree, i);
+                TEST_ASSERT_NOT_NULL(node);
+                TEST_ASSERT_EQUAL(i, rb_tree_rank(tree, node->key));
+                TEST_ASSERT_EQUAL(i - 1, rb_tree_rank(tree, node->key - 1));
+        }
+        TEST_ASSERT_NULL(rb_tree_select(tree, 0));
+        TEST_ASSERT_NULL(rb_tree_select(tree, nr_nodes + 1));
+
+        TEST_ASSERT_EQUAL(0, rb_tree_range_count(tree, 0, 3));
+        TEST_ASSERT_EQUAL(3, rb_tree_range_count(tree, 0, 13));
+        TEST_ASSERT_EQUAL(nr_nodes,
+                          rb_tree_range_count(tree, 0, RB_MAX_KEY));
+        TEST_ASSERT_EQUAL(0, rb_tree_range_count(tree, 10, 10));
+}
+
+void test_rb_order_statistic_concat(void)
+{
+        struct rb_tree *t1 = tree_arr[0];
+        struct rb_tree *t2 = tree_arr[1];
+        struct rb_node *x;
+
+        rb_tree_enable_order_stat(t1);
+        for (key_t key = 1; key <= 50; key++) {
+                TEST_ASSERT_EQUAL(0, rb_tree_insert(t1, key, NULL));
+        }
+        for (key_t key = 51; key <= 60; key++) {
+                TEST_ASSERT_EQUAL(0, rb_tree_insert(t2, key, NULL));
+        }
+
+        x = rb_tree_minimum(t2, t2->root);
+        tree = rb_tree_concat(t1, t2, x);
+        TEST_ASSERT_NOT_NULL(tree);
+        tree_arr[0] = tree;
+        tree_arr[1] = NULL;
+
+        TEST_ASSERT_EQUAL(60, check_size(tree, tree->root));
+        for (size_t i = 1; i <= 60; i++) {
+                TEST_ASSERT_EQUAL(i, rb_tree_select(tree, i)->key);
+        }
+}
+
+void test_rb_lockless_search(void)
+{
+        key_t key;
+        void *data;
+
+        TEST_ASSERT_EQUAL(-EINVAL, rb_tree_search_lockless(tree, 1, &data));
+        TEST_ASSERT_EQUAL(0, rb_tree_enable_concurrent(tree));
+        for (key = 10; key <= 100; key += 10) {
+                char *str = (char *)malloc(sizeof(char) * STR_BUF_SIZE);
+                sprintf(str, "%ld", key);
+                TEST_ASSERT_EQUAL(0, rb_tree_insert(tree, key, str));
+        }
+
+        TEST_ASSERT_EQUAL(0, rb_tree_search_lockless(tree, 30, &data));
+        TEST_ASSERT_EQUAL_STRING("30", data);
+        TEST_ASSERT_EQUAL(-ENODATA, rb_tree_search_lockless(tree, 35, &data));
+
+        TEST_ASSERT_EQUAL(0, rb_tree_next_lockless(tree, 35, &key, &data));
+        TEST_ASSERT_EQUAL(40, key);
+        TEST_ASSERT_EQUAL(0, rb_tree_prev_lockless(tree, 35, &key, NULL));
+        TEST_ASSERT_EQUAL(30, key);
+        TEST_ASSERT_EQUAL(-ENODATA, rb_tree_next_lockless(tree, 100, &key,
+                                                          NULL));
+        TEST_ASSERT_EQUAL(-ENODATA, rb_tree_prev_lockless(tree, 10, &key,
+                                                          NULL));
+
+        TEST_ASSERT_EQUAL(0, rb_tree_delete(tree, 30));
+        TEST_ASSERT_EQUAL(-ENODATA, rb_tree_search_lockless(tree, 30, &data));
+        rb_tree_synchronize(tree);
+        TEST_ASSERT_NULL(tree->sync->waiting);
+        TEST_ASSERT_NULL(tree->sync->retired);
+}
+
+#define NR_READERS (3)
+#define NR_STABLE_KEYS (128)
+
+static int writer_done;
+
+static void *lockless_reader(void *arg)
+{
+        struct rb_tree *tree = (struct rb_tree *)arg;
+        size_t nr_fails = 0;
+        key_t next;
+
+        while (!__atomic_load_n(&writer_done, __ATOMIC_ACQUIRE)) {
+                for (key_t key = 0; key < NR_STABLE_KEYS; key++) {
+                        if (rb_tree_search_lockless(tree, key * 2, NULL) ||
+                            rb_tree_next_lockless(tree, key * 2, &next,
+                                                  NULL) ||
+                            next > key * 2 + 2) {
+                                nr_fails++;
+                        }
+                }
+        }
+
+        return (void *)nr_fails;
+}
+
+void test_rb_lockless_concurrent_readers(void)
+{
+        pthread_t readers[NR_READERS];
+        void *nr_fails;
+
+        TEST_ASSERT_EQUAL(0, rb_tree_enable_concurrent(tree));
+        for (key_t key = 0; key <= NR_STABLE_KEYS; key++) {
+                TEST_ASSERT_EQUAL(0, rb_tree_insert(tree, key * 2, NULL));
+        }
+
+        writer_done = 0;
+        for (int i = 0; i < NR_READERS; i++) {
+                TEST_ASSERT_EQUAL(0, pthread_create(&readers[i], NULL,
+                                                    lockless_reader, tree));
+        }
+
+        for (int round = 0; round < 20; round++) {
+                for (key_t key = 0; key < NR_STABLE_KEYS; key++) {
+                        TEST_ASSERT_EQUAL(0, rb_tree_insert(tree, key * 2 + 1,
+                                                            NULL));
+                }
+                for (key_t key = 0; key < NR_STABLE_KEYS; key++) {
+                        TEST_ASSERT_EQUAL(0, rb_tree_delete(tree, key * 2 + 1));
+                }
+        }
+        __atomic_store_n(&writer_done, 1, __ATOMIC_RELEASE);
+
+        for (int i = 0; i < NR_READERS; i++) {
+                TEST_ASSERT_EQUAL(0, pthread_join(readers[i], &nr_fails));
+                TEST_ASSERT_NULL(nr_fails);
+        }
+}
+
+static size_t check_rb(struct rb_tree *tree, struct rb_node *node)
+{
+        size_t left_bh, right_bh;
+        if (node == tree->nil) {
+                return 0;
+        }
+        if (node->color == RB_NODE_COLOR_RED) {
+                TEST_ASSERT_EQUAL(RB_NODE_COLOR_BLACK, node->left->color);
+                TEST_ASSERT_EQUAL(RB_NODE_COLOR_BLACK, node->right->color);
+        }
+        if (node->left != tree->nil) {
+                TEST_ASSERT_EQUAL_PTR(node, node->left->parent);
+                TEST_ASSERT_TRUE(node->left->key < node->key);
+        }
+        if (node->right != tree->nil) {
+                TEST_ASSERT_EQUAL_PTR(node, node->right->parent);
+                TEST_ASSERT_TRUE(node->key < node->right->key);
+        }
+        left_bh = check_rb(tree, node->left) +
+                  (node->left->color == RB_NODE_COLOR_BLACK);
+        right_bh = check_rb(tree, node->right) +
+                   (node->right->color == RB_NODE_COLOR_BLACK);
+        TEST_ASSERT_EQUAL(left_bh, right_bh);
+        return left_bh;
+}
+
+static void check_tree(struct rb_tree *tree)
+{
+        TEST_ASSERT_EQUAL(RB_NODE_COLOR_BLACK, tree->root->color);
+        TEST_ASSERT_EQUAL(tree->bh, check_rb(tree, tree->root));
+        if (tree->root == tree->nil) {
+                TEST_ASSERT_NULL(tree->max);
+        } else {
+                TEST_ASSERT_EQUAL_PTR(rb_tree_maximum(tree, tree->root),
+                                      tree->max);
+        }
+}
+
+void test_rb_insert_hint_sequential(void)
+{
+        struct rb_node *node;
+        key_t expect = 0;
+
+        for (key_t key = 0; key < INSERT_SIZE; key++) {
+                TEST_ASSERT_EQUAL(0, rb_tree_insert_hint(tree, NULL, key,
+                                                         NULL));
+                TEST_ASSERT_EQUAL(key, tree->finger->key);
+        }
+        check_tree(tree);
+
+        for (node = rb_tree_minimum(tree, tree->root); node != tree->nil;
+             node = rb_tree_successor(tree, node)) {
+                TEST_ASSERT_EQUAL(expect++, node->key);
+        }
+        TEST_ASSERT_EQUAL(INSERT_SIZE, expect);
+}
+
+void test_rb_insert_hint_nearly_sorted(void)
+{
+        const int WINDOW = 8;
+        struct rb_tree_iter iter;
+        struct rb_node *node;
+        key_t expect = 0;
+
+        for (int i = 0; i < INSERT_SIZE; i++) {
+                key_arr[i] = i;
+        }
+        for (int i = 0; i + WINDOW < INSERT_SIZE; i += WINDOW) {
+                int j = i + rand() % WINDOW;
+                key_t temp = key_arr[i];
+                key_arr[i] = key_arr[j];
+                key_arr[j] = temp;
+        }
+
+        for (int i = 0; i < INSERT_SIZE; i++) {
+                TEST_ASSERT_EQUAL(0, rb_tree_insert_hint(tree, NULL,
+                                                         key_arr[i], NULL));
+        }
+        for (int i = 0; i < INSERT_SIZE; i += 3) {
+                TEST_ASSERT_EQUAL(0, rb_tree_delete(tree, i));
+                check_tree(tree);
+        }
+        for (int i = 0; i < INSERT_SIZE; i += 3) {
+                node = rb_tree_search(tree, rand() % INSERT_SIZE);
+                TEST_ASSERT_EQUAL(0, rb_tree_insert_hint(tree, node, i, NULL));
+        }
+        check_tree(tree);
+
+        rb_tree_iter_init(&iter, tree, 0, RB_MAX_KEY);
+        while ((node = rb_tree_iter_next(&iter)) != NULL) {
+                TEST_ASSERT_EQUAL(expect++, node->key);
+        }
+        TEST_ASSERT_EQUAL(INSERT_SIZE, expect);
+}
+
+void test_rb_pool(void)
+{
+        struct rb_tree *t1 = NULL, *t2 = NULL;
+        struct rb_node *x;
+
+        rb_tree_dealloc(tree_arr[0]);
+        tree = tree_arr[0] = rb_tree_alloc_with_pool(16);
+        TEST_ASSERT_NOT_NULL(tree);
+
+        for (int i = 0; i < INSERT_SIZE; i++) {
+                char *data = (char *)malloc(sizeof(char) * STR_BUF_SIZE);
+                key_arr[i] = rand() % INSERT_SIZE;
+                sprintf(data, "%d", i);
+                TEST_ASSERT_EQUAL(0, rb_tree_insert(tree, key_arr[i], data));
+        }
+        for (int i = 0; i < INSERT_SIZE; i += 2) {
+                rb_tree_delete(tree, key_arr[i]);
+                TEST_ASSERT_NULL(rb_tree_search(tree, key_arr[i]));
+        }
+        check_tree(tree);
+        for (int i = 0; i < INSERT_SIZE; i += 2) {
+                TEST_ASSERT_EQUAL(0, rb_tree_insert(tree, key_arr[i], NULL));
+        }
+        check_tree(tree);
+
+        /* split trees share the pool and concat gives it back to one tree */
+        TEST_ASSERT_EQUAL(0, rb_tree_split(tree, INSERT_SIZE / 2, &t1, &t2));
+        tree_arr[0] = NULL;
+        TEST_ASSERT_EQUAL_PTR(t1->pool, t2->pool);
+        TEST_ASSERT_EQUAL(2, t1->pool->ref);
+        TEST_ASSERT_NULL(rb_tree_concat(t1, tree_arr[1],
+                                        rb_tree_maximum(t1, t1->root)));
+
+        x = rb_tree_maximum(t1, t1->root);
+        tree = rb_tree_concat(t1, t2, x);
+        TEST_ASSERT_NOT_NULL(tree);
+        tree_arr[0] = tree;
+        TEST_ASSERT_EQUAL(1, tree->pool->ref);
+        for (int i = 0; i < INSERT_SIZE; i++) {
+                TEST_ASSERT_NOT_NULL(rb_tree_search(tree, key_arr[i]));
+        }
+
+        /* malloc-ed x is moved to the pool node */
+        TEST_ASSERT_EQUAL(0, rb_tree_split(tree, INSERT_SIZE / 2, &t1, &t2));
+        tree_arr[0] = NULL;
+        rb_tree_delete(t2, INSERT_SIZE / 2 + 1);
+        x = rb_node_alloc(INSERT_SIZE / 2 + 1);
+        TEST_ASSERT_NOT_NULL(x);
+        x->data = malloc(sizeof(char) * STR_BUF_SIZE);
+        tree = rb_tree_concat(t1, t2, x);
+        TEST_ASSERT_NOT_NULL(tree);
+        tree_arr[0] = tree;
+        x = rb_tree_search(tree, INSERT_SIZE / 2 + 1);
+        TEST_ASSERT_NOT_NULL(x);
+        TEST_ASSERT_NOT_NULL(x->data);
+        check_tree(tree);
+}
+
+void test_rb_split_and_concat_balanced(void)
+{
+        struct rb_tree *t1 = NULL, *t2 = NULL;
+        key_t split_key;
+
+        rb_tree_enable_order_stat(tree);
+        for (key_t key = 0; key < INSERT_SIZE; key++) {
+                TEST_ASSERT_EQUAL(0, rb_tree_insert(tree, key * 2, NULL));
+        }
+
+        for (int i = 0; i < 100; i++) {
+                split_key = rand() % (INSERT_SIZE * 2);
+                TEST_ASSERT_EQUAL(0, rb_tree_split(tree, split_key, &t1, &t2));
+                tree = tree_arr[0] = NULL;
+                check_tree(t1);
+                check_tree(t2);
+                TEST_ASSERT_EQUAL(split_key / 2 + 1, t1->root->size);
+                TEST_ASSERT_EQUAL(INSERT_SIZE - split_key / 2 - 1,
+                                  t2->root->size);
+
+                if (t1->root == t1->nil) {
+                        tree = rb_tree_concat(t1, t2,
+                                              rb_tree_minimum(t2, t2->root));
+                } else {
+                        tree = rb_tree_concat(t1, t2,
+                                              rb_tree_maximum(t1, t1->root));
+                }
+                TEST_ASSERT_NOT_NULL(tree);
+                tree_arr[0] = tree;
+                check_tree(tree);
+                TEST_ASSERT_EQUAL(INSERT_SIZE, tree->root->size);
+                TEST_ASSERT_EQUAL_PTR(rb_tree_select(tree, split_key / 2 + 1),
+                                      rb_tree_search(tree, split_key / 2 * 2));
+        }
+}
+
 int main(void)
 {
         UNITY_BEGIN();
@@ -270,6 +707,17 @@ int main(void)
         RUN_TEST(test_rb_bh);
         RUN_TEST(test_rb_concat);
         RUN_TEST(test_rb_split);
+        RUN_TEST(test_rb_lower_and_upper_bound);
+        RUN_TEST(test_rb_range_iter);
+        RUN_TEST(test_rb_range_foreach);
+        RUN_TEST(test_rb_order_statistic);
+        RUN_TEST(test_rb_order_statistic_concat);
+        RUN_TEST(test_rb_lockless_search);
+        RUN_TEST(test_rb_lockless_concurrent_readers);
+        RUN_TEST(test_rb_insert_hint_sequential);
+        RUN_TEST(test_rb_insert_hint_nearly_sorted);
+        RUN_TEST(test_rb_pool);
+        RUN_TEST(test_rb_split_and_concat_balanced);
 
         return UNITY_END();
 }
\ No newline at end of file
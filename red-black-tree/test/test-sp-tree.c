@@ -0,0 +1,132 @@
+#include <stdlib.h>
+#include <errno.h>
+
+#include "sp-tree.h"
+#include "unity.h"
+
+#define KEY_SPACE (2000)
+#define NR_OPS (20000)
+#define NR_CHAIN (100000)
+
+struct sp_tree *tree;
+char contains[KEY_SPACE];
+
+void setUp(void)
+{
+        tree = sp_tree_alloc();
+        TEST_ASSERT_NOT_NULL(tree);
+        memset(contains, 0, sizeof(contains));
+}
+
+void tearDown(void)
+{
+        sp_tree_dealloc(tree);
+}
+
+/**
+ * @brief Check the binary search tree order and return number of nodes
+ */
+static size_t check_bst(struct sp_node *node, key_t lo, key_t hi)
+{
+        if (node == NULL) {
+                return 0;
+        }
+        TEST_ASSERT_TRUE(lo <= node->key && node->key < hi);
+        TEST_ASSERT_EQUAL(node->key, *(key_t *)node->data);
+        return 1 + check_bst(node->left, lo, node->key) +
+               check_bst(node->right, node->key + 1, hi);
+}
+
+static size_t depth_of(struct sp_node *node, key_t key)
+{
+        size_t depth = 1;
+        while (node && node->key != key) {
+                node = (key < node->key ? node->left : node->right);
+                depth++;
+        }
+        TEST_ASSERT_NOT_NULL(node);
+        return depth;
+}
+
+static key_t *key_data(key_t key)
+{
+        key_t *data = (key_t *)malloc(sizeof(key_t));
+        TEST_ASSERT_NOT_NULL(data);
+        *data = key;
+        return data;
+}
+
+void test_sp_random(void)
+{
+        size_t count = 0;
+
+        for (int i = 0; i < NR_OPS; i++) {
+                key_t key = rand() % KEY_SPACE;
+                struct sp_node *node = NULL;
+
+                switch (rand() % 3) {
+                case 0:
+                        TEST_ASSERT_EQUAL(0, sp_tree_insert(tree, key,
+                                                            key_data(key)));
+                        count += !contains[key];
+                        contains[key] = 1;
+                        break;
+                case 1:
+                        TEST_ASSERT_EQUAL(contains[key] ? 0 : -ENODATA,
+                                          sp_tree_delete(tree, key));
+                        count -= contains[key];
+                        contains[key] = 0;
+                        break;
+                default:
+                        node = sp_tree_search(tree, key);
+                        if (contains[key]) {
+                                TEST_ASSERT_NOT_NULL(node);
+                                TEST_ASSERT_TRUE(node == tree->root);
+                        } else {
+                                TEST_ASSERT_NULL(node);
+                        }
+                        break;
+                }
+                TEST_ASSERT_EQUAL(count, tree->nr_nodes);
+        }
+        TEST_ASSERT_EQUAL(count, check_bst(tree->root, 0, KEY_SPACE));
+        TEST_ASSERT_EQUAL(-EINVAL, sp_tree_insert(tree, RB_MAX_KEY, NULL));
+}
+
+void test_sp_working_set(void)
+{
+        struct sp_node *node = NULL;
+
+        for (key_t key = 0; key < NR_CHAIN; key++) {
+                TEST_ASSERT_EQUAL(0, sp_tree_insert(tree, key, key_data(key)));
+        }
+        /* sequential insert makes the left chain */
+        TEST_ASSERT_EQUAL(NR_CHAIN - 1, tree->root->key);
+        TEST_ASSERT_NULL(tree->root->right);
+
+        /* splaying the deepest node halves the depth of the chain */
+        TEST_ASSERT_NOT_NULL(sp_tree_search(tree, 0));
+        node = tree->root->right;
+        TEST_ASSERT_NOT_NULL(node);
+        TEST_ASSERT_EQUAL(NR_CHAIN - 2, node->key);
+        TEST_ASSERT_EQUAL(NR_CHAIN - 1, node->right->key);
+        TEST_ASSERT_EQUAL(NR_CHAIN - 4, node->left->key);
+
+        /* recently accessed key stays near the root */
+        TEST_ASSERT_NOT_NULL(sp_tree_search(tree, 7));
+        TEST_ASSERT_NOT_NULL(sp_tree_search(tree, 3));
+        TEST_ASSERT_EQUAL(3, tree->root->key);
+        TEST_ASSERT_TRUE(depth_of(tree->root, 7) <= 3);
+
+        /* update replaces the data */
+        TEST_ASSERT_EQUAL(0, sp_tree_insert(tree, 3, key_data(3)));
+        TEST_ASSERT_EQUAL(NR_CHAIN, tree->nr_nodes);
+}
+
+int main(void)
+{
+        UNITY_BEGIN();
+        RUN_TEST(test_sp_random);
+        RUN_TEST(test_sp_working_set);
+        return UNITY_END();
+}
@@ -2,6 +2,8 @@
 #include "tg-tree.h"
 
 #define KEY_SIZE(keys) (sizeof(keys) / sizeof(key_t))
+#define NR_BIG_KEYS (1023)
+#define NR_ACCESSES (5000)
 
 struct tg_tree *tree;
 key_t keys[] = { 8, 12, 14, 13, 15, 10, 11, 9, 4, 2, 3, 1, 6, 7, 5 };
@@ -17,14 +19,298 @@ void tearDown(void)
         tg_tree_dealloc(tree);
 }
 
+/**
+ * @brief Check the augmented depth range and return the maximum depth
+ */
+static size_t check_depth_range(struct rb_tree *aux, struct rb_node *x,
+                                size_t *min_depth)
+{
+        size_t left_min = (size_t)-1, right_min = (size_t)-1;
+        size_t max_depth;
+        struct tg_aux_node *node;
+
+        if (x == aux->nil) {
+                *min_depth = (size_t)-1;
+                return 0;
+        }
+        node = tg_aux_entry(x);
+        max_depth = node->depth;
+        *min_depth = node->depth;
+        if (check_depth_range(aux, x->left, &left_min) > max_depth) {
+                max_depth = tg_aux_entry(x->left)->max_depth;
+        }
+        if (check_depth_range(aux, x->right, &right_min) > max_depth) {
+                max_depth = tg_aux_entry(x->right)->max_depth;
+        }
+        *min_depth = (left_min < *min_depth ? left_min : *min_depth);
+        *min_depth = (right_min < *min_depth ? right_min : *min_depth);
+        TEST_ASSERT_EQUAL(max_depth, node->max_depth);
+        TEST_ASSERT_EQUAL(*min_depth, node->min_depth);
+        return max_depth;
+}
+
+/**
+ * @brief Check the path which starts from node and return number of nodes
+ * in the paths of the subtree
+ */
+static size_t check_paths(struct tg_bst_node *node)
+{
+        struct rb_tree *aux;
+        struct rb_node *x;
+        size_t nr_nodes = 0, min_depth = 0;
+        key_t prev_key = 0;
+
+        if (!node) {
+                return 0;
+        }
+
+        if (node->path) {
+                TEST_ASSERT_EQUAL_PTR(node, node->path->top);
+                TEST_ASSERT_TRUE(!node->parent ||
+                                 (node->parent->left == node ?
+                                          node->parent->prefer != TG_BST_LEFT :
+                                          node->parent->prefer != TG_BST_RIGHT));
+                aux = node->path->aux;
+                for (x = rb_tree_minimum(aux, aux->root); x != aux->nil;
+                     x = rb_tree_successor(aux, x)) {
+                        struct tg_bst_node *ref = tg_aux_entry(x)->ref;
+                        TEST_ASSERT_TRUE(nr_nodes == 0 || prev_key < x->key);
+                        TEST_ASSERT_EQUAL(ref->key, x->key);
+                        TEST_ASSERT_EQUAL(ref->depth, tg_aux_entry(x)->depth);
+                        if (ref != node) {
+                                TEST_ASSERT_TRUE(ref->depth > node->depth);
+                                TEST_ASSERT_TRUE(
+                                        ref->parent->prefer ==
+                                        (ref->parent->left == ref ?
+                                                 TG_BST_LEFT :
+                                                 TG_BST_RIGHT));
+                        }
+                        prev_key = x->key;
+                        nr_nodes++;
+                }
+                TEST_ASSERT_EQUAL(node->path->nr_nodes, nr_nodes);
+                TEST_ASSERT_EQUAL(node->depth + nr_nodes - 1,
+                                  check_depth_range(aux, aux->root,
+                                                    &min_depth));
+                TEST_ASSERT_EQUAL(node->depth, min_depth);
+        }
+
+        return nr_nodes + check_paths(node->left) + check_paths(node->right);
+}
+
 void test_tg_tree_search(void)
 {
         tg_bst_tree_dump(tree->ref);
+        TEST_ASSERT_EQUAL(KEY_SIZE(keys), check_paths(tree->ref->root));
+
+        for (size_t i = 0; i < KEY_SIZE(keys); i++) {
+                struct tg_bst_node *node = tg_tree_search(tree, keys[i]);
+                TEST_ASSERT_NOT_NULL(node);
+                TEST_ASSERT_EQUAL(keys[i], node->key);
+                TEST_ASSERT_EQUAL(KEY_SIZE(keys), check_paths(tree->ref->root));
+        }
+
+        TEST_ASSERT_NULL(tg_tree_search(tree, 0));
+        TEST_ASSERT_NULL(tg_tree_search(tree, 16));
+        TEST_ASSERT_EQUAL(KEY_SIZE(keys), check_paths(tree->ref->root));
+}
+
+void test_tg_tree_preferred_path(void)
+{
+        for (size_t i = 0; i < KEY_SIZE(keys); i++) {
+                struct tg_bst_node *node = tg_tree_search(tree, keys[i]);
+                struct rb_tree *aux = tree->root->aux;
+
+                /* root path must be the search path of the key */
+                TEST_ASSERT_EQUAL(node->depth, tree->root->nr_nodes);
+                for (struct tg_bst_node *p = node; p; p = p->parent) {
+                        TEST_ASSERT_NOT_NULL(rb_tree_search(aux, p->key));
+                }
+        }
+}
+
+void test_tg_tree_cut_and_join(void)
+{
+        struct tg_bst_node *node = tg_tree_search(tree, 1);
+        struct tg_node *root = tree->root;
+        struct tg_node *lower = NULL;
+        size_t nr_nodes = root->nr_nodes;
+
+        TEST_ASSERT_NOT_NULL(node);
+        TEST_ASSERT_EQUAL(0, tg_tree_cut(root, nr_nodes, &lower));
+        TEST_ASSERT_NULL(lower);
+        TEST_ASSERT_EQUAL(nr_nodes, root->nr_nodes);
+
+        TEST_ASSERT_EQUAL(0, tg_tree_cut(root, 1, &lower));
+        TEST_ASSERT_NOT_NULL(lower);
+        TEST_ASSERT_EQUAL(2, lower->top->depth);
+        TEST_ASSERT_EQUAL_PTR(lower, lower->top->path);
+        TEST_ASSERT_EQUAL(1, root->nr_nodes);
+        TEST_ASSERT_EQUAL(nr_nodes - 1, lower->nr_nodes);
+
+        TEST_ASSERT_EQUAL_PTR(root, tg_tree_join(tree, root, lower));
+        TEST_ASSERT_EQUAL(nr_nodes, root->nr_nodes);
+        TEST_ASSERT_EQUAL(KEY_SIZE(keys), check_paths(tree->ref->root));
+}
+
+static void make_balanced_order(key_t *arr, size_t *nr, key_t lo, key_t hi)
+{
+        key_t mid;
+        if (lo > hi) {
+                return;
+        }
+        mid = lo + (hi - lo) / 2;
+        arr[(*nr)++] = mid;
+        if (mid > lo) {
+                make_balanced_order(arr, nr, lo, mid - 1);
+        }
+        make_balanced_order(arr, nr, mid + 1, hi);
+}
+
+void test_tg_tree_repetitive_access(void)
+{
+        key_t big_keys[NR_BIG_KEYS];
+        key_t working_set[16];
+        size_t nr = 0;
+
+        make_balanced_order(big_keys, &nr, 1, NR_BIG_KEYS);
+        TEST_ASSERT_EQUAL(NR_BIG_KEYS, nr);
+
+        tg_tree_dealloc(tree);
+        tree = tg_tree_alloc(big_keys, NR_BIG_KEYS);
+        TEST_ASSERT_NOT_NULL(tree);
+
+        for (int i = 0; i < 16; i++) {
+                working_set[i] = rand() % NR_BIG_KEYS + 1;
+        }
+        for (int i = 0; i < NR_ACCESSES; i++) {
+                key_t key = (i % 4 ? working_set[rand() % 16] :
+                                     (key_t)(rand() % NR_BIG_KEYS + 1));
+                struct tg_bst_node *node = tg_tree_search(tree, key);
+                TEST_ASSERT_NOT_NULL(node);
+                TEST_ASSERT_EQUAL(key, node->key);
+                if (i % 500 == 0) {
+                        TEST_ASSERT_EQUAL(NR_BIG_KEYS,
+                                          check_paths(tree->ref->root));
+                }
+        }
+        TEST_ASSERT_EQUAL(NR_BIG_KEYS, check_paths(tree->ref->root));
+}
+
+static size_t check_ref(struct tg_bst_node *node, key_t *prev, size_t *nr)
+{
+        size_t left_depth, right_depth;
+        if (!node) {
+                return 0;
+        }
+        TEST_ASSERT_EQUAL(node->parent ? node->parent->depth + 1 : 1,
+                          node->depth);
+        left_depth = check_ref(node->left, prev, nr);
+        TEST_ASSERT_TRUE(*nr == 0 || *prev < node->key);
+        *prev = node->key;
+        (*nr)++;
+        right_depth = check_ref(node->right, prev, nr);
+        /* complete tree: left subtree is never shorter than right subtree */
+        TEST_ASSERT_TRUE(left_depth >= right_depth);
+        TEST_ASSERT_TRUE(left_depth <= right_depth + 1);
+        return left_depth + 1;
+}
+
+void test_tg_tree_build_balanced(void)
+{
+        const size_t NR_KEYS = 100000;
+        key_t *sorted = (key_t *)malloc(sizeof(key_t) * NR_KEYS);
+        key_t prev = 0;
+        size_t nr = 0, height;
+
+        TEST_ASSERT_NOT_NULL(sorted);
+        for (size_t i = 0; i < NR_KEYS; i++) {
+                sorted[i] = i * 3;
+        }
+
+        tg_tree_dealloc(tree);
+        tree = tg_tree_alloc(sorted, NR_KEYS);
+        TEST_ASSERT_NOT_NULL(tree);
+        free(sorted);
+
+        height = check_ref(tree->ref->root, &prev, &nr);
+        TEST_ASSERT_EQUAL(NR_KEYS, nr);
+        TEST_ASSERT_EQUAL(17, height); /* floor(lg(100000)) + 1 */
+        TEST_ASSERT_EQUAL(NR_KEYS, check_paths(tree->ref->root));
+
+        for (size_t i = 0; i < NR_KEYS; i += 7) {
+                TEST_ASSERT_EQUAL(i * 3, tg_tree_search(tree, i * 3)->key);
+                TEST_ASSERT_NULL(tg_tree_search(tree, i * 3 + 1));
+        }
+        TEST_ASSERT_EQUAL(NR_KEYS, check_paths(tree->ref->root));
+}
+
+void test_tg_tree_build_duplicated(void)
+{
+        key_t dup_keys[] = { 5, 3, 5, 1, 3, 9, 7, 1 };
+        key_t prev = 0;
+        size_t nr = 0;
+
+        tg_tree_dealloc(tree);
+        tree = tg_tree_alloc(dup_keys, KEY_SIZE(dup_keys));
+        TEST_ASSERT_NOT_NULL(tree);
+        check_ref(tree->ref->root, &prev, &nr);
+        TEST_ASSERT_EQUAL(5, nr);
+        TEST_ASSERT_EQUAL(7, tree->ref->root->key); /* left is complete */
+        TEST_ASSERT_NULL(tg_bst_tree_build(dup_keys, KEY_SIZE(dup_keys)));
+}
+
+void test_tg_aux_depth_bounded_query(void)
+{
+        key_t big_keys[NR_BIG_KEYS];
+        struct rb_tree *aux;
+
+        for (int i = 0; i < NR_BIG_KEYS; i++) {
+                big_keys[i] = i * 2;
+        }
+        tg_tree_dealloc(tree);
+        tree = tg_tree_alloc(big_keys, NR_BIG_KEYS);
+        TEST_ASSERT_NOT_NULL(tree);
+
+        for (int i = 0; i < 200; i++) {
+                TEST_ASSERT_NOT_NULL(tg_tree_search(tree, big_keys[i * 5]));
+                aux = tree->root->aux;
+                for (int q = 0; q < 20; q++) {
+                        key_t key = rand() % (NR_BIG_KEYS * 2);
+                        size_t depth = rand() % 11;
+                        struct tg_aux_node *succ = NULL, *pred = NULL;
+                        struct rb_node *x;
+
+                        for (x = rb_tree_minimum(aux, aux->root);
+                             x != aux->nil; x = rb_tree_successor(aux, x)) {
+                                if (tg_aux_entry(x)->depth <= depth) {
+                                        continue;
+                                }
+                                if (x->key <= key) {
+                                        pred = tg_aux_entry(x);
+                                }
+                                if (x->key >= key && !succ) {
+                                        succ = tg_aux_entry(x);
+                                }
+                        }
+                        TEST_ASSERT_EQUAL_PTR(succ, tg_aux_successor_deeper(
+                                                            aux, key, depth));
+                        TEST_ASSERT_EQUAL_PTR(pred, tg_aux_predecessor_deeper(
+                                                            aux, key, depth));
+                }
+        }
+        TEST_ASSERT_EQUAL(NR_BIG_KEYS, check_paths(tree->ref->root));
 }
 
 int main(void)
 {
         UNITY_BEGIN();
         RUN_TEST(test_tg_tree_search);
+        RUN_TEST(test_tg_tree_preferred_path);
+        RUN_TEST(test_tg_tree_cut_and_join);
+        RUN_TEST(test_tg_tree_repetitive_access);
+        RUN_TEST(test_tg_tree_build_balanced);
+        RUN_TEST(test_tg_tree_build_duplicated);
+        RUN_TEST(test_tg_aux_depth_bounded_query);
         return UNITY_END();
-}
\ No newline at end of file
+}